@@ -1,4 +1,5 @@
 #!/usr/bin/env python3
+import os
 import subprocess
 import sys
 import time
@@ -10,10 +11,16 @@ from statistics import mean
 #
 # Example:
 #   python3 benchmark_testers.py bamberg.slg 0.05 8 1 100
+#
+# With SLGRAPHD_SOCKET set, the testers run in slgraphd on its first graph (graph_path is only printed),
+# which keeps the graph open and warm across runs.
 
 
-def run_one(cmd):
+def run_one(cmd, client=None):
     t0 = time.perf_counter()
+    if client:
+        final = client.tester(cmd[0].rsplit("_", 1)[1], *cmd[2:])
+        return time.perf_counter() - t0, final
     cp = subprocess.run(cmd, capture_output=True, text=True, check=True)
     dt = time.perf_counter() - t0
     lines = [ln.strip() for ln in cp.stdout.splitlines() if ln.strip()]
@@ -21,7 +28,7 @@ def run_one(cmd):
     return dt, final
 
 
-def bench(exe, graph, eps, degree, seed_start, seed_end, use_seed):
+def bench(exe, graph, eps, degree, seed_start, seed_end, use_seed, client=None):
     times = []
     accepts = 0
     rejects = 0
@@ -29,7 +36,7 @@ def bench(exe, graph, eps, degree, seed_start, seed_end, use_seed):
 
     for seed in range(seed_start, seed_end + 1):
         cmd = [exe, graph, eps, degree, str(seed)] if use_seed else [exe, graph]
-        dt, final = run_one(cmd)
+        dt, final = run_one(cmd, client)
         times.append(dt)
         if final.startswith("ACCEPT"):
             accepts += 1
@@ -78,11 +85,16 @@ def main():
     if len(sys.argv) >= 6:
         seed_end = int(sys.argv[5])
 
+    client = None
+    if os.environ.get("SLGRAPHD_SOCKET"):
+        from slgraphd_client import Client
+        client = Client(os.environ["SLGRAPHD_SOCKET"])
+
     print(f"GRAPH={graph} eps={eps} d={degree} seeds={seed_start}..{seed_end}\n")
 
-    classical = bench("test/slgraph_tester_classical", graph, eps, degree, seed_start, seed_end, False)
-    basic = bench("test/slgraph_tester_basic", graph, eps, degree, seed_start, seed_end, True)
-    improved = bench("test/slgraph_tester_improved", graph, eps, degree, seed_start, seed_end, True)
+    classical = bench("test/slgraph_tester_classical", graph, eps, degree, seed_start, seed_end, False, client)
+    basic = bench("test/slgraph_tester_basic", graph, eps, degree, seed_start, seed_end, True, client)
+    improved = bench("test/slgraph_tester_improved", graph, eps, degree, seed_start, seed_end, True, client)
 
     print("CLASSICAL")
     print_result("classical", classical)
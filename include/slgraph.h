@@ -1,7 +1,20 @@
+#ifndef SLGRAPH_H
+#define SLGRAPH_H
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+// restrict is not a C++ keyword. For the C++ API, see slgraph.hpp.
+#define restrict __restrict
+extern "C" {
+#endif
+
+struct slgraph_cache;
+struct slgraph_shards;
+struct slgraph_wal;
+
 struct slgraph_t
 {
 	int fd;
@@ -10,6 +23,9 @@ struct slgraph_t
 	size_t size;
 	size_t free;
 	uint64_t version;
+	struct slgraph_cache *cache; // Block cache, if the graph is read through the block cache backend (ptr is 0 then).
+	struct slgraph_shards *shards; // Shards, if the graph was opened from a manifest (ptr is 0 then).
+	struct slgraph_wal *wal; // Write-ahead log, if the graph was opened with slgraph_open_batched().
 };
 
 typedef struct slgraph_t slgraph_t;
@@ -35,8 +51,51 @@ void slgraph_write64(unsigned char *ptr, uint_fast64_t v);
 int slgraph_new(slgraph_t *g);
 
 // Open the file at filename as g. Returns 0 if successful. Complexity O(1).
+// If filename is the manifest of a sharded graph, g is opened as one read-only graph (see below).
+// If readonly is set and the environment variable SLGRAPH_BACKEND is "cache", g is opened with slgraph_open_cached(),
+// configured by SLGRAPH_CACHE_MB, SLGRAPH_CACHE_BLOCK_KB, SLGRAPH_CACHE_PREFETCH and SLGRAPH_CACHE_THREADS.
+// Batches committed to the write-ahead log of the file (see below) but not yet fully written to it are replayed first,
+// which takes O(size of the log). Read-only opens fail while there are any.
 int slgraph_open(slgraph_t *g, const char *restrict filename, bool readonly);
 
+// Like slgraph_open(), but fails instead of creating an empty graph if there is no file at filename. For tools that
+// read a graph and may store results in it. Complexity O(1).
+int slgraph_open_existing(slgraph_t *g, const char *restrict filename, bool readonly);
+
+// === Block cache backend ===
+
+typedef struct
+{
+	size_t block_size;         // Bytes per block, rounded up to a power of two (default 64 KiB)
+	size_t memory_limit;       // Bytes of cached blocks (default 256 MiB, at least one block per shard)
+	unsigned shards;           // Independently locked parts of the cache (default 16)
+	unsigned prefetch;         // Blocks read ahead after a miss (default 4, 0 disables readahead)
+	unsigned prefetch_threads; // Threads doing the readahead (default 2, 0 disables readahead)
+} slgraph_cache_config_t;
+
+typedef struct
+{
+	uint_fast64_t hits;
+	uint_fast64_t misses;
+	uint_fast64_t prefetched;  // Blocks read ahead
+	uint_fast64_t evictions;
+	uint_fast64_t memory;      // Bytes of cache memory
+} slgraph_cache_stats_t;
+
+// Fill config with the default block cache configuration.
+void slgraph_cache_config_default(slgraph_cache_config_t *config);
+
+// Open the file at filename as read-only g without mapping it: reads go through a sharded block cache, using pread(),
+// with memory bounded by config (defaults if config is 0). This keeps resident memory bounded for graphs larger than RAM
+// and works on file systems that don't support mmap. Access functions work as usual, but functions returning pointers
+// into the graph (slgraph_section(), slgraph_property()) return 0, and g can't be the source of slgraph_copy().
+// Access functions can be called from several threads at once. Returns 0 if successful. Complexity O(1).
+int slgraph_open_cached(slgraph_t *g, const char *restrict filename, const slgraph_cache_config_t *config);
+
+// Get the block cache statistics of g. Returns 0 if successful, -1 if g does not use the block cache backend.
+// If the environment variable SLGRAPH_CACHE_STATS is set, slgraph_close() prints them to stderr.
+int slgraph_cache_stats(const slgraph_t *g, slgraph_cache_stats_t *stats);
+
 // Reserve space for up to a total of n nodes.
 // Returns 0 if successful. Complexity O(slgraph_nodes()).
 int slgraph_nodelist_expand(slgraph_t *g, uint_fast64_t n);
@@ -45,12 +104,22 @@ int slgraph_nodelist_expand(slgraph_t *g, uint_fast64_t n);
 void slgraph_close(slgraph_t *g);
 
 // Make g a copy of h. Returns 0 if successful. Complexity O(nodes + edges).
+// The copy is compacted: out- and in-incidence lists are packed without spare room or unused space between them.
+// Edge IDs are kept, so removed edges, property columns and other sections are carried over unchanged.
 int slgraph_copy(slgraph_t *g, const slgraph_t *h);
 
+// Same as slgraph_copy(), using up to the given number of threads. Returns 0 if successful. Complexity O(nodes + edges).
+int slgraph_copy_threads(slgraph_t *g, const slgraph_t *h, unsigned threads);
+
+// Get the file size of a compacted copy of h. If it equals the size of h, h is already compacted and its file can be
+// copied as is. Complexity O(nodes).
+uint_fast64_t slgraph_copy_size(const slgraph_t *h, unsigned threads);
+
 // Get the number of nodes in g. Complexity O(1).
 uint_fast64_t slgraph_nodes(const slgraph_t *g);
 
-// Get the number of edges in g. Complexity O(1).
+// Get the bound on edge IDs in g: all edges have IDs below it. This includes removed edges whose slots were not
+// reused or compacted yet; subtract slgraph_removed_edges() for the number of live edges. Complexity O(1).
 uint_fast64_t slgraph_edges(const slgraph_t *g);
 
 // Get the degree of n in g. Complexity O(1).
@@ -93,11 +162,305 @@ slgraph_edge_t slgraph_in_incident(const slgraph_t *g, slgraph_node_t n, uint_fa
 slgraph_node_t slgraph_out_neighbour(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i);
 slgraph_node_t slgraph_in_neighbour(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i);
 
+// Remove directed edge e from g. The edge is swap-removed from both incidence lists (or, if they are sorted, the entries
+// behind it are shifted down and their recorded positions rewritten) and its ID is put on a free list for reuse by
+// slgraph_add_directed_edge(). Other edges keep their IDs, unless a compaction threshold was set (see below). Returns 0
+// if successful. Complexity O(1), O(out-degree of its source + in-degree of its target) if sorted, except for the first
+// removal in a graph, which needs O(nodes + edges) to record incidence list positions, and for compaction.
+int slgraph_remove_edge(slgraph_t *g, slgraph_edge_t e);
+
+// Remove node n and all its incident edges from g. The node ID is not reused. Other edges keep their IDs, unless a
+// compaction threshold was set. Returns 0 if successful. Complexity O(degree), or O(sum of the degrees of its
+// neighbours) if sorted, since each removed edge is shifted out of the list of its other end.
+int slgraph_remove_node(slgraph_t *g, slgraph_node_t n);
+
+// Move live edges into the slots of removed edges, so edge IDs are contiguous again: with k = slgraph_edges() -
+// slgraph_removed_edges() live edges, the live edges with IDs k and above get the IDs of the removed edges below k.
+// Edges below k keep their IDs. Returns 0 if successful. Complexity O(removed edges).
+int slgraph_compact(slgraph_t *g);
+
+// Set the fraction of removed edges at which slgraph_remove_edge() and slgraph_remove_node() call slgraph_compact(),
+// which renumbers edges other than the removed ones. By default they never do (threshold 1.0; 1.0 or more disables
+// it), so edge IDs only change when the caller compacts. Returns 0 if successful. Complexity O(1).
+int slgraph_set_compaction_threshold(slgraph_t *g, double threshold);
+double slgraph_compaction_threshold(const slgraph_t *g);
+
+// Get the number of removed edges still occupying edge IDs, and of removed nodes. Complexity O(1).
+uint_fast64_t slgraph_removed_edges(const slgraph_t *g);
+uint_fast64_t slgraph_removed_nodes(const slgraph_t *g);
+
+// Check whether edge e / node n has been removed. Complexity O(1).
+bool slgraph_edge_removed(const slgraph_t *g, slgraph_edge_t e);
+bool slgraph_node_removed(const slgraph_t *g, slgraph_node_t n);
+
+// === Sorted adjacency ===
+
+// Sort all out-lists by target and all in-lists by source, and keep them sorted from now on: slgraph_add_directed_edge()
+// inserts in order and removal shifts instead of swapping, both in O(degree). Returns 0 if successful.
+// Complexity O(nodes + edges log degree), O(1) if already sorted.
+int slgraph_sort_adjacency(slgraph_t *g);
+
+// Check whether the incidence lists of g are kept sorted. Complexity O(1).
+bool slgraph_sorted_adjacency(const slgraph_t *g);
+
+// Get an edge from u to v (SLGRAPH_INVALID_EDGE if none). Searches the shorter of the out-list of u and the in-list of v.
+// Complexity O(log(min(out-degree(u), in-degree(v)))) with sorted adjacency, O(min(out-degree(u), in-degree(v))) otherwise.
+slgraph_edge_t slgraph_find_edge(const slgraph_t *g, slgraph_node_t u, slgraph_node_t v);
+
+// Check whether there is an edge from u to v. Complexity as slgraph_find_edge().
+bool slgraph_has_edge(const slgraph_t *g, slgraph_node_t u, slgraph_node_t v);
+
+// === Summary ===
+
+typedef struct
+{
+	uint_fast64_t nodes;           // Nodes, not counting removed ones
+	uint_fast64_t edges;           // Edges, not counting removed ones
+	uint_fast64_t max_out_degree;
+	uint_fast64_t max_in_degree;
+	uint_fast64_t self_loops;
+	uint_fast64_t duplicate_edges; // Edges that have the same source and target as an earlier edge
+	uint_fast64_t isolated_nodes;  // Nodes without incident edges, not counting removed ones
+} slgraph_summary_t;
+
+// Store a summary of g, with out-degree and in-degree histograms of max_out_degree + 1 and max_in_degree + 1 entries.
+// The summary stays valid until g is modified. See test/stats.c for computing it. Returns 0 if successful.
+// Complexity O(maximum degree).
+int slgraph_set_summary(slgraph_t *g, const slgraph_summary_t *summary, const uint_fast64_t *out_histogram, const uint_fast64_t *in_histogram);
+
+// Get the stored summary of g. Returns 0 if successful, -1 if there is no summary or g was modified since. Complexity O(1).
+int slgraph_summary(const slgraph_t *g, slgraph_summary_t *summary);
+
+// Get the number of nodes of the given out-degree / in-degree from the stored summary (0 if there is none). Complexity O(1).
+uint_fast64_t slgraph_summary_out_degree_count(const slgraph_t *g, uint_fast64_t degree);
+uint_fast64_t slgraph_summary_in_degree_count(const slgraph_t *g, uint_fast64_t degree);
+
+// === CSR arrays ===
+
+// The adjacency of g can be stored in compressed sparse row form, so that other tools (e.g. the Python bindings) can
+// use it as plain arrays in place. Neighbours are the other ends of the edges, in incidence list order.
+
+// Store the out-neighbours (in-neighbours if reverse is set) of all nodes of g as CSR arrays. They stay valid until g is
+// modified. Returns 0 if successful. Might remap. Complexity O(nodes + edges).
+int slgraph_csr_store(slgraph_t *g, bool reverse);
+
+// Get the nodes + 1 offsets of the stored CSR arrays of g (0 if there are none or g was modified since), and the
+// neighbours in *targets unless targets is 0: those of node n are (*targets)[offsets[n]] to (*targets)[offsets[n + 1] - 1].
+// The arrays are little-endian, so they can only be used directly on little-endian hosts. Complexity O(sections).
+const uint64_t *slgraph_csr(const slgraph_t *g, bool reverse, const uint64_t **targets);
+
+// === Contraction hierarchies ===
+
+// A contraction hierarchy ranks the nodes and adds shortcut arcs, so that shortest paths between any two nodes can be
+// found by two searches that only go up in rank. It is computed from edge weights by a tool (see test/ch_build.c) and
+// stored in g. Like the CSR arrays, it can only be used directly on little-endian hosts.
+
+typedef struct
+{
+	uint64_t node;   // Higher ranked end of the arc
+	double weight;
+	uint64_t middle; // Node the shortcut bypasses, or SLGRAPH_INVALID_NODE for an edge of g
+} slgraph_ch_arc_t;
+
+typedef struct
+{
+	const uint64_t *rank;               // Rank of each node: its position in the contraction order
+	const uint64_t *up;                 // nodes + 1 offsets into up_arcs
+	const slgraph_ch_arc_t *up_arcs;    // Arcs from node n to higher ranked nodes: up_arcs[up[n]] to up_arcs[up[n + 1] - 1]
+	const uint64_t *down;               // nodes + 1 offsets into down_arcs
+	const slgraph_ch_arc_t *down_arcs;  // Arcs to node n from higher ranked nodes, likewise
+} slgraph_ch_t;
+
+// Store a contraction hierarchy of g, replacing any stored before. It stays valid until g is modified. Returns 0 if
+// successful. Might remap. Complexity O(nodes + arcs).
+int slgraph_set_ch(slgraph_t *g, const uint64_t *rank, const uint64_t *up, const slgraph_ch_arc_t *up_arcs, const uint64_t *down, const slgraph_ch_arc_t *down_arcs);
+
+// Get the stored contraction hierarchy of g, pointing into g. Returns 0 if successful, -1 if there is none or g was
+// modified since. Complexity O(sections).
+int slgraph_ch(const slgraph_t *g, slgraph_ch_t *ch);
+
+// === Reachability index ===
+
+// A reachability index answers whether one node can reach another without searching the whole graph. The strongly
+// connected components of g are numbered in topological order, so an edge between components always goes to a higher
+// number, and each component c of their DAG gets an interval [low, post] per randomized DFS of the DAG, with post the
+// postorder number of c and low the smallest one below c: if c reaches d, every interval of d is within that of c. It is
+// computed by a tool (see test/reach_index.c) and stored in g. It can only be used directly on little-endian hosts.
+
+typedef struct
+{
+	uint64_t components;         // Strongly connected components of g
+	uint64_t labels;             // Intervals per component
+	const uint64_t *component;   // Component of each node
+	const uint64_t *dag;         // components + 1 offsets into dag_targets
+	const uint64_t *dag_targets; // Components with an edge from component c, increasing: dag_targets[dag[c]] to dag_targets[dag[c + 1] - 1]
+	const uint64_t *intervals;   // Interval i of component c: low at intervals[2 * (c * labels + i)], post right after it
+} slgraph_reach_t;
+
+// Store the reachability index reach of g, replacing any stored before. It stays valid until g is modified. Returns 0 if
+// successful. Might remap. Complexity O(nodes + components * labels + DAG edges).
+int slgraph_set_reach(slgraph_t *g, const slgraph_reach_t *reach);
+
+// Get the stored reachability index of g, pointing into g. Returns 0 if successful, -1 if there is none or g was
+// modified since. Complexity O(sections).
+int slgraph_reach(const slgraph_t *g, slgraph_reach_t *reach);
+
+// === Property columns ===
+
+// Property columns hold one value of a fixed type per node or per edge, stored contiguously, little-endian
+// and 64-byte aligned, so they can be scanned without touching node or edge entries.
+typedef enum
+{
+	SLGRAPH_U8 = 1,
+	SLGRAPH_U32,
+	SLGRAPH_U64,
+	SLGRAPH_F32,
+	SLGRAPH_F64
+} slgraph_type_t;
+
+typedef enum
+{
+	SLGRAPH_NODE_PROPERTY = 1,
+	SLGRAPH_EDGE_PROPERTY
+} slgraph_scope_t;
+
+// Add a property column called name (at most 18 characters) with one zero-initialized value per node or edge.
+// The values of an edge are zeroed when it is removed, so an edge that reuses its slot starts at zero too.
+// Returns pointer to the column, or 0 on error or if a column of that name but different scope or type exists.
+// Might remap, invalidating pointers into g. Complexity O(nodes) or O(edges).
+void *slgraph_property_add(slgraph_t *g, const char *name, slgraph_scope_t scope, slgraph_type_t type);
+
+// Get a pointer to the values of property column name (0 if there is none), and its scope, type and length in
+// elements. On little-endian hosts the column can be accessed directly as an array of the type. Complexity O(sections).
+void *slgraph_property(const slgraph_t *g, const char *name, slgraph_scope_t *scope, slgraph_type_t *type, uint_fast64_t *length);
+
+// Copy the values for the count nodes or edges starting at first from property column name into values.
+// Returns 0 if successful. Complexity O(count).
+int slgraph_property_get(const slgraph_t *g, const char *name, uint_fast64_t first, uint_fast64_t count, void *values);
+
+// Copy count values into property column name, starting at node or edge first. Grows the column if nodes or edges
+// were added after it was created. Returns 0 if successful. Might remap. Complexity O(count).
+int slgraph_property_set(slgraph_t *g, const char *name, uint_fast64_t first, uint_fast64_t count, const void *values);
+
+// === Original node IDs ===
+
+// Loaders renumber sparse input node IDs (e.g. OSM node IDs) to 0..n-1 in ascending order, and can keep the original IDs
+// in the graph as a sorted dictionary, so results can be reported in terms of the input.
+
+// Store the original IDs of the count nodes starting at 0, which must be strictly ascending, replacing any stored before.
+// Returns 0 if successful. Might remap. Complexity O(count).
+int slgraph_set_original_ids(slgraph_t *g, const uint64_t *ids, uint_fast64_t count);
+
+// Check whether g has original IDs. Complexity O(sections).
+bool slgraph_has_original_ids(const slgraph_t *g);
+
+// Get the original ID of node n: n itself if g has no original IDs, SLGRAPH_INVALID_NODE if n was added after they were
+// stored. Complexity O(sections).
+uint_fast64_t slgraph_original_id(const slgraph_t *g, slgraph_node_t n);
+
+// Get the node with original ID id (SLGRAPH_INVALID_NODE if there is none). Complexity O(log log n) expected for evenly
+// spread IDs, O(log n) worst case.
+slgraph_node_t slgraph_node_by_original_id(const slgraph_t *g, uint_fast64_t id);
+
+// === Sharded graphs ===
+
+// A sharded graph is split by node range into shard files, which can be built independently, and a manifest listing them.
+// Opening the manifest with slgraph_open() presents the shards as one read-only directed graph with global node IDs.
+// All shards are opened with the manifest, which fails if one is missing or doesn't match it.
+// An edge between two shards is stored in both, and slgraph_in_incident() returns the ID of the copy in the shard of its
+// target, so edge IDs are unique but not contiguous. slgraph_edges() counts each edge once.
+// Sections, property columns and the summary of the shards are not available through the manifest.
+
+// Create a shard file at filename (which must not exist or be empty) for the count nodes starting at first of a graph
+// with nodes nodes in total, and open it as g. Returns 0 if successful. Complexity O(count).
+int slgraph_shard_new(slgraph_t *g, const char *restrict filename, slgraph_node_t first, uint_fast64_t count, uint_fast64_t nodes);
+
+// Add a directed edge from src to dst (global node IDs) to shard g. At least one of them must be in the node range of
+// the shard. Returns the local edge ID or SLGRAPH_INVALID_EDGE. Complexity as slgraph_add_directed_edge().
+slgraph_edge_t slgraph_shard_add_edge(slgraph_t *g, slgraph_node_t src, slgraph_node_t dst);
+
+// Write the manifest for the given shard files, listed in node order, to filename. Shard file names are stored relative
+// to the directory of the manifest. Returns 0 if successful. Complexity O(count).
+int slgraph_shards_write_manifest(const char *restrict filename, const char *const *shardfiles, unsigned count);
+
+// === Batched append ===
+
+// Batches of edges can be appended to a directed graph durably, so that a crash while loading doesn't require rebuilding
+// the graph. A batch is written to space the graph doesn't use yet, and the few bytes of the graph it changes in place
+// (list sizes and offsets) are logged to a write-ahead log at <filename>.wal. The batch is committed with an msync() of
+// the pages of the graph it wrote and one fdatasync() of the log, and only then applied in place. slgraph_open() replays
+// committed batches.
+
+// Open the file at filename as g (creating it if needed) for batched appends. Returns 0 if successful.
+// Complexity O(1) plus the replay.
+int slgraph_open_batched(slgraph_t *g, const char *restrict filename);
+
+// Grow g to at least nodes nodes and append count directed edges from src[i] to dst[i] as one batch, committed when
+// this returns. The edges get consecutive IDs; returns the first, or SLGRAPH_INVALID_EDGE on error, in which case g is
+// unchanged. Can be called from several threads at once: batches arriving while another is being committed are
+// committed together (group commit). Slots of removed edges are not reused. Might remap.
+// Complexity O(count log count), plus O(degree) for each touched node of a graph with sorted adjacency.
+slgraph_edge_t slgraph_append_edges(slgraph_t *g, uint_fast64_t nodes, const slgraph_node_t *src, const slgraph_node_t *dst, uint_fast64_t count);
+
+// Write all changes to g to its file and empty the write-ahead log. Must be called before g is changed other than by
+// slgraph_append_edges(). slgraph_close() does it too. Returns 0 if successful.
+int slgraph_checkpoint(slgraph_t *g);
+
+// === Random walks ===
+
+// Walks are advanced in batches, one step of every walker of a batch at a time, so the memory accesses of the walkers
+// overlap instead of each step waiting for the previous one. Random numbers come from a counter-based generator
+// (Philox4x32-10) applied to (seed, walk, step), so a walk only depends on the seed, its index and its start.
+
+typedef struct
+{
+	uint_fast64_t length; // Steps per walk (default 32)
+	double restart;       // Probability of jumping back to the start instead of taking a step (default 0)
+	bool reverse;         // Follow in-edges instead of out-edges (default false)
+	uint64_t seed;        // (default 0)
+	unsigned batch;       // Walkers advanced together (default 1024)
+} slgraph_walk_config_t;
+
+typedef struct
+{
+	slgraph_node_t end;    // Node the walk ended at
+	uint_fast64_t steps;   // Steps taken, including restarts
+	uint_fast64_t returns; // Steps that led back to the start, not counting restarts
+} slgraph_walk_t;
+
+// Fill config with the default walk configuration.
+void slgraph_walk_config_default(slgraph_walk_config_t *config);
+
+// Walk from each of the count nodes in starts, configured by config (defaults if config is 0). Walks follow edges in
+// either direction if they are undirected. A walk at a node it can't leave restarts if config->restart is positive and
+// ends otherwise. If visits is not 0, visits[v] is incremented each time a walk is at node v, including its start. If
+// walks is not 0, walks[i] describes the walk from starts[i]. Returns 0 if successful.
+// Complexity O(count * length).
+int slgraph_random_walks(const slgraph_t *g, const slgraph_node_t *starts, uint_fast64_t count, const slgraph_walk_config_t *config, uint_fast64_t *visits, slgraph_walk_t *walks);
+
+// === Sections ===
+
+// Get a pointer to the data of the named section and its size in bytes (0 if g has no such section).
+// Section data is aligned to 64 bytes. Complexity O(sections).
+unsigned char *slgraph_section(const slgraph_t *g, const char *name, uint_fast64_t *size);
+
+// Create the named section with size bytes, or grow it to size bytes, keeping its contents. New bytes are zero.
+// Returns pointer to the section data or 0 on error. Might remap, invalidating pointers into g. Complexity O(size).
+unsigned char *slgraph_section_reserve(slgraph_t *g, const char *name, uint_fast64_t size);
+
 // === Internal accessors ===
 
+#ifndef __cplusplus
 // Get pointer to node list
 static unsigned char *slgraph_nodelist(const slgraph_t *g);
 
 // Get pointer to edge list
 static unsigned char *slgraph_edgelist(const slgraph_t *g);
+#endif
+
+#ifdef __cplusplus
+}
+#undef restrict
+#endif
 
+#endif
@@ -0,0 +1,298 @@
+// C++17 header-only access to mapped SLGraphs.
+//
+// graph_view<Version> reads a graph opened with slgraph_open() directly from its mapping: the neighbour ranges walk the
+// raw incidence lists, so iterating over them is inlined pointer arithmetic instead of one call per neighbour. The
+// layout is fixed by the template parameters (format version and ID width), so the entry sizes are constants.
+// visit() picks the instantiation matching a graph at run time.
+//
+// A view is invalidated by anything that might remap the graph or change its lists (adding or removing nodes or
+// edges, sorting, closing). Graphs read through the block cache or from a shard manifest are not mapped and can't be
+// viewed. For the Boost Graph Library adapters, see slgraph_boost.hpp.
+
+#ifndef SLGRAPH_HPP
+#define SLGRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "slgraph.h"
+
+namespace slgraph
+{
+
+using node_type = std::uint64_t;
+using edge_type = std::uint64_t;
+
+constexpr node_type invalid_node = SLGRAPH_INVALID_NODE;
+constexpr edge_type invalid_edge = SLGRAPH_INVALID_EDGE;
+
+// An edge as seen from one of its ends: out-ranges yield edges with source the node they were taken from, in-ranges
+// edges with target that node. Edges compare by ID.
+struct edge
+{
+	edge_type id = invalid_edge;
+	node_type source = invalid_node;
+	node_type target = invalid_node;
+
+	friend bool operator==(const edge &a, const edge &b) { return a.id == b.id; }
+	friend bool operator!=(const edge &a, const edge &b) { return a.id != b.id; }
+};
+
+namespace detail
+{
+
+// Read a little-endian integer of Bytes bytes.
+template <unsigned Bytes, std::size_t... I>
+inline std::uint64_t load(const unsigned char *p, std::index_sequence<I...>)
+{
+	return ((std::uint64_t(p[I]) << (8 * I)) | ...);
+}
+
+template <unsigned Bytes>
+inline std::uint64_t load(const unsigned char *p)
+{
+	static_assert(Bytes >= 1 && Bytes <= 8, "IDs and offsets are at most 8 bytes");
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	// 48-bit IDs as one 32-bit and one 16-bit load; byte-wise reads of them aren't always merged.
+	if constexpr(Bytes == 6)
+	{
+		std::uint32_t lo;
+		std::uint16_t hi;
+		std::memcpy(&lo, p, 4);
+		std::memcpy(&hi, p + 4, 2);
+		return lo | std::uint64_t(hi) << 32;
+	}
+	if constexpr(Bytes == 8)
+	{
+		std::uint64_t v;
+		std::memcpy(&v, p, 8);
+		return v;
+	}
+#endif
+	return load<Bytes>(p, std::make_index_sequence<Bytes>());
+}
+
+// The file layout for a given ID width (see doc/README).
+template <unsigned IdBytes>
+struct layout
+{
+	static constexpr std::size_t list_header = 2 * IdBytes;     // Capacity, length
+	static constexpr std::size_t node_size = 8 + 8 + IdBytes;   // Out-list offset, in-list offset, label
+	static constexpr std::size_t edge_size = 3 * IdBytes + 1;   // Node 0, node 1, label, flags
+	static constexpr std::size_t incidence_size = IdBytes;      // Edge ID
+	static constexpr std::size_t header_nodelist = 16 + 8;
+	static constexpr std::size_t header_edgelist = 16 + 8 * 2;
+};
+
+// What an incidence list iterator yields: the neighbour, or the edge with its ends.
+enum class yield
+{
+	neighbour,
+	edge
+};
+
+// Iterator over an incidence list of owner. Out selects the side owner is on in the edges it yields. The neighbour is
+// the end of the edge that isn't owner, which also covers undirected edges (listed in the out-lists of both ends).
+template <unsigned IdBytes, yield Yield, bool Out>
+class incidence_iterator
+{
+public:
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = std::conditional_t<Yield == yield::neighbour, node_type, edge>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	using reference = value_type;
+
+	incidence_iterator() = default;
+	incidence_iterator(const unsigned char *pos, const unsigned char *edges, node_type owner) : pos(pos), edges(edges), owner(owner) {}
+
+	value_type operator*() const
+	{
+		const edge_type e = load<IdBytes>(pos);
+		const unsigned char *ends = edges + e * layout<IdBytes>::edge_size;
+		const node_type n0 = load<IdBytes>(ends);
+		const node_type n1 = load<IdBytes>(ends + IdBytes);
+		const node_type other = n0 == owner ? n1 : n0;
+
+		if constexpr(Yield == yield::neighbour)
+			return other;
+		else if constexpr(Out)
+			return edge{e, owner, other};
+		else
+			return edge{e, other, owner};
+	}
+	value_type operator[](difference_type i) const { return *(*this + i); }
+
+	incidence_iterator &operator++() { pos += IdBytes; return *this; }
+	incidence_iterator operator++(int) { incidence_iterator i = *this; pos += IdBytes; return i; }
+	incidence_iterator &operator--() { pos -= IdBytes; return *this; }
+	incidence_iterator operator--(int) { incidence_iterator i = *this; pos -= IdBytes; return i; }
+	incidence_iterator &operator+=(difference_type n) { pos += n * difference_type(IdBytes); return *this; }
+	incidence_iterator &operator-=(difference_type n) { pos -= n * difference_type(IdBytes); return *this; }
+	friend incidence_iterator operator+(incidence_iterator i, difference_type n) { return i += n; }
+	friend incidence_iterator operator+(difference_type n, incidence_iterator i) { return i += n; }
+	friend incidence_iterator operator-(incidence_iterator i, difference_type n) { return i -= n; }
+	friend difference_type operator-(const incidence_iterator &a, const incidence_iterator &b) { return (a.pos - b.pos) / difference_type(IdBytes); }
+
+	friend bool operator==(const incidence_iterator &a, const incidence_iterator &b) { return a.pos == b.pos; }
+	friend bool operator!=(const incidence_iterator &a, const incidence_iterator &b) { return a.pos != b.pos; }
+	friend bool operator<(const incidence_iterator &a, const incidence_iterator &b) { return a.pos < b.pos; }
+	friend bool operator>(const incidence_iterator &a, const incidence_iterator &b) { return a.pos > b.pos; }
+	friend bool operator<=(const incidence_iterator &a, const incidence_iterator &b) { return a.pos <= b.pos; }
+	friend bool operator>=(const incidence_iterator &a, const incidence_iterator &b) { return a.pos >= b.pos; }
+
+private:
+	const unsigned char *pos = nullptr;   // Current entry
+	const unsigned char *edges = nullptr; // First edge entry
+	node_type owner = invalid_node;
+};
+
+} // namespace detail
+
+// A pair of iterators, usable in range-based for loops.
+template <class Iterator>
+class range
+{
+public:
+	using iterator = Iterator;
+
+	range() = default;
+	range(Iterator first, Iterator last) : first(first), last(last) {}
+
+	Iterator begin() const { return first; }
+	Iterator end() const { return last; }
+	std::size_t size() const { return std::size_t(last - first); }
+	bool empty() const { return first == last; }
+	auto operator[](std::size_t i) const { return first[i]; }
+
+private:
+	Iterator first, last;
+};
+
+// Read-only view of a mapped graph of format version Version (1: undirected, incidence lists only; 2: directed, with
+// separate out- and in-lists) with IdBytes-byte node and edge IDs.
+template <unsigned Version, unsigned IdBytes = 6>
+class graph_view
+{
+	static_assert(Version == 1 || Version == 2, "Unknown format version");
+	using layout = detail::layout<IdBytes>;
+
+public:
+	static constexpr unsigned version = Version;
+
+	using out_neighbour_iterator = detail::incidence_iterator<IdBytes, detail::yield::neighbour, true>;
+	using in_neighbour_iterator = detail::incidence_iterator<IdBytes, detail::yield::neighbour, false>;
+	using out_edge_iterator = detail::incidence_iterator<IdBytes, detail::yield::edge, true>;
+	using in_edge_iterator = detail::incidence_iterator<IdBytes, detail::yield::edge, false>;
+
+	graph_view() = default;
+
+	// Throws std::invalid_argument if g isn't mapped or has another format version.
+	explicit graph_view(const slgraph_t &g)
+	{
+		if(!g.ptr || g.version != Version)
+			throw std::invalid_argument("slgraph::graph_view: graph is not mapped or has another format version");
+
+		base = g.ptr;
+		nodelist = base + detail::load<8>(base + layout::header_nodelist);
+		edgelist = base + detail::load<8>(base + layout::header_edgelist);
+		node_count = detail::load<IdBytes>(nodelist + IdBytes);
+		edge_count = detail::load<IdBytes>(edgelist + IdBytes);
+		nodelist += layout::list_header;
+		edgelist += layout::list_header;
+	}
+
+	node_type nodes() const { return node_count; }
+	edge_type edges() const { return edge_count; }
+
+	// Number of entries in the out- and in-lists. Version 1 graphs are undirected, their in-lists are their out-lists.
+	std::size_t out_degree(node_type v) const { return list_size(v, 0); }
+	std::size_t in_degree(node_type v) const { return list_size(v, 8); }
+
+	range<out_neighbour_iterator> out_neighbours(node_type v) const { return list<out_neighbour_iterator>(v, 0); }
+	range<in_neighbour_iterator> in_neighbours(node_type v) const { return list<in_neighbour_iterator>(v, 8); }
+	range<out_edge_iterator> out_edges(node_type v) const { return list<out_edge_iterator>(v, 0); }
+	range<in_edge_iterator> in_edges(node_type v) const { return list<in_edge_iterator>(v, 8); }
+
+	// The ends of edge e, in the order they were added.
+	std::pair<node_type, node_type> edge_ends(edge_type e) const
+	{
+		const unsigned char *ends = edgelist + e * layout::edge_size;
+		return {detail::load<IdBytes>(ends), detail::load<IdBytes>(ends + IdBytes)};
+	}
+
+private:
+	const unsigned char *list_at(node_type v, std::size_t field) const
+	{
+		if constexpr(Version == 1)
+			field = 0;
+
+		const std::uint64_t offset = detail::load<8>(nodelist + v * layout::node_size + field);
+		return offset ? base + offset : nullptr;
+	}
+
+	std::size_t list_size(node_type v, std::size_t field) const
+	{
+		const unsigned char *l = list_at(v, field);
+		return l ? std::size_t(detail::load<IdBytes>(l + IdBytes)) : 0;
+	}
+
+	template <class Iterator>
+	range<Iterator> list(node_type v, std::size_t field) const
+	{
+		const unsigned char *l = list_at(v, field);
+		if(!l)
+			return {};
+
+		const unsigned char *first = l + layout::list_header;
+		return {Iterator(first, edgelist, v), Iterator(first + detail::load<IdBytes>(l + IdBytes) * layout::incidence_size, edgelist, v)};
+	}
+
+	const unsigned char *base = nullptr;
+	const unsigned char *nodelist = nullptr; // First node entry
+	const unsigned char *edgelist = nullptr; // First edge entry
+	node_type node_count = 0;
+	edge_type edge_count = 0;
+};
+
+// Call f with the graph_view matching the format version of g, and return its result.
+// Throws std::invalid_argument if g isn't mapped.
+template <class F>
+decltype(auto) visit(const slgraph_t &g, F &&f)
+{
+	if(g.version == 1)
+		return std::forward<F>(f)(graph_view<1>(g));
+	return std::forward<F>(f)(graph_view<2>(g));
+}
+
+// A graph file opened read-only for the lifetime of the object.
+class file
+{
+public:
+	// Throws std::runtime_error if the file can't be opened.
+	explicit file(const char *filename)
+	{
+		if(slgraph_open(&g, filename, true))
+			throw std::runtime_error(std::string("slgraph::file: failed to open ") + filename);
+	}
+	~file() { slgraph_close(&g); }
+
+	file(const file &) = delete;
+	file &operator=(const file &) = delete;
+
+	const slgraph_t &get() const { return g; }
+	operator const slgraph_t &() const { return g; }
+
+private:
+	slgraph_t g;
+};
+
+} // namespace slgraph
+
+#endif
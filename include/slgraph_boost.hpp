@@ -0,0 +1,126 @@
+// Boost Graph Library adapters for slgraph::graph_view (see slgraph.hpp).
+//
+// A graph_view models IncidenceGraph, BidirectionalGraph, AdjacencyGraph and VertexListGraph, with vertex_index as the
+// identity, so BGL algorithms run directly on a mapped graph:
+//
+//   slgraph::file f("graph.slg");
+//   slgraph::graph_view<2> g(f);
+//   std::vector<std::uint64_t> component(num_vertices(g));
+//   auto count = boost::strong_components(g, boost::make_iterator_property_map(component.begin(), get(boost::vertex_index, g)));
+//
+// Version 2 graphs are directed (bidirectional_tag), version 1 graphs undirected (undirected_tag).
+
+#ifndef SLGRAPH_BOOST_HPP
+#define SLGRAPH_BOOST_HPP
+
+#include <utility>
+
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/properties.hpp>
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/property_map/property_map.hpp>
+
+#include "slgraph.hpp"
+
+namespace boost
+{
+
+template <unsigned Version, unsigned IdBytes>
+struct graph_traits<slgraph::graph_view<Version, IdBytes>>
+{
+	using graph = slgraph::graph_view<Version, IdBytes>;
+
+	struct traversal_category : bidirectional_graph_tag, adjacency_graph_tag, vertex_list_graph_tag {};
+
+	using vertex_descriptor = slgraph::node_type;
+	using edge_descriptor = slgraph::edge;
+	using directed_category = std::conditional_t<Version == 1, undirected_tag, bidirectional_tag>;
+	using edge_parallel_category = allow_parallel_edge_tag;
+
+	using out_edge_iterator = typename graph::out_edge_iterator;
+	using in_edge_iterator = typename graph::in_edge_iterator;
+	using adjacency_iterator = typename graph::out_neighbour_iterator;
+	using vertex_iterator = counting_iterator<slgraph::node_type>;
+
+	using degree_size_type = std::size_t;
+	using vertices_size_type = slgraph::node_type;
+	using edges_size_type = slgraph::edge_type;
+
+	static vertex_descriptor null_vertex() { return slgraph::invalid_node; }
+};
+
+template <unsigned Version, unsigned IdBytes>
+struct property_map<slgraph::graph_view<Version, IdBytes>, vertex_index_t>
+{
+	using type = typed_identity_property_map<slgraph::node_type>;
+	using const_type = type;
+};
+
+} // namespace boost
+
+namespace slgraph
+{
+
+// The functions are found by argument-dependent lookup, as BGL expects.
+
+template <unsigned V, unsigned B>
+std::pair<typename graph_view<V, B>::out_edge_iterator, typename graph_view<V, B>::out_edge_iterator>
+out_edges(node_type v, const graph_view<V, B> &g)
+{
+	const auto r = g.out_edges(v);
+	return {r.begin(), r.end()};
+}
+
+template <unsigned V, unsigned B>
+std::pair<typename graph_view<V, B>::in_edge_iterator, typename graph_view<V, B>::in_edge_iterator>
+in_edges(node_type v, const graph_view<V, B> &g)
+{
+	const auto r = g.in_edges(v);
+	return {r.begin(), r.end()};
+}
+
+template <unsigned V, unsigned B>
+std::pair<typename graph_view<V, B>::out_neighbour_iterator, typename graph_view<V, B>::out_neighbour_iterator>
+adjacent_vertices(node_type v, const graph_view<V, B> &g)
+{
+	const auto r = g.out_neighbours(v);
+	return {r.begin(), r.end()};
+}
+
+template <unsigned V, unsigned B>
+std::pair<boost::counting_iterator<node_type>, boost::counting_iterator<node_type>> vertices(const graph_view<V, B> &g)
+{
+	return {boost::counting_iterator<node_type>(0), boost::counting_iterator<node_type>(g.nodes())};
+}
+
+template <unsigned V, unsigned B>
+node_type source(const edge &e, const graph_view<V, B> &) { return e.source; }
+
+template <unsigned V, unsigned B>
+node_type target(const edge &e, const graph_view<V, B> &) { return e.target; }
+
+template <unsigned V, unsigned B>
+std::size_t out_degree(node_type v, const graph_view<V, B> &g) { return g.out_degree(v); }
+
+template <unsigned V, unsigned B>
+std::size_t in_degree(node_type v, const graph_view<V, B> &g) { return g.in_degree(v); }
+
+// Version 1 graphs are undirected, so each incident edge counts once.
+template <unsigned V, unsigned B>
+std::size_t degree(node_type v, const graph_view<V, B> &g) { return V == 1 ? g.out_degree(v) : g.out_degree(v) + g.in_degree(v); }
+
+template <unsigned V, unsigned B>
+node_type num_vertices(const graph_view<V, B> &g) { return g.nodes(); }
+
+template <unsigned V, unsigned B>
+edge_type num_edges(const graph_view<V, B> &g) { return g.edges(); }
+
+template <unsigned V, unsigned B>
+boost::typed_identity_property_map<node_type> get(boost::vertex_index_t, const graph_view<V, B> &) { return {}; }
+
+template <unsigned V, unsigned B>
+node_type get(boost::vertex_index_t, const graph_view<V, B> &, node_type v) { return v; }
+
+} // namespace slgraph
+
+#endif
@@ -1,4 +1,5 @@
 #!/usr/bin/env python3
+import os
 import subprocess
 import sys
 from collections import Counter
@@ -9,15 +10,26 @@ from collections import Counter
 #
 # Example:
 #   python3 run_20_tests.py bamberg.slg 0.1 9 1 20
+#
+# With SLGRAPHD_SOCKET set, the testers run in slgraphd on its first graph (graph_path is only printed).
+
+client = None
 
 
 def run_one(cmd):
+    if client:
+        return "", client.tester(cmd[0].rsplit("_", 1)[1], *cmd[2:])
     out = subprocess.check_output(cmd, text=True)
     lines = [ln.strip() for ln in out.strip().splitlines() if ln.strip()]
     return lines[0], lines[-1]  # stats, final line
 
 
 def main():
+    global client
+    if os.environ.get("SLGRAPHD_SOCKET"):
+        from slgraphd_client import Client
+        client = Client(os.environ["SLGRAPHD_SOCKET"])
+
     graph = "bamberg.slg"
     eps = "0.1"
     d = "9"
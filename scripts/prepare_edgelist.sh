@@ -9,6 +9,7 @@ Usage:
   scripts/prepare_edgelist.sh --mode osm --input map.osm.pbf --output edges.txt
   scripts/prepare_edgelist.sh --mode osm --input map.osm --output edges.txt
   scripts/prepare_edgelist.sh --mode table --input graph.csv --output edges.txt [options]
+  scripts/prepare_edgelist.sh --mode osm --input map.osm.pbf --output - | test/slgraph_load_edgelist - graph.slg
 
 Modes:
   osm
@@ -22,7 +23,8 @@ Modes:
 Options:
   --mode MODE         Required: osm | table
   --input PATH        Required: input file path
-  --output PATH       Required: output edge-list file path
+  --output PATH       Required: output edge-list file path, or - to stream the
+                      edges to stdout (e.g. straight into slgraph_load_edgelist)
 
   --delimiter STR     table mode only. Default: auto-detect (comma -> CSV,
                       otherwise whitespace split)
@@ -127,83 +129,97 @@ done
 (( SRC_COL >= 1 )) || die "--src-col must be >= 1"
 (( DST_COL >= 1 )) || die "--dst-col must be >= 1"
 
-tmp_out="$(mktemp /tmp/edgelist_raw_XXXXXX.txt)"
-trap 'rm -f "$tmp_out"' EXIT
+# Write "u v" lines for the selected mode to stdout.
+emit_edges() {
+  if [[ "$MODE" == "osm" ]]; then
+    # Keep road ways and export their node-reference sequences, streamed
+    # from one step into the next without intermediate files.
+    osmium tags-filter "$INPUT" w/highway -f pbf -o - \
+      | osmium export -F pbf - -f jsonseq -o - \
+      | jq -r '
+        select(.type == "Feature")
+        | .properties.nodes as $n
+        | if ($n | length) > 1 then
+            range(0; ($n | length) - 1) as $i
+            | "\($n[$i]) \($n[$i + 1])"
+          else empty end
+      '
+  else
+    awk -v src="$SRC_COL" -v dst="$DST_COL" \
+        -v delim="$DELIM" -v skip_header="$SKIP_HEADER" \
+        -v allow_nonnumeric="$ALLOW_NONNUMERIC" '
+      BEGIN {
+        if (delim != "") {
+          FS = delim;
+        } else {
+          FS = "[[:space:]]+";
+        }
+      }
+      NR == 1 && skip_header == 1 { next }
+      /^[[:space:]]*$/ { next }
+      /^[[:space:]]*#/ { next }
+      {
+        if (delim == "" && index($0, ",") > 0) {
+          split($0, f, ",");
+          u = f[src];
+          v = f[dst];
+        } else {
+          if (NF < src || NF < dst) next;
+          u = $src;
+          v = $dst;
+        }
+
+        gsub(/^[[:space:]]+|[[:space:]]+$/, "", u);
+        gsub(/^[[:space:]]+|[[:space:]]+$/, "", v);
+        if (u == "" || v == "") next;
+
+        if (!allow_nonnumeric) {
+          if (u !~ /^[0-9]+$/ || v !~ /^[0-9]+$/) next;
+        }
+
+        print u " " v;
+      }
+    ' "$INPUT"
+  fi
+}
+
+# Emit the reverse edge "v u" for each edge.
+add_reverse() {
+  if (( UNDIRECTED == 1 )); then
+    awk '{ print $1 " " $2; print $2 " " $1 }'
+  else
+    cat
+  fi
+}
+
+dedup() {
+  if (( DEDUP == 1 )); then
+    awk '!seen[$0]++'
+  else
+    cat
+  fi
+}
 
 if [[ "$MODE" == "osm" ]]; then
   require_cmd osmium
   require_cmd jq
-
-  tmp_pbf="$(mktemp /tmp/osm_highways_XXXXXX.osm.pbf)"
-  tmp_json="$(mktemp /tmp/osm_highways_XXXXXX.jsonseq)"
-  trap 'rm -f "$tmp_out" "$tmp_pbf" "$tmp_json"' EXIT
-
-  # Keep road ways and export their node-reference sequences.
-  osmium tags-filter "$INPUT" w/highway -o "$tmp_pbf" --overwrite
-  osmium export "$tmp_pbf" -f jsonseq -o "$tmp_json" --overwrite
-
-  jq -r '
-    select(.type == "Feature")
-    | .properties.nodes as $n
-    | if ($n | length) > 1 then
-        range(0; ($n | length) - 1) as $i
-        | "\($n[$i]) \($n[$i + 1])"
-      else empty end
-  ' "$tmp_json" > "$tmp_out"
-
 elif [[ "$MODE" == "table" ]]; then
   require_cmd awk
-
-  awk -v src="$SRC_COL" -v dst="$DST_COL" \
-      -v delim="$DELIM" -v skip_header="$SKIP_HEADER" \
-      -v allow_nonnumeric="$ALLOW_NONNUMERIC" '
-    BEGIN {
-      if (delim != "") {
-        FS = delim;
-      } else {
-        FS = "[[:space:]]+";
-      }
-    }
-    NR == 1 && skip_header == 1 { next }
-    /^[[:space:]]*$/ { next }
-    /^[[:space:]]*#/ { next }
-    {
-      if (delim == "" && index($0, ",") > 0) {
-        split($0, f, ",");
-        u = f[src];
-        v = f[dst];
-      } else {
-        if (NF < src || NF < dst) next;
-        u = $src;
-        v = $dst;
-      }
-
-      gsub(/^[[:space:]]+|[[:space:]]+$/, "", u);
-      gsub(/^[[:space:]]+|[[:space:]]+$/, "", v);
-      if (u == "" || v == "") next;
-
-      if (!allow_nonnumeric) {
-        if (u !~ /^[0-9]+$/ || v !~ /^[0-9]+$/) next;
-      }
-
-      print u " " v;
-    }
-  ' "$INPUT" > "$tmp_out"
-
 else
   die "Unsupported --mode: $MODE (expected osm or table)"
 fi
 
-if (( UNDIRECTED == 1 )); then
-  awk '{ print $1 " " $2; print $2 " " $1 }' "$tmp_out" > "${tmp_out}.undir"
-  mv "${tmp_out}.undir" "$tmp_out"
-  DEDUP=1
-fi
+(( UNDIRECTED == 0 )) || DEDUP=1
 
-if (( DEDUP == 1 )); then
-  awk '!seen[$0]++' "$tmp_out" > "$OUTPUT"
+if [[ "$OUTPUT" == "-" ]]; then
+  emit_edges | add_reverse | dedup
+  echo "Wrote edge list to stdout" >&2
 else
+  # Write to a temporary file first, so a failed run does not leave a partial edge list behind.
+  tmp_out="$(mktemp /tmp/edgelist_raw_XXXXXX.txt)"
+  trap 'rm -f "$tmp_out"' EXIT
+
+  emit_edges | add_reverse | dedup > "$tmp_out"
   cp "$tmp_out" "$OUTPUT"
+  echo "Wrote edge list: $OUTPUT" >&2
 fi
-
-echo "Wrote edge list: $OUTPUT"
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+import socket
+import struct
+
+
+# Minimal client for slgraphd (see test/slgraphd.h for the protocol).
+#
+# Example:
+#   with Client("/tmp/slgraphd.sock") as c:
+#       print(c.info())
+#       print(c.tester("basic", 0.05, 8, 1))
+
+OPS = {"info": 1, "degree": 2, "neighbours": 3, "sample": 4, "bfs": 5, "tester": 6}
+TESTERS = {"basic": 0, "improved": 1, "classical": 2}
+STATUS = {1: "bad request", 2: "no such graph", 3: "out of memory", 4: "graph has no up-to-date summary"}
+
+
+class Client:
+    def __init__(self, path, graph=0):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.graph = graph
+        self.tag = 0
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def close(self):
+        self.sock.close()
+
+    def _recv(self, n):
+        buf = b""
+        while len(buf) < n:
+            chunk = self.sock.recv(n - len(buf))
+            if not chunk:
+                raise ConnectionError("slgraphd closed the connection")
+            buf += chunk
+        return buf
+
+    def request(self, op, args=()):
+        """Send one request and return the raw result bytes."""
+        self.tag = (self.tag + 1) & 0xFFFFFFFF
+        body = struct.pack("<IBBH", self.tag, OPS[op], self.graph, 0) + b"".join(struct.pack("<Q", a) for a in args)
+        self.sock.sendall(struct.pack("<I", len(body)) + body)
+        size, tag, status = struct.unpack("<III", self._recv(12))
+        payload = self._recv(size - 8)
+        if status:
+            raise RuntimeError(f"slgraphd: {STATUS.get(status, status)}")
+        return payload
+
+    def _u64s(self, payload):
+        return list(struct.unpack(f"<{len(payload) // 8}Q", payload))
+
+    def info(self):
+        nodes, edges, version = self._u64s(self.request("info"))
+        return {"nodes": nodes, "edges": edges, "version": version}
+
+    def degree(self, nodes, incoming=False):
+        return self._u64s(self.request("degree", [int(incoming)] + list(nodes)))
+
+    def neighbours(self, node, first=0, count=2**32, incoming=False):
+        return self._u64s(self.request("neighbours", [int(incoming), node, first, count]))
+
+    def sample(self, seed, count):
+        return self._u64s(self.request("sample", [seed, count]))
+
+    def bfs(self, node, cutoff, incoming=False):
+        return self._u64s(self.request("bfs", [int(incoming), node, cutoff]))[0]
+
+    def tester(self, name, eps=0.0, d=0, seed=1):
+        """Run a tester; d = 0 (or "auto") reads the degree bound from the summary. Returns its result line."""
+        d = 0 if d == "auto" else int(d)
+        eps_bits = struct.unpack("<Q", struct.pack("<d", float(eps)))[0]
+        return self.request("tester", [TESTERS[name], eps_bits, d, int(seed)]).decode()
@@ -4,11 +4,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
 
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <pthread.h>
 
 #define SLGRAPH_HEADERSIZE_BASIC 16
 #define SLGRAPH_HEADERSIZE (SLGRAPH_HEADERSIZE_BASIC + 8 * 3 + 6)
@@ -29,6 +31,69 @@
 #define SLGRAPH_EDGESIZE (6 + 6 + 6 + 1)
 #define SLGRAPH_INCIDENCESIZE 6
 
+// Offsets of the incidence list fields inside a node entry.
+#define SLGRAPH_NODE_OUT 0
+#define SLGRAPH_NODE_IN 8
+
+// Flag byte at the end of an edge entry.
+#define SLGRAPH_EDGE_DIRECTED 0x01
+#define SLGRAPH_EDGE_DELETED 0x02
+
+// Node label marking a removed node.
+#define SLGRAPH_NODE_DELETED 0xfffffffffffeull
+
+// The graph label slot in the header holds the offset of the section table.
+#define SLGRAPH_HEADER_SECTIONS (SLGRAPH_HEADERSIZE_BASIC + 8 * 3)
+#define SLGRAPH_NOSECTIONS 0xffffffffffffull
+#define SLGRAPH_SECTIONNAMESIZE 24
+#define SLGRAPH_SECTIONSIZE (SLGRAPH_SECTIONNAMESIZE + 8 * 3)
+#define SLGRAPH_SECTIONALIGN 64
+
+// Edge position entry: position in the out-list of node0, position in the in-list of node1.
+#define SLGRAPH_EDGEPOSSIZE (6 + 6)
+#define SLGRAPH_EDGEPOS_OUT 0
+#define SLGRAPH_EDGEPOS_IN 6
+
+// Removal state: free edge list head, removed edges, removed nodes, compaction threshold (parts per million).
+#define SLGRAPH_REMOVEDSIZE (8 * 4)
+#define SLGRAPH_COMPACTION_DEFAULT 1000000 // Never, since compaction renumbers edges.
+#define SLGRAPH_FREELIST_END 0xffffffffffffull
+
+// Graph flags section: 8-byte set of flags.
+#define SLGRAPH_FLAG_SORTED 0x01
+#define SLGRAPH_FLAG_SUMMARY 0x02
+#define SLGRAPH_FLAG_CSROUT 0x04
+#define SLGRAPH_FLAG_CSRIN 0x08
+#define SLGRAPH_FLAG_CH 0x10
+#define SLGRAPH_FLAG_REACH 0x20
+#define SLGRAPH_FLAG_DERIVED (SLGRAPH_FLAG_SUMMARY | SLGRAPH_FLAG_CSROUT | SLGRAPH_FLAG_CSRIN | SLGRAPH_FLAG_CH | SLGRAPH_FLAG_REACH) // Dropped on modification
+
+// CSR sections "csr.out" and "csr.in": nodes + 1 8-byte offsets into the following 8-byte neighbours.
+
+// Contraction hierarchy sections: "ch.rank" with an 8-byte rank per node, "ch.up" and "ch.down" with nodes + 1 8-byte
+// offsets into the following arcs of 8-byte node, 8-byte weight (IEEE 754 double) and 8-byte middle node.
+#define SLGRAPH_CHARCSIZE 24
+
+// Reachability index sections: "reach.comp" with 8-byte number of components and labellings followed by an 8-byte
+// component per node, "reach.dag" with components + 1 8-byte offsets into the following 8-byte target components, and
+// "reach.labels" with 8-byte low and post for each labelling of each component.
+#define SLGRAPH_REACHHEADERSIZE 16
+
+// Summary section: 8-byte nodes, edges, maximum out-degree, maximum in-degree, self-loops, duplicate edges and
+// isolated nodes, followed by the out-degree and in-degree histograms.
+#define SLGRAPH_SUMMARYSIZE (8 * 7)
+
+// Lists up to this degree are searched by plain binary search, longer ones are narrowed down by interpolation first.
+#define SLGRAPH_SEARCH_SMALL 64
+
+// Property columns are sections named SLGRAPH_PROPERTYPREFIX followed by the property name.
+// The section info field holds the element type (byte 0) and scope (byte 1).
+#define SLGRAPH_PROPERTYPREFIX "prop."
+#define SLGRAPH_PROPERTYNAMESIZE (SLGRAPH_SECTIONNAMESIZE - sizeof(SLGRAPH_PROPERTYPREFIX) + 1)
+
+// Original ID dictionary section: 8-byte original ID per node, ascending, so node n has the n-th smallest ID.
+#define SLGRAPH_IDSSECTION "ids"
+
 // Write a 6-byte little-endian integer
 void write_6_bytes(unsigned char *dst, uint64_t value) {
     for (int i = 0; i < 6; ++i)
@@ -45,6 +110,20 @@ uint64_t read_6_bytes(const unsigned char *src) {
     return value;
 }
 static int slgraph_resize(slgraph_t *g, size_t s);
+static int slgraph_edgepos_set(slgraph_t *g, slgraph_edge_t e, size_t field, uint_fast64_t pos);
+static slgraph_edge_t slgraph_free_edge(slgraph_t *g);
+static void slgraph_reuse_edge(slgraph_t *g, uint_fast64_t next);
+static void slgraph_unmake_directed_incident(slgraph_t *g, slgraph_node_t n, size_t offset_field, slgraph_edge_t e);
+static void slgraph_properties_move(slgraph_t *g, slgraph_scope_t scope, uint_fast64_t dst, uint_fast64_t src);
+static void slgraph_properties_clear(slgraph_t *g, slgraph_scope_t scope, uint_fast64_t index);
+static unsigned char *slgraph_sectiontable(const slgraph_t *g);
+static uint_fast64_t slgraph_section_find(const slgraph_t *g, const char *name, uint_fast64_t *size, uint_fast64_t *info);
+static int slgraph_open_manifest(slgraph_t *g, const char *restrict filename);
+static int slgraph_wal_replay(const char *restrict filename, int fd);
+static void slgraph_wal_close(slgraph_t *g);
+static uint_fast64_t slgraph_flags(const slgraph_t *g);
+static void slgraph_flags_clear(slgraph_t *g, uint_fast64_t flags);
+static slgraph_node_t slgraph_incident_key(const slgraph_t *g, slgraph_edge_t e, size_t offset_field);
 
 // Add an incidence list with space for at least size neighbours
 static unsigned char *slgraph_add_incidencelist(slgraph_t *g, uint_fast64_t size)
@@ -92,18 +171,42 @@ static int slgraph_make_directed_incident(slgraph_t *g, slgraph_node_t n, size_t
 		listptr = newlist;
 	}
 
-	slgraph_write48(listptr + SLGRAPH_LISTHEADERSIZE + degree * SLGRAPH_INCIDENCESIZE, e);
+	const size_t field = offset_field == SLGRAPH_NODE_OUT ? SLGRAPH_EDGEPOS_OUT : SLGRAPH_EDGEPOS_IN;
+	uint_fast64_t pos = degree;
+
+	if(slgraph_flags(g) & SLGRAPH_FLAG_SORTED) // Keep the list sorted by neighbour.
+	{
+		slgraph_node_t key = slgraph_incident_key(g, e, offset_field);
+		for(; pos && slgraph_incident_key(g, slgraph_read48(listptr + SLGRAPH_LISTHEADERSIZE + (pos - 1) * SLGRAPH_INCIDENCESIZE), offset_field) > key; pos--)
+			memcpy(listptr + SLGRAPH_LISTHEADERSIZE + pos * SLGRAPH_INCIDENCESIZE, listptr + SLGRAPH_LISTHEADERSIZE + (pos - 1) * SLGRAPH_INCIDENCESIZE, SLGRAPH_INCIDENCESIZE);
+	}
+
+	slgraph_write48(listptr + SLGRAPH_LISTHEADERSIZE + pos * SLGRAPH_INCIDENCESIZE, e);
 	slgraph_write48(listptr + SLGRAPH_SIZE, degree + 1);
 
+	if(slgraph_edgepos_set(g, e, field, pos))
+		return(-1);
+
+	// Entries behind the new one have moved. slgraph_edgepos_set() won't remap for them, since their edges are older.
+	listptr = g->ptr + slgraph_read64(slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE + offset_field);
+	for(uint_fast64_t i = pos + 1; i <= degree; i++)
+		slgraph_edgepos_set(g, slgraph_read48(listptr + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE), field, i);
+
 	return(0);
 }
 
-uint_fast64_t slgraph_add_directed_edge(slgraph_t *g, uint_fast64_t src, uint_fast64_t dst) {
+// Add a directed edge from src to dst, putting it into the out-list of out_node and the in-list of in_node, unless
+// they are SLGRAPH_INVALID_NODE. Shard files store global endpoints but local incidence lists.
+static slgraph_edge_t slgraph_append_directed_edge(slgraph_t *g, uint_fast64_t src, uint_fast64_t dst, slgraph_node_t out_node, slgraph_node_t in_node) {
+    slgraph_flags_clear(g, SLGRAPH_FLAG_DERIVED);
+
     uint64_t edge_count = slgraph_edges(g);
     uint64_t edge_capacity = slgraph_read48(slgraph_edgelist(g));
+    slgraph_edge_t edge = slgraph_free_edge(g);
+    uint_fast64_t next = 0;
 
     // Expand edge list if needed
-    if (edge_count >= edge_capacity) {
+    if (edge == SLGRAPH_INVALID_EDGE && edge_count >= edge_capacity) {
         uint64_t newedges = (edge_count + 32) * 4;
         size_t oldsize = g->size;
         size_t newsize = g->size + SLGRAPH_LISTHEADERSIZE + (edge_count + newedges) * SLGRAPH_EDGESIZE;
@@ -118,22 +221,46 @@ uint_fast64_t slgraph_add_directed_edge(slgraph_t *g, uint_fast64_t src, uint_fa
         slgraph_write48(slgraph_edgelist(g), edge_count + newedges);
     }
 
-    // Write edge
-    unsigned char *edge_entry = slgraph_edgelist(g) + SLGRAPH_LISTHEADERSIZE + edge_count * SLGRAPH_EDGESIZE;
+    // Reuse the slot of a removed edge if there is one, append otherwise
+    bool reused = edge != SLGRAPH_INVALID_EDGE;
+    if (!reused) {
+        edge = edge_count;
+        write_6_bytes(slgraph_edgelist(g) + SLGRAPH_SIZE, edge_count + 1);
+    }
+
+    // Write edge, keeping the free list link of a reused slot until the edge is in its lists
+    unsigned char *edge_entry = slgraph_edgelist(g) + SLGRAPH_LISTHEADERSIZE + edge * SLGRAPH_EDGESIZE;
+    if (reused)
+        next = slgraph_read48(edge_entry + 12);
     write_6_bytes(edge_entry, src);
     write_6_bytes(edge_entry + 6, dst);
     write_6_bytes(edge_entry + 12, 0); // label
-    edge_entry[18] = 1; // directed flag
-
-    write_6_bytes(slgraph_edgelist(g) + SLGRAPH_SIZE, edge_count + 1);
+    edge_entry[18] = SLGRAPH_EDGE_DIRECTED;
+    slgraph_properties_clear(g, SLGRAPH_EDGE_PROPERTY, edge); // Values start at zero, in reused slots too
 
     // Handle node incidence lists (grow as needed)
-    if(slgraph_make_directed_incident(g, src, 0, edge_count))
-        return SLGRAPH_INVALID_EDGE;
-    if(slgraph_make_directed_incident(g, dst, 8, edge_count))
-        return SLGRAPH_INVALID_EDGE;
+    int failed = out_node != SLGRAPH_INVALID_NODE && slgraph_make_directed_incident(g, out_node, SLGRAPH_NODE_OUT, edge);
+    if (!failed && in_node != SLGRAPH_INVALID_NODE && slgraph_make_directed_incident(g, in_node, SLGRAPH_NODE_IN, edge)) {
+        if (reused && out_node != SLGRAPH_INVALID_NODE)
+            slgraph_unmake_directed_incident(g, out_node, SLGRAPH_NODE_OUT, edge);
+        failed = 1;
+    }
+
+    if (reused) {
+        if (failed) { // Leave the slot on the free list.
+            edge_entry = slgraph_edgelist(g) + SLGRAPH_LISTHEADERSIZE + edge * SLGRAPH_EDGESIZE;
+            write_6_bytes(edge_entry + 12, next);
+            edge_entry[18] = SLGRAPH_EDGE_DIRECTED | SLGRAPH_EDGE_DELETED;
+            return SLGRAPH_INVALID_EDGE;
+        }
+        slgraph_reuse_edge(g, next);
+    }
+
+    return failed ? SLGRAPH_INVALID_EDGE : edge;
+}
 
-    return edge_count;
+uint_fast64_t slgraph_add_directed_edge(slgraph_t *g, uint_fast64_t src, uint_fast64_t dst) {
+    return slgraph_append_directed_edge(g, src, dst, src, dst);
 }
 
 
@@ -171,6 +298,447 @@ uint_fast64_t slgraph_add_directed_edge(slgraph_t *g, uint_fast64_t src, uint_fa
 		ptr[i] = (v >> i * 8) & 0xff;
 }
 
+// === Block cache storage backend ===
+// Instead of mapping the file, a read-only graph can be read with pread() through a cache of fixed-size blocks.
+// The cache is split into shards by block number, each with its own lock, frames replaced in CLOCK order and an
+// open addressing hash table from block number to frame. After a miss, the following blocks are queued for readahead
+// by a small pool of prefetch threads.
+
+#define SLGRAPH_CACHE_BLOCKSIZE (64 * 1024)
+#define SLGRAPH_CACHE_MEMORY (256 * 1024 * 1024)
+#define SLGRAPH_CACHE_SHARDS 16
+#define SLGRAPH_CACHE_PREFETCH 4
+#define SLGRAPH_CACHE_PREFETCHTHREADS 2
+#define SLGRAPH_CACHE_QUEUE 256
+#define SLGRAPH_CACHE_EMPTY UINT_FAST64_MAX
+
+struct slgraph_cacheshard
+{
+	pthread_mutex_t lock;
+	size_t frames;
+	size_t hand;               // CLOCK hand
+	uint_fast64_t *blocks;     // Block held by each frame (SLGRAPH_CACHE_EMPTY if none)
+	unsigned char *referenced; // CLOCK reference bit of each frame
+	unsigned char *data;       // Frame contents
+	size_t *table;             // Frame + 1 for each hash table slot (0 if the slot is free), linear probing
+	size_t tablemask;
+	uint_fast64_t hits, misses, prefetched, evictions;
+};
+
+struct slgraph_cache
+{
+	int fd;
+	size_t blocksize;
+	unsigned blockshift;
+	uint_fast64_t blocks;
+	unsigned shards;
+	struct slgraph_cacheshard *shard;
+
+	// Header fields and graph flags, which can't change since the graph is read-only.
+	uint_fast64_t nodelist, edgelist, flags;
+
+	// Readahead queue, served by the prefetch threads.
+	unsigned prefetch;
+	unsigned threads;
+	pthread_t *thread;
+	pthread_mutex_t queuelock;
+	pthread_cond_t queuecond;
+	uint_fast64_t queue[SLGRAPH_CACHE_QUEUE];
+	size_t queuehead, queuelen;
+	bool stop;
+};
+
+static uint_fast64_t slgraph_cache_hash(uint_fast64_t block)
+{
+	block ^= block >> 33;
+	block *= 0xff51afd7ed558ccdull;
+	block ^= block >> 33;
+	return(block);
+}
+
+// Find the frame holding block (return s->frames if it is not cached). Called with the shard locked.
+static size_t slgraph_cacheshard_find(const struct slgraph_cacheshard *s, uint_fast64_t block, uint_fast64_t hash)
+{
+	for(size_t i = (hash >> 32) & s->tablemask; s->table[i]; i = (i + 1) & s->tablemask)
+		if(s->blocks[s->table[i] - 1] == block)
+			return(s->table[i] - 1);
+
+	return(s->frames);
+}
+
+// Remove block from the hash table, shifting later entries of its probe sequence back. Called with the shard locked.
+static void slgraph_cacheshard_unlink(struct slgraph_cacheshard *s, uint_fast64_t block)
+{
+	size_t i = (slgraph_cache_hash(block) >> 32) & s->tablemask;
+
+	while(s->blocks[s->table[i] - 1] != block)
+		i = (i + 1) & s->tablemask;
+
+	for(size_t j = (i + 1) & s->tablemask; s->table[j]; j = (j + 1) & s->tablemask)
+	{
+		size_t home = (slgraph_cache_hash(s->blocks[s->table[j] - 1]) >> 32) & s->tablemask;
+		if(((j - home) & s->tablemask) >= ((j - i) & s->tablemask)) // The entry at j may move to the gap at i.
+		{
+			s->table[i] = s->table[j];
+			i = j;
+		}
+	}
+
+	s->table[i] = 0;
+}
+
+// Take a frame for block, evicting the first frame without reference bit after the CLOCK hand. Called with the shard locked.
+static size_t slgraph_cacheshard_evict(struct slgraph_cacheshard *s, uint_fast64_t block, uint_fast64_t hash)
+{
+	for(; s->referenced[s->hand]; s->hand = (s->hand + 1) % s->frames)
+		s->referenced[s->hand] = 0;
+
+	const size_t frame = s->hand;
+	s->hand = (s->hand + 1) % s->frames;
+
+	if(s->blocks[frame] != SLGRAPH_CACHE_EMPTY)
+	{
+		slgraph_cacheshard_unlink(s, s->blocks[frame]);
+		s->evictions++;
+	}
+
+	size_t i = (hash >> 32) & s->tablemask;
+	while(s->table[i])
+		i = (i + 1) & s->tablemask;
+	s->table[i] = frame + 1;
+	s->blocks[frame] = block;
+
+	return(frame);
+}
+
+// Read block from the file into buf, zero-filling anything past the end of the file.
+static void slgraph_cache_load(const struct slgraph_cache *c, uint_fast64_t block, unsigned char *buf)
+{
+	size_t done = 0;
+
+	while(done < c->blocksize)
+	{
+		ssize_t r = pread(c->fd, buf + done, c->blocksize - done, (off_t)(block * c->blocksize + done));
+		if(r < 0 && errno == EINTR)
+			continue;
+		if(r <= 0)
+			break;
+		done += r;
+	}
+
+	memset(buf + done, 0, c->blocksize - done);
+}
+
+// Queue the blocks following block for readahead. Requests are dropped while the queue is full.
+static void slgraph_cache_readahead(struct slgraph_cache *c, uint_fast64_t block)
+{
+	pthread_mutex_lock(&c->queuelock);
+	for(uint_fast64_t b = block + 1; b <= block + c->prefetch && b < c->blocks && c->queuelen < SLGRAPH_CACHE_QUEUE; b++)
+		c->queue[(c->queuehead + c->queuelen++) % SLGRAPH_CACHE_QUEUE] = b;
+	pthread_cond_signal(&c->queuecond);
+	pthread_mutex_unlock(&c->queuelock);
+}
+
+static void *slgraph_cache_prefetcher(void *arg)
+{
+	struct slgraph_cache *c = arg;
+	unsigned char *buf = malloc(c->blocksize);
+
+	pthread_mutex_lock(&c->queuelock);
+	for(;;)
+	{
+		while(!c->queuelen && !c->stop)
+			pthread_cond_wait(&c->queuecond, &c->queuelock);
+		if(c->stop)
+			break;
+
+		const uint_fast64_t block = c->queue[c->queuehead];
+		c->queuehead = (c->queuehead + 1) % SLGRAPH_CACHE_QUEUE;
+		c->queuelen--;
+		if(c->queuelen)
+			pthread_cond_signal(&c->queuecond);
+		pthread_mutex_unlock(&c->queuelock);
+
+		const uint_fast64_t hash = slgraph_cache_hash(block);
+		struct slgraph_cacheshard *s = c->shard + hash % c->shards;
+
+		// Read without holding the shard lock, then insert unless a reader got there first.
+		pthread_mutex_lock(&s->lock);
+		bool cached = slgraph_cacheshard_find(s, block, hash) != s->frames;
+		pthread_mutex_unlock(&s->lock);
+		if(!cached && buf)
+		{
+			slgraph_cache_load(c, block, buf);
+			pthread_mutex_lock(&s->lock);
+			if(slgraph_cacheshard_find(s, block, hash) == s->frames)
+			{
+				size_t frame = slgraph_cacheshard_evict(s, block, hash);
+				memcpy(s->data + frame * c->blocksize, buf, c->blocksize);
+				s->prefetched++;
+			}
+			pthread_mutex_unlock(&s->lock);
+		}
+
+		pthread_mutex_lock(&c->queuelock);
+	}
+	pthread_mutex_unlock(&c->queuelock);
+
+	free(buf);
+	return(0);
+}
+
+// Copy len bytes at offset in the graph file to dst.
+static void slgraph_cache_read(struct slgraph_cache *c, uint_fast64_t offset, size_t len, unsigned char *dst)
+{
+	while(len)
+	{
+		const uint_fast64_t block = offset >> c->blockshift;
+		const size_t inblock = offset & (c->blocksize - 1);
+		const size_t n = len < c->blocksize - inblock ? len : c->blocksize - inblock;
+		const uint_fast64_t hash = slgraph_cache_hash(block);
+		struct slgraph_cacheshard *s = c->shard + hash % c->shards;
+		unsigned char *buf = 0;
+
+		pthread_mutex_lock(&s->lock);
+		size_t frame = slgraph_cacheshard_find(s, block, hash);
+		const bool miss = frame == s->frames;
+		if(miss)
+		{
+			// Read without holding the shard lock, as the prefetcher does, so other readers of the shard don't wait
+			// for the disk. Without a buffer, read into the frame under the lock.
+			pthread_mutex_unlock(&s->lock);
+			buf = malloc(c->blocksize);
+			if(buf)
+				slgraph_cache_load(c, block, buf);
+			pthread_mutex_lock(&s->lock);
+			if((frame = slgraph_cacheshard_find(s, block, hash)) == s->frames) // Not inserted by another thread meanwhile
+			{
+				frame = slgraph_cacheshard_evict(s, block, hash);
+				if(buf)
+					memcpy(s->data + frame * c->blocksize, buf, c->blocksize);
+				else
+					slgraph_cache_load(c, block, s->data + frame * c->blocksize);
+			}
+			s->misses++;
+		}
+		else
+			s->hits++;
+		s->referenced[frame] = 1;
+		memcpy(dst, s->data + frame * c->blocksize + inblock, n);
+		pthread_mutex_unlock(&s->lock);
+		free(buf);
+
+		if(miss && c->threads)
+			slgraph_cache_readahead(c, block);
+
+		offset += n;
+		dst += n;
+		len -= n;
+	}
+}
+
+static void slgraph_cache_destroy(struct slgraph_cache *c)
+{
+	pthread_mutex_lock(&c->queuelock);
+	c->stop = true;
+	pthread_cond_broadcast(&c->queuecond);
+	pthread_mutex_unlock(&c->queuelock);
+	for(unsigned t = 0; t < c->threads; t++)
+		pthread_join(c->thread[t], 0);
+
+	for(unsigned i = 0; i < c->shards && c->shard; i++)
+	{
+		pthread_mutex_destroy(&c->shard[i].lock);
+		free(c->shard[i].blocks);
+		free(c->shard[i].referenced);
+		free(c->shard[i].data);
+		free(c->shard[i].table);
+	}
+	pthread_mutex_destroy(&c->queuelock);
+	pthread_cond_destroy(&c->queuecond);
+	free(c->shard);
+	free(c->thread);
+	free(c);
+}
+
+static struct slgraph_cache *slgraph_cache_create(int fd, uint_fast64_t filesize, const slgraph_cache_config_t *config)
+{
+	struct slgraph_cache *c = calloc(1, sizeof(struct slgraph_cache));
+
+	if(!c)
+		return(0);
+
+	c->fd = fd;
+	for(c->blockshift = 6; ((size_t)1 << c->blockshift) < config->block_size; c->blockshift++);
+	c->blocksize = (size_t)1 << c->blockshift;
+	c->blocks = (filesize + c->blocksize - 1) >> c->blockshift;
+	c->shards = config->shards ? config->shards : 1;
+	c->prefetch = config->prefetch;
+	pthread_mutex_init(&c->queuelock, 0);
+	pthread_cond_init(&c->queuecond, 0);
+
+	const size_t frames = config->memory_limit / c->blocksize / c->shards ? config->memory_limit / c->blocksize / c->shards : 1;
+	size_t tablesize = 1;
+	while(tablesize < frames * 2)
+		tablesize *= 2;
+
+	if(!(c->shard = calloc(c->shards, sizeof(struct slgraph_cacheshard))))
+	{
+		c->shards = 0;
+		slgraph_cache_destroy(c);
+		return(0);
+	}
+	for(unsigned i = 0; i < c->shards; i++)
+	{
+		struct slgraph_cacheshard *s = c->shard + i;
+		pthread_mutex_init(&s->lock, 0);
+		s->frames = frames;
+		s->tablemask = tablesize - 1;
+		s->blocks = malloc(frames * sizeof(uint_fast64_t));
+		s->referenced = calloc(frames, 1);
+		s->data = malloc(frames * c->blocksize);
+		s->table = calloc(tablesize, sizeof(size_t));
+		if(!s->blocks || !s->referenced || !s->data || !s->table)
+		{
+			c->shards = i + 1;
+			slgraph_cache_destroy(c);
+			return(0);
+		}
+		for(size_t f = 0; f < frames; f++)
+			s->blocks[f] = SLGRAPH_CACHE_EMPTY;
+	}
+
+	// Without readahead threads, blocks are only read on demand.
+	if(c->prefetch && config->prefetch_threads && (c->thread = malloc(config->prefetch_threads * sizeof(pthread_t))))
+		for(; c->threads < config->prefetch_threads; c->threads++)
+			if(pthread_create(c->thread + c->threads, 0, slgraph_cache_prefetcher, c))
+				break;
+
+	return(c);
+}
+
+// Get pointer to len bytes at offset in the graph file. The block cache backend copies them to buf, which must hold len bytes.
+static const unsigned char *slgraph_at(const slgraph_t *g, uint_fast64_t offset, size_t len, unsigned char *buf)
+{
+	if(!g->cache)
+		return(g->ptr + offset);
+
+	slgraph_cache_read(g->cache, offset, len, buf);
+	return(buf);
+}
+
+static uint_fast64_t slgraph_get48(const slgraph_t *g, uint_fast64_t offset)
+{
+	unsigned char buf[6];
+	return(slgraph_read48(slgraph_at(g, offset, 6, buf)));
+}
+
+static uint_fast64_t slgraph_get64(const slgraph_t *g, uint_fast64_t offset)
+{
+	unsigned char buf[8];
+	return(slgraph_read64(slgraph_at(g, offset, 8, buf)));
+}
+
+// Get offset of node list / edge list
+static uint_fast64_t slgraph_nodelist_offset(const slgraph_t *g)
+{
+	return(g->cache ? g->cache->nodelist : slgraph_read64(g->ptr + SLGRAPH_HEADER_NODELIST));
+}
+
+static uint_fast64_t slgraph_edgelist_offset(const slgraph_t *g)
+{
+	return(g->cache ? g->cache->edgelist : slgraph_read64(g->ptr + SLGRAPH_HEADER_EDGELIST));
+}
+
+// Get offset of the entry of node n / edge e
+static uint_fast64_t slgraph_node_offset(const slgraph_t *g, slgraph_node_t n)
+{
+	return(slgraph_nodelist_offset(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE);
+}
+
+static uint_fast64_t slgraph_edge_offset(const slgraph_t *g, slgraph_edge_t e)
+{
+	return(slgraph_edgelist_offset(g) + SLGRAPH_LISTHEADERSIZE + e * SLGRAPH_EDGESIZE);
+}
+
+// === Sharded graphs ===
+// A manifest lists shard files, each holding the nodes of a contiguous range with their out- and in-lists. Edge entries
+// hold global node IDs. An edge between two shards is stored in both: the copy in the shard of its source is in the
+// out-list, the copy in the shard of its target in the in-list. Global edge IDs are the local ones plus the number of edge
+// slots of the preceding shards. Shards are opened on first access.
+
+// Shard section: 8-byte first node, 8-byte number of nodes in the shard, 8-byte number of nodes in the graph,
+// 8-byte number of edges with their source in the shard.
+#define SLGRAPH_SHARDSIZE (8 * 4)
+#define SLGRAPH_MANIFESTMAGIC "slgraph-shards 1"
+
+struct slgraph_shard
+{
+	slgraph_t g;
+	bool open;
+	char *filename;
+	slgraph_node_t first;
+	uint_fast64_t nodes;
+	uint_fast64_t edges;    // Edges with their source in the shard
+	uint_fast64_t edgebase; // Global ID of the first edge slot of the shard
+	uint_fast64_t slots;    // Edge slots, including copies of edges coming from other shards
+};
+
+struct slgraph_shards
+{
+	unsigned count;
+	uint_fast64_t nodes, edges, flags;
+	struct slgraph_shard *shard;
+};
+
+// Get the graph of shard k. All shards are opened with the manifest, since access functions can't report errors.
+static const slgraph_t *slgraph_shard_graph(struct slgraph_shards *s, unsigned k)
+{
+	return(&s->shard[k].g);
+}
+
+// Get the graph of the shard holding node n of sharded graph g, the local ID of n in it, and the global ID of its first edge.
+static const slgraph_t *slgraph_shard_node(const slgraph_t *g, slgraph_node_t n, slgraph_node_t *local, uint_fast64_t *edgebase)
+{
+	const struct slgraph_shards *s = g->shards;
+	unsigned lo = 0, hi = s->count - 1;
+
+	while(lo < hi)
+	{
+		unsigned mid = lo + (hi - lo + 1) / 2;
+		if(s->shard[mid].first <= n)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	*local = n - s->shard[lo].first;
+	if(edgebase)
+		*edgebase = s->shard[lo].edgebase;
+
+	return(slgraph_shard_graph(g->shards, lo));
+}
+
+// Get the graph of the shard holding edge e of sharded graph g, and the local ID of e in it.
+static const slgraph_t *slgraph_shard_edge(const slgraph_t *g, slgraph_edge_t e, slgraph_edge_t *local)
+{
+	const struct slgraph_shards *s = g->shards;
+	unsigned lo = 0, hi = s->count - 1;
+
+	while(lo < hi)
+	{
+		unsigned mid = lo + (hi - lo + 1) / 2;
+		if(s->shard[mid].edgebase <= e)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	*local = e - s->shard[lo].edgebase;
+
+	return(slgraph_shard_graph(g->shards, lo));
+}
+
 // Resize graph file
 // (to create free space at the end for future use or to eliminate free space at the end to reduce file size)
 static int slgraph_resize(slgraph_t *g, size_t s)
@@ -318,19 +886,154 @@ int slgraph_new(slgraph_t *g)
 
 	g->readonly = false;
 	g->free = 0;
+	g->version = 1;
+	g->cache = 0;
+	g->shards = 0;
+	g->wal = 0;
 
 	return(0);
 }
 
-int slgraph_open(slgraph_t *g, const char *restrict filename, bool readonly)
+void slgraph_cache_config_default(slgraph_cache_config_t *config)
+{
+	config->block_size = SLGRAPH_CACHE_BLOCKSIZE;
+	config->memory_limit = SLGRAPH_CACHE_MEMORY;
+	config->shards = SLGRAPH_CACHE_SHARDS;
+	config->prefetch = SLGRAPH_CACHE_PREFETCH;
+	config->prefetch_threads = SLGRAPH_CACHE_PREFETCHTHREADS;
+}
+
+// Read the block cache configuration from the environment, using defaults for unset variables.
+static void slgraph_cache_config_env(slgraph_cache_config_t *config)
+{
+	const char *v;
+
+	slgraph_cache_config_default(config);
+	if((v = getenv("SLGRAPH_CACHE_MB")))
+		config->memory_limit = strtoull(v, 0, 10) * 1024 * 1024;
+	if((v = getenv("SLGRAPH_CACHE_BLOCK_KB")))
+		config->block_size = strtoull(v, 0, 10) * 1024;
+	if((v = getenv("SLGRAPH_CACHE_PREFETCH")))
+		config->prefetch = strtoul(v, 0, 10);
+	if((v = getenv("SLGRAPH_CACHE_THREADS")))
+		config->prefetch_threads = strtoul(v, 0, 10);
+}
+
+int slgraph_open_cached(slgraph_t *g, const char *restrict filename, const slgraph_cache_config_t *config)
+{
+	slgraph_cache_config_t defaults;
+	unsigned char header[SLGRAPH_HEADERSIZE];
+
+	if(!config)
+	{
+		slgraph_cache_config_default(&defaults);
+		config = &defaults;
+	}
+
+	g->wal = 0;
+
+	// The file is inconsistent until committed batches have been replayed by a writable open.
+	if(slgraph_wal_replay(filename, -1) || (g->fd = open(filename, O_RDONLY)) == -1)
+		return(-1);
+
+	if(pread(g->fd, header, SLGRAPH_HEADERSIZE, 0) != SLGRAPH_HEADERSIZE || memcmp(header, u8"slgraph", 8) ||
+		(slgraph_read64(header + 8) != 1 && slgraph_read64(header + 8) != 2))
+	{
+		close(g->fd);
+		g->fd = -1;
+		return(-1);
+	}
+
+	g->version = slgraph_read64(header + 8);
+	g->size = slgraph_read64(header + SLGRAPH_HEADERSIZE_BASIC);
+	g->ptr = 0;
+	g->readonly = true;
+	g->free = 0;
+	g->shards = 0;
+
+	if(!(g->cache = slgraph_cache_create(g->fd, g->size, config)))
+	{
+		close(g->fd);
+		g->fd = -1;
+		return(-1);
+	}
+
+	g->cache->nodelist = slgraph_read64(header + SLGRAPH_HEADER_NODELIST);
+	g->cache->edgelist = slgraph_read64(header + SLGRAPH_HEADER_EDGELIST);
+	const uint_fast64_t flags = slgraph_section_find(g, "flags", 0, 0);
+	g->cache->flags = flags ? slgraph_get64(g, flags) : 0;
+
+	return(0);
+}
+
+int slgraph_cache_stats(const slgraph_t *g, slgraph_cache_stats_t *stats)
+{
+	const struct slgraph_cache *c = g->cache;
+
+	if(!c)
+		return(-1);
+
+	memset(stats, 0, sizeof(slgraph_cache_stats_t));
+	for(unsigned i = 0; i < c->shards; i++)
+	{
+		struct slgraph_cacheshard *s = c->shard + i;
+		pthread_mutex_lock(&s->lock);
+		stats->hits += s->hits;
+		stats->misses += s->misses;
+		stats->prefetched += s->prefetched;
+		stats->evictions += s->evictions;
+		stats->memory += s->frames * c->blocksize;
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	return(0);
+}
+
+// Open the file at filename as g, creating an empty graph there if there is no file and create is set.
+static int slgraph_open_file(slgraph_t *g, const char *restrict filename, bool readonly, bool create)
 {
 	struct stat stat;
+	const char *backend = getenv("SLGRAPH_BACKEND");
+	int manifest;
+
+	g->cache = 0;
+	g->shards = 0;
+	g->wal = 0;
+
+	// A manifest presents its shards as one read-only graph.
+	if((manifest = slgraph_open_manifest(g, filename)) <= 0)
+	{
+		if(!manifest && !readonly) // Sharded graphs can only be read.
+		{
+			slgraph_close(g);
+			return(-1);
+		}
+		return(manifest);
+	}
+
+	// The file is inconsistent until committed batches have been replayed by a writable open.
+	if(readonly && slgraph_wal_replay(filename, -1))
+		return(-1);
+
+	// Read-only graphs can be read through the block cache instead of mapping the file.
+	if(readonly && backend && !strcmp(backend, "cache"))
+	{
+		slgraph_cache_config_t config;
+		slgraph_cache_config_env(&config);
+		return(slgraph_open_cached(g, filename, &config));
+	}
 
 	// Open file with appropriate permissions
-	if ((g->fd = open(filename, readonly ? O_RDONLY : (O_RDWR | O_CREAT),
+	if ((g->fd = open(filename, readonly ? O_RDONLY : create ? (O_RDWR | O_CREAT) : O_RDWR,
 	                  S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) == -1)
 		return -1;
 
+	// Replay batches committed before a crash.
+	if (!readonly && slgraph_wal_replay(filename, g->fd)) {
+		close(g->fd);
+		return -1;
+	}
+
 	fstat(g->fd, &stat);
 
 	// If file is empty and we're allowed to write, initialize header
@@ -386,6 +1089,16 @@ int slgraph_open(slgraph_t *g, const char *restrict filename, bool readonly)
 	return 0;
 }
 
+int slgraph_open(slgraph_t *g, const char *restrict filename, bool readonly)
+{
+	return(slgraph_open_file(g, filename, readonly, true));
+}
+
+int slgraph_open_existing(slgraph_t *g, const char *restrict filename, bool readonly)
+{
+	return(slgraph_open_file(g, filename, readonly, false));
+}
+
 
 
 int slgraph_nodelist_expand(slgraph_t *g, uint_fast64_t n)
@@ -408,9 +1121,37 @@ int slgraph_nodelist_expand(slgraph_t *g, uint_fast64_t n)
 
 void slgraph_close(slgraph_t *g)
 {
+	if(g->shards)
+	{
+		for(unsigned k = 0; k < g->shards->count; k++)
+		{
+			if(g->shards->shard[k].open)
+				slgraph_close(&g->shards->shard[k].g);
+			free(g->shards->shard[k].filename);
+		}
+		free(g->shards->shard);
+		free(g->shards);
+		g->shards = 0;
+	}
+
 	if(g->fd < 0)
 		return;
 
+	if(g->cache)
+	{
+		slgraph_cache_stats_t stats;
+		if(getenv("SLGRAPH_CACHE_STATS") && !slgraph_cache_stats(g, &stats))
+			fprintf(stderr, "Cache: hits=%llu misses=%llu hit_rate=%.4f prefetched=%llu evictions=%llu memory=%llu\n",
+				(unsigned long long)stats.hits, (unsigned long long)stats.misses,
+				stats.hits + stats.misses ? (double)stats.hits / (stats.hits + stats.misses) : 0.0,
+				(unsigned long long)stats.prefetched, (unsigned long long)stats.evictions, (unsigned long long)stats.memory);
+		slgraph_cache_destroy(g->cache);
+		g->cache = 0;
+	}
+
+	if(g->wal)
+		slgraph_wal_close(g);
+
 	if(!g->readonly && g->ptr)
 	{
 		slgraph_write64(g->ptr + SLGRAPH_HEADERSIZE_BASIC, g->size - g->free);
@@ -425,87 +1166,286 @@ void slgraph_close(slgraph_t *g)
 	g->ptr = 0;
 }
 
-int slgraph_copy(slgraph_t *g, const slgraph_t *h)
+// Get the size of the incidence list referenced by the offset field of node n in a compacted copy.
+static uint_fast64_t slgraph_copy_listsize(const slgraph_t *h, slgraph_node_t n, size_t offset_field)
 {
-	size_t nodelist_size = SLGRAPH_LISTHEADERSIZE + slgraph_nodes(h) * SLGRAPH_NODESIZE;
-	size_t edgelist_size = SLGRAPH_LISTHEADERSIZE + slgraph_edges(h) * SLGRAPH_EDGESIZE;
-	size_t incidencelists_size = 0;
+	uint_fast64_t offset = slgraph_read64(slgraph_nodelist(h) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE + offset_field);
+	uint_fast64_t degree = offset ? slgraph_read48(h->ptr + offset + SLGRAPH_SIZE) : 0;
 
-	uint_fast64_t n = slgraph_nodes(h);
+	return(!degree ? 0 : SLGRAPH_LISTHEADERSIZE + degree * SLGRAPH_INCIDENCESIZE);
+}
 
-	for(uint_fast64_t i = 0; i < n; i++)
-	{
-		uint_fast64_t degree = slgraph_degree(h, i);
-		incidencelists_size += !degree ? 0 : SLGRAPH_LISTHEADERSIZE + degree * SLGRAPH_INCIDENCESIZE;
-	}
+// A share of the work of slgraph_copy_threads(): a range of nodes with their incidence lists and a range of edges.
+struct slgraph_copyjob
+{
+	slgraph_t *g;
+	const slgraph_t *h;
+	uint_fast64_t begin, end;
+	uint_fast64_t edges_begin, edges_end;
+	uint_fast64_t offset; // Destination of the first incidence list of the range
+	uint_fast64_t size;   // Size of the incidence lists of the range
+};
+
+static void *slgraph_copyjob_size(void *arg)
+{
+	struct slgraph_copyjob *job = arg;
 
-	if(slgraph_resize(g, SLGRAPH_HEADERSIZE + nodelist_size + edgelist_size + incidencelists_size))
-		return(-1);
+	job->size = 0;
+	for(slgraph_node_t n = job->begin; n < job->end; n++)
+		job->size += slgraph_copy_listsize(job->h, n, SLGRAPH_NODE_OUT) + slgraph_copy_listsize(job->h, n, SLGRAPH_NODE_IN);
 
-	// Copy node list
-	slgraph_write64(g->ptr + SLGRAPH_HEADER_NODELIST, SLGRAPH_HEADERSIZE);
-	memcpy(slgraph_nodelist(g), slgraph_nodelist(h), nodelist_size);
-	slgraph_write48(slgraph_nodelist(g), slgraph_nodes(g));
+	return(0);
+}
 
-	// Copy edge list
-	slgraph_write64(g->ptr + SLGRAPH_HEADER_EDGELIST, SLGRAPH_HEADERSIZE + nodelist_size);
-	memcpy(slgraph_edgelist(g), slgraph_edgelist(h), edgelist_size);
-	slgraph_write48(slgraph_edgelist(g), slgraph_edges(g));
+static void *slgraph_copyjob_copy(void *arg)
+{
+	struct slgraph_copyjob *job = arg;
+	slgraph_t *g = job->g;
+	const slgraph_t *h = job->h;
+	uint_fast64_t offset = job->offset;
 
-	g->free = incidencelists_size;
+	memcpy(slgraph_edgelist(g) + SLGRAPH_LISTHEADERSIZE + job->edges_begin * SLGRAPH_EDGESIZE,
+		slgraph_edgelist(h) + SLGRAPH_LISTHEADERSIZE + job->edges_begin * SLGRAPH_EDGESIZE, (job->edges_end - job->edges_begin) * SLGRAPH_EDGESIZE);
 
-	// Copy incidence lists
-	for(uint_fast64_t i = 0; i < n; i++)
+	for(slgraph_node_t n = job->begin; n < job->end; n++)
 	{
-		uint_fast64_t degree = slgraph_degree(h, i);
+		const unsigned char *hnodeptr = slgraph_nodelist(h) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
+		unsigned char *gnodeptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
 
-		if(!degree)
-			continue;
+		memcpy(gnodeptr, hnodeptr, SLGRAPH_NODESIZE);
 
-		unsigned char *listptr = slgraph_add_incidencelist(g, degree);
-		assert(listptr); // slgraph_add_incidencelist() should never need to allocate extra memory, since we already allocated sufficient free space earlier.
-		slgraph_write64(slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_NODESIZE, listptr - g->ptr);
-		memcpy(listptr, slgraph_incidencelist(h, i), SLGRAPH_LISTHEADERSIZE + degree * 6);
+		for(size_t offset_field = SLGRAPH_NODE_OUT; offset_field <= SLGRAPH_NODE_IN; offset_field += SLGRAPH_NODE_IN - SLGRAPH_NODE_OUT)
+		{
+			uint_fast64_t listsize = slgraph_copy_listsize(h, n, offset_field);
+
+			slgraph_write64(gnodeptr + offset_field, listsize ? offset : 0);
+			if(!listsize)
+				continue;
+
+			memcpy(g->ptr + offset, h->ptr + slgraph_read64(hnodeptr + offset_field), listsize);
+			slgraph_write48(g->ptr + offset, (listsize - SLGRAPH_LISTHEADERSIZE) / SLGRAPH_INCIDENCESIZE);
+			offset += listsize;
+		}
 	}
 
 	return(0);
 }
 
-uint_fast64_t slgraph_nodes(const slgraph_t *g)
+// Run job on each of the jobs, in parallel if there is more than one.
+static int slgraph_copyjobs_run(struct slgraph_copyjob *jobs, unsigned threads, void *(*job)(void *))
 {
-	return(slgraph_read48(slgraph_nodelist(g) + SLGRAPH_SIZE));
-}
+	pthread_t *tids = threads > 1 ? malloc(threads * sizeof(pthread_t)) : 0;
+	unsigned started = 0;
 
-uint_fast64_t slgraph_edges(const slgraph_t *g)
-{
-	return(slgraph_read48(slgraph_edgelist(g) + SLGRAPH_SIZE));
-}
+	if(tids)
+		for(; started < threads; started++)
+			if(pthread_create(tids + started, 0, job, jobs + started))
+				break;
 
-uint_fast64_t slgraph_degree(const slgraph_t *g, slgraph_node_t n)
-{
-	const unsigned char *incidenceptr = slgraph_incidencelist(g, n);
-	return(!incidenceptr ? 0 : slgraph_read48(incidenceptr + SLGRAPH_SIZE));
+	for(unsigned t = started; t < threads; t++) // Remaining jobs run in the calling thread.
+		job(jobs + t);
 
+	for(unsigned t = 0; t < started; t++)
+		pthread_join(tids[t], 0);
 
-}
-uint_fast64_t slgraph_out_degree(const slgraph_t *g, slgraph_node_t n) {
-    const unsigned char *nodeptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
-    uint64_t out_off = slgraph_read64(nodeptr + 0);
-    return (out_off ? slgraph_read48(g->ptr + out_off + SLGRAPH_SIZE) : 0);
-}
+	free(tids);
 
-uint_fast64_t slgraph_in_degree(const slgraph_t *g, slgraph_node_t n) {
-    const unsigned char *nodeptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
-    uint64_t in_off = slgraph_read64(nodeptr + 8);
-    return (in_off ? slgraph_read48(g->ptr + in_off + SLGRAPH_SIZE) : 0);
+	return(0);
 }
 
-
-slgraph_node_t slgraph_neighbour(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i)
+// Get the size of the section table and sections in a compacted copy, starting at offset.
+static uint_fast64_t slgraph_copy_sectionsize(const slgraph_t *h, uint_fast64_t offset)
 {
-	slgraph_edge_t e = slgraph_incident(g, n, i);
+	const unsigned char *table = slgraph_sectiontable(h);
+	const uint_fast64_t start = offset;
 
-	if(e == SLGRAPH_INVALID_EDGE)
+	if(!table)
+		return(0);
+
+	uint_fast64_t sections = slgraph_read48(table + SLGRAPH_SIZE);
+
+	offset += (8 - offset % 8) % 8;
+	offset += SLGRAPH_LISTHEADERSIZE + sections * SLGRAPH_SECTIONSIZE;
+	for(uint_fast64_t i = 0; i < sections; i++)
+	{
+		offset += (SLGRAPH_SECTIONALIGN - offset % SLGRAPH_SECTIONALIGN) % SLGRAPH_SECTIONALIGN;
+		offset += slgraph_read64(table + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_SECTIONSIZE + SLGRAPH_SECTIONNAMESIZE + 8);
+	}
+
+	return(offset - start);
+}
+
+// Split the nodes and edges of h into jobs and compute the size of the incidence lists of each.
+static struct slgraph_copyjob *slgraph_copyjobs(slgraph_t *g, const slgraph_t *h, unsigned threads)
+{
+	struct slgraph_copyjob *jobs = calloc(threads, sizeof(struct slgraph_copyjob));
+	const uint_fast64_t n = slgraph_nodes(h);
+	const uint_fast64_t m = slgraph_edges(h);
+
+	if(!jobs)
+		return(0);
+
+	for(unsigned t = 0; t < threads; t++)
+	{
+		jobs[t].g = g;
+		jobs[t].h = h;
+		jobs[t].begin = n * t / threads;
+		jobs[t].end = n * (t + 1) / threads;
+		jobs[t].edges_begin = m * t / threads;
+		jobs[t].edges_end = m * (t + 1) / threads;
+	}
+
+	slgraph_copyjobs_run(jobs, threads, slgraph_copyjob_size);
+
+	return(jobs);
+}
+
+uint_fast64_t slgraph_copy_size(const slgraph_t *h, unsigned threads)
+{
+	if(h->cache || h->shards)
+		return(0);
+	if(!threads)
+		threads = 1;
+
+	struct slgraph_copyjob *jobs = slgraph_copyjobs(0, h, threads);
+	if(!jobs)
+		return(0);
+
+	uint_fast64_t size = SLGRAPH_HEADERSIZE + SLGRAPH_LISTHEADERSIZE + slgraph_nodes(h) * SLGRAPH_NODESIZE + SLGRAPH_LISTHEADERSIZE + slgraph_edges(h) * SLGRAPH_EDGESIZE;
+	for(unsigned t = 0; t < threads; t++)
+		size += jobs[t].size;
+	size += slgraph_copy_sectionsize(h, size);
+
+	free(jobs);
+
+	return(size);
+}
+
+int slgraph_copy_threads(slgraph_t *g, const slgraph_t *h, unsigned threads)
+{
+	if(h->cache || h->shards)
+		return(-1);
+	if(!threads)
+		threads = 1;
+
+	const uint_fast64_t n = slgraph_nodes(h);
+	const uint_fast64_t m = slgraph_edges(h);
+	const size_t nodelist_size = SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
+	const size_t edgelist_size = SLGRAPH_LISTHEADERSIZE + m * SLGRAPH_EDGESIZE;
+
+	struct slgraph_copyjob *jobs = slgraph_copyjobs(g, h, threads);
+	if(!jobs)
+		return(-1);
+
+	// Incidence lists follow node list and edge list, each job's lists follow those of the previous one.
+	uint_fast64_t offset = SLGRAPH_HEADERSIZE + nodelist_size + edgelist_size;
+	for(unsigned t = 0; t < threads; t++)
+	{
+		jobs[t].offset = offset;
+		offset += jobs[t].size;
+	}
+
+	if(slgraph_resize(g, offset + slgraph_copy_sectionsize(h, offset)))
+	{
+		free(jobs);
+		return(-1);
+	}
+
+	g->version = h->version;
+	slgraph_write64(g->ptr + 8, h->version);
+
+	slgraph_write64(g->ptr + SLGRAPH_HEADER_NODELIST, SLGRAPH_HEADERSIZE);
+	slgraph_write48(slgraph_nodelist(g), n);
+	slgraph_write48(slgraph_nodelist(g) + SLGRAPH_SIZE, n);
+
+	slgraph_write64(g->ptr + SLGRAPH_HEADER_EDGELIST, SLGRAPH_HEADERSIZE + nodelist_size);
+	slgraph_write48(slgraph_edgelist(g), m);
+	slgraph_write48(slgraph_edgelist(g) + SLGRAPH_SIZE, m);
+
+	slgraph_copyjobs_run(jobs, threads, slgraph_copyjob_copy);
+	free(jobs);
+
+	// Copy section table and sections. Edge IDs and list positions are kept, so all sections stay valid.
+	const unsigned char *htable = slgraph_sectiontable(h);
+	slgraph_write48(g->ptr + SLGRAPH_HEADER_SECTIONS, SLGRAPH_NOSECTIONS);
+	if(htable)
+	{
+		uint_fast64_t sections = slgraph_read48(htable + SLGRAPH_SIZE);
+
+		offset += (8 - offset % 8) % 8;
+		unsigned char *gtable = g->ptr + offset;
+		slgraph_write48(g->ptr + SLGRAPH_HEADER_SECTIONS, offset);
+		slgraph_write48(gtable, sections);
+		slgraph_write48(gtable + SLGRAPH_SIZE, sections);
+		memcpy(gtable + SLGRAPH_LISTHEADERSIZE, htable + SLGRAPH_LISTHEADERSIZE, sections * SLGRAPH_SECTIONSIZE);
+		offset += SLGRAPH_LISTHEADERSIZE + sections * SLGRAPH_SECTIONSIZE;
+
+		for(uint_fast64_t i = 0; i < sections; i++)
+		{
+			unsigned char *entry = gtable + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_SECTIONSIZE;
+			uint_fast64_t size = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8);
+
+			offset += (SLGRAPH_SECTIONALIGN - offset % SLGRAPH_SECTIONALIGN) % SLGRAPH_SECTIONALIGN;
+			memcpy(g->ptr + offset, h->ptr + slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE), size);
+			slgraph_write64(entry + SLGRAPH_SECTIONNAMESIZE, offset);
+			offset += size;
+		}
+	}
+
+	g->free = 0;
+
+	return(0);
+}
+
+int slgraph_copy(slgraph_t *g, const slgraph_t *h)
+{
+	return(slgraph_copy_threads(g, h, 1));
+}
+
+uint_fast64_t slgraph_nodes(const slgraph_t *g)
+{
+	if(g->shards)
+		return(g->shards->nodes);
+
+	return(slgraph_get48(g, slgraph_nodelist_offset(g) + SLGRAPH_SIZE));
+}
+
+uint_fast64_t slgraph_edges(const slgraph_t *g)
+{
+	if(g->shards)
+		return(g->shards->edges);
+
+	return(slgraph_get48(g, slgraph_edgelist_offset(g) + SLGRAPH_SIZE));
+}
+
+uint_fast64_t slgraph_degree(const slgraph_t *g, slgraph_node_t n)
+{
+	if(g->shards)
+		g = slgraph_shard_node(g, n, &n, 0);
+
+	uint_fast64_t incidence_offset = slgraph_get64(g, slgraph_node_offset(g, n));
+	return(!incidence_offset ? 0 : slgraph_get48(g, incidence_offset + SLGRAPH_SIZE));
+
+
+}
+uint_fast64_t slgraph_out_degree(const slgraph_t *g, slgraph_node_t n) {
+    if (g->shards) g = slgraph_shard_node(g, n, &n, 0);
+    uint64_t out_off = slgraph_get64(g, slgraph_node_offset(g, n) + SLGRAPH_NODE_OUT);
+    return (out_off ? slgraph_get48(g, out_off + SLGRAPH_SIZE) : 0);
+}
+
+uint_fast64_t slgraph_in_degree(const slgraph_t *g, slgraph_node_t n) {
+    if (g->shards) g = slgraph_shard_node(g, n, &n, 0);
+    uint64_t in_off = slgraph_get64(g, slgraph_node_offset(g, n) + SLGRAPH_NODE_IN);
+    return (in_off ? slgraph_get48(g, in_off + SLGRAPH_SIZE) : 0);
+}
+
+
+slgraph_node_t slgraph_neighbour(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i)
+{
+	slgraph_edge_t e = slgraph_incident(g, n, i);
+
+	if(e == SLGRAPH_INVALID_EDGE)
 		return(SLGRAPH_INVALID_NODE);
 
 	slgraph_node_t n0, n1;
@@ -535,31 +1475,43 @@ slgraph_node_t slgraph_in_neighbour(const slgraph_t *g, slgraph_node_t n, uint_f
 
 slgraph_edge_t slgraph_incident(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i)
 {
-	const unsigned char *incidenceptr = slgraph_incidencelist(g, n);
-	return(!incidenceptr ? SLGRAPH_INVALID_EDGE : slgraph_read48(incidenceptr + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE));
+	uint_fast64_t edgebase = 0;
+	if(g->shards)
+		g = slgraph_shard_node(g, n, &n, &edgebase);
+
+	uint_fast64_t incidence_offset = slgraph_get64(g, slgraph_node_offset(g, n));
+	return(!incidence_offset ? SLGRAPH_INVALID_EDGE : edgebase + slgraph_get48(g, incidence_offset + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE));
 }
 slgraph_edge_t slgraph_out_incident(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i) {
-    const unsigned char *nodeptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
-    uint64_t out_off = slgraph_read64(nodeptr + 0);
+    uint_fast64_t edgebase = 0;
+    if (g->shards) g = slgraph_shard_node(g, n, &n, &edgebase);
+    uint64_t out_off = slgraph_get64(g, slgraph_node_offset(g, n) + SLGRAPH_NODE_OUT);
     if (!out_off) return SLGRAPH_INVALID_EDGE;
-    return slgraph_read48(g->ptr + out_off + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
+    return edgebase + slgraph_get48(g, out_off + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
 }
 
 slgraph_edge_t slgraph_in_incident(const slgraph_t *g, slgraph_node_t n, uint_fast32_t i) {
-    const unsigned char *nodeptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
-    uint64_t in_off = slgraph_read64(nodeptr + 8);
+    uint_fast64_t edgebase = 0;
+    if (g->shards) g = slgraph_shard_node(g, n, &n, &edgebase);
+    uint64_t in_off = slgraph_get64(g, slgraph_node_offset(g, n) + SLGRAPH_NODE_IN);
     if (!in_off) return SLGRAPH_INVALID_EDGE;
-    return slgraph_read48(g->ptr + in_off + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
+    return edgebase + slgraph_get48(g, in_off + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
 }
 
 void slgraph_edge_ends(const slgraph_t *g, slgraph_edge_t e, slgraph_node_t *n0, slgraph_node_t *n1)
 {
-	const unsigned char *ptr = slgraph_edgelist(g);
-	*n0 = slgraph_read48(ptr + SLGRAPH_LISTHEADERSIZE + e * SLGRAPH_EDGESIZE + 0);
-	*n1 = slgraph_read48(ptr + SLGRAPH_LISTHEADERSIZE + e * SLGRAPH_EDGESIZE + 6);
+	if(g->shards)
+		g = slgraph_shard_edge(g, e, &e);
+
+	unsigned char buf[12];
+	const unsigned char *ptr = slgraph_at(g, slgraph_edge_offset(g, e), 12, buf);
+	*n0 = slgraph_read48(ptr + 0);
+	*n1 = slgraph_read48(ptr + 6);
 }
 
 slgraph_node_t slgraph_add_node(slgraph_t *g) {
+    slgraph_flags_clear(g, SLGRAPH_FLAG_DERIVED);
+
     uint_fast64_t nodes = slgraph_nodes(g);
     uint_fast64_t nodelist_size = slgraph_read48(slgraph_nodelist(g));
 
@@ -594,6 +1546,8 @@ slgraph_node_t slgraph_add_node(slgraph_t *g) {
 
 slgraph_edge_t slgraph_add_edge(slgraph_t *g, slgraph_node_t n0, slgraph_node_t n1)
 {
+	slgraph_flags_clear(g, SLGRAPH_FLAG_DERIVED);
+
 	uint_fast64_t edges = slgraph_edges(g);
 	uint_fast64_t edgelist_size = slgraph_read48(slgraph_edgelist(g));
 
@@ -631,3 +1585,2289 @@ slgraph_edge_t slgraph_add_edge(slgraph_t *g, slgraph_node_t n0, slgraph_node_t
 
 	return(edge);
 }
+
+// Allocate size bytes at an offset that is a multiple of align from the free space at the end of the file.
+// Returns the offset (0 on failure). Might remap.
+static uint_fast64_t slgraph_alloc(slgraph_t *g, uint_fast64_t size, uint_fast64_t align)
+{
+	const size_t start = g->size - g->free;
+	const size_t pad = (align - start % align) % align;
+
+	if(g->free < pad + size)
+	{
+		size_t addfree = (g->size / 8) + pad + size;
+		if(slgraph_resize(g, g->size + addfree))
+			return(0);
+		g->free += addfree;
+	}
+
+	g->free -= pad + size;
+
+	return(start + pad);
+}
+
+// Get pointer to section table (return 0 if there are no sections)
+static unsigned char *slgraph_sectiontable(const slgraph_t *g)
+{
+	if(g->cache || g->shards) // Sections are only available by pointer with the mmap backend, see slgraph_section_find().
+		return(0);
+
+	uint_fast64_t offset = slgraph_read48(g->ptr + SLGRAPH_HEADER_SECTIONS);
+	return(offset == SLGRAPH_NOSECTIONS ? 0 : g->ptr + offset);
+}
+
+// Get pointer to the section table entry for name (return 0 if there is none)
+static unsigned char *slgraph_section_entry(const slgraph_t *g, const char *name)
+{
+	unsigned char *table = slgraph_sectiontable(g);
+
+	if(!table)
+		return(0);
+
+	uint_fast64_t sections = slgraph_read48(table + SLGRAPH_SIZE);
+
+	for(uint_fast64_t i = 0; i < sections; i++)
+	{
+		unsigned char *entry = table + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_SECTIONSIZE;
+		if(!strncmp((const char *)entry, name, SLGRAPH_SECTIONNAMESIZE))
+			return(entry);
+	}
+
+	return(0);
+}
+
+// Find the named section by offset, which works with any backend. Returns the offset of its data (0 if there is none),
+// and its size and info fields.
+static uint_fast64_t slgraph_section_find(const slgraph_t *g, const char *name, uint_fast64_t *size, uint_fast64_t *info)
+{
+	if(g->shards) // The manifest has no sections of its own.
+		return(0);
+
+	const uint_fast64_t table = slgraph_get48(g, SLGRAPH_HEADER_SECTIONS);
+
+	if(table == SLGRAPH_NOSECTIONS)
+		return(0);
+
+	uint_fast64_t sections = slgraph_get48(g, table + SLGRAPH_SIZE);
+
+	for(uint_fast64_t i = 0; i < sections; i++)
+	{
+		unsigned char buf[SLGRAPH_SECTIONSIZE];
+		const unsigned char *entry = slgraph_at(g, table + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_SECTIONSIZE, SLGRAPH_SECTIONSIZE, buf);
+		if(strncmp((const char *)entry, name, SLGRAPH_SECTIONNAMESIZE))
+			continue;
+		if(size)
+			*size = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8);
+		if(info)
+			*info = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 16);
+		return(slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE));
+	}
+
+	return(0);
+}
+
+unsigned char *slgraph_section(const slgraph_t *g, const char *name, uint_fast64_t *size)
+{
+	const unsigned char *entry = slgraph_section_entry(g, name);
+
+	if(!entry)
+		return(0);
+
+	if(size)
+		*size = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8);
+
+	return(g->ptr + slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE));
+}
+
+unsigned char *slgraph_section_reserve(slgraph_t *g, const char *name, uint_fast64_t size)
+{
+	if(g->readonly || strlen(name) >= SLGRAPH_SECTIONNAMESIZE)
+		return(0);
+
+	unsigned char *entry = slgraph_section_entry(g, name);
+	const uint_fast64_t oldoffset = entry ? slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE) : 0;
+	const uint_fast64_t oldsize = entry ? slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8) : 0;
+
+	if(entry && oldsize >= size)
+		return(g->ptr + oldoffset);
+
+	if(!entry) // Add an entry, moving the section table to the end of the file if it is full.
+	{
+		unsigned char *table = slgraph_sectiontable(g);
+		uint_fast64_t tablesize = table ? slgraph_read48(table) : 0;
+		uint_fast64_t sections = table ? slgraph_read48(table + SLGRAPH_SIZE) : 0;
+
+		if(sections + 1 > tablesize)
+		{
+			tablesize = sections * 2 + 4;
+			uint_fast64_t offset = slgraph_alloc(g, SLGRAPH_LISTHEADERSIZE + tablesize * SLGRAPH_SECTIONSIZE, 8);
+			if(!offset)
+				return(0);
+			if((table = slgraph_sectiontable(g))) // Can't reuse previous table, since slgraph_alloc() might have remapped.
+				memcpy(g->ptr + offset + SLGRAPH_LISTHEADERSIZE, table + SLGRAPH_LISTHEADERSIZE, sections * SLGRAPH_SECTIONSIZE);
+			table = g->ptr + offset;
+			slgraph_write48(table, tablesize);
+			slgraph_write48(g->ptr + SLGRAPH_HEADER_SECTIONS, offset);
+		}
+
+		entry = table + SLGRAPH_LISTHEADERSIZE + sections * SLGRAPH_SECTIONSIZE;
+		memset(entry, 0, SLGRAPH_SECTIONSIZE);
+		memcpy(entry, name, strlen(name));
+		slgraph_write48(table + SLGRAPH_SIZE, sections + 1);
+	}
+
+	const size_t entryoffset = entry - g->ptr;
+	uint_fast64_t offset = slgraph_alloc(g, size, SLGRAPH_SECTIONALIGN);
+	if(!offset)
+		return(0);
+	entry = g->ptr + entryoffset;
+
+	if(oldsize)
+		memcpy(g->ptr + offset, g->ptr + oldoffset, oldsize);
+	memset(g->ptr + offset + oldsize, 0, size - oldsize);
+
+	slgraph_write64(entry + SLGRAPH_SECTIONNAMESIZE, offset);
+	slgraph_write64(entry + SLGRAPH_SECTIONNAMESIZE + 8, size);
+
+	return(g->ptr + offset);
+}
+
+// Record that edge e is at position pos of its out- or in-list, if edge positions are tracked for g.
+static int slgraph_edgepos_set(slgraph_t *g, slgraph_edge_t e, size_t field, uint_fast64_t pos)
+{
+	uint_fast64_t size;
+	unsigned char *edgepos = slgraph_section(g, "edgepos", &size);
+
+	if(!edgepos)
+		return(0);
+
+	if((e + 1) * SLGRAPH_EDGEPOSSIZE > size) // The edge list has grown since.
+		if(!(edgepos = slgraph_section_reserve(g, "edgepos", slgraph_read48(slgraph_edgelist(g)) * SLGRAPH_EDGEPOSSIZE)))
+			return(-1);
+
+	slgraph_write48(edgepos + e * SLGRAPH_EDGEPOSSIZE + field, pos);
+
+	return(0);
+}
+
+// Start tracking edge positions, so edges can be removed from incidence lists in constant time.
+// Complexity O(nodes + edges) once, O(1) if positions are already tracked. Might remap.
+static int slgraph_edgepos_build(slgraph_t *g)
+{
+	if(slgraph_section(g, "edgepos", 0))
+		return(0);
+
+	unsigned char *edgepos = slgraph_section_reserve(g, "edgepos", slgraph_read48(slgraph_edgelist(g)) * SLGRAPH_EDGEPOSSIZE);
+	if(!edgepos)
+		return(-1);
+
+	uint_fast64_t n = slgraph_nodes(g);
+
+	for(slgraph_node_t v = 0; v < n; v++)
+	{
+		uint_fast64_t degree = slgraph_out_degree(g, v);
+		for(uint_fast64_t i = 0; i < degree; i++)
+			slgraph_write48(edgepos + slgraph_out_incident(g, v, i) * SLGRAPH_EDGEPOSSIZE + SLGRAPH_EDGEPOS_OUT, i);
+
+		degree = slgraph_in_degree(g, v);
+		for(uint_fast64_t i = 0; i < degree; i++)
+			slgraph_write48(edgepos + slgraph_in_incident(g, v, i) * SLGRAPH_EDGEPOSSIZE + SLGRAPH_EDGEPOS_IN, i);
+	}
+
+	return(0);
+}
+
+// Get pointer to the removal state, creating it if create is set (return 0 if there is none). Might remap.
+static unsigned char *slgraph_removed(slgraph_t *g, bool create)
+{
+	unsigned char *removed = slgraph_section(g, "removed", 0);
+
+	if(removed || !create)
+		return(removed);
+
+	if(!(removed = slgraph_section_reserve(g, "removed", SLGRAPH_REMOVEDSIZE)))
+		return(0);
+
+	slgraph_write64(removed, SLGRAPH_INVALID_EDGE);
+	slgraph_write64(removed + 24, SLGRAPH_COMPACTION_DEFAULT);
+
+	return(removed);
+}
+
+// Get the first edge slot on the free edge list (return SLGRAPH_INVALID_EDGE if it is empty).
+static slgraph_edge_t slgraph_free_edge(slgraph_t *g)
+{
+	const unsigned char *removed = slgraph_removed(g, false);
+
+	return(removed ? slgraph_read64(removed) : SLGRAPH_INVALID_EDGE);
+}
+
+// Take the first edge slot off the free edge list, once it is in use again. next is the link the slot held.
+static void slgraph_reuse_edge(slgraph_t *g, uint_fast64_t next)
+{
+	unsigned char *removed = slgraph_removed(g, false);
+
+	slgraph_write64(removed, next == SLGRAPH_FREELIST_END ? SLGRAPH_INVALID_EDGE : next);
+	slgraph_write64(removed + 8, slgraph_read64(removed + 8) - 1);
+}
+
+// Swap-remove edge e from the incidence list referenced by the offset field of node n.
+static void slgraph_unmake_directed_incident(slgraph_t *g, slgraph_node_t n, size_t offset_field, slgraph_edge_t e)
+{
+	unsigned char *edgepos = slgraph_section(g, "edgepos", 0);
+	const size_t field = offset_field == SLGRAPH_NODE_OUT ? SLGRAPH_EDGEPOS_OUT : SLGRAPH_EDGEPOS_IN;
+	const unsigned char *nodeptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE;
+	unsigned char *listptr = g->ptr + slgraph_read64(nodeptr + offset_field);
+	uint_fast64_t degree = slgraph_read48(listptr + SLGRAPH_SIZE);
+	uint_fast64_t pos = slgraph_read48(edgepos + e * SLGRAPH_EDGEPOSSIZE + field);
+
+	if(slgraph_flags(g) & SLGRAPH_FLAG_SORTED) // Shift the rest of the list to keep it sorted.
+		for(uint_fast64_t i = pos + 1; i < degree; i++)
+		{
+			slgraph_edge_t next = slgraph_read48(listptr + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
+			slgraph_write48(listptr + SLGRAPH_LISTHEADERSIZE + (i - 1) * SLGRAPH_INCIDENCESIZE, next);
+			slgraph_write48(edgepos + next * SLGRAPH_EDGEPOSSIZE + field, i - 1);
+		}
+	else if(pos + 1 < degree)
+	{
+		slgraph_edge_t last = slgraph_read48(listptr + SLGRAPH_LISTHEADERSIZE + (degree - 1) * SLGRAPH_INCIDENCESIZE);
+		slgraph_write48(listptr + SLGRAPH_LISTHEADERSIZE + pos * SLGRAPH_INCIDENCESIZE, last);
+		slgraph_write48(edgepos + last * SLGRAPH_EDGEPOSSIZE + field, pos);
+	}
+	slgraph_write48(listptr + SLGRAPH_SIZE, degree - 1);
+}
+
+// Remove directed edge e from both incidence lists and put it on the free edge list.
+// Edge positions and removal state must already exist.
+static int slgraph_tombstone_edge(slgraph_t *g, slgraph_edge_t e)
+{
+	if(e >= slgraph_edges(g))
+		return(-1);
+
+	unsigned char *edgeptr = slgraph_edgelist(g) + SLGRAPH_LISTHEADERSIZE + e * SLGRAPH_EDGESIZE;
+	if(edgeptr[18] != SLGRAPH_EDGE_DIRECTED) // Undirected or already removed
+		return(-1);
+
+	slgraph_flags_clear(g, SLGRAPH_FLAG_DERIVED);
+
+	slgraph_node_t src, dst;
+	slgraph_edge_ends(g, e, &src, &dst);
+	slgraph_unmake_directed_incident(g, src, SLGRAPH_NODE_OUT, e);
+	slgraph_unmake_directed_incident(g, dst, SLGRAPH_NODE_IN, e);
+
+	unsigned char *removed = slgraph_removed(g, false);
+	uint_fast64_t next = slgraph_read64(removed);
+	slgraph_write48(edgeptr + 12, next == SLGRAPH_INVALID_EDGE ? SLGRAPH_FREELIST_END : next);
+	edgeptr[18] = SLGRAPH_EDGE_DIRECTED | SLGRAPH_EDGE_DELETED;
+	slgraph_properties_clear(g, SLGRAPH_EDGE_PROPERTY, e);
+	slgraph_write64(removed, e);
+	slgraph_write64(removed + 8, slgraph_read64(removed + 8) + 1);
+
+	return(0);
+}
+
+// Compact the edge list if the fraction of removed edges exceeds the compaction threshold.
+static int slgraph_compact_lazy(slgraph_t *g)
+{
+	const unsigned char *removed = slgraph_removed(g, false);
+	uint_fast64_t threshold = slgraph_read64(removed + 24);
+
+	if(threshold >= 1000000 || slgraph_read64(removed + 8) * 1000000 <= threshold * slgraph_edges(g))
+		return(0);
+
+	return(slgraph_compact(g));
+}
+
+// Check whether e is a live directed edge of a graph that supports removal.
+static bool slgraph_removable_edge(slgraph_t *g, slgraph_edge_t e)
+{
+	if(g->readonly || g->version != 2 || e >= slgraph_edges(g))
+		return(false);
+
+	return(slgraph_edgelist(g)[SLGRAPH_LISTHEADERSIZE + e * SLGRAPH_EDGESIZE + 18] == SLGRAPH_EDGE_DIRECTED);
+}
+
+// Create the removal state and edge positions. Callers check first that the removal can succeed, so that a failing
+// call leaves the file unchanged.
+static int slgraph_remove_prepare(slgraph_t *g)
+{
+	return((!slgraph_removed(g, true) || slgraph_edgepos_build(g)) ? -1 : 0);
+}
+
+int slgraph_remove_edge(slgraph_t *g, slgraph_edge_t e)
+{
+	if(!slgraph_removable_edge(g, e) || slgraph_remove_prepare(g) || slgraph_tombstone_edge(g, e))
+		return(-1);
+
+	return(slgraph_compact_lazy(g));
+}
+
+int slgraph_remove_node(slgraph_t *g, slgraph_node_t n)
+{
+	if(g->readonly || g->version != 2 || n >= slgraph_nodes(g) || slgraph_node_removed(g, n))
+		return(-1);
+	for(uint_fast64_t i = 0, degree = slgraph_out_degree(g, n); i < degree; i++)
+		if(!slgraph_removable_edge(g, slgraph_out_incident(g, n, i)))
+			return(-1);
+	for(uint_fast64_t i = 0, degree = slgraph_in_degree(g, n); i < degree; i++)
+		if(!slgraph_removable_edge(g, slgraph_in_incident(g, n, i)))
+			return(-1);
+	if(slgraph_remove_prepare(g))
+		return(-1);
+
+	// Removing the last entry of a list never moves other entries.
+	for(uint_fast64_t degree; (degree = slgraph_out_degree(g, n));)
+		if(slgraph_tombstone_edge(g, slgraph_out_incident(g, n, degree - 1)))
+			return(-1);
+	for(uint_fast64_t degree; (degree = slgraph_in_degree(g, n));)
+		if(slgraph_tombstone_edge(g, slgraph_in_incident(g, n, degree - 1)))
+			return(-1);
+
+	slgraph_flags_clear(g, SLGRAPH_FLAG_DERIVED);
+	slgraph_write48(slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE + 16, SLGRAPH_NODE_DELETED);
+	unsigned char *removed = slgraph_removed(g, false);
+	slgraph_write64(removed + 16, slgraph_read64(removed + 16) + 1);
+
+	return(slgraph_compact_lazy(g));
+}
+
+int slgraph_compact(slgraph_t *g)
+{
+	if(g->readonly || !slgraph_removed(g, false) || !slgraph_read64(slgraph_removed(g, false) + 8))
+		return(0);
+
+	if(slgraph_edgepos_build(g))
+		return(-1);
+
+	unsigned char *removed = slgraph_removed(g, false);
+	unsigned char *edgepos = slgraph_section(g, "edgepos", 0);
+	unsigned char *edgelist = slgraph_edgelist(g) + SLGRAPH_LISTHEADERSIZE;
+	uint_fast64_t edges = slgraph_edges(g);
+
+	// Fill each hole in the edge list with the last live edge. Holes at the end are simply cut off.
+	for(slgraph_edge_t hole = slgraph_read64(removed); hole != SLGRAPH_INVALID_EDGE;)
+	{
+		uint_fast64_t next = slgraph_read48(edgelist + hole * SLGRAPH_EDGESIZE + 12);
+
+		while(edges && (edgelist[(edges - 1) * SLGRAPH_EDGESIZE + 18] & SLGRAPH_EDGE_DELETED))
+			edges--;
+
+		if(hole < edges)
+		{
+			slgraph_edge_t last = --edges;
+			slgraph_node_t src, dst;
+			slgraph_edge_ends(g, last, &src, &dst);
+
+			uint_fast64_t outpos = slgraph_read48(edgepos + last * SLGRAPH_EDGEPOSSIZE + SLGRAPH_EDGEPOS_OUT);
+			uint_fast64_t inpos = slgraph_read48(edgepos + last * SLGRAPH_EDGEPOSSIZE + SLGRAPH_EDGEPOS_IN);
+			const unsigned char *srcptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + src * SLGRAPH_NODESIZE;
+			const unsigned char *dstptr = slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + dst * SLGRAPH_NODESIZE;
+			slgraph_write48(g->ptr + slgraph_read64(srcptr + SLGRAPH_NODE_OUT) + SLGRAPH_LISTHEADERSIZE + outpos * SLGRAPH_INCIDENCESIZE, hole);
+			slgraph_write48(g->ptr + slgraph_read64(dstptr + SLGRAPH_NODE_IN) + SLGRAPH_LISTHEADERSIZE + inpos * SLGRAPH_INCIDENCESIZE, hole);
+
+			memcpy(edgelist + hole * SLGRAPH_EDGESIZE, edgelist + last * SLGRAPH_EDGESIZE, SLGRAPH_EDGESIZE);
+			memcpy(edgepos + hole * SLGRAPH_EDGEPOSSIZE, edgepos + last * SLGRAPH_EDGEPOSSIZE, SLGRAPH_EDGEPOSSIZE);
+			slgraph_properties_move(g, SLGRAPH_EDGE_PROPERTY, hole, last);
+			slgraph_properties_clear(g, SLGRAPH_EDGE_PROPERTY, last); // The slot may be appended to again.
+		}
+
+		hole = next == SLGRAPH_FREELIST_END ? SLGRAPH_INVALID_EDGE : next;
+	}
+
+	slgraph_write48(slgraph_edgelist(g) + SLGRAPH_SIZE, edges);
+	slgraph_write64(removed, SLGRAPH_INVALID_EDGE);
+	slgraph_write64(removed + 8, 0);
+
+	return(0);
+}
+
+int slgraph_set_compaction_threshold(slgraph_t *g, double threshold)
+{
+	unsigned char *removed = g->readonly ? 0 : slgraph_removed(g, true);
+
+	if(!removed || threshold < 0.0)
+		return(-1);
+
+	slgraph_write64(removed + 24, threshold >= 1.0 ? 1000000 : (uint_fast64_t)(threshold * 1000000.0));
+
+	return(0);
+}
+
+double slgraph_compaction_threshold(const slgraph_t *g)
+{
+	const uint_fast64_t removed = slgraph_section_find(g, "removed", 0, 0);
+
+	return((removed ? slgraph_get64(g, removed + 24) : SLGRAPH_COMPACTION_DEFAULT) / 1000000.0);
+}
+
+uint_fast64_t slgraph_removed_edges(const slgraph_t *g)
+{
+	const uint_fast64_t removed = slgraph_section_find(g, "removed", 0, 0);
+
+	return(removed ? slgraph_get64(g, removed + 8) : 0);
+}
+
+uint_fast64_t slgraph_removed_nodes(const slgraph_t *g)
+{
+	const uint_fast64_t removed = slgraph_section_find(g, "removed", 0, 0);
+
+	return(removed ? slgraph_get64(g, removed + 16) : 0);
+}
+
+bool slgraph_edge_removed(const slgraph_t *g, slgraph_edge_t e)
+{
+	if(g->shards)
+		g = slgraph_shard_edge(g, e, &e);
+
+	unsigned char buf[1];
+	return(*slgraph_at(g, slgraph_edge_offset(g, e) + 18, 1, buf) & SLGRAPH_EDGE_DELETED);
+}
+
+bool slgraph_node_removed(const slgraph_t *g, slgraph_node_t n)
+{
+	if(g->shards)
+		g = slgraph_shard_node(g, n, &n, 0);
+
+	return(slgraph_get48(g, slgraph_node_offset(g, n) + 16) == SLGRAPH_NODE_DELETED);
+}
+
+// Get the size in bytes of one element of a property column of type t (0 for invalid types).
+static size_t slgraph_typesize(slgraph_type_t t)
+{
+	switch(t)
+	{
+	case SLGRAPH_U8:
+		return(1);
+	case SLGRAPH_U32:
+	case SLGRAPH_F32:
+		return(4);
+	case SLGRAPH_U64:
+	case SLGRAPH_F64:
+		return(8);
+	default:
+		return(0);
+	}
+}
+
+// Get the section table entry of a property column (return 0 if there is none)
+static unsigned char *slgraph_property_entry(const slgraph_t *g, const char *name)
+{
+	char sectionname[SLGRAPH_SECTIONNAMESIZE];
+
+	if(strlen(name) >= SLGRAPH_PROPERTYNAMESIZE)
+		return(0);
+
+	strcpy(sectionname, SLGRAPH_PROPERTYPREFIX);
+	strcat(sectionname, name);
+
+	return(slgraph_section_entry(g, sectionname));
+}
+
+// Get the number of elements a column of the given scope needs to cover every node or edge slot in g.
+static uint_fast64_t slgraph_property_capacity(const slgraph_t *g, slgraph_scope_t scope)
+{
+	return(slgraph_read48(scope == SLGRAPH_NODE_PROPERTY ? slgraph_nodelist(g) : slgraph_edgelist(g)));
+}
+
+void *slgraph_property_add(slgraph_t *g, const char *name, slgraph_scope_t scope, slgraph_type_t type)
+{
+	const unsigned char *entry = slgraph_property_entry(g, name);
+
+	if(entry)
+		return((slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 16) & 0xffff) == (type | scope << 8) ? g->ptr + slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE) : 0);
+
+	if(!slgraph_typesize(type) || (scope != SLGRAPH_NODE_PROPERTY && scope != SLGRAPH_EDGE_PROPERTY) || strlen(name) >= SLGRAPH_PROPERTYNAMESIZE)
+		return(0);
+
+	char sectionname[SLGRAPH_SECTIONNAMESIZE];
+	strcpy(sectionname, SLGRAPH_PROPERTYPREFIX);
+	strcat(sectionname, name);
+
+	unsigned char *column = slgraph_section_reserve(g, sectionname, slgraph_property_capacity(g, scope) * slgraph_typesize(type));
+	if(!column)
+		return(0);
+
+	slgraph_write64(slgraph_section_entry(g, sectionname) + SLGRAPH_SECTIONNAMESIZE + 16, type | scope << 8);
+
+	return(column);
+}
+
+void *slgraph_property(const slgraph_t *g, const char *name, slgraph_scope_t *scope, slgraph_type_t *type, uint_fast64_t *length)
+{
+	const unsigned char *entry = slgraph_property_entry(g, name);
+
+	if(!entry)
+		return(0);
+
+	uint_fast64_t info = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 16);
+
+	if(scope)
+		*scope = (info >> 8) & 0xff;
+	if(type)
+		*type = info & 0xff;
+	if(length)
+		*length = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8) / slgraph_typesize(info & 0xff);
+
+	return(g->ptr + slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE));
+}
+
+int slgraph_property_get(const slgraph_t *g, const char *name, uint_fast64_t first, uint_fast64_t count, void *values)
+{
+	char sectionname[SLGRAPH_SECTIONNAMESIZE];
+	uint_fast64_t size, info;
+
+	if(strlen(name) >= SLGRAPH_PROPERTYNAMESIZE)
+		return(-1);
+
+	strcpy(sectionname, SLGRAPH_PROPERTYPREFIX);
+	strcat(sectionname, name);
+
+	const uint_fast64_t column = slgraph_section_find(g, sectionname, &size, &info);
+	const size_t typesize = slgraph_typesize(info & 0xff);
+
+	if(!column || !typesize || first + count > size / typesize)
+		return(-1);
+
+	if(g->cache)
+		slgraph_cache_read(g->cache, column + first * typesize, count * typesize, values);
+	else
+		memcpy(values, g->ptr + column + first * typesize, count * typesize);
+
+	return(0);
+}
+
+int slgraph_property_set(slgraph_t *g, const char *name, uint_fast64_t first, uint_fast64_t count, const void *values)
+{
+	slgraph_scope_t scope;
+	slgraph_type_t type;
+	uint_fast64_t length;
+	unsigned char *column = slgraph_property(g, name, &scope, &type, &length);
+
+	if(!column || g->readonly)
+		return(-1);
+
+	if(first + count > length) // The node or edge list has grown since the column was created.
+	{
+		uint_fast64_t capacity = slgraph_property_capacity(g, scope);
+		char sectionname[SLGRAPH_SECTIONNAMESIZE];
+		strcpy(sectionname, SLGRAPH_PROPERTYPREFIX);
+		strcat(sectionname, name);
+		if(!(column = slgraph_section_reserve(g, sectionname, (capacity > first + count ? capacity : first + count) * slgraph_typesize(type))))
+			return(-1);
+	}
+
+	memcpy(column + first * slgraph_typesize(type), values, count * slgraph_typesize(type));
+
+	return(0);
+}
+
+// Copy the value at index src to index dst in all property columns of the given scope.
+static void slgraph_properties_move(slgraph_t *g, slgraph_scope_t scope, uint_fast64_t dst, uint_fast64_t src)
+{
+	const unsigned char *table = slgraph_sectiontable(g);
+	uint_fast64_t sections = table ? slgraph_read48(table + SLGRAPH_SIZE) : 0;
+
+	for(uint_fast64_t i = 0; i < sections; i++)
+	{
+		const unsigned char *entry = table + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_SECTIONSIZE;
+		uint_fast64_t info = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 16);
+		size_t typesize = slgraph_typesize(info & 0xff);
+
+		if(strncmp((const char *)entry, SLGRAPH_PROPERTYPREFIX, sizeof(SLGRAPH_PROPERTYPREFIX) - 1) || ((info >> 8) & 0xff) != scope)
+			continue;
+
+		unsigned char *column = g->ptr + slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE);
+		if((src + 1) * typesize <= slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8))
+			memcpy(column + dst * typesize, column + src * typesize, typesize);
+	}
+}
+
+// Zero the value at index in all property columns of the given scope.
+static void slgraph_properties_clear(slgraph_t *g, slgraph_scope_t scope, uint_fast64_t index)
+{
+	const unsigned char *table = slgraph_sectiontable(g);
+	uint_fast64_t sections = table ? slgraph_read48(table + SLGRAPH_SIZE) : 0;
+
+	for(uint_fast64_t i = 0; i < sections; i++)
+	{
+		const unsigned char *entry = table + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_SECTIONSIZE;
+		uint_fast64_t info = slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 16);
+		size_t typesize = slgraph_typesize(info & 0xff);
+
+		if(strncmp((const char *)entry, SLGRAPH_PROPERTYPREFIX, sizeof(SLGRAPH_PROPERTYPREFIX) - 1) || ((info >> 8) & 0xff) != scope)
+			continue;
+
+		if((index + 1) * typesize <= slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE + 8))
+			memset(g->ptr + slgraph_read64(entry + SLGRAPH_SECTIONNAMESIZE) + index * typesize, 0, typesize);
+	}
+}
+
+// Get the offset of the original ID dictionary of g and the number of IDs in it (0 if there is none).
+static uint_fast64_t slgraph_ids(const slgraph_t *g, uint_fast64_t *count)
+{
+	uint_fast64_t size = 0;
+	const uint_fast64_t ids = slgraph_section_find(g, SLGRAPH_IDSSECTION, &size, 0);
+
+	*count = size / 8;
+
+	return(ids);
+}
+
+int slgraph_set_original_ids(slgraph_t *g, const uint64_t *ids, uint_fast64_t count)
+{
+	if(g->readonly || count > slgraph_nodes(g))
+		return(-1);
+
+	for(uint_fast64_t i = 1; i < count; i++)
+		if(ids[i] <= ids[i - 1])
+			return(-1);
+
+	unsigned char *section = slgraph_section_reserve(g, SLGRAPH_IDSSECTION, count * 8);
+	if(!section)
+		return(-1);
+
+	for(uint_fast64_t i = 0; i < count; i++)
+		slgraph_write64(section + i * 8, ids[i]);
+
+	// Replacing a larger dictionary keeps its section, so the size is set explicitly.
+	slgraph_write64(slgraph_section_entry(g, SLGRAPH_IDSSECTION) + SLGRAPH_SECTIONNAMESIZE + 8, count * 8);
+
+	return(0);
+}
+
+bool slgraph_has_original_ids(const slgraph_t *g)
+{
+	uint_fast64_t count;
+
+	if(g->shards)
+		g = slgraph_shard_graph(g->shards, 0);
+
+	return(slgraph_ids(g, &count) != 0);
+}
+
+uint_fast64_t slgraph_original_id(const slgraph_t *g, slgraph_node_t n)
+{
+	slgraph_node_t local = n;
+	uint_fast64_t count;
+
+	if(g->shards) // Each shard holds the IDs of its own nodes.
+		g = slgraph_shard_node(g, n, &local, 0);
+
+	const uint_fast64_t ids = slgraph_ids(g, &count);
+
+	if(!ids)
+		return(n);
+
+	return(local < count ? slgraph_get64(g, ids + local * 8) : SLGRAPH_INVALID_NODE);
+}
+
+// Get the i-th smallest original ID of g, from the dictionary at offset ids unless g is sharded.
+static uint_fast64_t slgraph_original_id_at(const slgraph_t *g, uint_fast64_t ids, uint_fast64_t i)
+{
+	return(g->shards ? slgraph_original_id(g, i) : slgraph_get64(g, ids + i * 8));
+}
+
+slgraph_node_t slgraph_node_by_original_id(const slgraph_t *g, uint_fast64_t id)
+{
+	uint_fast64_t ids = 0, count = slgraph_nodes(g);
+
+	if(!slgraph_has_original_ids(g))
+		return(id < count ? id : SLGRAPH_INVALID_NODE);
+	if(!g->shards)
+		ids = slgraph_ids(g, &count);
+
+	uint_fast64_t lo = 0, hi = count; // The node is in [lo, hi) if there is one.
+
+	// Guess the position from the ID range, assuming IDs are spread evenly (as OSM IDs of a region mostly are).
+	// A guess that does not halve the range is followed by a bisection step, bounding the worst case.
+	for(bool bisect = false; hi - lo > SLGRAPH_SEARCH_SMALL;)
+	{
+		const uint_fast64_t first = slgraph_original_id_at(g, ids, lo);
+		const uint_fast64_t last = slgraph_original_id_at(g, ids, hi - 1);
+
+		if(id < first || id > last)
+			return(SLGRAPH_INVALID_NODE);
+
+		const uint_fast64_t range = hi - lo;
+		const uint_fast64_t pos = bisect ? lo + range / 2 : lo + (uint_fast64_t)((double)(id - first) / (double)(last - first) * (double)(range - 1));
+		const uint_fast64_t v = slgraph_original_id_at(g, ids, pos);
+
+		if(v == id)
+			return(pos);
+		if(v < id)
+			lo = pos + 1;
+		else
+			hi = pos;
+
+		bisect = hi - lo > range / 2;
+	}
+
+	while(lo < hi)
+	{
+		const uint_fast64_t mid = lo + (hi - lo) / 2;
+		const uint_fast64_t v = slgraph_original_id_at(g, ids, mid);
+
+		if(v == id)
+			return(mid);
+		if(v < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return(SLGRAPH_INVALID_NODE);
+}
+
+// Get the graph flags (0 if there is no flags section)
+static uint_fast64_t slgraph_flags(const slgraph_t *g)
+{
+	if(g->shards)
+		return(g->shards->flags);
+	if(g->cache)
+		return(g->cache->flags);
+
+	const unsigned char *flags = slgraph_section(g, "flags", 0);
+
+	return(flags ? slgraph_read64(flags) : 0);
+}
+
+// Get the neighbour by which edge e is ordered in an out-list (node1) or in-list (node0).
+static slgraph_node_t slgraph_incident_key(const slgraph_t *g, slgraph_edge_t e, size_t offset_field)
+{
+	return(slgraph_get48(g, slgraph_edge_offset(g, e) + (offset_field == SLGRAPH_NODE_OUT ? 6 : 0)));
+}
+
+// Clear graph flags, if set.
+static void slgraph_flags_clear(slgraph_t *g, uint_fast64_t flags)
+{
+	unsigned char *ptr = slgraph_section(g, "flags", 0);
+
+	if(ptr && (slgraph_read64(ptr) & flags))
+		slgraph_write64(ptr, slgraph_read64(ptr) & ~flags);
+}
+
+bool slgraph_sorted_adjacency(const slgraph_t *g)
+{
+	return(slgraph_flags(g) & SLGRAPH_FLAG_SORTED);
+}
+
+struct slgraph_sortentry
+{
+	slgraph_node_t key;
+	slgraph_edge_t edge;
+};
+
+static int slgraph_sortentry_cmp(const void *a, const void *b)
+{
+	const struct slgraph_sortentry *ea = a, *eb = b;
+
+	if(ea->key != eb->key)
+		return(ea->key < eb->key ? -1 : 1);
+	return((ea->edge > eb->edge) - (ea->edge < eb->edge));
+}
+
+int slgraph_sort_adjacency(slgraph_t *g)
+{
+	if(g->readonly)
+		return(-1);
+
+	if(slgraph_flags(g) & SLGRAPH_FLAG_SORTED)
+		return(0);
+
+	unsigned char *flags = slgraph_section_reserve(g, "flags", 8);
+	if(!flags)
+		return(-1);
+
+	uint_fast64_t n = slgraph_nodes(g);
+	uint_fast64_t bufsize = 0;
+	struct slgraph_sortentry *buf = 0;
+	unsigned char *edgepos = slgraph_section(g, "edgepos", 0);
+
+	for(slgraph_node_t v = 0; v < n; v++)
+		for(size_t offset_field = SLGRAPH_NODE_OUT; offset_field <= SLGRAPH_NODE_IN; offset_field += SLGRAPH_NODE_IN - SLGRAPH_NODE_OUT)
+		{
+			uint_fast64_t offset = slgraph_read64(slgraph_nodelist(g) + SLGRAPH_LISTHEADERSIZE + v * SLGRAPH_NODESIZE + offset_field);
+			unsigned char *listptr = g->ptr + offset;
+			uint_fast64_t degree = offset ? slgraph_read48(listptr + SLGRAPH_SIZE) : 0;
+
+			if(degree < 2)
+				continue;
+
+			if(degree > bufsize)
+			{
+				struct slgraph_sortentry *newbuf = realloc(buf, degree * sizeof(struct slgraph_sortentry));
+				if(!newbuf)
+				{
+					free(buf);
+					return(-1);
+				}
+				buf = newbuf;
+				bufsize = degree;
+			}
+
+			for(uint_fast64_t i = 0; i < degree; i++)
+			{
+				buf[i].edge = slgraph_read48(listptr + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
+				buf[i].key = slgraph_incident_key(g, buf[i].edge, offset_field);
+			}
+
+			qsort(buf, degree, sizeof(struct slgraph_sortentry), slgraph_sortentry_cmp);
+
+			for(uint_fast64_t i = 0; i < degree; i++)
+			{
+				slgraph_write48(listptr + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE, buf[i].edge);
+				if(edgepos)
+					slgraph_write48(edgepos + buf[i].edge * SLGRAPH_EDGEPOSSIZE + (offset_field == SLGRAPH_NODE_OUT ? SLGRAPH_EDGEPOS_OUT : SLGRAPH_EDGEPOS_IN), i);
+			}
+		}
+
+	free(buf);
+
+	slgraph_write64(flags, slgraph_read64(flags) | SLGRAPH_FLAG_SORTED);
+
+	return(0);
+}
+
+// Find the first position in the sorted list at offset list whose neighbour is not less than key.
+static uint_fast64_t slgraph_lower_bound(const slgraph_t *g, uint_fast64_t list, size_t offset_field, slgraph_node_t key)
+{
+	const uint_fast64_t entries = list + SLGRAPH_LISTHEADERSIZE;
+	uint_fast64_t lo = 0, hi = slgraph_get48(g, list + SLGRAPH_SIZE); // The result is in [lo, hi].
+
+	// Hubs: guess the position from the neighbour range, assuming neighbours are spread evenly.
+	// A guess that does not halve the range is followed by a bisection step, bounding the worst case.
+	for(bool bisect = false; hi - lo > SLGRAPH_SEARCH_SMALL;)
+	{
+		slgraph_node_t first = slgraph_incident_key(g, slgraph_get48(g, entries + lo * SLGRAPH_INCIDENCESIZE), offset_field);
+		slgraph_node_t last = slgraph_incident_key(g, slgraph_get48(g, entries + (hi - 1) * SLGRAPH_INCIDENCESIZE), offset_field);
+
+		if(key <= first)
+			return(lo);
+		if(key > last)
+			return(hi);
+
+		const uint_fast64_t range = hi - lo;
+		uint_fast64_t pos = bisect ? lo + range / 2 : lo + (uint_fast64_t)((double)(key - first) / (double)(last - first) * (double)(range - 1));
+
+		if(slgraph_incident_key(g, slgraph_get48(g, entries + pos * SLGRAPH_INCIDENCESIZE), offset_field) < key)
+			lo = pos + 1;
+		else
+			hi = pos + 1;
+
+		bisect = hi - lo > range / 2;
+	}
+
+	// Small lists: branchless binary search.
+	uint_fast64_t base = lo, len = hi - lo;
+	if(!len)
+		return(lo);
+	while(len > 1)
+	{
+		uint_fast64_t half = len / 2;
+		base = slgraph_incident_key(g, slgraph_get48(g, entries + (base + half - 1) * SLGRAPH_INCIDENCESIZE), offset_field) < key ? base + half : base;
+		len -= half;
+	}
+	return(base + (slgraph_incident_key(g, slgraph_get48(g, entries + base * SLGRAPH_INCIDENCESIZE), offset_field) < key));
+}
+
+// Find the edge with neighbour key in the out- or in-list of owner (SLGRAPH_INVALID_EDGE if none).
+static slgraph_edge_t slgraph_list_find(const slgraph_t *g, slgraph_node_t owner, size_t offset_field, slgraph_node_t key)
+{
+	const uint_fast64_t degree = offset_field == SLGRAPH_NODE_OUT ? slgraph_out_degree(g, owner) : slgraph_in_degree(g, owner);
+
+	if(!degree)
+		return(SLGRAPH_INVALID_EDGE);
+
+	const uint_fast64_t list = slgraph_get64(g, slgraph_node_offset(g, owner) + offset_field);
+
+	if(slgraph_flags(g) & SLGRAPH_FLAG_SORTED)
+	{
+		uint_fast64_t pos = slgraph_lower_bound(g, list, offset_field, key);
+		if(pos == degree)
+			return(SLGRAPH_INVALID_EDGE);
+		slgraph_edge_t e = slgraph_get48(g, list + SLGRAPH_LISTHEADERSIZE + pos * SLGRAPH_INCIDENCESIZE);
+		return(slgraph_incident_key(g, e, offset_field) == key ? e : SLGRAPH_INVALID_EDGE);
+	}
+
+	for(uint_fast64_t i = 0; i < degree; i++)
+	{
+		slgraph_edge_t e = slgraph_get48(g, list + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
+		if(slgraph_incident_key(g, e, offset_field) == key)
+			return(e);
+	}
+
+	return(SLGRAPH_INVALID_EDGE);
+}
+
+slgraph_edge_t slgraph_find_edge(const slgraph_t *g, slgraph_node_t u, slgraph_node_t v)
+{
+	// Search the shorter of the out-list of u and the in-list of v.
+	const size_t offset_field = slgraph_out_degree(g, u) <= slgraph_in_degree(g, v) ? SLGRAPH_NODE_OUT : SLGRAPH_NODE_IN;
+	slgraph_node_t owner = offset_field == SLGRAPH_NODE_OUT ? u : v;
+	uint_fast64_t edgebase = 0;
+
+	if(g->shards) // Lists are local to the shard of their node, neighbours are global.
+		g = slgraph_shard_node(g, owner, &owner, &edgebase);
+
+	slgraph_edge_t e = slgraph_list_find(g, owner, offset_field, offset_field == SLGRAPH_NODE_OUT ? v : u);
+
+	return(e == SLGRAPH_INVALID_EDGE ? e : edgebase + e);
+}
+
+bool slgraph_has_edge(const slgraph_t *g, slgraph_node_t u, slgraph_node_t v)
+{
+	return(slgraph_find_edge(g, u, v) != SLGRAPH_INVALID_EDGE);
+}
+
+int slgraph_set_summary(slgraph_t *g, const slgraph_summary_t *summary, const uint_fast64_t *out_histogram, const uint_fast64_t *in_histogram)
+{
+	if(g->readonly || !slgraph_section_reserve(g, "flags", 8))
+		return(-1);
+
+	const uint_fast64_t size = SLGRAPH_SUMMARYSIZE + (summary->max_out_degree + 1 + summary->max_in_degree + 1) * 8;
+	uint_fast64_t oldsize = 0;
+	unsigned char *ptr = slgraph_section(g, "summary", &oldsize);
+
+	// A smaller summary still fits into the old section, the histogram sizes follow from the maximum degrees.
+	if(!ptr || oldsize < size)
+		if(!(ptr = slgraph_section_reserve(g, "summary", size)))
+			return(-1);
+
+	slgraph_write64(ptr + 0, summary->nodes);
+	slgraph_write64(ptr + 8, summary->edges);
+	slgraph_write64(ptr + 16, summary->max_out_degree);
+	slgraph_write64(ptr + 24, summary->max_in_degree);
+	slgraph_write64(ptr + 32, summary->self_loops);
+	slgraph_write64(ptr + 40, summary->duplicate_edges);
+	slgraph_write64(ptr + 48, summary->isolated_nodes);
+
+	ptr += SLGRAPH_SUMMARYSIZE;
+	for(uint_fast64_t d = 0; d <= summary->max_out_degree; d++, ptr += 8)
+		slgraph_write64(ptr, out_histogram[d]);
+	for(uint_fast64_t d = 0; d <= summary->max_in_degree; d++, ptr += 8)
+		slgraph_write64(ptr, in_histogram[d]);
+
+	unsigned char *flags = slgraph_section(g, "flags", 0);
+	slgraph_write64(flags, slgraph_read64(flags) | SLGRAPH_FLAG_SUMMARY);
+
+	return(0);
+}
+
+// Get offset of the summary section (return 0 if there is none or it is outdated)
+static uint_fast64_t slgraph_summary_section(const slgraph_t *g)
+{
+	return((slgraph_flags(g) & SLGRAPH_FLAG_SUMMARY) ? slgraph_section_find(g, "summary", 0, 0) : 0);
+}
+
+int slgraph_summary(const slgraph_t *g, slgraph_summary_t *summary)
+{
+	const uint_fast64_t offset = slgraph_summary_section(g);
+	unsigned char buf[SLGRAPH_SUMMARYSIZE];
+
+	if(!offset)
+		return(-1);
+
+	const unsigned char *ptr = slgraph_at(g, offset, SLGRAPH_SUMMARYSIZE, buf);
+
+	summary->nodes = slgraph_read64(ptr + 0);
+	summary->edges = slgraph_read64(ptr + 8);
+	summary->max_out_degree = slgraph_read64(ptr + 16);
+	summary->max_in_degree = slgraph_read64(ptr + 24);
+	summary->self_loops = slgraph_read64(ptr + 32);
+	summary->duplicate_edges = slgraph_read64(ptr + 40);
+	summary->isolated_nodes = slgraph_read64(ptr + 48);
+
+	return(0);
+}
+
+uint_fast64_t slgraph_summary_out_degree_count(const slgraph_t *g, uint_fast64_t degree)
+{
+	const uint_fast64_t offset = slgraph_summary_section(g);
+
+	if(!offset || degree > slgraph_get64(g, offset + 16))
+		return(0);
+
+	return(slgraph_get64(g, offset + SLGRAPH_SUMMARYSIZE + degree * 8));
+}
+
+uint_fast64_t slgraph_summary_in_degree_count(const slgraph_t *g, uint_fast64_t degree)
+{
+	const uint_fast64_t offset = slgraph_summary_section(g);
+
+	if(!offset || degree > slgraph_get64(g, offset + 24))
+		return(0);
+
+	return(slgraph_get64(g, offset + SLGRAPH_SUMMARYSIZE + (slgraph_get64(g, offset + 16) + 1 + degree) * 8));
+}
+
+int slgraph_csr_store(slgraph_t *g, bool reverse)
+{
+	const char *name = reverse ? "csr.in" : "csr.out";
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	const bool in = reverse && g->version != 1; // Version 1 graphs only have the out-lists
+
+	if(g->readonly || !slgraph_section_reserve(g, "flags", 8))
+		return(-1);
+
+	uint_fast64_t targets = 0;
+	for(slgraph_node_t n = 0; n < nodes; n++)
+		targets += in ? slgraph_in_degree(g, n) : slgraph_out_degree(g, n);
+
+	unsigned char *ptr = slgraph_section_reserve(g, name, (nodes + 1 + targets) * 8);
+	if(!ptr)
+		return(-1);
+
+	unsigned char *target = ptr + (nodes + 1) * 8;
+	uint_fast64_t offset = 0;
+	for(slgraph_node_t n = 0; n < nodes; n++)
+	{
+		const uint_fast64_t degree = in ? slgraph_in_degree(g, n) : slgraph_out_degree(g, n);
+
+		slgraph_write64(ptr + n * 8, offset);
+		for(uint_fast64_t i = 0; i < degree; i++, offset++)
+		{
+			slgraph_node_t n0, n1;
+			slgraph_edge_ends(g, in ? slgraph_in_incident(g, n, i) : slgraph_out_incident(g, n, i), &n0, &n1);
+			slgraph_write64(target + offset * 8, n0 == n ? n1 : n0);
+		}
+	}
+	slgraph_write64(ptr + nodes * 8, offset);
+
+	unsigned char *flags = slgraph_section(g, "flags", 0);
+	slgraph_write64(flags, slgraph_read64(flags) | (reverse ? SLGRAPH_FLAG_CSRIN : SLGRAPH_FLAG_CSROUT));
+
+	return(0);
+}
+
+const uint64_t *slgraph_csr(const slgraph_t *g, bool reverse, const uint64_t **targets)
+{
+	uint_fast64_t size;
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	const unsigned char *ptr = (slgraph_flags(g) & (reverse ? SLGRAPH_FLAG_CSRIN : SLGRAPH_FLAG_CSROUT)) ? slgraph_section(g, reverse ? "csr.in" : "csr.out", &size) : 0;
+
+	if(!ptr || size < (nodes + 1) * 8 || size < (nodes + 1 + slgraph_read64(ptr + nodes * 8)) * 8)
+		return(0);
+
+	if(targets)
+		*targets = (const uint64_t *)(ptr + (nodes + 1) * 8);
+	return((const uint64_t *)ptr);
+}
+
+// Write the arcs of one direction of a contraction hierarchy into the section name.
+static int slgraph_ch_write(slgraph_t *g, const char *name, const uint64_t *offsets, const slgraph_ch_arc_t *arcs)
+{
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	unsigned char *ptr = slgraph_section_reserve(g, name, (nodes + 1) * 8 + offsets[nodes] * SLGRAPH_CHARCSIZE);
+
+	if(!ptr)
+		return(-1);
+
+	for(uint_fast64_t n = 0; n <= nodes; n++)
+		slgraph_write64(ptr + n * 8, offsets[n]);
+
+	unsigned char *arc = ptr + (nodes + 1) * 8;
+	for(uint_fast64_t i = 0; i < offsets[nodes]; i++, arc += SLGRAPH_CHARCSIZE)
+	{
+		uint64_t weight;
+		memcpy(&weight, &arcs[i].weight, 8);
+		slgraph_write64(arc, arcs[i].node);
+		slgraph_write64(arc + 8, weight);
+		slgraph_write64(arc + 16, arcs[i].middle);
+	}
+
+	return(0);
+}
+
+int slgraph_set_ch(slgraph_t *g, const uint64_t *rank, const uint64_t *up, const slgraph_ch_arc_t *up_arcs, const uint64_t *down, const slgraph_ch_arc_t *down_arcs)
+{
+	const uint_fast64_t nodes = slgraph_nodes(g);
+
+	if(g->readonly || !slgraph_section_reserve(g, "flags", 8))
+		return(-1);
+
+	// The old hierarchy is gone once any of its sections is overwritten.
+	slgraph_flags_clear(g, SLGRAPH_FLAG_CH);
+
+	unsigned char *ptr = slgraph_section_reserve(g, "ch.rank", nodes * 8);
+	if(!ptr)
+		return(-1);
+	for(uint_fast64_t n = 0; n < nodes; n++)
+		slgraph_write64(ptr + n * 8, rank[n]);
+
+	if(slgraph_ch_write(g, "ch.up", up, up_arcs) || slgraph_ch_write(g, "ch.down", down, down_arcs))
+		return(-1);
+
+	unsigned char *flags = slgraph_section(g, "flags", 0);
+	slgraph_write64(flags, slgraph_read64(flags) | SLGRAPH_FLAG_CH);
+
+	return(0);
+}
+
+// Get the offsets of one direction of the contraction hierarchy of g and its arcs (0 if the section is too small).
+static const uint64_t *slgraph_ch_read(const slgraph_t *g, const char *name, const slgraph_ch_arc_t **arcs)
+{
+	uint_fast64_t size;
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	const unsigned char *ptr = slgraph_section(g, name, &size);
+
+	if(!ptr || size < (nodes + 1) * 8 || size < (nodes + 1) * 8 + slgraph_read64(ptr + nodes * 8) * SLGRAPH_CHARCSIZE)
+		return(0);
+
+	*arcs = (const slgraph_ch_arc_t *)(ptr + (nodes + 1) * 8);
+	return((const uint64_t *)ptr);
+}
+
+int slgraph_ch(const slgraph_t *g, slgraph_ch_t *ch)
+{
+	uint_fast64_t size;
+
+	if(!(slgraph_flags(g) & SLGRAPH_FLAG_CH))
+		return(-1);
+
+	ch->rank = (const uint64_t *)slgraph_section(g, "ch.rank", &size);
+	ch->up = slgraph_ch_read(g, "ch.up", &ch->up_arcs);
+	ch->down = slgraph_ch_read(g, "ch.down", &ch->down_arcs);
+
+	return(ch->rank && size >= slgraph_nodes(g) * 8 && ch->up && ch->down ? 0 : -1);
+}
+
+int slgraph_set_reach(slgraph_t *g, const slgraph_reach_t *reach)
+{
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	const uint_fast64_t components = reach->components;
+	const uint_fast64_t values = components * reach->labels * 2;
+
+	if(g->readonly || !slgraph_section_reserve(g, "flags", 8))
+		return(-1);
+
+	// The old index is gone once any of its sections is overwritten.
+	slgraph_flags_clear(g, SLGRAPH_FLAG_REACH);
+
+	unsigned char *ptr = slgraph_section_reserve(g, "reach.comp", SLGRAPH_REACHHEADERSIZE + nodes * 8);
+	if(!ptr)
+		return(-1);
+	slgraph_write64(ptr, components);
+	slgraph_write64(ptr + 8, reach->labels);
+	for(uint_fast64_t n = 0; n < nodes; n++)
+		slgraph_write64(ptr + SLGRAPH_REACHHEADERSIZE + n * 8, reach->component[n]);
+
+	if(!(ptr = slgraph_section_reserve(g, "reach.dag", (components + 1 + reach->dag[components]) * 8)))
+		return(-1);
+	for(uint_fast64_t c = 0; c <= components; c++)
+		slgraph_write64(ptr + c * 8, reach->dag[c]);
+	for(uint_fast64_t i = 0; i < reach->dag[components]; i++)
+		slgraph_write64(ptr + (components + 1 + i) * 8, reach->dag_targets[i]);
+
+	if(!(ptr = slgraph_section_reserve(g, "reach.labels", values * 8)))
+		return(-1);
+	for(uint_fast64_t i = 0; i < values; i++)
+		slgraph_write64(ptr + i * 8, reach->intervals[i]);
+
+	unsigned char *flags = slgraph_section(g, "flags", 0);
+	slgraph_write64(flags, slgraph_read64(flags) | SLGRAPH_FLAG_REACH);
+
+	return(0);
+}
+
+int slgraph_reach(const slgraph_t *g, slgraph_reach_t *reach)
+{
+	uint_fast64_t size, dag_size, labels_size;
+
+	if(!(slgraph_flags(g) & SLGRAPH_FLAG_REACH))
+		return(-1);
+
+	const unsigned char *comp = slgraph_section(g, "reach.comp", &size);
+	const unsigned char *dag = slgraph_section(g, "reach.dag", &dag_size);
+	const unsigned char *labels = slgraph_section(g, "reach.labels", &labels_size);
+	if(!comp || !dag || !labels || size < SLGRAPH_REACHHEADERSIZE + slgraph_nodes(g) * 8)
+		return(-1);
+
+	const uint_fast64_t components = slgraph_read64(comp), labels_count = slgraph_read64(comp + 8);
+	if(dag_size < (components + 1) * 8 || dag_size < (components + 1 + slgraph_read64(dag + components * 8)) * 8 ||
+	   labels_size < components * labels_count * 2 * 8)
+		return(-1);
+
+	reach->components = components;
+	reach->labels = labels_count;
+	reach->component = (const uint64_t *)(comp + SLGRAPH_REACHHEADERSIZE);
+	reach->dag = (const uint64_t *)dag;
+	reach->dag_targets = reach->dag + components + 1;
+	reach->intervals = (const uint64_t *)labels;
+
+	return(0);
+}
+
+int slgraph_shard_new(slgraph_t *g, const char *restrict filename, slgraph_node_t first, uint_fast64_t count, uint_fast64_t nodes)
+{
+	if(first + count > nodes || slgraph_open(g, filename, false))
+		return(-1);
+
+	if(slgraph_nodes(g) || slgraph_nodelist_expand(g, count)) // Shards are built from scratch.
+	{
+		slgraph_close(g);
+		return(-1);
+	}
+
+	for(uint_fast64_t i = 0; i < count; i++)
+		if(slgraph_add_node(g) == SLGRAPH_INVALID_NODE)
+		{
+			slgraph_close(g);
+			return(-1);
+		}
+
+	unsigned char *shard = slgraph_section_reserve(g, "shard", SLGRAPH_SHARDSIZE);
+	if(!shard)
+	{
+		slgraph_close(g);
+		return(-1);
+	}
+
+	slgraph_write64(shard + 0, first);
+	slgraph_write64(shard + 8, count);
+	slgraph_write64(shard + 16, nodes);
+	slgraph_write64(shard + 24, 0);
+
+	return(0);
+}
+
+slgraph_edge_t slgraph_shard_add_edge(slgraph_t *g, slgraph_node_t src, slgraph_node_t dst)
+{
+	const unsigned char *shard = g->readonly ? 0 : slgraph_section(g, "shard", 0);
+
+	if(!shard)
+		return(SLGRAPH_INVALID_EDGE);
+
+	const slgraph_node_t first = slgraph_read64(shard);
+	const uint_fast64_t count = slgraph_read64(shard + 8);
+	const bool out = src >= first && src - first < count;
+	const bool in = dst >= first && dst - first < count;
+
+	if(!out && !in)
+		return(SLGRAPH_INVALID_EDGE);
+
+	slgraph_edge_t e = slgraph_append_directed_edge(g, src, dst, out ? src - first : SLGRAPH_INVALID_NODE, in ? dst - first : SLGRAPH_INVALID_NODE);
+
+	if(e != SLGRAPH_INVALID_EDGE && out)
+	{
+		unsigned char *edges = slgraph_section(g, "shard", 0) + 24; // Adding the edge might have remapped.
+		slgraph_write64(edges, slgraph_read64(edges) + 1);
+	}
+
+	return(e);
+}
+
+int slgraph_shards_write_manifest(const char *restrict filename, const char *const *shardfiles, unsigned count)
+{
+	const char *slash = strrchr(filename, '/');
+	const size_t dirlen = slash ? (size_t)(slash - filename) + 1 : 0;
+	uint_fast64_t nodes = 0, edges = 0, total = 0;
+	uint_fast64_t flags = SLGRAPH_FLAG_SORTED;
+	int ret = 0;
+
+	FILE *f = count ? fopen(filename, "w") : 0;
+	if(!f)
+		return(-1);
+
+	fprintf(f, SLGRAPH_MANIFESTMAGIC "\n");
+
+	// Shard lines: first node, nodes, edges with their source in the shard, edge slots, file name.
+	for(unsigned k = 0; k < count && !ret; k++)
+	{
+		slgraph_t s;
+		uint_fast64_t size;
+		const unsigned char *shard;
+
+		if(slgraph_open(&s, shardfiles[k], true))
+		{
+			ret = -1;
+			break;
+		}
+
+		// Shards must be listed in node order and together cover all nodes of the graph.
+		if(!k && (shard = slgraph_section(&s, "shard", 0)))
+			total = slgraph_read64(shard + 16);
+		if(!(shard = slgraph_section(&s, "shard", &size)) || size < SLGRAPH_SHARDSIZE || slgraph_read64(shard) != nodes ||
+			slgraph_read64(shard + 16) != total || (k + 1 == count && nodes + slgraph_read64(shard + 8) != total))
+			ret = -1;
+		else
+		{
+			// Names are relative to the directory of the manifest, so the files can be moved together.
+			const char *name = shardfiles[k];
+			if(dirlen && !strncmp(name, filename, dirlen))
+				name += dirlen;
+
+			fprintf(f, "shard %llu %llu %llu %llu %s\n", (unsigned long long)nodes, (unsigned long long)slgraph_read64(shard + 8),
+				(unsigned long long)slgraph_read64(shard + 24), (unsigned long long)slgraph_edges(&s), name);
+			nodes += slgraph_read64(shard + 8);
+			edges += slgraph_read64(shard + 24);
+			flags &= slgraph_flags(&s);
+		}
+
+		slgraph_close(&s);
+	}
+
+	fprintf(f, "nodes %llu\nedges %llu\nflags %llu\n", (unsigned long long)nodes, (unsigned long long)edges, (unsigned long long)flags);
+
+	if(fclose(f) || ret)
+	{
+		remove(filename);
+		return(-1);
+	}
+
+	return(0);
+}
+
+// Open the manifest at filename as sharded graph g. Returns 0 if successful, 1 if filename is not a manifest.
+static int slgraph_open_manifest(slgraph_t *g, const char *restrict filename)
+{
+	const char *slash = strrchr(filename, '/');
+	const size_t dirlen = slash ? (size_t)(slash - filename) + 1 : 0;
+	char line[4096];
+
+	FILE *f = fopen(filename, "r");
+	if(!f)
+		return(1);
+
+	if(!fgets(line, sizeof(line), f) || strcmp(line, SLGRAPH_MANIFESTMAGIC "\n"))
+	{
+		fclose(f);
+		return(1);
+	}
+
+	struct slgraph_shards *s = calloc(1, sizeof(struct slgraph_shards));
+	if(!s)
+	{
+		fclose(f);
+		return(-1);
+	}
+	g->shards = s;
+	g->wal = 0;
+	g->fd = -1;
+	g->ptr = 0;
+	g->size = 0;
+	g->free = 0;
+	g->readonly = true;
+	g->version = 2;
+
+	int ret = 0;
+	uint_fast64_t edgebase = 0;
+	while(!ret && fgets(line, sizeof(line), f))
+	{
+		unsigned long long first, nodes, edges, slots, value;
+		int pos;
+
+		if(sscanf(line, "shard %llu %llu %llu %llu %n", &first, &nodes, &edges, &slots, &pos) == 4)
+		{
+			struct slgraph_shard *shard = realloc(s->shard, (s->count + 1) * sizeof(struct slgraph_shard));
+			const size_t namelen = strcspn(line + pos, "\n");
+			if(!shard)
+			{
+				ret = -1;
+				break;
+			}
+			s->shard = shard;
+			shard += s->count++;
+			memset(shard, 0, sizeof(struct slgraph_shard));
+			shard->first = first;
+			shard->nodes = nodes;
+			shard->edges = edges;
+			shard->slots = slots;
+			shard->edgebase = edgebase;
+			edgebase += slots;
+
+			// Relative names are relative to the directory of the manifest.
+			const size_t prefix = line[pos] == '/' ? 0 : dirlen;
+			if(!(shard->filename = malloc(prefix + namelen + 1)))
+			{
+				ret = -1;
+				break;
+			}
+			memcpy(shard->filename, filename, prefix);
+			memcpy(shard->filename + prefix, line + pos, namelen);
+			shard->filename[prefix + namelen] = 0;
+
+			// Files are only mapped, so opening all shards is cheap, and a shard that is missing or doesn't match the
+			// manifest fails here instead of at an access.
+			if(slgraph_open(&shard->g, shard->filename, true))
+			{
+				ret = -1;
+				break;
+			}
+			shard->open = true;
+			if(slgraph_nodes(&shard->g) != nodes || slgraph_edges(&shard->g) != slots)
+				ret = -1;
+		}
+		else if(sscanf(line, "nodes %llu", &value) == 1)
+			s->nodes = value;
+		else if(sscanf(line, "edges %llu", &value) == 1)
+			s->edges = value;
+		else if(sscanf(line, "flags %llu", &value) == 1)
+			s->flags = value;
+		else
+			ret = -1;
+	}
+
+	fclose(f);
+
+	if(ret || !s->count)
+	{
+		slgraph_close(g);
+		return(-1);
+	}
+
+	return(0);
+}
+
+// === Batched append ===
+// The write-ahead log holds one record per committed batch: the magic, the number of entries, the entries and an
+// FNV-1a checksum of the number of entries and the entries. An entry is an 8-byte offset, with the number of bytes to
+// write (1 to 8) in the top byte, and the 8-byte value of which that many low bytes are written there. Entries are
+// absolute, so replaying them again, or replaying an older record before a newer one, is harmless.
+
+#define SLGRAPH_WALMAGIC u8"slgwal1"
+#define SLGRAPH_WALENTRYSIZE 16
+#define SLGRAPH_WALHEADERSIZE 16
+#define SLGRAPH_WALCHECKPOINT (64 * 1024 * 1024) // Log size after which a commit is followed by a checkpoint.
+
+struct slgraph_walbatch
+{
+	uint_fast64_t nodes;
+	const slgraph_node_t *src;
+	const slgraph_node_t *dst;
+	uint_fast64_t count;
+	slgraph_edge_t first;
+	bool done;
+	struct slgraph_walbatch *next;
+};
+
+struct slgraph_walrange
+{
+	uint_fast64_t begin;
+	uint_fast64_t end;
+};
+
+struct slgraph_wal
+{
+	int fd;
+	uint_fast64_t size;                // Bytes in the log
+	bool failed;                       // The log couldn't be restored after a failed write.
+	bool committing;                   // A thread is committing or checkpointing, others wait.
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	struct slgraph_walbatch *queue;
+	struct slgraph_walbatch **tail;
+
+	// The record of the batch being committed, and the end of the graph before it. Bytes from there on aren't
+	// reachable from the committed graph yet, and are written directly instead of logged.
+	unsigned char *record;
+	size_t recordsize;
+	size_t recordcap;
+	uint_fast64_t fresh;
+
+	// Ranges below fresh written directly because they are behind the end of a list. They are synced together with the
+	// fresh space before the record is written.
+	struct slgraph_walrange *dirty;
+	size_t dirtycount;
+	size_t dirtycap;
+};
+
+// A new incidence list entry of a batch.
+struct slgraph_walentry
+{
+	slgraph_node_t node;
+	size_t offset_field;
+	slgraph_node_t key;
+	slgraph_edge_t edge;
+};
+
+static uint_fast64_t slgraph_wal_checksum(const unsigned char *data, size_t size)
+{
+	uint_fast64_t hash = 0xcbf29ce484222325ull;
+
+	for(size_t i = 0; i < size; i++)
+		hash = ((hash ^ data[i]) * 0x100000001b3ull) & 0xffffffffffffffffull;
+
+	return(hash);
+}
+
+static char *slgraph_wal_filename(const char *restrict filename)
+{
+	char *walname = malloc(strlen(filename) + 5);
+
+	if(walname)
+		sprintf(walname, "%s.wal", filename);
+
+	return(walname);
+}
+
+// Replay the committed records of the write-ahead log of the graph file filename onto fd, and empty the log. With fd -1,
+// only check that there are none. Returns 0 if successful.
+static int slgraph_wal_replay(const char *restrict filename, int fd)
+{
+	char *walname = slgraph_wal_filename(filename);
+	if(!walname)
+		return(-1);
+
+	int walfd = open(walname, fd < 0 ? O_RDONLY : O_RDWR);
+	free(walname);
+	if(walfd == -1)
+		return(errno == ENOENT ? 0 : -1);
+
+	struct stat walstat, stat;
+	unsigned char *log = 0;
+	int ret = fstat(walfd, &walstat) || (fd >= 0 && fstat(fd, &stat)) ? -1 : 0;
+	if(!ret && walstat.st_size && (!(log = malloc(walstat.st_size)) || pread(walfd, log, walstat.st_size, 0) != walstat.st_size))
+		ret = -1;
+
+	// A torn record at the end was never committed, and ends the log.
+	uint_fast64_t pos = 0;
+	bool replayed = false;
+	while(!ret && walstat.st_size - pos >= SLGRAPH_WALHEADERSIZE + 8 && !memcmp(log + pos, SLGRAPH_WALMAGIC, 8))
+	{
+		const uint_fast64_t entries = slgraph_read64(log + pos + 8);
+		if(entries > (walstat.st_size - pos - SLGRAPH_WALHEADERSIZE - 8) / SLGRAPH_WALENTRYSIZE)
+			break;
+		const size_t checked = 8 + entries * SLGRAPH_WALENTRYSIZE;
+		if(slgraph_wal_checksum(log + pos + 8, checked) != slgraph_read64(log + pos + 8 + checked))
+			break;
+
+		if(fd < 0) // The graph file is inconsistent until this record has been replayed.
+		{
+			ret = -1;
+			break;
+		}
+
+		for(uint_fast64_t i = 0; i < entries && !ret; i++)
+		{
+			const unsigned char *entry = log + pos + SLGRAPH_WALHEADERSIZE + i * SLGRAPH_WALENTRYSIZE;
+			const uint_fast64_t offset = slgraph_read64(entry) & 0xffffffffffffffull;
+			const size_t len = entry[7];
+			if(!len || len > 8 || offset + len > (uint_fast64_t)stat.st_size || pwrite(fd, entry + 8, len, offset) != (ssize_t)len)
+				ret = -1;
+		}
+
+		replayed = true;
+		pos += SLGRAPH_WALHEADERSIZE + checked;
+	}
+
+	if(!ret && replayed && fdatasync(fd))
+		ret = -1;
+	if(!ret && fd >= 0 && walstat.st_size && (ftruncate(walfd, 0) || fsync(walfd)))
+		ret = -1;
+
+	free(log);
+	close(walfd);
+	return(ret);
+}
+
+// Write the len low bytes of v at offset of g as part of the batch being committed: directly if offset is in space
+// allocated for the batch, logged to be written after the commit otherwise. Returns 0 if successful.
+static int slgraph_wal_put(slgraph_t *g, uint_fast64_t offset, size_t len, uint_fast64_t v)
+{
+	struct slgraph_wal *w = g->wal;
+
+	if(offset >= w->fresh)
+	{
+		for(size_t i = 0; i < len; i++)
+			g->ptr[offset + i] = (v >> (8 * i)) & 0xff;
+		return(0);
+	}
+
+	if(w->recordsize + SLGRAPH_WALENTRYSIZE + 8 > w->recordcap)
+	{
+		size_t newcap = w->recordcap * 2 + SLGRAPH_WALENTRYSIZE * 64;
+		unsigned char *newrecord = realloc(w->record, newcap);
+		if(!newrecord)
+			return(-1);
+		w->record = newrecord;
+		w->recordcap = newcap;
+	}
+
+	slgraph_write64(w->record + w->recordsize, offset | (uint_fast64_t)len << 56);
+	slgraph_write64(w->record + w->recordsize + 8, v);
+	w->recordsize += SLGRAPH_WALENTRYSIZE;
+
+	return(0);
+}
+
+// Note that len bytes at offset of g were written directly as part of the batch being committed, so that they are synced
+// before the commit record. Returns 0 if successful.
+static int slgraph_wal_dirty(slgraph_t *g, uint_fast64_t offset, uint_fast64_t len)
+{
+	struct slgraph_wal *w = g->wal;
+
+	if(offset >= w->fresh || !len)
+		return(0);
+
+	if(w->dirtycount == w->dirtycap)
+	{
+		size_t newcap = w->dirtycap * 2 + 64;
+		struct slgraph_walrange *newdirty = realloc(w->dirty, newcap * sizeof(struct slgraph_walrange));
+		if(!newdirty)
+			return(-1);
+		w->dirty = newdirty;
+		w->dirtycap = newcap;
+	}
+
+	w->dirty[w->dirtycount++] = (struct slgraph_walrange){offset, offset + len};
+	return(0);
+}
+
+static int slgraph_walrange_cmp(const void *a, const void *b)
+{
+	const struct slgraph_walrange *ra = a, *rb = b;
+
+	return((ra->begin > rb->begin) - (ra->begin < rb->begin));
+}
+
+// Sync what the batch being committed wrote directly: the fresh space and the dirty ranges, widened to whole pages.
+// Returns 0 if successful.
+static int slgraph_wal_sync(slgraph_t *g)
+{
+	struct slgraph_wal *w = g->wal;
+	const uint_fast64_t page = sysconf(_SC_PAGESIZE);
+
+	qsort(w->dirty, w->dirtycount, sizeof(struct slgraph_walrange), slgraph_walrange_cmp);
+
+	// Ranges that share a page are synced at once.
+	uint_fast64_t begin = 0, end = 0;
+	for(size_t i = 0; i <= w->dirtycount; i++)
+	{
+		const struct slgraph_walrange r = i < w->dirtycount ? w->dirty[i] : (struct slgraph_walrange){w->fresh, g->size};
+		if(r.begin / page * page > end)
+		{
+			if(end > begin && msync(g->ptr + begin, end - begin, MS_SYNC))
+				return(-1);
+			begin = r.begin / page * page;
+		}
+		end = r.end > end ? r.end : end;
+	}
+
+	return(end > begin && msync(g->ptr + begin, end - begin, MS_SYNC) ? -1 : 0);
+}
+
+// Order new entries by list, and then by edge (appended in the order they were added).
+static int slgraph_walentry_cmp(const void *a, const void *b)
+{
+	const struct slgraph_walentry *ea = a, *eb = b;
+
+	if(ea->node != eb->node)
+		return(ea->node < eb->node ? -1 : 1);
+	if(ea->offset_field != eb->offset_field)
+		return(ea->offset_field < eb->offset_field ? -1 : 1);
+	return((ea->edge > eb->edge) - (ea->edge < eb->edge));
+}
+
+// Order new entries by list, and then by neighbour and edge (merged into sorted lists).
+static int slgraph_walentry_keycmp(const void *a, const void *b)
+{
+	const struct slgraph_walentry *ea = a, *eb = b;
+
+	if(ea->node != eb->node || ea->offset_field != eb->offset_field || ea->key == eb->key)
+		return(slgraph_walentry_cmp(a, b));
+	return(ea->key < eb->key ? -1 : 1);
+}
+
+// Move a list (node list or edge list) with count entries of entrysize bytes, referenced by the header field at
+// header, to a new place with room for capacity entries. Returns the new offset (0 on failure). Might remap.
+static uint_fast64_t slgraph_wal_movelist(slgraph_t *g, size_t header, uint_fast64_t count, size_t entrysize, uint_fast64_t capacity)
+{
+	const uint_fast64_t offset = slgraph_alloc(g, SLGRAPH_LISTHEADERSIZE + capacity * entrysize, 8);
+
+	if(!offset)
+		return(0);
+
+	memcpy(g->ptr + offset, g->ptr + slgraph_read64(g->ptr + header), SLGRAPH_LISTHEADERSIZE + count * entrysize);
+	slgraph_write48(g->ptr + offset, capacity);
+
+	return(slgraph_wal_put(g, header, 8, offset) ? 0 : offset);
+}
+
+// Add the count new entries of the out- or in-list of one node to the graph. edgepos is the offset of the edge positions
+// (0 if they aren't tracked). Returns 0 if successful. Might remap.
+static int slgraph_wal_list(slgraph_t *g, uint_fast64_t nodelist, const struct slgraph_walentry *entries, uint_fast64_t count, uint_fast64_t edgepos, bool sorted)
+{
+	const slgraph_node_t n = entries[0].node;
+	const size_t offset_field = entries[0].offset_field;
+	const size_t field = offset_field == SLGRAPH_NODE_OUT ? SLGRAPH_EDGEPOS_OUT : SLGRAPH_EDGEPOS_IN;
+	const uint_fast64_t nodefield = nodelist + SLGRAPH_LISTHEADERSIZE + n * SLGRAPH_NODESIZE + offset_field;
+	uint_fast64_t list = slgraph_read64(g->ptr + nodefield);
+	const uint_fast64_t degree = list ? slgraph_read48(g->ptr + list + SLGRAPH_SIZE) : 0;
+	const uint_fast64_t capacity = list ? slgraph_read48(g->ptr + list) : 0;
+
+	// Appending to an unsorted list with room to spare only writes behind its end.
+	if(!sorted && degree + count <= capacity)
+	{
+		for(uint_fast64_t i = 0; i < count; i++)
+		{
+			slgraph_write48(g->ptr + list + SLGRAPH_LISTHEADERSIZE + (degree + i) * SLGRAPH_INCIDENCESIZE, entries[i].edge);
+			if(edgepos)
+				slgraph_write48(g->ptr + edgepos + entries[i].edge * SLGRAPH_EDGEPOSSIZE + field, degree + i);
+		}
+		return(slgraph_wal_dirty(g, list + SLGRAPH_LISTHEADERSIZE + degree * SLGRAPH_INCIDENCESIZE, count * SLGRAPH_INCIDENCESIZE) ||
+			slgraph_wal_put(g, list + SLGRAPH_SIZE, SLGRAPH_SIZE, degree + count));
+	}
+
+	// Otherwise the list is rebuilt in new space, merging the new entries in order if it is sorted.
+	const uint_fast64_t newcapacity = (degree + count) * 2 + 1;
+	const uint_fast64_t newlist = slgraph_alloc(g, SLGRAPH_LISTHEADERSIZE + newcapacity * SLGRAPH_INCIDENCESIZE, 1);
+	if(!newlist)
+		return(-1);
+	slgraph_write48(g->ptr + newlist, newcapacity);
+	slgraph_write48(g->ptr + newlist + SLGRAPH_SIZE, degree + count);
+
+	uint_fast64_t i = 0, j = 0;
+	for(uint_fast64_t pos = 0; pos < degree + count; pos++)
+	{
+		slgraph_edge_t e;
+		if(j == count || (i < degree && (!sorted ||
+			slgraph_incident_key(g, slgraph_read48(g->ptr + list + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE), offset_field) <= entries[j].key)))
+		{
+			e = slgraph_read48(g->ptr + list + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE);
+			if(edgepos && pos != i && slgraph_wal_put(g, edgepos + e * SLGRAPH_EDGEPOSSIZE + field, SLGRAPH_SIZE, pos))
+				return(-1);
+			i++;
+		}
+		else
+		{
+			e = entries[j++].edge;
+			if(edgepos)
+				slgraph_write48(g->ptr + edgepos + e * SLGRAPH_EDGEPOSSIZE + field, pos);
+		}
+		slgraph_write48(g->ptr + newlist + SLGRAPH_LISTHEADERSIZE + pos * SLGRAPH_INCIDENCESIZE, e);
+	}
+
+	return(slgraph_wal_put(g, nodefield, 8, newlist));
+}
+
+// Write the batches to the graph and commit them. Sets the first edge of each batch that is valid.
+static int slgraph_wal_commit(slgraph_t *g, struct slgraph_walbatch *batches)
+{
+	struct slgraph_wal *w = g->wal;
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	const uint_fast64_t edges = slgraph_edges(g);
+	const bool sorted = slgraph_flags(g) & SLGRAPH_FLAG_SORTED;
+	uint_fast64_t newnodes = nodes, newedges = edges;
+
+	if(w->failed)
+		return(-1);
+
+	// Number the edges of the valid batches.
+	for(struct slgraph_walbatch *b = batches; b; b = b->next)
+	{
+		const uint_fast64_t n = b->nodes > newnodes ? b->nodes : newnodes;
+		bool valid = n < SLGRAPH_INVALID_NODE >> 16 && newedges + b->count < SLGRAPH_INVALID_EDGE >> 16;
+		for(uint_fast64_t i = 0; i < b->count && valid; i++)
+			valid = b->src[i] < n && b->dst[i] < n;
+		if(!valid)
+			continue;
+		b->first = newedges;
+		newedges += b->count;
+		newnodes = n;
+	}
+	if(newnodes == nodes && newedges == edges)
+		return(0);
+
+	struct slgraph_walentry *entries = malloc((newedges - edges) * 2 * sizeof(struct slgraph_walentry));
+	if(newedges > edges && !entries)
+		goto fail;
+
+	w->fresh = g->size - g->free;
+	w->recordsize = SLGRAPH_WALHEADERSIZE;
+	w->dirtycount = 0;
+
+	// New nodes start without incidence lists.
+	uint_fast64_t nodelist = slgraph_read64(g->ptr + SLGRAPH_HEADER_NODELIST);
+	if(newnodes > slgraph_read48(g->ptr + nodelist))
+	{
+		const uint_fast64_t capacity = nodes + (nodes + 32) * 4;
+		if(!(nodelist = slgraph_wal_movelist(g, SLGRAPH_HEADER_NODELIST, nodes, SLGRAPH_NODESIZE, capacity > newnodes ? capacity : newnodes)))
+			goto fail;
+	}
+	for(slgraph_node_t v = nodes; v < newnodes; v++)
+	{
+		unsigned char *nodeptr = g->ptr + nodelist + SLGRAPH_LISTHEADERSIZE + v * SLGRAPH_NODESIZE;
+		slgraph_write64(nodeptr + SLGRAPH_NODE_OUT, 0);
+		slgraph_write64(nodeptr + SLGRAPH_NODE_IN, 0);
+		slgraph_write48(nodeptr + 16, 0xffffffffffffull);
+	}
+	if(newnodes > nodes && (slgraph_wal_dirty(g, nodelist + SLGRAPH_LISTHEADERSIZE + nodes * SLGRAPH_NODESIZE, (newnodes - nodes) * SLGRAPH_NODESIZE) ||
+		slgraph_wal_put(g, nodelist + SLGRAPH_SIZE, SLGRAPH_SIZE, newnodes)))
+		goto fail;
+
+	// New edges are written behind the end of the edge list, and of the edge positions if they are tracked.
+	uint_fast64_t edgelist = slgraph_read64(g->ptr + SLGRAPH_HEADER_EDGELIST);
+	if(newedges > slgraph_read48(g->ptr + edgelist))
+	{
+		const uint_fast64_t capacity = edges + (edges + 32) * 4;
+		if(!(edgelist = slgraph_wal_movelist(g, SLGRAPH_HEADER_EDGELIST, edges, SLGRAPH_EDGESIZE, capacity > newedges ? capacity : newedges)))
+			goto fail;
+	}
+
+	uint_fast64_t edgepos = 0;
+	const unsigned char *entry = slgraph_section_entry(g, "edgepos");
+	if(entry)
+	{
+		const uint_fast64_t entryoffset = entry - g->ptr;
+		const uint_fast64_t oldsize = slgraph_read64(g->ptr + entryoffset + SLGRAPH_SECTIONNAMESIZE + 8);
+		const uint_fast64_t size = slgraph_read48(g->ptr + edgelist) * SLGRAPH_EDGEPOSSIZE;
+		edgepos = slgraph_read64(g->ptr + entryoffset + SLGRAPH_SECTIONNAMESIZE);
+		if(oldsize < newedges * SLGRAPH_EDGEPOSSIZE)
+		{
+			const uint_fast64_t oldedgepos = edgepos;
+			if(!(edgepos = slgraph_alloc(g, size, SLGRAPH_SECTIONALIGN)))
+				goto fail;
+			memcpy(g->ptr + edgepos, g->ptr + oldedgepos, oldsize);
+			memset(g->ptr + edgepos + oldsize, 0, size - oldsize);
+			if(slgraph_wal_put(g, entryoffset + SLGRAPH_SECTIONNAMESIZE, 8, edgepos) ||
+				slgraph_wal_put(g, entryoffset + SLGRAPH_SECTIONNAMESIZE + 8, 8, size))
+				goto fail;
+		}
+	}
+
+	uint_fast64_t count = 0;
+	for(struct slgraph_walbatch *b = batches; b; b = b->next)
+		for(uint_fast64_t i = 0; b->first != SLGRAPH_INVALID_EDGE && i < b->count; i++)
+		{
+			const slgraph_edge_t e = b->first + i;
+			unsigned char *edgeptr = g->ptr + edgelist + SLGRAPH_LISTHEADERSIZE + e * SLGRAPH_EDGESIZE;
+			slgraph_write48(edgeptr, b->src[i]);
+			slgraph_write48(edgeptr + 6, b->dst[i]);
+			slgraph_write48(edgeptr + 12, 0);
+			edgeptr[18] = SLGRAPH_EDGE_DIRECTED;
+			entries[count++] = (struct slgraph_walentry){b->src[i], SLGRAPH_NODE_OUT, b->dst[i], e};
+			entries[count++] = (struct slgraph_walentry){b->dst[i], SLGRAPH_NODE_IN, b->src[i], e};
+		}
+	if(newedges > edges && (slgraph_wal_dirty(g, edgelist + SLGRAPH_LISTHEADERSIZE + edges * SLGRAPH_EDGESIZE, (newedges - edges) * SLGRAPH_EDGESIZE) ||
+		(edgepos && slgraph_wal_dirty(g, edgepos + edges * SLGRAPH_EDGEPOSSIZE, (newedges - edges) * SLGRAPH_EDGEPOSSIZE)) ||
+		slgraph_wal_put(g, edgelist + SLGRAPH_SIZE, SLGRAPH_SIZE, newedges)))
+		goto fail;
+
+	// Add the entries of each incidence list at once.
+	qsort(entries, count, sizeof(struct slgraph_walentry), sorted ? slgraph_walentry_keycmp : slgraph_walentry_cmp);
+	for(uint_fast64_t i = 0, j; i < count; i = j)
+	{
+		for(j = i + 1; j < count && entries[j].node == entries[i].node && entries[j].offset_field == entries[i].offset_field; j++);
+		if(slgraph_wal_list(g, nodelist, entries + i, j - i, edgepos, sorted))
+			goto fail;
+	}
+
+	// The summary and CSR arrays don't describe the graph anymore.
+	const uint_fast64_t flags = slgraph_section_find(g, "flags", 0, 0);
+	if(flags && (slgraph_read64(g->ptr + flags) & SLGRAPH_FLAG_DERIVED) &&
+		slgraph_wal_put(g, flags, 8, slgraph_read64(g->ptr + flags) & ~(uint_fast64_t)SLGRAPH_FLAG_DERIVED))
+		goto fail;
+	if(slgraph_wal_put(g, SLGRAPH_HEADERSIZE_BASIC, 8, g->size))
+		goto fail;
+
+	// Commit: everything written so far has to be on disk before the record is.
+	const uint_fast64_t entrycount = (w->recordsize - SLGRAPH_WALHEADERSIZE) / SLGRAPH_WALENTRYSIZE;
+	memcpy(w->record, SLGRAPH_WALMAGIC, 8);
+	slgraph_write64(w->record + 8, entrycount);
+	slgraph_write64(w->record + w->recordsize, slgraph_wal_checksum(w->record + 8, w->recordsize - 8));
+	if(slgraph_wal_sync(g))
+		goto fail;
+	if(pwrite(w->fd, w->record, w->recordsize + 8, w->size) != (ssize_t)(w->recordsize + 8) || fdatasync(w->fd))
+	{
+		if(ftruncate(w->fd, w->size) || fdatasync(w->fd))
+			w->failed = true;
+		goto fail;
+	}
+	w->size += w->recordsize + 8;
+
+	// Apply the logged changes.
+	for(uint_fast64_t i = 0; i < entrycount; i++)
+	{
+		const unsigned char *e = w->record + SLGRAPH_WALHEADERSIZE + i * SLGRAPH_WALENTRYSIZE;
+		memcpy(g->ptr + (slgraph_read64(e) & 0xffffffffffffffull), e + 8, e[7]);
+	}
+
+	free(entries);
+	return(0);
+
+fail:
+	for(struct slgraph_walbatch *b = batches; b; b = b->next)
+		b->first = SLGRAPH_INVALID_EDGE;
+	free(entries);
+	return(-1);
+}
+
+// Write all changes to the graph file and empty the log. The caller has to be the committing thread.
+static int slgraph_wal_checkpoint(slgraph_t *g)
+{
+	struct slgraph_wal *w = g->wal;
+
+	if(w->failed || msync(g->ptr, g->size, MS_SYNC) || fsync(g->fd))
+		return(-1);
+	if(!w->size)
+		return(0);
+	if(ftruncate(w->fd, 0) || fdatasync(w->fd))
+	{
+		w->failed = true;
+		return(-1);
+	}
+	w->size = 0;
+
+	return(0);
+}
+
+// Checkpoint and close the log.
+static void slgraph_wal_close(slgraph_t *g)
+{
+	struct slgraph_wal *w = g->wal;
+
+	if(slgraph_wal_checkpoint(g))
+		fprintf(stderr, "slgraph: checkpoint failed, committed batches will be replayed on the next open\n");
+	close(w->fd);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->done);
+	free(w->record);
+	free(w->dirty);
+	free(w);
+	g->wal = 0;
+}
+
+int slgraph_open_batched(slgraph_t *g, const char *restrict filename)
+{
+	if(slgraph_open(g, filename, false))
+		return(-1);
+
+	// Batches are only supported for plain directed graphs.
+	if(g->version != 2 || slgraph_section(g, "shard", 0))
+	{
+		slgraph_close(g);
+		return(-1);
+	}
+
+	struct slgraph_wal *w = calloc(1, sizeof(struct slgraph_wal));
+	char *walname = slgraph_wal_filename(filename);
+	if(!w || !walname || (w->fd = open(walname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) == -1)
+	{
+		free(w);
+		free(walname);
+		slgraph_close(g);
+		return(-1);
+	}
+
+	// The log has to survive a crash, including its directory entry.
+	const char *slash = strrchr(walname, '/');
+	if(slash)
+		walname[slash - walname + 1] = 0;
+	int dirfd = open(slash ? walname : ".", O_RDONLY);
+	if(dirfd != -1)
+	{
+		fsync(dirfd);
+		close(dirfd);
+	}
+	free(walname);
+
+	pthread_mutex_init(&w->lock, 0);
+	pthread_cond_init(&w->done, 0);
+	w->tail = &w->queue;
+	g->wal = w;
+
+	return(0);
+}
+
+slgraph_edge_t slgraph_append_edges(slgraph_t *g, uint_fast64_t nodes, const slgraph_node_t *src, const slgraph_node_t *dst, uint_fast64_t count)
+{
+	struct slgraph_wal *w = g->wal;
+	struct slgraph_walbatch batch = {nodes, src, dst, count, SLGRAPH_INVALID_EDGE, false, 0};
+
+	if(!w)
+		return(SLGRAPH_INVALID_EDGE);
+
+	pthread_mutex_lock(&w->lock);
+	*w->tail = &batch;
+	w->tail = &batch.next;
+
+	while(!batch.done)
+	{
+		if(w->committing)
+		{
+			pthread_cond_wait(&w->done, &w->lock);
+			continue;
+		}
+
+		// Commit every batch that has queued up, including this one.
+		struct slgraph_walbatch *batches = w->queue;
+		w->queue = 0;
+		w->tail = &w->queue;
+		w->committing = true;
+		pthread_mutex_unlock(&w->lock);
+
+		if(!slgraph_wal_commit(g, batches) && w->size > SLGRAPH_WALCHECKPOINT)
+			slgraph_wal_checkpoint(g);
+
+		pthread_mutex_lock(&w->lock);
+		for(struct slgraph_walbatch *b = batches; b; b = b->next)
+			b->done = true;
+		w->committing = false;
+		pthread_cond_broadcast(&w->done);
+	}
+
+	pthread_mutex_unlock(&w->lock);
+
+	return(batch.first);
+}
+
+int slgraph_checkpoint(slgraph_t *g)
+{
+	struct slgraph_wal *w = g->wal;
+
+	if(!w)
+		return(g->readonly || !g->ptr || msync(g->ptr, g->size, MS_SYNC) ? -1 : 0);
+
+	pthread_mutex_lock(&w->lock);
+	while(w->committing)
+		pthread_cond_wait(&w->done, &w->lock);
+	int ret = slgraph_wal_checkpoint(g);
+	pthread_mutex_unlock(&w->lock);
+
+	return(ret);
+}
+
+// === Random walks ===
+// Each step of a batch runs in stages over all its walkers: draw the random numbers, pick an entry of the incidence list
+// of each walker, read the edge IDs, then the edge ends. The loads of one stage are independent, and each stage
+// prefetches what the next one reads, so the latency of the cache misses of different walkers overlaps. Walkers that
+// end are removed from the batch, keeping the stages dense.
+
+#define SLGRAPH_WALK_LENGTH 32
+#define SLGRAPH_WALK_BATCH 1024
+#define SLGRAPH_WALK_LANES 8 // Walkers per iteration of the random number loop, a multiple of common SIMD widths
+
+// Stage values: the walker ends or restarts, or the stage result plus SLGRAPH_WALK_NEXT.
+#define SLGRAPH_WALK_END 0
+#define SLGRAPH_WALK_RESTART 1
+#define SLGRAPH_WALK_NEXT 2
+
+#ifdef __GNUC__
+#define SLGRAPH_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define SLGRAPH_PREFETCH(p) ((void)(p))
+#endif
+
+void slgraph_walk_config_default(slgraph_walk_config_t *config)
+{
+	config->length = SLGRAPH_WALK_LENGTH;
+	config->restart = 0;
+	config->reverse = false;
+	config->seed = 0;
+	config->batch = SLGRAPH_WALK_BATCH;
+}
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3") of counter (walk[i], step) with the seed as
+// key, keeping two of the four output words. n must be a multiple of SLGRAPH_WALK_LANES. The rounds run over fixed-size
+// groups of independent lanes, which compilers vectorize, using SIMD 32x32->64-bit multiplies.
+static void slgraph_walk_random(uint64_t seed, uint_fast64_t step, const uint64_t *restrict walk, uint32_t *restrict r0, uint32_t *restrict r1, size_t n)
+{
+	for(size_t i = 0; i < n; i += SLGRAPH_WALK_LANES)
+	{
+		uint32_t c0[SLGRAPH_WALK_LANES], c1[SLGRAPH_WALK_LANES], c2[SLGRAPH_WALK_LANES], c3[SLGRAPH_WALK_LANES];
+
+		for(unsigned l = 0; l < SLGRAPH_WALK_LANES; l++)
+		{
+			c0[l] = (uint32_t)walk[i + l];
+			c1[l] = (uint32_t)(walk[i + l] >> 32);
+			c2[l] = (uint32_t)step;
+			c3[l] = (uint32_t)((uint64_t)step >> 32);
+		}
+
+		uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+		for(unsigned round = 0; round < 10; round++)
+		{
+			for(unsigned l = 0; l < SLGRAPH_WALK_LANES; l++)
+			{
+				uint64_t p0 = (uint64_t)0xd2511f53u * c0[l];
+				uint64_t p1 = (uint64_t)0xcd9e8d57u * c2[l];
+				c0[l] = (uint32_t)(p1 >> 32) ^ c1[l] ^ k0;
+				c1[l] = (uint32_t)p1;
+				c2[l] = (uint32_t)(p0 >> 32) ^ c3[l] ^ k1;
+				c3[l] = (uint32_t)p0;
+			}
+			k0 += 0x9e3779b9u;
+			k1 += 0xbb67ae85u;
+		}
+
+		for(unsigned l = 0; l < SLGRAPH_WALK_LANES; l++)
+		{
+			r0[i + l] = c0[l];
+			r1[i + l] = c1[l];
+		}
+	}
+}
+
+// Pick one of degree entries with random numbers r (used for the restart) and s. Degrees fit in 32 bits in practice,
+// where this is a multiply instead of a division.
+static uint_fast64_t slgraph_walk_pick(uint32_t r, uint32_t s, uint_fast64_t degree)
+{
+	if(degree <= UINT32_MAX)
+		return(((uint64_t)s * degree) >> 32);
+	return((((uint64_t)r << 32) | s) % degree);
+}
+
+int slgraph_random_walks(const slgraph_t *g, const slgraph_node_t *starts, uint_fast64_t count, const slgraph_walk_config_t *config, uint_fast64_t *visits, slgraph_walk_t *walks)
+{
+	slgraph_walk_config_t defaults;
+	if(!config)
+	{
+		slgraph_walk_config_default(&defaults);
+		config = &defaults;
+	}
+
+	const uint_fast64_t nodes = slgraph_nodes(g);
+	for(uint_fast64_t i = 0; i < count; i++)
+		if(starts[i] >= nodes)
+			return(-1);
+	if(!count)
+		return(0);
+
+	size_t batch = config->batch ? config->batch : SLGRAPH_WALK_BATCH;
+	if(batch > count)
+		batch = count;
+	batch = (batch + SLGRAPH_WALK_LANES - 1) / SLGRAPH_WALK_LANES * SLGRAPH_WALK_LANES;
+
+	// Restart if r0 < restart * 2^32.
+	const uint64_t restart = config->restart <= 0 ? 0 : config->restart >= 1 ? UINT64_C(1) << 32 : (uint64_t)(config->restart * 4294967296.0);
+	const bool reverse = config->reverse && g->version != 1; // Version 1 graphs only have the out-lists
+	const bool mapped = g->ptr && !g->cache && !g->shards;
+	const unsigned char *base = g->ptr;
+	const uint_fast64_t field = reverse ? SLGRAPH_NODE_IN : SLGRAPH_NODE_OUT;
+	const uint_fast64_t nodelist = mapped ? slgraph_nodelist_offset(g) + SLGRAPH_LISTHEADERSIZE : 0;
+	const uint_fast64_t edgelist = mapped ? slgraph_edgelist_offset(g) + SLGRAPH_LISTHEADERSIZE : 0;
+
+	// State of the walkers of the batch that haven't ended, in structure-of-arrays form for the random number loop.
+	uint64_t *walk = malloc(batch * (sizeof(uint64_t) * 5 + sizeof(uint32_t) * 2));
+	if(!walk)
+		return(-1);
+	uint64_t *cur = walk + batch;
+	uint64_t *start = cur + batch;
+	uint64_t *returns = start + batch;
+	uint64_t *stage = returns + batch;
+	uint32_t *r0 = (uint32_t *)(stage + batch);
+	uint32_t *r1 = r0 + batch;
+	memset(walk, 0, batch * sizeof(uint64_t));
+
+	for(uint_fast64_t first = 0; first < count; first += batch)
+	{
+		size_t active = count - first < batch ? count - first : batch;
+
+		for(size_t j = 0; j < active; j++)
+		{
+			walk[j] = first + j;
+			cur[j] = start[j] = starts[first + j];
+			returns[j] = 0;
+			if(visits)
+				visits[cur[j]]++;
+		}
+
+		uint_fast64_t step = 0;
+		for(; step < config->length && active; step++)
+		{
+			slgraph_walk_random(config->seed, step, walk, r0, r1, (active + SLGRAPH_WALK_LANES - 1) / SLGRAPH_WALK_LANES * SLGRAPH_WALK_LANES);
+
+			// Pick the incidence list entry (mapped: its offset, otherwise: its index).
+			for(size_t j = 0; j < active; j++)
+			{
+				if(r0[j] < restart)
+				{
+					stage[j] = SLGRAPH_WALK_RESTART;
+					continue;
+				}
+
+				uint_fast64_t list = 0, degree;
+				if(mapped)
+				{
+					list = slgraph_read64(base + nodelist + cur[j] * SLGRAPH_NODESIZE + field);
+					degree = list ? slgraph_read48(base + list + SLGRAPH_SIZE) : 0;
+				}
+				else
+					degree = reverse ? slgraph_in_degree(g, cur[j]) : slgraph_out_degree(g, cur[j]);
+
+				if(!degree)
+				{
+					stage[j] = restart ? SLGRAPH_WALK_RESTART : SLGRAPH_WALK_END;
+					continue;
+				}
+
+				uint_fast64_t i = slgraph_walk_pick(r0[j], r1[j], degree);
+				if(mapped)
+				{
+					stage[j] = list + SLGRAPH_LISTHEADERSIZE + i * SLGRAPH_INCIDENCESIZE;
+					SLGRAPH_PREFETCH(base + stage[j]);
+				}
+				else
+					stage[j] = i + SLGRAPH_WALK_NEXT;
+			}
+
+			// Read the edge IDs (mapped: the offsets of their entries).
+			for(size_t j = 0; j < active; j++)
+			{
+				if(stage[j] < SLGRAPH_WALK_NEXT)
+					continue;
+
+				if(mapped)
+				{
+					stage[j] = edgelist + slgraph_read48(base + stage[j]) * SLGRAPH_EDGESIZE;
+					SLGRAPH_PREFETCH(base + stage[j]);
+				}
+				else
+				{
+					uint_fast32_t i = stage[j] - SLGRAPH_WALK_NEXT;
+					stage[j] = (reverse ? slgraph_in_incident(g, cur[j], i) : slgraph_out_incident(g, cur[j], i)) + SLGRAPH_WALK_NEXT;
+				}
+			}
+
+			// Move to the other end of the edges, and remove the walkers that ended.
+			size_t kept = 0;
+			for(size_t j = 0; j < active; j++)
+			{
+				slgraph_node_t next;
+
+				if(stage[j] == SLGRAPH_WALK_END)
+				{
+					if(walks)
+						walks[walk[j]] = (slgraph_walk_t){cur[j], step, returns[j]};
+					continue;
+				}
+				else if(stage[j] == SLGRAPH_WALK_RESTART)
+					next = start[j];
+				else
+				{
+					slgraph_node_t n0, n1;
+					if(mapped)
+					{
+						n0 = slgraph_read48(base + stage[j]);
+						n1 = slgraph_read48(base + stage[j] + SLGRAPH_SIZE);
+					}
+					else
+						slgraph_edge_ends(g, stage[j] - SLGRAPH_WALK_NEXT, &n0, &n1);
+
+					next = n0 == cur[j] ? n1 : n0;
+					if(next == start[j])
+						returns[j]++;
+					if(mapped)
+						SLGRAPH_PREFETCH(base + nodelist + next * SLGRAPH_NODESIZE + field);
+				}
+
+				if(visits)
+					visits[next]++;
+
+				walk[kept] = walk[j];
+				cur[kept] = next;
+				start[kept] = start[j];
+				returns[kept] = returns[j];
+				kept++;
+			}
+			active = kept;
+		}
+
+		for(size_t j = 0; j < active && walks; j++)
+			walks[walk[j]] = (slgraph_walk_t){cur[j], step, returns[j]};
+	}
+
+	free(walk);
+
+	return(0);
+}
@@ -0,0 +1,375 @@
+// Estimate the neighbourhood function of a directed SLGraph with HyperANF (Boldi, Rosa and Vigna), and from it the
+// effective diameter and the average distance.
+//
+// Usage:
+//   slgraph_anf [--threads N] [--log2m B] [--direction out|in] [--hops H] [--seed S] [--fraction F] [--check] <graph.slg>
+//
+// The neighbourhood function N(t) is the number of pairs of nodes (x, y) with y at most t hops from x. Every node keeps
+// a HyperLogLog counter of 2^B registers (default B = 7, about 9% relative error per counter) for the set of nodes
+// within t hops, starting with the node itself. Each pass takes the register-wise maximum of the counter of a node and
+// those of its out-neighbours (or in-neighbours with --direction in, which gives the same function), so that after
+// pass t the counters hold the balls of radius t, and N(t) is the sum of their estimates. The registers are bytes,
+// merged eight at a time in 64-bit words; a node none of whose neighbours changed in the last pass keeps its counter
+// without merging. The N threads (default: one per CPU) sweep chunks of nodes, reading the counters of the last pass
+// and writing those of this one, until no counter changes or after H passes. Memory is two arrays of 2^B bytes per
+// node.
+//
+// Prints for each pass
+//   hop=<t> pairs=<N(t)> changed=<counters that changed> time=<seconds>
+// then the number of reachable pairs, the effective diameter (the number of hops, interpolated, within which a
+// fraction F of them are, default 0.9) and the average distance between them. --check computes the neighbourhood
+// function exactly by breadth-first search from every node, which is only feasible for small graphs, and fails if an
+// estimate is off by more than three times the standard error of a counter.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+
+// Nodes are handed out to threads in chunks of this size.
+#define CHUNK 1024
+
+// Bytes of registers per word merged at once.
+#define LANES 8
+#define HIGH_BITS 0x8080808080808080ULL
+
+typedef struct {
+	const slgraph_t *g;
+	int in;                     // Merge over in-neighbours
+	unsigned log2m;
+	uint64_t words;             // Words of registers per counter
+	const uint64_t *cur;        // Counters of the last pass
+	uint64_t *next;             // Counters of this pass
+	const unsigned char *cur_changed; // Whether each counter changed in the last pass
+	unsigned char *next_changed;
+	double *estimate;           // Estimate of every counter, updated for the ones that change
+	const double *powers;       // 2^-r for every register value r
+	atomic_uint_fast64_t next_chunk;
+	pthread_mutex_t lock;
+	double pairs;               // Sum of the estimates of this pass
+	uint64_t changed;           // Counters that changed in this pass
+} anf_t;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint64_t mix(uint64_t z)
+{
+	z += 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Byte-wise maximum of two words of registers, which are all below 128 (at most 65 - B).
+static uint64_t max_bytes(uint64_t a, uint64_t b)
+{
+	// High bit of every byte of a that is at least the one of b, spread over the byte.
+	uint64_t ge = ((a | HIGH_BITS) - b) & HIGH_BITS;
+	uint64_t mask = (ge >> 7) * 0xff;
+	return (a & mask) | (b & ~mask);
+}
+
+// HyperLogLog estimate of the number of elements in a counter of m registers.
+static double count(const anf_t *a, const uint64_t *counter)
+{
+	const unsigned char *registers = (const unsigned char *)counter;
+	uint64_t m = a->words * LANES, zeros = 0;
+	double sum = 0.0;
+
+	for (uint64_t j = 0; j < m; j++) {
+		sum += a->powers[registers[j]];
+		zeros += registers[j] == 0;
+	}
+	double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / m);
+	double estimate = alpha * m * m / sum;
+	// Linear counting is more accurate for small sets.
+	if (estimate <= 2.5 * m && zeros) estimate = m * log((double)m / zeros);
+	return estimate;
+}
+
+static void *worker(void *arg)
+{
+	anf_t *a = arg;
+	const slgraph_t *g = a->g;
+	uint64_t n = slgraph_nodes(g), first, words = a->words, changed = 0;
+	double pairs = 0.0;
+
+	while ((first = atomic_fetch_add(&a->next_chunk, CHUNK)) < n) {
+		uint64_t end = first + CHUNK < n ? first + CHUNK : n;
+		for (uint64_t v = first; v < end; v++) {
+			const uint64_t *old = a->cur + v * words;
+			uint64_t *counter = a->next + v * words;
+			uint_fast64_t deg = a->in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+			int modified = 0;
+
+			memcpy(counter, old, words * sizeof(uint64_t));
+			for (uint_fast64_t k = 0; k < deg; k++) {
+				slgraph_node_t u = a->in ? slgraph_in_neighbour(g, v, k) : slgraph_out_neighbour(g, v, k);
+				if (u >= n || !a->cur_changed[u]) continue;
+				const uint64_t *other = a->cur + u * words;
+				for (uint64_t w = 0; w < words; w++) counter[w] = max_bytes(counter[w], other[w]);
+			}
+			for (uint64_t w = 0; w < words && !modified; w++) modified = counter[w] != old[w];
+
+			a->next_changed[v] = (unsigned char)modified;
+			if (modified) {
+				a->estimate[v] = count(a, counter);
+				changed++;
+			}
+			pairs += a->estimate[v];
+		}
+	}
+
+	pthread_mutex_lock(&a->lock);
+	a->pairs += pairs;
+	a->changed += changed;
+	pthread_mutex_unlock(&a->lock);
+	return NULL;
+}
+
+// Run a pass of a on threads threads.
+static void run(anf_t *a, long threads)
+{
+	pthread_t tids[threads];
+	long started = 1;
+
+	atomic_store(&a->next_chunk, 0);
+	a->pairs = 0.0;
+	a->changed = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, a)) break;
+	}
+	worker(a);
+	for (long t = 1; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+// The number of hops, interpolated between passes, within which a fraction of the reachable pairs are.
+static double effective_diameter(const double *pairs, uint64_t hops, double fraction)
+{
+	double target = fraction * pairs[hops];
+	uint64_t t = 0;
+
+	while (t < hops && pairs[t] < target) t++;
+	if (t == 0 || pairs[t] == pairs[t - 1]) return (double)t;
+	return t - 1 + (target - pairs[t - 1]) / (pairs[t] - pairs[t - 1]);
+}
+
+// Mean number of hops between the distinct pairs of nodes of which one reaches the other.
+static double average_distance(const double *pairs, uint64_t hops)
+{
+	double sum = 0.0;
+
+	if (pairs[hops] <= pairs[0]) return 0.0;
+	for (uint64_t t = 1; t <= hops; t++) sum += t * (pairs[t] - pairs[t - 1]);
+	return sum / (pairs[hops] - pairs[0]);
+}
+
+// The exact neighbourhood function, by breadth-first search from every node. Returns the number of hops after which it
+// no longer grows, or UINT64_MAX if out of memory.
+static uint64_t bfs_pairs(const slgraph_t *g, int in, double **exact)
+{
+	uint64_t n = slgraph_nodes(g), hops = 0;
+	uint64_t *dist = malloc(n * sizeof(uint64_t)), *queue = malloc(n * sizeof(uint64_t)), *histogram = calloc(n, sizeof(uint64_t));
+
+	*exact = NULL;
+	if (!dist || !queue || !histogram) {
+		free(dist);
+		free(queue);
+		free(histogram);
+		return UINT64_MAX;
+	}
+	for (uint64_t v = 0; v < n; v++) dist[v] = UINT64_MAX;
+	for (uint64_t s = 0; s < n; s++) {
+		uint64_t head = 0, tail = 0;
+		dist[s] = 0;
+		queue[tail++] = s;
+		while (head < tail) {
+			slgraph_node_t v = queue[head++];
+			histogram[dist[v]]++;
+			if (dist[v] > hops) hops = dist[v];
+			uint_fast64_t deg = in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+			for (uint_fast64_t k = 0; k < deg; k++) {
+				slgraph_node_t u = in ? slgraph_in_neighbour(g, v, k) : slgraph_out_neighbour(g, v, k);
+				if (u >= n || dist[u] != UINT64_MAX) continue;
+				dist[u] = dist[v] + 1;
+				queue[tail++] = u;
+			}
+		}
+		for (uint64_t i = 0; i < tail; i++) dist[queue[i]] = UINT64_MAX;
+	}
+
+	if ((*exact = malloc((hops + 1) * sizeof(double)))) {
+		double sum = 0.0;
+		for (uint64_t t = 0; t <= hops; t++) (*exact)[t] = sum += histogram[t];
+	}
+	free(dist);
+	free(queue);
+	free(histogram);
+	return *exact ? hops : UINT64_MAX;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned long log2m = 7;
+	uint64_t max_hops = UINT64_MAX, seed = 0;
+	double fraction = 0.9;
+	int in = 0, check = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--log2m") == 0 && argi + 1 < argc - 1) {
+			log2m = strtoul(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--direction") == 0 && argi + 1 < argc - 1) {
+			argi++;
+			if (strcmp(argv[argi], "in") == 0) {
+				in = 1;
+			} else if (strcmp(argv[argi], "out") == 0) {
+				in = 0;
+			} else {
+				break;
+			}
+		} else if (strcmp(argv[argi], "--hops") == 0 && argi + 1 < argc - 1) {
+			max_hops = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--seed") == 0 && argi + 1 < argc - 1) {
+			seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--fraction") == 0 && argi + 1 < argc - 1) {
+			fraction = atof(argv[++argi]);
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else {
+			break;
+		}
+	}
+	// The HyperLogLog estimate needs at least 16 registers.
+	if (argi != argc - 1 || log2m < 4 || log2m > 16 || !(fraction > 0.0 && fraction <= 1.0)) {
+		fprintf(stderr, "Usage: %s [--threads N] [--log2m B] [--direction out|in] [--hops H] [--seed S] [--fraction F] [--check] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	slgraph_t g;
+	if (slgraph_open(&g, argv[argi], true)) {
+		fprintf(stderr, "Failed to open graph: %s\n", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	uint64_t m = (uint64_t)1 << log2m;
+	double powers[128];
+	for (int r = 0; r < 128; r++) powers[r] = ldexp(1.0, -r);
+
+	anf_t a = {.g = &g, .in = in, .log2m = (unsigned)log2m, .words = m / LANES, .powers = powers};
+	uint64_t *counters[2] = {calloc(n, m), malloc(n * m)};
+	unsigned char *changed[2] = {malloc(n), malloc(n)};
+	a.estimate = malloc(n * sizeof(double));
+	double *pairs = malloc(sizeof(double));
+	if (!counters[0] || !counters[1] || !changed[0] || !changed[1] || !a.estimate || !pairs || pthread_mutex_init(&a.lock, NULL)) {
+		fprintf(stderr, "Out of memory for %lu counters of %lu registers\n", (unsigned long)n, (unsigned long)m);
+		return 1;
+	}
+	atomic_init(&a.next_chunk, 0);
+
+	// Every counter starts with its node: register j gets the position of the first 1 bit of the rest of the hash.
+	for (uint64_t v = 0; v < n; v++) {
+		uint64_t h = mix(v ^ mix(seed)), j = h >> (64 - log2m), rest = h << log2m;
+		unsigned char rho = 1;
+		while (rho <= 64 - log2m && !(rest & ((uint64_t)1 << 63))) {
+			rest <<= 1;
+			rho++;
+		}
+		((unsigned char *)(counters[0] + v * a.words))[j] = rho;
+		changed[0][v] = 1;
+		a.estimate[v] = count(&a, counters[0] + v * a.words);
+		pairs[0] = v ? pairs[0] + a.estimate[v] : a.estimate[v];
+	}
+
+	printf("Stats: nodes=%lu edges=%lu mode=anf direction=%s registers=%lu threads=%ld\n", (unsigned long)n,
+	       (unsigned long)slgraph_edges(&g), in ? "in" : "out", (unsigned long)m, threads);
+	printf("hop=0 pairs=%.0f changed=%lu time=0.000\n", pairs[0], (unsigned long)n);
+
+	uint64_t hops = 0;
+	int cur = 0, failed = 0;
+	double total_time = 0.0;
+	while (hops < max_hops) {
+		double *grown = realloc(pairs, (hops + 2) * sizeof(double));
+		if (!grown) {
+			fprintf(stderr, "Out of memory\n");
+			failed = 1;
+			break;
+		}
+		pairs = grown;
+
+		a.cur = counters[cur];
+		a.next = counters[1 - cur];
+		a.cur_changed = changed[cur];
+		a.next_changed = changed[1 - cur];
+		double t0 = now();
+		run(&a, threads);
+		double t = now() - t0;
+		if (!a.changed) break;
+
+		cur = 1 - cur;
+		total_time += t;
+		pairs[++hops] = a.pairs;
+		printf("hop=%lu pairs=%.0f changed=%lu time=%.3f\n", (unsigned long)hops, a.pairs, (unsigned long)a.changed, t);
+	}
+
+	double diameter = effective_diameter(pairs, hops, fraction), distance = average_distance(pairs, hops);
+	printf("hops=%lu converged=%s reachable_pairs=%.0f effective_diameter=%.2f average_distance=%.2f time=%.3f\n",
+	       (unsigned long)hops, hops < max_hops ? "yes" : "no", pairs[hops], diameter, distance, total_time);
+
+	if (!failed && check) {
+		double *exact;
+		uint64_t exact_hops = bfs_pairs(&g, in, &exact);
+		if (exact_hops == UINT64_MAX) {
+			fprintf(stderr, "Out of memory for the check\n");
+			failed = 1;
+		} else {
+			// Compare up to the last pass, after which both functions are constant.
+			double worst = 0.0;
+			uint64_t last = hops > exact_hops ? hops : exact_hops;
+			for (uint64_t t = 0; t <= last && t <= max_hops; t++) {
+				double estimate = pairs[t < hops ? t : hops], expected = exact[t < exact_hops ? t : exact_hops];
+				double error = fabs(estimate - expected) / expected;
+				if (error > worst) worst = error;
+			}
+			int ok = worst <= 3 * 1.04 / sqrt((double)m);
+			printf("exact_pairs=%.0f exact_effective_diameter=%.2f exact_average_distance=%.2f\n", exact[exact_hops],
+			       effective_diameter(exact, exact_hops, fraction), average_distance(exact, exact_hops));
+			printf("check=%s max_relative_error=%.4f\n", ok ? "OK" : "FAILED", worst);
+			failed = !ok;
+		}
+		free(exact);
+	}
+
+	pthread_mutex_destroy(&a.lock);
+	free(counters[0]);
+	free(counters[1]);
+	free(changed[0]);
+	free(changed[1]);
+	free(a.estimate);
+	free(pairs);
+	slgraph_close(&g);
+	return failed;
+}
@@ -0,0 +1,546 @@
+// Build a contraction hierarchy of a weighted SLGraph and store it in the graph, for fast point-to-point shortest path
+// queries with slgraph_ch_query.
+//
+// Usage:
+//   slgraph_ch_build [--threads T] [--settle S] [--weight NAME] <graph.slg>
+//
+// Weights are those of slgraph_sssp (see weights.h). Nodes are contracted in order of twice their edge difference
+// (shortcuts added minus arcs removed) plus the number of their neighbours contracted before them and their level, which
+// keeps the hierarchy shallow. Each round contracts the nodes that come before all their neighbours in that order, no
+// two of which are adjacent, on T threads (default: one per CPU): the witness searches that decide which shortcuts a
+// node needs only read the remaining graph, and are run for all nodes of the round in parallel. A witness search
+// settles at most S nodes (default 500); if it gives up, the shortcut is added, which keeps distances exact at the cost
+// of more arcs. The priorities of the neighbours of the round are then updated in parallel too.
+//
+// The hierarchy is dropped when the graph is modified.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+#include "weights.h"
+
+typedef struct {
+	slgraph_ch_arc_t *arcs;
+	uint32_t count, cap;
+} adj_t;
+
+typedef struct {
+	uint64_t from, to;
+	double weight;
+	uint64_t middle;
+} shortcut_t;
+
+typedef struct {
+	double dist;
+	uint64_t node;
+} heap_entry_t;
+
+// Per-thread witness search state.
+typedef struct {
+	double *dist;
+	uint32_t *stamp;            // Search that dist belongs to
+	uint32_t *target;           // Search that is looking for the node
+	uint32_t search;
+	heap_entry_t *heap;
+	size_t heap_size, heap_cap;
+	shortcut_t *shortcuts;      // Shortcuts of the nodes contracted in this round
+	size_t shortcut_count, shortcut_cap;
+	int failed;
+} scratch_t;
+
+static uint64_t n;
+static adj_t *out, *in;         // Arcs between nodes not contracted yet; frozen once a node is contracted
+static int64_t *priority;
+static uint32_t *deleted;       // Neighbours contracted so far
+static uint32_t *level;         // Length of the longest chain of contracted nodes below the node
+static unsigned char *contracted; // Set from the start of the round a node is contracted in
+static uint64_t settle_limit = 500;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint64_t hash(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// Order of contraction: by priority, ties broken by a hash of the node so that neighbours rarely tie.
+static int before(uint64_t u, uint64_t v)
+{
+	if (priority[u] != priority[v]) return priority[u] < priority[v];
+	uint64_t hu = hash(u), hv = hash(v);
+	return hu != hv ? hu < hv : u < v;
+}
+
+static int adj_push(adj_t *a, slgraph_ch_arc_t arc)
+{
+	if (a->count == a->cap) {
+		uint32_t cap = a->cap ? 2 * a->cap : 4;
+		slgraph_ch_arc_t *arcs = realloc(a->arcs, cap * sizeof(slgraph_ch_arc_t));
+		if (!arcs) return -1;
+		a->arcs = arcs;
+		a->cap = cap;
+	}
+	a->arcs[a->count++] = arc;
+	return 0;
+}
+
+static void adj_remove(adj_t *a, uint64_t node)
+{
+	for (uint32_t i = 0; i < a->count; i++) {
+		if (a->arcs[i].node == node) {
+			a->arcs[i] = a->arcs[--a->count];
+			return;
+		}
+	}
+}
+
+static slgraph_ch_arc_t *adj_find(adj_t *a, uint64_t node)
+{
+	for (uint32_t i = 0; i < a->count; i++) {
+		if (a->arcs[i].node == node) return &a->arcs[i];
+	}
+	return NULL;
+}
+
+// Add an arc from u to v, or lower the weight of the one there is. Returns 0 if successful.
+static int add_arc(uint64_t u, uint64_t v, double weight, uint64_t middle)
+{
+	slgraph_ch_arc_t *fwd = adj_find(&out[u], v);
+
+	if (fwd) {
+		if (fwd->weight <= weight) return 0;
+		slgraph_ch_arc_t *bwd = adj_find(&in[v], u);
+		fwd->weight = bwd->weight = weight;
+		fwd->middle = bwd->middle = middle;
+		return 0;
+	}
+	return adj_push(&out[u], (slgraph_ch_arc_t){v, weight, middle}) || adj_push(&in[v], (slgraph_ch_arc_t){u, weight, middle});
+}
+
+static void heap_push(scratch_t *s, heap_entry_t e)
+{
+	if (s->heap_size == s->heap_cap) {
+		size_t cap = s->heap_cap ? 2 * s->heap_cap : 1024;
+		heap_entry_t *heap = realloc(s->heap, cap * sizeof(heap_entry_t));
+		if (!heap) {
+			s->failed = 1;
+			return;
+		}
+		s->heap = heap;
+		s->heap_cap = cap;
+	}
+	size_t i = s->heap_size++;
+	while (i && s->heap[(i - 1) / 2].dist > e.dist) {
+		s->heap[i] = s->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	s->heap[i] = e;
+}
+
+static heap_entry_t heap_pop(scratch_t *s)
+{
+	heap_entry_t top = s->heap[0], last = s->heap[--s->heap_size];
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= s->heap_size) break;
+		if (c + 1 < s->heap_size && s->heap[c + 1].dist < s->heap[c].dist) c++;
+		if (s->heap[c].dist >= last.dist) break;
+		s->heap[i] = s->heap[c];
+		i = c;
+	}
+	if (s->heap_size) s->heap[i] = last;
+	return top;
+}
+
+static double dist_of(const scratch_t *s, uint64_t v)
+{
+	return s->stamp[v] == s->search ? s->dist[v] : INFINITY;
+}
+
+// Search from u in the remaining graph without v, until the out-neighbours of v are settled, or up to distance limit or
+// settle_limit settled nodes. Nodes contracted in the current round are avoided as well: they may all rely on paths
+// through each other otherwise.
+static void witness_search(scratch_t *s, uint64_t u, uint64_t v, double limit)
+{
+	uint64_t settled = 0, targets = 0;
+
+	if (++s->search == 0) {
+		memset(s->stamp, 0, n * sizeof(uint32_t));
+		memset(s->target, 0, n * sizeof(uint32_t));
+		s->search = 1;
+	}
+	for (uint32_t i = 0; i < out[v].count; i++) {
+		if (out[v].arcs[i].node == u) continue;
+		s->target[out[v].arcs[i].node] = s->search;
+		targets++;
+	}
+	s->heap_size = 0;
+	s->stamp[u] = s->search;
+	s->dist[u] = 0.0;
+	heap_push(s, (heap_entry_t){0.0, u});
+
+	while (s->heap_size && settled < settle_limit) {
+		heap_entry_t e = heap_pop(s);
+		if (e.dist > s->dist[e.node]) continue;
+		if (e.dist > limit) break;
+		if (s->target[e.node] == s->search && --targets == 0) break;
+		settled++;
+		for (uint32_t i = 0; i < out[e.node].count; i++) {
+			const slgraph_ch_arc_t *a = &out[e.node].arcs[i];
+			double d = e.dist + a->weight;
+			if (a->node == v || contracted[a->node] || d >= dist_of(s, a->node)) continue;
+			s->stamp[a->node] = s->search;
+			s->dist[a->node] = d;
+			heap_push(s, (heap_entry_t){d, a->node});
+		}
+	}
+}
+
+// Find the shortcuts contracting v needs: one from u to w for each path u -> v -> w without a path from u to w as
+// short that avoids v. They are added to s->shortcuts if collect is set. Returns the number of shortcuts.
+static uint64_t find_shortcuts(scratch_t *s, uint64_t v, int collect)
+{
+	uint64_t count = 0;
+
+	for (uint32_t i = 0; i < in[v].count; i++) {
+		const slgraph_ch_arc_t *a = &in[v].arcs[i];
+		double limit = -1.0;
+		for (uint32_t j = 0; j < out[v].count; j++) {
+			if (out[v].arcs[j].node != a->node && a->weight + out[v].arcs[j].weight > limit) limit = a->weight + out[v].arcs[j].weight;
+		}
+		if (limit < 0.0) continue;
+
+		witness_search(s, a->node, v, limit);
+		for (uint32_t j = 0; j < out[v].count; j++) {
+			const slgraph_ch_arc_t *b = &out[v].arcs[j];
+			double via = a->weight + b->weight;
+			if (b->node == a->node || dist_of(s, b->node) <= via) continue;
+			count++;
+			if (!collect) continue;
+			if (s->shortcut_count == s->shortcut_cap) {
+				size_t cap = s->shortcut_cap ? 2 * s->shortcut_cap : 256;
+				shortcut_t *shortcuts = realloc(s->shortcuts, cap * sizeof(shortcut_t));
+				if (!shortcuts) {
+					s->failed = 1;
+					return count;
+				}
+				s->shortcuts = shortcuts;
+				s->shortcut_cap = cap;
+			}
+			s->shortcuts[s->shortcut_count++] = (shortcut_t){a->node, b->node, via, v};
+		}
+	}
+	return count;
+}
+
+static void update_priority(scratch_t *s, uint64_t v)
+{
+	int64_t shortcuts = (int64_t)find_shortcuts(s, v, 0);
+	priority[v] = 2 * (shortcuts - (int64_t)in[v].count - (int64_t)out[v].count) + (int64_t)deleted[v] + (int64_t)level[v];
+}
+
+// === Parallel loops ===
+
+typedef enum {
+	JOB_PRIORITY,   // Update the priority of nodes[i]
+	JOB_SELECT,     // Set selected[i] if nodes[i] comes before all its neighbours
+	JOB_SHORTCUTS   // Collect the shortcuts of nodes[i]
+} job_kind_t;
+
+typedef struct {
+	job_kind_t kind;
+	const uint64_t *nodes;
+	unsigned char *selected;
+	uint64_t count;
+	atomic_uint_fast64_t next;
+	scratch_t *scratch;
+	unsigned threads;
+} job_t;
+
+typedef struct {
+	job_t *job;
+	unsigned id;
+} job_arg_t;
+
+static void *job_worker(void *arg)
+{
+	job_t *job = ((job_arg_t *)arg)->job;
+	scratch_t *s = &job->scratch[((job_arg_t *)arg)->id];
+	uint64_t i;
+
+	while ((i = atomic_fetch_add(&job->next, 64)) < job->count) {
+		uint64_t end = i + 64 < job->count ? i + 64 : job->count;
+		for (; i < end; i++) {
+			uint64_t v = job->nodes[i];
+			if (job->kind == JOB_PRIORITY) {
+				update_priority(s, v);
+			} else if (job->kind == JOB_SHORTCUTS) {
+				find_shortcuts(s, v, 1);
+			} else {
+				int first = 1;
+				for (uint32_t k = 0; k < out[v].count && first; k++) first = before(v, out[v].arcs[k].node);
+				for (uint32_t k = 0; k < in[v].count && first; k++) first = before(v, in[v].arcs[k].node);
+				job->selected[i] = (unsigned char)first;
+			}
+		}
+	}
+	return NULL;
+}
+
+// Run job on all threads. Returns 0 if successful.
+static int run_job(job_t *job)
+{
+	pthread_t tids[job->threads];
+	job_arg_t args[job->threads];
+	unsigned started = 1;
+
+	atomic_init(&job->next, 0);
+	for (unsigned t = 0; t < job->threads; t++) args[t] = (job_arg_t){job, t};
+	for (; started < job->threads && job->count > 64 * started; started++) {
+		if (pthread_create(&tids[started], NULL, job_worker, &args[started])) break;
+	}
+	job_worker(&args[0]);
+	for (unsigned t = 1; t < started; t++) pthread_join(tids[t], NULL);
+
+	for (unsigned t = 0; t < job->threads; t++) {
+		if (job->scratch[t].failed) return -1;
+	}
+	return 0;
+}
+
+// Turn the frozen arc lists into CSR arrays: up from out, down from in.
+static int build_csr(adj_t *lists, uint64_t **offsets, slgraph_ch_arc_t **arcs)
+{
+	uint64_t total = 0;
+
+	*offsets = malloc((n + 1) * sizeof(uint64_t));
+	if (!*offsets) return -1;
+	for (uint64_t v = 0; v < n; v++) {
+		(*offsets)[v] = total;
+		total += lists[v].count;
+	}
+	(*offsets)[n] = total;
+
+	*arcs = malloc((total ? total : 1) * sizeof(slgraph_ch_arc_t));
+	if (!*arcs) return -1;
+	for (uint64_t v = 0; v < n; v++) {
+		memcpy(*arcs + (*offsets)[v], lists[v].arcs, lists[v].count * sizeof(slgraph_ch_arc_t));
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *weight_name = "weight";
+	int named = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--settle") == 0 && argi + 1 < argc - 1) {
+			settle_limit = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--weight") == 0 && argi + 1 < argc - 1) {
+			weight_name = argv[++argi];
+			named = 1;
+		} else {
+			break;
+		}
+	}
+	if (argc - argi != 1 || settle_limit == 0) {
+		fprintf(stderr, "Usage: %s [--threads T] [--settle S] [--weight NAME] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	slgraph_t g;
+	if (slgraph_open_existing(&g, argv[argi], false)) {
+		fprintf(stderr, "Failed to open graph for writing: %s\n", argv[argi]);
+		return 1;
+	}
+
+	const double *weights;
+	double *owned;
+	const char *weight_source = load_weights(&g, weight_name, named, &weights, &owned);
+	if (!weight_source) {
+		slgraph_close(&g);
+		return 1;
+	}
+
+	double t0 = now();
+	n = slgraph_nodes(&g);
+	uint64_t edges = 0, shortcuts = 0, rounds = 0;
+	out = calloc(n ? n : 1, sizeof(adj_t));
+	in = calloc(n ? n : 1, sizeof(adj_t));
+	priority = calloc(n ? n : 1, sizeof(int64_t));
+	deleted = calloc(n ? n : 1, sizeof(uint32_t));
+	level = calloc(n ? n : 1, sizeof(uint32_t));
+	contracted = calloc(n ? n : 1, 1);
+	uint64_t *rank = malloc((n ? n : 1) * sizeof(uint64_t));
+	uint64_t *remaining = malloc((n ? n : 1) * sizeof(uint64_t));
+	uint64_t *touched = malloc((n ? n : 1) * sizeof(uint64_t));
+	unsigned char *selected = malloc(n ? n : 1), *mark = calloc(n ? n : 1, 1);
+	scratch_t *scratch = calloc(threads, sizeof(scratch_t));
+	int failed = !out || !in || !priority || !deleted || !level || !contracted || !rank || !remaining || !touched || !selected || !mark || !scratch;
+
+	for (long t = 0; !failed && t < threads; t++) {
+		scratch[t].dist = malloc((n ? n : 1) * sizeof(double));
+		scratch[t].stamp = calloc(n ? n : 1, sizeof(uint32_t));
+		scratch[t].target = calloc(n ? n : 1, sizeof(uint32_t));
+		failed = !scratch[t].dist || !scratch[t].stamp || !scratch[t].target;
+	}
+
+	// The graph without self-loops, and of parallel edges only the shortest.
+	for (uint64_t u = 0; !failed && u < n; u++) {
+		uint_fast64_t deg = slgraph_out_degree(&g, u);
+		for (uint_fast64_t k = 0; k < deg && !failed; k++) {
+			slgraph_node_t v = slgraph_out_neighbour(&g, u, k);
+			if (v == u || v >= n) continue;
+			failed = add_arc(u, v, weights ? weights[slgraph_out_incident(&g, u, k)] : 1.0, SLGRAPH_INVALID_NODE);
+		}
+	}
+	if (failed) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (uint64_t u = 0; u < n; u++) {
+		edges += out[u].count;
+		remaining[u] = u;
+	}
+
+	job_t job = {.scratch = scratch, .threads = (unsigned)threads, .selected = selected};
+	job.kind = JOB_PRIORITY;
+	job.nodes = remaining;
+	job.count = n;
+	failed = run_job(&job);
+
+	uint64_t left = n, next_rank = 0;
+	while (left && !failed) {
+		rounds++;
+		job.kind = JOB_SELECT;
+		job.nodes = remaining;
+		job.count = left;
+		run_job(&job);
+
+		// Move the selected nodes to the front of remaining.
+		uint64_t chosen = 0;
+		for (uint64_t i = 0; i < left; i++) {
+			if (!selected[i]) continue;
+			uint64_t v = remaining[i];
+			remaining[i] = remaining[chosen];
+			remaining[chosen++] = v;
+			contracted[v] = 1;
+		}
+
+		for (long t = 0; t < threads; t++) scratch[t].shortcut_count = 0;
+		job.kind = JOB_SHORTCUTS;
+		job.count = chosen;
+		if ((failed = run_job(&job))) break;
+
+		// Contract: detach the chosen nodes, whose arcs become their up and down arcs, and add their shortcuts.
+		uint64_t touched_count = 0;
+		for (uint64_t i = 0; i < chosen; i++) {
+			uint64_t v = remaining[i];
+			rank[v] = next_rank++;
+			for (uint32_t k = 0; k < out[v].count; k++) {
+				uint64_t w = out[v].arcs[k].node;
+				adj_remove(&in[w], v);
+				deleted[w]++;
+				if (level[w] <= level[v]) level[w] = level[v] + 1;
+				if (!mark[w]) mark[w] = 1, touched[touched_count++] = w;
+			}
+			for (uint32_t k = 0; k < in[v].count; k++) {
+				uint64_t u = in[v].arcs[k].node;
+				adj_remove(&out[u], v);
+				deleted[u]++;
+				if (level[u] <= level[v]) level[u] = level[v] + 1;
+				if (!mark[u]) mark[u] = 1, touched[touched_count++] = u;
+			}
+		}
+		for (long t = 0; t < threads && !failed; t++) {
+			for (size_t i = 0; i < scratch[t].shortcut_count && !failed; i++) {
+				const shortcut_t *sc = &scratch[t].shortcuts[i];
+				failed = add_arc(sc->from, sc->to, sc->weight, sc->middle);
+			}
+			shortcuts += scratch[t].shortcut_count;
+		}
+		for (uint64_t i = 0; i < touched_count; i++) mark[touched[i]] = 0;
+
+		job.kind = JOB_PRIORITY;
+		job.nodes = touched;
+		job.count = touched_count;
+		if (!failed) failed = run_job(&job);
+
+		remaining += chosen;
+		left -= chosen;
+	}
+	remaining -= n - left;
+
+	uint64_t *up = NULL, *down = NULL;
+	slgraph_ch_arc_t *up_arcs = NULL, *down_arcs = NULL;
+	if (failed || build_csr(out, &up, &up_arcs) || build_csr(in, &down, &down_arcs)) {
+		fprintf(stderr, "Out of memory\n");
+		failed = 1;
+	}
+	double build_time = now() - t0;
+
+	if (!failed && slgraph_set_ch(&g, rank, up, up_arcs, down, down_arcs)) {
+		fprintf(stderr, "Failed to store the contraction hierarchy\n");
+		failed = 1;
+	}
+	if (!failed) {
+		printf("Stats: nodes=%lu edges=%lu mode=ch_build weights=%s threads=%ld settle=%lu\n", (unsigned long)n,
+		       (unsigned long)slgraph_edges(&g), weight_source, threads, (unsigned long)settle_limit);
+		printf("arcs=%lu shortcuts=%lu up_arcs=%lu down_arcs=%lu rounds=%lu time=%.3f\n", (unsigned long)edges,
+		       (unsigned long)shortcuts, (unsigned long)up[n], (unsigned long)down[n], (unsigned long)rounds, build_time);
+	}
+
+	for (uint64_t v = 0; out && in && v < n; v++) {
+		free(out[v].arcs);
+		free(in[v].arcs);
+	}
+	for (long t = 0; scratch && t < threads; t++) {
+		free(scratch[t].dist);
+		free(scratch[t].stamp);
+		free(scratch[t].target);
+		free(scratch[t].heap);
+		free(scratch[t].shortcuts);
+	}
+	free(scratch);
+	free(out);
+	free(in);
+	free(priority);
+	free(deleted);
+	free(level);
+	free(contracted);
+	free(rank);
+	free(remaining);
+	free(touched);
+	free(selected);
+	free(mark);
+	free(up);
+	free(down);
+	free(up_arcs);
+	free(down_arcs);
+	free(owned);
+	slgraph_close(&g);
+	return failed;
+}
@@ -0,0 +1,431 @@
+// Point-to-point shortest path queries on the contraction hierarchy stored by slgraph_ch_build.
+//
+// Usage:
+//   slgraph_ch_query [--queries Q] [--seed S] [--pairs FILE] [--check] [--print] [--path] [--original-ids]
+//                    [--weight NAME] <graph.slg>
+//
+// Runs Q (default 1000) queries between nodes drawn at random with seed S, or one for each "<source> <target>" line of
+// FILE ("-" for stdin). Each query is a bidirectional Dijkstra that only follows arcs to higher ranked nodes: forward
+// over the up arcs from the source, backward over the down arcs from the target, until neither side can improve the
+// best meeting point. Prints the latency percentiles of the queries and the mean number of nodes they settled.
+//
+// --print prints "<source> <target> <distance>" for each query (inf if there is no path), followed by the nodes of the
+// path with --path, which unpacks the shortcuts on it. --original-ids reads and prints nodes by their ID in the input
+// the graph was loaded from. --check compares every distance with Dijkstra's on the graph itself, using the weights of
+// slgraph_sssp (see weights.h), which must be those the hierarchy was built with, and checks that the unpacked path is
+// as long as the distance.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "slgraph.h"
+#include "weights.h"
+
+typedef struct {
+	double dist;
+	uint64_t node;
+} heap_entry_t;
+
+typedef struct {
+	heap_entry_t *entries;
+	size_t size, cap;
+} heap_t;
+
+// One direction of a query.
+typedef struct {
+	const uint64_t *offsets;
+	const slgraph_ch_arc_t *arcs;
+	double *dist;
+	uint64_t *parent;
+	uint32_t *stamp;            // Query that dist and parent belong to
+	heap_t heap;
+} side_t;
+
+typedef struct {
+	uint64_t *nodes;
+	size_t count, cap;
+} path_t;
+
+static uint32_t query;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t splitmix(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int heap_push(heap_t *h, heap_entry_t e)
+{
+	if (h->size == h->cap) {
+		size_t cap = h->cap ? 2 * h->cap : 1024;
+		heap_entry_t *entries = realloc(h->entries, cap * sizeof(heap_entry_t));
+		if (!entries) return -1;
+		h->entries = entries;
+		h->cap = cap;
+	}
+	size_t i = h->size++;
+	while (i && h->entries[(i - 1) / 2].dist > e.dist) {
+		h->entries[i] = h->entries[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	h->entries[i] = e;
+	return 0;
+}
+
+static heap_entry_t heap_pop(heap_t *h)
+{
+	heap_entry_t top = h->entries[0], last = h->entries[--h->size];
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= h->size) break;
+		if (c + 1 < h->size && h->entries[c + 1].dist < h->entries[c].dist) c++;
+		if (h->entries[c].dist >= last.dist) break;
+		h->entries[i] = h->entries[c];
+		i = c;
+	}
+	if (h->size) h->entries[i] = last;
+	return top;
+}
+
+static double dist_of(const side_t *s, uint64_t v)
+{
+	return s->stamp[v] == query ? s->dist[v] : INFINITY;
+}
+
+static int side_init(side_t *s, const uint64_t *offsets, const slgraph_ch_arc_t *arcs, uint64_t n)
+{
+	memset(s, 0, sizeof(side_t));
+	s->offsets = offsets;
+	s->arcs = arcs;
+	s->dist = malloc(n * sizeof(double));
+	s->parent = malloc(n * sizeof(uint64_t));
+	s->stamp = calloc(n, sizeof(uint32_t));
+	return s->dist && s->parent && s->stamp ? 0 : -1;
+}
+
+static void side_free(side_t *s)
+{
+	free(s->dist);
+	free(s->parent);
+	free(s->stamp);
+	free(s->heap.entries);
+}
+
+// Settle the closest node of s and relax its arcs. Updates *best and *meet if it meets the other side. Returns 0 if
+// successful.
+static int side_step(side_t *s, const side_t *other, double *best, uint64_t *meet, uint64_t *settled)
+{
+	heap_entry_t e = heap_pop(&s->heap);
+	if (e.dist > s->dist[e.node]) return 0; // Stale entry
+	(*settled)++;
+
+	double through = e.dist + dist_of(other, e.node);
+	if (through < *best) {
+		*best = through;
+		*meet = e.node;
+	}
+
+	for (uint64_t i = s->offsets[e.node]; i < s->offsets[e.node + 1]; i++) {
+		const slgraph_ch_arc_t *a = &s->arcs[i];
+		double d = e.dist + a->weight;
+		if (d >= dist_of(s, a->node)) continue;
+		s->stamp[a->node] = query;
+		s->dist[a->node] = d;
+		s->parent[a->node] = e.node;
+		if (heap_push(&s->heap, (heap_entry_t){d, a->node})) return -1;
+	}
+	return 0;
+}
+
+// Distance from source to target, or INFINITY; *meet is the highest ranked node of the path. Returns -1 if out of
+// memory.
+static int ch_distance(side_t *fwd, side_t *bwd, uint64_t n, uint64_t source, uint64_t target, double *best, uint64_t *meet, uint64_t *settled)
+{
+	if (++query == 0) {
+		memset(fwd->stamp, 0, n * sizeof(uint32_t));
+		memset(bwd->stamp, 0, n * sizeof(uint32_t));
+		query = 1;
+	}
+	*best = INFINITY;
+	*meet = SLGRAPH_INVALID_NODE;
+	fwd->heap.size = bwd->heap.size = 0;
+	fwd->stamp[source] = bwd->stamp[target] = query;
+	fwd->dist[source] = bwd->dist[target] = 0.0;
+	fwd->parent[source] = bwd->parent[target] = SLGRAPH_INVALID_NODE;
+	if (heap_push(&fwd->heap, (heap_entry_t){0.0, source}) || heap_push(&bwd->heap, (heap_entry_t){0.0, target})) return -1;
+
+	for (;;) {
+		double f = fwd->heap.size ? fwd->heap.entries[0].dist : INFINITY;
+		double b = bwd->heap.size ? bwd->heap.entries[0].dist : INFINITY;
+		if (f >= *best && b >= *best) break;
+		if (f <= b ? side_step(fwd, bwd, best, meet, settled) : side_step(bwd, fwd, best, meet, settled)) return -1;
+	}
+	return 0;
+}
+
+static int path_push(path_t *p, uint64_t v)
+{
+	if (p->count == p->cap) {
+		size_t cap = p->cap ? 2 * p->cap : 64;
+		uint64_t *nodes = realloc(p->nodes, cap * sizeof(uint64_t));
+		if (!nodes) return -1;
+		p->nodes = nodes;
+		p->cap = cap;
+	}
+	p->nodes[p->count++] = v;
+	return 0;
+}
+
+// Find the arc between v and the higher ranked node w among the arcs of v.
+static const slgraph_ch_arc_t *find_arc(const uint64_t *offsets, const slgraph_ch_arc_t *arcs, uint64_t v, uint64_t w)
+{
+	for (uint64_t i = offsets[v]; i < offsets[v + 1]; i++) {
+		if (arcs[i].node == w) return &arcs[i];
+	}
+	return NULL;
+}
+
+// Append the nodes after u of the path the arc from u to w stands for, and add the weights of its edges to *length.
+static int unpack(const slgraph_ch_t *ch, uint64_t u, uint64_t w, double *length, path_t *p)
+{
+	const slgraph_ch_arc_t *a = ch->rank[u] < ch->rank[w] ? find_arc(ch->up, ch->up_arcs, u, w) : find_arc(ch->down, ch->down_arcs, w, u);
+
+	if (!a) return -1;
+	if (a->middle == SLGRAPH_INVALID_NODE) {
+		*length += a->weight;
+		return path_push(p, w);
+	}
+	return unpack(ch, u, a->middle, length, p) || unpack(ch, a->middle, w, length, p);
+}
+
+// The path of the last query through meet, as nodes of the graph, and its length. hops is scratch space.
+static int build_path(const slgraph_ch_t *ch, const side_t *fwd, const side_t *bwd, uint64_t meet, double *length, path_t *hops, path_t *p)
+{
+	// The nodes the search went through: the forward half from meet back to the source reversed, then the backward half.
+	hops->count = 0;
+	for (uint64_t v = meet; v != SLGRAPH_INVALID_NODE; v = fwd->parent[v]) {
+		if (path_push(hops, v)) return -1;
+	}
+	for (size_t i = 0; i < hops->count / 2; i++) {
+		uint64_t v = hops->nodes[i];
+		hops->nodes[i] = hops->nodes[hops->count - 1 - i];
+		hops->nodes[hops->count - 1 - i] = v;
+	}
+	for (uint64_t v = bwd->parent[meet]; v != SLGRAPH_INVALID_NODE; v = bwd->parent[v]) {
+		if (path_push(hops, v)) return -1;
+	}
+
+	p->count = 0;
+	*length = 0.0;
+	if (path_push(p, hops->nodes[0])) return -1;
+	for (size_t i = 1; i < hops->count; i++) {
+		if (unpack(ch, hops->nodes[i - 1], hops->nodes[i], length, p)) return -1;
+	}
+	return 0;
+}
+
+// Distances from source with Dijkstra's algorithm on the graph itself, with lazy deletion instead of decrease-key.
+static int dijkstra(const slgraph_t *g, const double *weights, uint64_t source, double *dist, heap_t *h)
+{
+	uint64_t n = slgraph_nodes(g);
+
+	for (uint64_t v = 0; v < n; v++) dist[v] = INFINITY;
+	dist[source] = 0.0;
+	h->size = 0;
+	if (heap_push(h, (heap_entry_t){0.0, source})) return -1;
+
+	while (h->size) {
+		heap_entry_t e = heap_pop(h);
+		if (e.dist > dist[e.node]) continue;
+
+		uint_fast64_t deg = slgraph_out_degree(g, e.node);
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t v = slgraph_out_neighbour(g, e.node, k);
+			double nd = e.dist + (weights ? weights[slgraph_out_incident(g, e.node, k)] : 1.0);
+			if (nd >= dist[v]) continue;
+			dist[v] = nd;
+			if (heap_push(h, (heap_entry_t){nd, v})) return -1;
+		}
+	}
+	return 0;
+}
+
+static int same_distance(double a, double b)
+{
+	return a == b || fabs(a - b) <= 1e-9 * fmax(1.0, fabs(b));
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t queries = 1000, seed = 1;
+	const char *pairs_name = NULL, *weight_name = "weight";
+	int check = 0, print = 0, print_path = 0, original_ids = 0, named = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--queries") == 0 && argi + 1 < argc - 1) {
+			queries = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--seed") == 0 && argi + 1 < argc - 1) {
+			seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--pairs") == 0 && argi + 1 < argc - 1) {
+			pairs_name = argv[++argi];
+		} else if (strcmp(argv[argi], "--weight") == 0 && argi + 1 < argc - 1) {
+			weight_name = argv[++argi];
+			named = 1;
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else if (strcmp(argv[argi], "--print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[argi], "--path") == 0) {
+			print_path = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else {
+			break;
+		}
+	}
+	if (argc - argi != 1) {
+		fprintf(stderr, "Usage: %s [--queries Q] [--seed S] [--pairs FILE] [--check] [--print] [--path] [--original-ids] [--weight NAME] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+
+	slgraph_t g;
+	if (slgraph_open(&g, argv[argi], true)) {
+		fprintf(stderr, "Failed to open graph: %s\n", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g);
+	slgraph_ch_t ch;
+	if (n == 0 || slgraph_ch(&g, &ch)) {
+		fprintf(stderr, "Graph has no contraction hierarchy (run slgraph_ch_build)\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	const double *weights = NULL;
+	double *owned = NULL;
+	if (check && !load_weights(&g, weight_name, named, &weights, &owned)) {
+		slgraph_close(&g);
+		return 1;
+	}
+
+	FILE *pairs = NULL;
+	if (pairs_name) {
+		pairs = strcmp(pairs_name, "-") == 0 ? stdin : fopen(pairs_name, "r");
+		if (!pairs) {
+			fprintf(stderr, "Failed to open %s\n", pairs_name);
+			free(owned);
+			slgraph_close(&g);
+			return 1;
+		}
+		queries = 0;
+	}
+
+	side_t fwd, bwd;
+	heap_t check_heap = {0};
+	path_t path = {0}, hops = {0};
+	size_t latency_cap = queries ? queries : 1024, total = 0;
+	uint64_t *latency = malloc(latency_cap * sizeof(uint64_t));
+	double *expected = check ? malloc(n * sizeof(double)) : NULL;
+	int failed = side_init(&fwd, ch.up, ch.up_arcs, n) | side_init(&bwd, ch.down, ch.down_arcs, n) | !latency | (check && !expected);
+
+	uint64_t state = seed, settled = 0, reached = 0, mismatched = 0, bad_paths = 0;
+	char line[256];
+	while (!failed) {
+		uint64_t s, t;
+		if (pairs) {
+			unsigned long a, b;
+			if (!fgets(line, sizeof(line), pairs)) break;
+			if (line[0] == '#' || sscanf(line, "%lu %lu", &a, &b) != 2) continue;
+			s = original_ids ? slgraph_node_by_original_id(&g, a) : a;
+			t = original_ids ? slgraph_node_by_original_id(&g, b) : b;
+			if (s >= n || t >= n) {
+				fprintf(stderr, "No such node: %s", line);
+				continue;
+			}
+		} else {
+			if (total == queries) break;
+			s = splitmix(&state) % n;
+			t = splitmix(&state) % n;
+		}
+
+		double best;
+		uint64_t meet, start = now_ns();
+		if ((failed = ch_distance(&fwd, &bwd, n, s, t, &best, &meet, &settled))) break;
+		uint64_t elapsed = now_ns() - start;
+
+		if (total == latency_cap) {
+			uint64_t *grown = realloc(latency, 2 * latency_cap * sizeof(uint64_t));
+			if (!grown) {
+				failed = 1;
+				break;
+			}
+			latency = grown;
+			latency_cap *= 2;
+		}
+		latency[total++] = elapsed;
+		reached += best < INFINITY;
+
+		double length = 0.0;
+		if (best < INFINITY && (print_path || check) && (failed = build_path(&ch, &fwd, &bwd, meet, &length, &hops, &path))) break;
+		if (check) {
+			if ((failed = dijkstra(&g, weights, s, expected, &check_heap))) break;
+			mismatched += !same_distance(best, expected[t]);
+			bad_paths += best < INFINITY && (!same_distance(length, best) || path.nodes[path.count - 1] != t);
+		}
+		if (print) {
+			printf("%lu %lu %.17g", (unsigned long)(original_ids ? slgraph_original_id(&g, s) : s),
+			       (unsigned long)(original_ids ? slgraph_original_id(&g, t) : t), best);
+			for (size_t i = 0; print_path && best < INFINITY && i < path.count; i++) {
+				printf(" %lu", (unsigned long)(original_ids ? slgraph_original_id(&g, path.nodes[i]) : path.nodes[i]));
+			}
+			printf("\n");
+		}
+	}
+
+	if (failed) {
+		fprintf(stderr, "Out of memory or corrupt hierarchy\n");
+	} else if (total) {
+		qsort(latency, total, sizeof(uint64_t), cmp_u64);
+		printf("Stats: nodes=%lu edges=%lu mode=ch_query queries=%lu up_arcs=%lu down_arcs=%lu\n", (unsigned long)n,
+		       (unsigned long)slgraph_edges(&g), (unsigned long)total, (unsigned long)ch.up[n], (unsigned long)ch.down[n]);
+		printf("reached=%lu settled_mean=%.1f\n", (unsigned long)reached, (double)settled / total);
+		printf("latency_us p50=%.1f p90=%.1f p99=%.1f p999=%.1f max=%.1f\n", latency[total / 2] / 1e3,
+		       latency[total * 9 / 10] / 1e3, latency[total * 99 / 100] / 1e3, latency[total * 999 / 1000] / 1e3,
+		       latency[total - 1] / 1e3);
+		if (check) printf("check=%s mismatched=%lu bad_paths=%lu\n", mismatched || bad_paths ? "FAILED" : "OK",
+		                  (unsigned long)mismatched, (unsigned long)bad_paths);
+	}
+
+	if (pairs && pairs != stdin) fclose(pairs);
+	side_free(&fwd);
+	side_free(&bwd);
+	free(check_heap.entries);
+	free(path.nodes);
+	free(hops.nodes);
+	free(latency);
+	free(expected);
+	free(owned);
+	slgraph_close(&g);
+	return failed || mismatched || bad_paths;
+}
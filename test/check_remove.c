@@ -0,0 +1,477 @@
+// Check edge and node removal, compaction and write-ahead log replay against a shadow model of the graph.
+//
+// Usage:
+//   slgraph_check_remove [--seed X] [--nodes N] [--rounds R] [--ops K] [--sorted] <scratch.slg>
+//
+// Builds a directed graph of N nodes (default 1000) and 4 N random edges at scratch.slg, which must not exist yet, and
+// runs R rounds (default 16) of K random operations (default 4000): adding an edge, removing an edge or, rarely,
+// removing a node. Odd rounds compact automatically at a threshold of 0.1, even ones only by calling slgraph_compact()
+// at their end. A shadow list of the live edges as (source, target) pairs follows along, and after every round the
+// incidence lists, the list positions in the "edgepos" section and slgraph_removed_edges() / slgraph_removed_nodes()
+// are compared with it.
+//
+// Every fourth round then appends a few batches with slgraph_append_edges() in a child process that exits without a
+// checkpoint, and simulates a crash right after the commit of the last batch: the in-place changes of its log record
+// are undone from a copy of the graph taken before, and the record is either kept, so reopening has to replay it, or
+// torn, so the batch has to be lost. This reads the log format described in src/slgraph.c.
+//
+// --sorted sorts the incidence lists first; their order is then checked too. Prints one line per round and
+// "check=OK mismatched=0" at the end, or stops after the first round with mismatches, which are listed on stderr.
+// The scratch files are removed unless a check failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "slgraph.h"
+
+// Batches appended per crash, and edges per batch.
+#define CRASH_BATCHES 4
+#define CRASH_BATCH 64
+
+// Mismatches listed on stderr per check.
+#define REPORT 10
+
+typedef struct {
+	uint64_t state;
+} rng_t;
+
+static void rng_seed(rng_t *r, uint64_t seed) {
+	r->state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+static uint64_t rng_next(rng_t *r) {
+	uint64_t x = r->state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	r->state = x;
+	return x * 2685821657736338717ULL;
+}
+
+static uint64_t rng_range(rng_t *r, uint64_t n) {
+	if (n == 0) return 0;
+	uint64_t x, limit = UINT64_MAX - (UINT64_MAX % n);
+	do {
+		x = rng_next(r);
+	} while (x >= limit);
+	return x % n;
+}
+
+typedef struct {
+	slgraph_node_t src;
+	slgraph_node_t dst;
+} pair_t;
+
+typedef struct {
+	pair_t *edges;          // Live edges, in no particular order
+	uint64_t count;
+	uint64_t cap;
+	unsigned char *removed; // Per node
+	uint64_t nodes;
+	uint64_t removed_nodes;
+} shadow_t;
+
+static int shadow_grow(shadow_t *sh, uint64_t nodes)
+{
+	unsigned char *removed = realloc(sh->removed, nodes);
+	if (!removed) return -1;
+	memset(removed + sh->nodes, 0, nodes - sh->nodes);
+	sh->removed = removed;
+	sh->nodes = nodes;
+	return 0;
+}
+
+static int shadow_add(shadow_t *sh, slgraph_node_t src, slgraph_node_t dst)
+{
+	if (sh->count == sh->cap) {
+		uint64_t cap = sh->cap ? sh->cap * 2 : 1024;
+		pair_t *edges = realloc(sh->edges, cap * sizeof(pair_t));
+		if (!edges) return -1;
+		sh->edges = edges;
+		sh->cap = cap;
+	}
+	sh->edges[sh->count++] = (pair_t){src, dst};
+	return 0;
+}
+
+// Remove one edge from src to dst. Returns -1 if there is none.
+static int shadow_remove(shadow_t *sh, slgraph_node_t src, slgraph_node_t dst)
+{
+	for (uint64_t i = 0; i < sh->count; i++) {
+		if (sh->edges[i].src == src && sh->edges[i].dst == dst) {
+			sh->edges[i] = sh->edges[--sh->count];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static void shadow_remove_node(shadow_t *sh, slgraph_node_t v)
+{
+	for (uint64_t i = 0; i < sh->count;) {
+		if (sh->edges[i].src == v || sh->edges[i].dst == v) {
+			sh->edges[i] = sh->edges[--sh->count];
+		} else {
+			i++;
+		}
+	}
+	sh->removed[v] = 1;
+	sh->removed_nodes++;
+}
+
+// A random node that was not removed, or SLGRAPH_INVALID_NODE if there are hardly any.
+static slgraph_node_t live_node(const shadow_t *sh, rng_t *rng)
+{
+	for (int tries = 0; tries < 64; tries++) {
+		slgraph_node_t v = rng_range(rng, sh->nodes);
+		if (!sh->removed[v]) return v;
+	}
+	return SLGRAPH_INVALID_NODE;
+}
+
+static int pair_cmp(const void *a, const void *b)
+{
+	const pair_t *x = a, *y = b;
+	if (x->src != y->src) return x->src < y->src ? -1 : 1;
+	if (x->dst != y->dst) return x->dst < y->dst ? -1 : 1;
+	return 0;
+}
+
+static uint64_t mismatch(uint64_t mismatched, const char *what, uint64_t a, uint64_t b, uint64_t c)
+{
+	if (mismatched < REPORT) fprintf(stderr, "mismatch: %s (%lu, %lu, %lu)\n", what, (unsigned long)a, (unsigned long)b, (unsigned long)c);
+	return mismatched + 1;
+}
+
+// Compare g with the shadow model. Returns the number of mismatches, or UINT64_MAX if out of memory.
+static uint64_t check(const slgraph_t *g, const shadow_t *sh, int sorted)
+{
+	const uint64_t n = slgraph_nodes(g), edges = slgraph_edges(g);
+	uint64_t mismatched = 0, live = 0, listed = 0;
+
+	if (n != sh->nodes) return mismatch(0, "nodes", n, sh->nodes, 0);
+	if (slgraph_removed_nodes(g) != sh->removed_nodes) {
+		mismatched = mismatch(mismatched, "removed nodes", slgraph_removed_nodes(g), sh->removed_nodes, 0);
+	}
+	for (slgraph_edge_t e = 0; e < edges; e++) {
+		if (!slgraph_edge_removed(g, e)) live++;
+	}
+	if (live != sh->count) mismatched = mismatch(mismatched, "live edges", live, sh->count, 0);
+	if (slgraph_removed_edges(g) != edges - live) {
+		mismatched = mismatch(mismatched, "removed edges", slgraph_removed_edges(g), edges - live, 0);
+	}
+
+	// Edge positions are only tracked once something was removed.
+	uint64_t size = 0;
+	const unsigned char *edgepos = slgraph_section(g, "edgepos", &size);
+	if (edgepos && size < edges * 12) mismatched = mismatch(mismatched, "edgepos size", size, edges * 12, 0);
+
+	unsigned char *seen = calloc(edges ? edges : 1, 1);
+	pair_t *pairs = malloc((live ? live : 1) * sizeof(pair_t));
+	pair_t *expected = malloc((sh->count ? sh->count : 1) * sizeof(pair_t));
+	if (!seen || !pairs || !expected) {
+		free(seen);
+		free(pairs);
+		free(expected);
+		return UINT64_MAX;
+	}
+
+	for (slgraph_node_t v = 0; v < n; v++) {
+		if (slgraph_node_removed(g, v) != (sh->removed[v] != 0)) mismatched = mismatch(mismatched, "node removed", v, 0, 0);
+
+		for (int in = 0; in < 2; in++) {
+			uint_fast64_t deg = in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+			slgraph_node_t prev = 0;
+			if (deg && sh->removed[v]) mismatched = mismatch(mismatched, "list of removed node", v, in, deg);
+
+			for (uint_fast64_t i = 0; i < deg; i++) {
+				slgraph_edge_t e = in ? slgraph_in_incident(g, v, i) : slgraph_out_incident(g, v, i);
+				slgraph_node_t src, dst;
+				if (e >= edges || slgraph_edge_removed(g, e) || (seen[e] & (1 << in))) {
+					mismatched = mismatch(mismatched, "listed edge", v, in, e);
+					continue;
+				}
+				seen[e] |= 1 << in;
+				slgraph_edge_ends(g, e, &src, &dst);
+				if ((in ? dst : src) != v) mismatched = mismatch(mismatched, "edge end", v, in, e);
+				if (edgepos && size >= (e + 1) * 12 && slgraph_read48(edgepos + e * 12 + (in ? 6 : 0)) != i) {
+					mismatched = mismatch(mismatched, "edgepos", e, in, slgraph_read48(edgepos + e * 12 + (in ? 6 : 0)));
+				}
+				slgraph_node_t nb = in ? src : dst;
+				if (sorted && i && nb < prev) mismatched = mismatch(mismatched, "order", v, in, i);
+				prev = nb;
+				if (!in && listed < live) pairs[listed++] = (pair_t){src, dst};
+			}
+		}
+	}
+	for (slgraph_edge_t e = 0; e < edges; e++) {
+		if (!slgraph_edge_removed(g, e) && seen[e] != 3) mismatched = mismatch(mismatched, "unlisted edge", e, seen[e], 0);
+	}
+
+	// The same edges, as a multiset of pairs.
+	if (listed == sh->count) {
+		memcpy(expected, sh->edges, sh->count * sizeof(pair_t));
+		qsort(pairs, listed, sizeof(pair_t), pair_cmp);
+		qsort(expected, listed, sizeof(pair_t), pair_cmp);
+		for (uint64_t i = 0; i < listed; i++) {
+			if (pair_cmp(&pairs[i], &expected[i])) {
+				mismatched = mismatch(mismatched, "edge pairs", i, pairs[i].src, pairs[i].dst);
+				break;
+			}
+		}
+	} else {
+		mismatched = mismatch(mismatched, "listed edges", listed, sh->count, 0);
+	}
+
+	free(seen);
+	free(pairs);
+	free(expected);
+	return mismatched;
+}
+
+// Apply ops random operations to g and sh. Returns 0 if successful.
+static int run_ops(slgraph_t *g, shadow_t *sh, rng_t *rng, uint64_t ops)
+{
+	for (uint64_t op = 0; op < ops; op++) {
+		uint64_t kind = rng_range(rng, 10000);
+
+		if (kind < 5500) {
+			slgraph_node_t u = live_node(sh, rng), v = live_node(sh, rng);
+			if (u == SLGRAPH_INVALID_NODE || v == SLGRAPH_INVALID_NODE) continue;
+			if (slgraph_add_directed_edge(g, u, v) == SLGRAPH_INVALID_EDGE || shadow_add(sh, u, v)) return -1;
+		} else if (kind < 9995) {
+			uint64_t edges = slgraph_edges(g);
+			for (int tries = 0; edges && sh->count && tries < 64; tries++) {
+				slgraph_edge_t e = rng_range(rng, edges);
+				if (slgraph_edge_removed(g, e)) continue;
+				slgraph_node_t src, dst;
+				slgraph_edge_ends(g, e, &src, &dst);
+				if (slgraph_remove_edge(g, e) || shadow_remove(sh, src, dst)) return -1;
+				break;
+			}
+		} else {
+			slgraph_node_t v = live_node(sh, rng);
+			if (v == SLGRAPH_INVALID_NODE) continue;
+			if (slgraph_remove_node(g, v)) return -1;
+			shadow_remove_node(sh, v);
+		}
+	}
+	return 0;
+}
+
+static int copy_file(const char *from, const char *to)
+{
+	int in = open(from, O_RDONLY), out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	char buf[65536];
+	ssize_t len = 0;
+	int ret = in == -1 || out == -1 ? -1 : 0;
+
+	while (!ret && (len = read(in, buf, sizeof(buf))) > 0) {
+		if (write(out, buf, len) != len) ret = -1;
+	}
+	if (len < 0) ret = -1;
+	if (in != -1) close(in);
+	if (out != -1) close(out);
+	return ret;
+}
+
+// Undo the in-place changes of the last record in the log of the graph at path, with the bytes of the copy at before,
+// and tear the record if torn is set. Returns 0 if successful.
+static int undo_last_record(const char *path, const char *wal, const char *before, int torn)
+{
+	int walfd = open(wal, O_RDWR), fd = open(path, O_RDWR), beforefd = open(before, O_RDONLY);
+	struct stat st;
+	unsigned char *log = NULL;
+	int ret = walfd == -1 || fd == -1 || beforefd == -1 || fstat(walfd, &st) ? -1 : 0;
+
+	if (!ret && (!st.st_size || !(log = malloc(st.st_size)) || pread(walfd, log, st.st_size, 0) != st.st_size)) ret = -1;
+
+	// Records are a 16-byte header with the number of entries, 16-byte entries and an 8-byte checksum.
+	uint64_t pos = 0, last = UINT64_MAX;
+	while (!ret && pos + 24 <= (uint64_t)st.st_size) {
+		last = pos;
+		pos += 24 + slgraph_read64(log + pos + 8) * 16;
+	}
+	if (!ret && (last == UINT64_MAX || pos != (uint64_t)st.st_size)) ret = -1;
+
+	for (uint64_t i = 0; !ret && i < slgraph_read64(log + last + 8); i++) {
+		const unsigned char *entry = log + last + 16 + i * 16;
+		unsigned char old[8];
+		uint64_t offset = slgraph_read64(entry) & 0xffffffffffffffull;
+		ssize_t len = entry[7];
+		if (pread(beforefd, old, len, offset) != len || pwrite(fd, old, len, offset) != len) ret = -1;
+	}
+	if (!ret && torn && ftruncate(walfd, last + (pos - last) / 2)) ret = -1;
+
+	free(log);
+	if (walfd != -1) close(walfd);
+	if (fd != -1) close(fd);
+	if (beforefd != -1) close(beforefd);
+	return ret;
+}
+
+// Close g, append batches to it in a child process that crashes after the last one, and reopen it. Returns 0 if
+// successful.
+static int crash_append(slgraph_t *g, const char *path, const char *wal, const char *before, shadow_t *sh, rng_t *rng, int torn)
+{
+	slgraph_node_t src[CRASH_BATCHES][CRASH_BATCH], dst[CRASH_BATCHES][CRASH_BATCH];
+	uint64_t nodes[CRASH_BATCHES];
+
+	// Each batch adds two nodes, and edges between nodes that were not removed.
+	uint64_t n = sh->nodes;
+	for (int b = 0; b < CRASH_BATCHES; b++) {
+		nodes[b] = n + 2;
+		for (int i = 0; i < CRASH_BATCH; i++) {
+			do {
+				src[b][i] = rng_range(rng, nodes[b]);
+			} while (src[b][i] < n && sh->removed[src[b][i]]);
+			do {
+				dst[b][i] = rng_range(rng, nodes[b]);
+			} while (dst[b][i] < n && sh->removed[dst[b][i]]);
+		}
+		n = nodes[b];
+	}
+
+	slgraph_close(g);
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) return -1;
+	if (pid == 0) {
+		slgraph_t h;
+		if (slgraph_open_batched(&h, path)) _exit(1);
+		for (int b = 0; b < CRASH_BATCHES; b++) {
+			if (b == CRASH_BATCHES - 1 && copy_file(path, before)) _exit(1);
+			if (slgraph_append_edges(&h, nodes[b], src[b], dst[b], CRASH_BATCH) == SLGRAPH_INVALID_EDGE) _exit(1);
+		}
+		_exit(0);
+	}
+	int status;
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) return -1;
+
+	if (undo_last_record(path, wal, before, torn)) return -1;
+	unlink(before);
+
+	for (int b = 0; b < CRASH_BATCHES - (torn ? 1 : 0); b++) {
+		if (shadow_grow(sh, nodes[b])) return -1;
+		for (int i = 0; i < CRASH_BATCH; i++) {
+			if (shadow_add(sh, src[b][i], dst[b][i])) return -1;
+		}
+	}
+
+	struct stat st;
+	if (slgraph_open(g, path, false)) return -1;
+	return stat(wal, &st) == 0 && st.st_size ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t seed = 1, nodes = 1000, rounds = 16, ops = 4000;
+	int sorted = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		int value = argi + 1 < argc - 1;
+		if (strcmp(argv[argi], "--seed") == 0 && value) {
+			seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--nodes") == 0 && value) {
+			nodes = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--rounds") == 0 && value) {
+			rounds = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--ops") == 0 && value) {
+			ops = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--sorted") == 0) {
+			sorted = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1 || nodes < 2) {
+		fprintf(stderr, "Usage: %s [--seed X] [--nodes N] [--rounds R] [--ops K] [--sorted] <scratch.slg>\n", argv[0]);
+		return 1;
+	}
+
+	const char *path = argv[argi];
+	char *wal = malloc(strlen(path) + 5), *before = malloc(strlen(path) + 8);
+	if (!wal || !before) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	sprintf(wal, "%s.wal", path);
+	sprintf(before, "%s.before", path);
+
+	struct stat st;
+	slgraph_t g;
+	if (stat(path, &st) == 0 && st.st_size > 0) {
+		fprintf(stderr, "Scratch graph exists already: %s\n", path);
+		return 1;
+	}
+	if (slgraph_open(&g, path, false)) {
+		fprintf(stderr, "Failed to create graph: %s\n", path);
+		return 1;
+	}
+
+	shadow_t sh = {0};
+	rng_t rng;
+	rng_seed(&rng, seed);
+	int failed = shadow_grow(&sh, nodes) || slgraph_nodelist_expand(&g, nodes);
+	for (uint64_t v = 0; !failed && v < nodes; v++) {
+		if (slgraph_add_node(&g) == SLGRAPH_INVALID_NODE) failed = 1;
+	}
+	for (uint64_t i = 0; !failed && i < nodes * 4; i++) {
+		slgraph_node_t u = rng_range(&rng, nodes), v = rng_range(&rng, nodes);
+		if (slgraph_add_directed_edge(&g, u, v) == SLGRAPH_INVALID_EDGE || shadow_add(&sh, u, v)) failed = 1;
+	}
+	if (!failed && sorted && slgraph_sort_adjacency(&g)) failed = 1;
+	if (failed) {
+		fprintf(stderr, "Failed to build graph: %s\n", path);
+		slgraph_close(&g);
+		return 1;
+	}
+
+	printf("Stats: nodes=%lu edges=%lu mode=check_remove seed=%lu sorted=%d\n", (unsigned long)slgraph_nodes(&g),
+	       (unsigned long)slgraph_edges(&g), (unsigned long)seed, sorted);
+
+	uint64_t mismatched = 0;
+	for (uint64_t r = 1; r <= rounds && !mismatched; r++) {
+		const char *crash = r % 4 ? "none" : (r / 4) % 2 ? "replayed" : "torn";
+
+		failed = slgraph_set_compaction_threshold(&g, r % 2 ? 0.1 : 1.0) || run_ops(&g, &sh, &rng, ops);
+		if (!failed && r % 2 == 0 && slgraph_compact(&g)) failed = 1;
+		if (!failed) mismatched = check(&g, &sh, sorted);
+		if (!failed && !mismatched && r % 4 == 0) {
+			if (crash_append(&g, path, wal, before, &sh, &rng, (r / 4) % 2 == 0)) {
+				fprintf(stderr, "Failed to append to and reopen %s\n", path);
+				return 1;
+			}
+			mismatched = check(&g, &sh, sorted);
+		}
+		if (failed || mismatched == UINT64_MAX) {
+			fprintf(stderr, "Failed in round %lu\n", (unsigned long)r);
+			slgraph_close(&g);
+			return 1;
+		}
+
+		printf("round=%lu edges=%lu live=%lu removed_edges=%lu removed_nodes=%lu crash=%s\n", (unsigned long)r,
+		       (unsigned long)slgraph_edges(&g), (unsigned long)sh.count, (unsigned long)slgraph_removed_edges(&g),
+		       (unsigned long)slgraph_removed_nodes(&g), crash);
+	}
+
+	printf("check=%s mismatched=%lu\n", mismatched ? "FAILED" : "OK", (unsigned long)mismatched);
+	slgraph_close(&g);
+	if (!mismatched) {
+		unlink(path);
+		unlink(wal);
+	}
+	free(wal);
+	free(before);
+	free(sh.edges);
+	free(sh.removed);
+	return mismatched ? 1 : 0;
+}
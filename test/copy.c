@@ -1,4 +1,5 @@
 // A simple program for copying graphs.
+// Graphs that contain unused space are compacted while copying (in parallel), others are cloned as files.
 
 // Philipp Klaus Krause, philipp@informatik.uni-frankfurt.de, 2017.
 // Copyright (c) 2017 University of Leeds
@@ -17,38 +18,128 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+// FICLONE and copy_file_range() are Linux-specific.
+#define _GNU_SOURCE
+
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
 
 #include "slgraph.h"
 
+// Copy the source file as is: share its blocks if the file system supports reflinks,
+// otherwise copy in the kernel. Returns 0 if successful.
+static int clone_file(const char *source, const char *destination)
+{
+	int ret = -1;
+	struct stat stat;
+	int in = open(source, O_RDONLY);
+	int out = open(destination, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+
+	if(in == -1 || out == -1 || fstat(in, &stat))
+		goto out;
+
+#ifdef __linux__
+#ifdef FICLONE
+	if(!ioctl(out, FICLONE, in))
+	{
+		ret = 0;
+		goto out;
+	}
+#endif
+	for(off_t left = stat.st_size; left > 0;)
+	{
+		ssize_t copied = copy_file_range(in, 0, out, 0, left, 0);
+		if(copied <= 0)
+			goto out;
+		left -= copied;
+	}
+	ret = 0;
+#endif
+
+out:
+	if(in != -1)
+		close(in);
+	if(out != -1)
+		close(out);
+	return(ret);
+}
+
 int main(int argc, char **argv)
 {
 	slgraph_t source, destination;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	bool clone = false, compact = false;
+	int argi = 1;
 
-	if(argc != 3)
+	for(; argi < argc - 2; argi++)
 	{
-		fprintf(stderr, "Usage: slgrapg_copy <source> <destination>\n");
+		if(!strcmp(argv[argi], "--threads") && argi + 1 < argc - 2)
+			threads = atol(argv[++argi]);
+		else if(!strcmp(argv[argi], "--clone"))
+			clone = true;
+		else if(!strcmp(argv[argi], "--compact"))
+			compact = true;
+		else
+			break;
+	}
+
+	if(argi != argc - 2 || (clone && compact))
+	{
+		fprintf(stderr, "Usage: slgraph_copy [--threads N] [--clone | --compact] <source> <destination>\n");
 		return(-1);
 	}
 
-	if(slgraph_open(&source, argv[1], true))
+	if(threads < 1)
+		threads = 1;
+
+	if(slgraph_open(&source, argv[argi], true))
 	{
-		printf("Failed to open source graph file %s.\n", argv[1]);
+		printf("Failed to open source graph file %s.\n", argv[argi]);
 		return(-1);
 	}
 
-	if(slgraph_open(&destination, argv[2], false))
+	// A source without unused space has the same layout as its compacted copy, so the file can be cloned.
+	if(!compact && (clone || slgraph_copy_size(&source, threads) == source.size))
 	{
-		printf("Failed to open destination graph file %s.\n", argv[2]);
+		slgraph_close(&source);
+		if(!clone_file(argv[argi], argv[argi + 1]))
+			return(0);
+		if(clone)
+		{
+			printf("Failed to clone %s to %s.\n", argv[argi], argv[argi + 1]);
+			return(-1);
+		}
+		if(slgraph_open(&source, argv[argi], true))
+		{
+			printf("Failed to open source graph file %s.\n", argv[argi]);
+			return(-1);
+		}
+	}
+
+	if(slgraph_open(&destination, argv[argi + 1], false))
+	{
+		printf("Failed to open destination graph file %s.\n", argv[argi + 1]);
+		slgraph_close(&source);
 		return(-1);
 	}
 
-	slgraph_copy(&destination, &source);
+	int ret = slgraph_copy_threads(&destination, &source, threads);
 
 	slgraph_close(&source);
 	slgraph_close(&destination);
 
-	return(0);
-}
+	if(ret)
+		printf("Failed to copy %s to %s.\n", argv[argi], argv[argi + 1]);
 
+	return(ret);
+}
@@ -0,0 +1,590 @@
+// Graph query daemon: keeps SLGraphs open and warm, and serves degree, neighbour, sampling, bounded BFS and tester
+// requests over a Unix socket, so that scripts and clients share one hot copy of the graph instead of reopening it for
+// every query. See slgraphd.h for the protocol.
+//
+// Usage:
+//   slgraphd [--threads T] [--warm] <socket> <graph.slg>...
+//
+// Graphs are numbered from 0 in command line order. One thread reads the requests of all clients and hands them to T
+// worker threads (default: one per CPU), which never block on a slow client: responses its socket has no room for are
+// queued, and sent by the reading thread. --warm reads every page of the graphs at startup; otherwise the kernel is only
+// advised to read them ahead. SIGINT and SIGTERM stop the daemon and remove the socket.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "slgraph.h"
+#include "slgraphd.h"
+#include "sc_testers.h"
+
+#define PIPELINE 256            // Requests of one client in flight before the daemon stops reading from it
+#define OUTLIMIT (4 * 1024 * 1024) // Unsent response bytes of one client before the daemon stops reading from it
+#define READSIZE (64 * 1024)
+
+typedef struct {
+	int fd;
+	pthread_mutex_t out_lock;
+	atomic_uint refs;       // Held by the reading thread until the connection is done, and by each request in flight
+	atomic_uint inflight;
+	atomic_int reading;     // Cleared when the client stops sending; its requests in flight are still answered
+	unsigned char *in;      // Bytes read but not yet handed out as requests
+	size_t in_len, in_cap;
+	unsigned char *out;     // Responses the socket had no room for, sent by the reading thread when it has
+	size_t out_len, out_cap;
+	int failed;             // Sending failed, so responses are dropped
+} conn_t;
+
+typedef struct job {
+	conn_t *conn;
+	struct job *next;
+	uint32_t size;          // Of the request, including the header
+	unsigned char req[];
+} job_t;
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	job_t *head, *tail;
+	int stop;
+} jobs = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0};
+
+// Scratch space of a worker thread, grown as needed.
+typedef struct {
+	pthread_t thread;
+	sc_scratch_t scratch;
+	unsigned char *out;     // Response
+	size_t out_len, out_cap;
+} worker_t;
+
+static slgraph_t *graphs;
+static unsigned graph_count;
+static volatile sig_atomic_t stopping;
+static int wakeup[2];   // Pipe the signal handler and workers write to, waking up poll()
+
+static void wake_reader(void)
+{
+	if (write(wakeup[1], "", 1) < 0) {
+		// Nothing to do: the pipe is full, so poll() returns anyway.
+	}
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stopping = 1;
+	wake_reader();
+}
+
+static void conn_put(conn_t *c)
+{
+	if (atomic_fetch_sub(&c->refs, 1) == 1) {
+		close(c->fd);
+		pthread_mutex_destroy(&c->out_lock);
+		free(c->in);
+		free(c->out);
+		free(c);
+	}
+}
+
+// Send as much of buf as the socket takes without blocking. Returns the number of bytes sent, and sets c->failed if
+// the client went away.
+static size_t conn_send(conn_t *c, const unsigned char *buf, size_t len)
+{
+	size_t sent = 0;
+
+	while (!c->failed && sent < len) {
+		ssize_t r = send(c->fd, buf + sent, len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (r < 0 && errno == EINTR) continue;
+		if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		if (r <= 0) c->failed = 1;
+		else sent += (size_t)r;
+	}
+	return sent;
+}
+
+// Get the number of unsent response bytes of c, or SIZE_MAX if sending failed.
+static size_t conn_pending(conn_t *c)
+{
+	pthread_mutex_lock(&c->out_lock);
+	size_t pending = c->failed ? SIZE_MAX : c->out_len;
+	pthread_mutex_unlock(&c->out_lock);
+	return pending;
+}
+
+// Send queued responses while the socket has room.
+static void conn_flush(conn_t *c)
+{
+	pthread_mutex_lock(&c->out_lock);
+	size_t sent = conn_send(c, c->out, c->out_len);
+	memmove(c->out, c->out + sent, c->out_len - sent);
+	c->out_len = c->failed ? 0 : c->out_len - sent;
+	pthread_mutex_unlock(&c->out_lock);
+}
+
+static int out_reserve(worker_t *w, size_t bytes)
+{
+	if (w->out_len + bytes <= w->out_cap) return 0;
+	size_t cap = w->out_cap ? w->out_cap : 4096;
+	while (cap < w->out_len + bytes) cap *= 2;
+	unsigned char *out = realloc(w->out, cap);
+	if (!out) return -1;
+	w->out = out;
+	w->out_cap = cap;
+	return 0;
+}
+
+// Append a result; space must have been reserved.
+static void out_u64(worker_t *w, uint64_t v)
+{
+	slgraphd_put64(w->out + w->out_len, v);
+	w->out_len += 8;
+}
+
+// Run a tester and append its result line.
+static uint32_t run_tester(worker_t *w, const slgraph_t *g, uint64_t tester, double eps, uint64_t d, uint64_t seed)
+{
+	char line[256];
+
+	switch (tester > SC_CLASSICAL ? SC_EARGS : sc_run_tester(&w->scratch, g, (int)tester, eps, d, seed, line, sizeof(line))) {
+	case SC_OK:
+		break;
+	case SC_ENOMEM:
+		return SLGRAPHD_ENOMEM;
+	case SC_ESUMMARY:
+		return SLGRAPHD_ESUMMARY;
+	default:
+		return SLGRAPHD_EREQUEST;
+	}
+
+	size_t len = strlen(line);
+	if (out_reserve(w, len)) return SLGRAPHD_ENOMEM;
+	memcpy(w->out + w->out_len, line, len);
+	w->out_len += len;
+	return SLGRAPHD_OK;
+}
+
+// Execute the request req of size bytes and append its results. Returns the status.
+static uint32_t execute(worker_t *w, const unsigned char *req, uint32_t size)
+{
+	unsigned op = req[8];
+	uint64_t argc = (size - SLGRAPHD_HEADERSIZE) / 8;
+	const unsigned char *args = req + SLGRAPHD_HEADERSIZE;
+
+	if ((size - SLGRAPHD_HEADERSIZE) % 8) return SLGRAPHD_EREQUEST;
+	if (req[9] >= graph_count) return SLGRAPHD_EGRAPH;
+
+	const slgraph_t *g = &graphs[req[9]];
+	uint64_t n = slgraph_nodes(g);
+#define ARG(i) slgraphd_get64(args + 8 * (i))
+
+	switch (op) {
+	case SLGRAPHD_INFO:
+		if (argc != 0) return SLGRAPHD_EREQUEST;
+		if (out_reserve(w, 3 * 8)) return SLGRAPHD_ENOMEM;
+		out_u64(w, n);
+		out_u64(w, slgraph_edges(g));
+		out_u64(w, g->version);
+		return SLGRAPHD_OK;
+
+	case SLGRAPHD_DEGREE:
+		if (argc < 1 || ARG(0) > SLGRAPHD_IN) return SLGRAPHD_EREQUEST;
+		for (uint64_t i = 1; i < argc; i++) {
+			if (ARG(i) >= n) return SLGRAPHD_EREQUEST;
+		}
+		if (out_reserve(w, (argc - 1) * 8)) return SLGRAPHD_ENOMEM;
+		for (uint64_t i = 1; i < argc; i++) {
+			out_u64(w, ARG(0) == SLGRAPHD_IN ? slgraph_in_degree(g, ARG(i)) : slgraph_out_degree(g, ARG(i)));
+		}
+		return SLGRAPHD_OK;
+
+	case SLGRAPHD_NEIGHBOURS: {
+		if (argc != 4 || ARG(0) > SLGRAPHD_IN || ARG(1) >= n) return SLGRAPHD_EREQUEST;
+		slgraph_node_t v = ARG(1);
+		uint_fast64_t deg = ARG(0) == SLGRAPHD_IN ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+		uint64_t first = ARG(2) < deg ? ARG(2) : deg;
+		uint64_t count = deg - first < ARG(3) ? deg - first : ARG(3);
+		if (count > SLGRAPHD_MAXRESULTS) count = SLGRAPHD_MAXRESULTS;
+		if (out_reserve(w, count * 8)) return SLGRAPHD_ENOMEM;
+		for (uint64_t i = first; i < first + count; i++) {
+			out_u64(w, ARG(0) == SLGRAPHD_IN ? slgraph_in_neighbour(g, v, i) : slgraph_out_neighbour(g, v, i));
+		}
+		return SLGRAPHD_OK;
+	}
+
+	case SLGRAPHD_SAMPLE: {
+		if (argc != 2 || n == 0 || ARG(1) > SLGRAPHD_MAXRESULTS) return SLGRAPHD_EREQUEST;
+		slgraph_node_t *nodes = malloc((ARG(1) ? ARG(1) : 1) * sizeof(slgraph_node_t));
+		if (!nodes || out_reserve(w, ARG(1) * 8)) {
+			free(nodes);
+			return SLGRAPHD_ENOMEM;
+		}
+		sc_sample(g, ARG(0), ARG(1), nodes);
+		for (uint64_t i = 0; i < ARG(1); i++) {
+			out_u64(w, nodes[i]);
+		}
+		free(nodes);
+		return SLGRAPHD_OK;
+	}
+
+	case SLGRAPHD_BFS: {
+		if (argc != 3 || ARG(0) > SLGRAPHD_IN || ARG(1) >= n) return SLGRAPHD_EREQUEST;
+		uint64_t visited = sc_bfs_cutoff(&w->scratch, g, ARG(1), ARG(2), ARG(0) == SLGRAPHD_IN);
+		if (visited == UINT64_MAX || out_reserve(w, 8)) return SLGRAPHD_ENOMEM;
+		out_u64(w, visited);
+		return SLGRAPHD_OK;
+	}
+
+	case SLGRAPHD_TESTER: {
+		if (argc != 4) return SLGRAPHD_EREQUEST;
+		double eps;
+		uint64_t bits = ARG(1);
+		memcpy(&eps, &bits, sizeof(eps));
+		return run_tester(w, g, ARG(0), eps, ARG(2), ARG(3));
+	}
+	}
+#undef ARG
+
+	return SLGRAPHD_EREQUEST;
+}
+
+// Send a response, and queue what the socket has no room for. Workers never block on a client that doesn't read its
+// responses; the reading thread sends the queue when the socket has room again.
+static void respond(conn_t *c, const unsigned char *buf, size_t len)
+{
+	pthread_mutex_lock(&c->out_lock);
+	int queued = c->out_len > 0, failed = c->failed;
+	size_t sent = queued ? 0 : conn_send(c, buf, len);
+	if (!c->failed && sent < len) {
+		if (c->out_cap - c->out_len < len - sent) {
+			size_t cap = c->out_cap ? c->out_cap : 4096;
+			while (cap - c->out_len < len - sent) cap *= 2;
+			unsigned char *out = realloc(c->out, cap);
+			if (out) {
+				c->out = out;
+				c->out_cap = cap;
+			} else {
+				c->failed = 1;
+			}
+		}
+		if (!c->failed) {
+			memcpy(c->out + c->out_len, buf + sent, len - sent);
+			c->out_len += len - sent;
+		}
+	}
+	// The reading thread has to poll for room, or drop the connection.
+	int wake = (!queued && c->out_len > 0) || (!failed && c->failed);
+	pthread_mutex_unlock(&c->out_lock);
+	if (wake) wake_reader();
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+
+	for (;;) {
+		pthread_mutex_lock(&jobs.lock);
+		while (!jobs.head && !jobs.stop) {
+			pthread_cond_wait(&jobs.ready, &jobs.lock);
+		}
+		job_t *job = jobs.head;
+		if (job) {
+			jobs.head = job->next;
+			if (!jobs.head) jobs.tail = NULL;
+		}
+		pthread_mutex_unlock(&jobs.lock);
+		if (!job) break;
+
+		// On failure, the response is just the header with the status.
+		uint32_t status = SLGRAPHD_ENOMEM;
+		unsigned char header[SLGRAPHD_HEADERSIZE];
+		w->out_len = 0;
+		if (!out_reserve(w, SLGRAPHD_HEADERSIZE)) {
+			w->out_len = SLGRAPHD_HEADERSIZE;
+			status = execute(w, job->req, job->size);
+		}
+		if (status != SLGRAPHD_OK) {
+			w->out_len = SLGRAPHD_HEADERSIZE;
+		}
+		unsigned char *out = status == SLGRAPHD_ENOMEM ? header : w->out;
+		slgraphd_put32(out, (uint32_t)(w->out_len - 4));
+		memcpy(out + 4, job->req + 4, 4);
+		slgraphd_put32(out + 8, status);
+		respond(job->conn, out, w->out_len);
+
+		// A client that stopped sending is closed once its last response is out.
+		if (atomic_fetch_sub(&job->conn->inflight, 1) == 1 && !atomic_load(&job->conn->reading)) wake_reader();
+		conn_put(job->conn);
+		free(job);
+	}
+
+	return NULL;
+}
+
+// Read what the client sent. Returns -1 if the client stopped sending or reading failed.
+static int conn_read(conn_t *c)
+{
+	if (c->in_cap - c->in_len < READSIZE) {
+		unsigned char *in = realloc(c->in, c->in_len + READSIZE);
+		if (!in) return -1;
+		c->in = in;
+		c->in_cap = c->in_len + READSIZE;
+	}
+
+	ssize_t r = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+	if (r < 0 && errno == EINTR) return 0;
+	if (r <= 0) return -1;
+	c->in_len += (size_t)r;
+	return 0;
+}
+
+// Check whether a complete request of c waits to be queued.
+static int conn_waiting(const conn_t *c)
+{
+	return c->in_len >= 4 && c->in_len - 4 >= slgraphd_get32(c->in);
+}
+
+// Queue the complete requests of c while it has fewer than PIPELINE in flight and at most OUTLIMIT bytes of responses
+// unsent. Returns -1 on a malformed request or if out of memory.
+static int conn_dispatch(conn_t *c)
+{
+	size_t pos = 0;
+	while (c->in_len - pos >= 4 && atomic_load(&c->inflight) < PIPELINE && conn_pending(c) <= OUTLIMIT) {
+		uint32_t size = slgraphd_get32(c->in + pos) + 4;
+		if (size < SLGRAPHD_HEADERSIZE || size > SLGRAPHD_MAXREQUEST) return -1;
+		if (c->in_len - pos < size) break;
+
+		job_t *job = malloc(sizeof(job_t) + size);
+		if (!job) return -1;
+		job->conn = c;
+		job->next = NULL;
+		job->size = size;
+		memcpy(job->req, c->in + pos, size);
+		pos += size;
+
+		atomic_fetch_add(&c->refs, 1);
+		atomic_fetch_add(&c->inflight, 1);
+		pthread_mutex_lock(&jobs.lock);
+		if (jobs.tail) jobs.tail->next = job;
+		else jobs.head = job;
+		jobs.tail = job;
+		pthread_cond_signal(&jobs.ready);
+		pthread_mutex_unlock(&jobs.lock);
+	}
+
+	memmove(c->in, c->in + pos, c->in_len - pos);
+	c->in_len -= pos;
+	return 0;
+}
+
+// Read every page of g, or advise the kernel to read it ahead.
+static uint64_t warm(const slgraph_t *g, int touch)
+{
+	volatile unsigned char sum = 0;
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (!g->ptr) return 0;
+	posix_madvise(g->ptr, g->size, POSIX_MADV_WILLNEED);
+	for (size_t i = 0; touch && i < g->size; i += (size_t)page) {
+		sum += g->ptr[i];
+	}
+	(void)sum;
+	return touch ? g->size : 0;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int touch = 0;
+	int argi = 1;
+
+	for (; argi < argc; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc) {
+			threads = strtol(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--warm") == 0) {
+			touch = 1;
+		} else {
+			break;
+		}
+	}
+	if (argc - argi < 2 || argc - argi - 1 > 256 || threads < 1) {
+		fprintf(stderr, "Usage: %s [--threads T] [--warm] <socket> <graph.slg>... (at most 256 graphs)\n", argv[0]);
+		return 1;
+	}
+
+	const char *path = argv[argi++];
+	graph_count = (unsigned)(argc - argi);
+	graphs = calloc(graph_count, sizeof(slgraph_t));
+	worker_t *workers = calloc((size_t)threads, sizeof(worker_t));
+	if (!graphs || !workers) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for (unsigned i = 0; i < graph_count; i++) {
+		if (slgraph_open(&graphs[i], argv[argi + i], true)) {
+			fprintf(stderr, "Failed to open graph: %s\n", argv[argi + i]);
+			while (i--) slgraph_close(&graphs[i]);
+			return 1;
+		}
+		uint64_t warmed = warm(&graphs[i], touch);
+		fprintf(stderr, "graph %u: %s nodes=%lu edges=%lu warmed=%luMiB\n", i, argv[argi + i],
+		        (unsigned long)slgraph_nodes(&graphs[i]), (unsigned long)slgraph_edges(&graphs[i]),
+		        (unsigned long)(warmed >> 20));
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return 1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path);
+	if (pipe(wakeup) || fcntl(wakeup[0], F_SETFL, O_NONBLOCK) || fcntl(wakeup[1], F_SETFL, O_NONBLOCK) || listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) || listen(listener, 128)) {
+		fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	// Workers leave the signals to the reading thread, whose poll() they interrupt.
+	sigset_t signals, old;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, &old);
+	for (long i = 0; i < threads; i++) {
+		if (pthread_create(&workers[i].thread, NULL, worker, &workers[i])) {
+			fprintf(stderr, "Failed to start worker threads\n");
+			return 1;
+		}
+	}
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	fprintf(stderr, "slgraphd: serving %u graphs on %s with %ld threads\n", graph_count, path, threads);
+
+	conn_t **conns = NULL;
+	struct pollfd *fds = NULL;
+	size_t nconns = 0, cap = 0;
+
+	while (!stopping) {
+		if (nconns + 1 > cap) {
+			cap = cap ? cap * 2 : 16;
+			conn_t **c = realloc(conns, cap * sizeof(conn_t *));
+			if (c) conns = c;
+			struct pollfd *f = realloc(fds, (cap + 2) * sizeof(struct pollfd));
+			if (f) fds = f;
+			if (!c || !f) {
+				fprintf(stderr, "Out of memory for connections\n");
+				break;
+			}
+		}
+
+		// Clients with PIPELINE requests in flight or OUTLIMIT bytes of responses unsent aren't read from until some
+		// complete or are sent, and neither are clients with requests still to be queued.
+		int throttled = 0;
+		fds[0] = (struct pollfd){listener, POLLIN, 0};
+		fds[1] = (struct pollfd){wakeup[0], POLLIN, 0};
+		for (size_t i = 0; i < nconns; i++) {
+			int full = atomic_load(&conns[i]->inflight) >= PIPELINE, waiting = conn_waiting(conns[i]);
+			size_t pending = conn_pending(conns[i]);
+			throttled |= full || waiting;
+			short events = atomic_load(&conns[i]->reading) && !full && !waiting && pending <= OUTLIMIT ? POLLIN : 0;
+			if (pending) events |= POLLOUT;
+			fds[i + 2] = (struct pollfd){conns[i]->fd, events, 0};
+		}
+
+		if (poll(fds, nconns + 2, throttled ? 1 : -1) < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "poll failed: %s\n", strerror(errno));
+			break;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			char buf[64];
+			while (read(wakeup[0], buf, sizeof(buf)) > 0) {
+			}
+		}
+
+		for (size_t i = nconns; i > 0; i--) {
+			conn_t *c = conns[i - 1];
+			short revents = fds[i + 1].revents;
+			if ((revents & POLLIN) && conn_read(c)) {
+				// The client stopped sending: answer the requests in flight, then close.
+				shutdown(c->fd, SHUT_RD);
+				atomic_store(&c->reading, 0);
+			}
+			if (revents & POLLOUT) conn_flush(c);
+
+			// Closed or failed: requests in flight still hold the connection, and are answered into the void.
+			int gone = conn_dispatch(c) || (revents & (POLLERR | POLLNVAL)) || ((revents & POLLHUP) && !(revents & POLLIN));
+			size_t pending = conn_pending(c);
+			int done = !atomic_load(&c->reading) && !atomic_load(&c->inflight) && !pending && !conn_waiting(c);
+			if (!gone && !done && pending != SIZE_MAX) continue;
+			shutdown(c->fd, SHUT_RDWR);
+			conn_put(c);
+			conns[i - 1] = conns[--nconns];
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(listener, NULL, NULL);
+			conn_t *c = fd >= 0 ? calloc(1, sizeof(conn_t)) : NULL;
+			if (c) {
+				c->fd = fd;
+				pthread_mutex_init(&c->out_lock, NULL);
+				atomic_init(&c->refs, 1);
+				atomic_init(&c->inflight, 0);
+				atomic_init(&c->reading, 1);
+				conns[nconns++] = c;
+			} else if (fd >= 0) {
+				close(fd);
+			}
+		}
+	}
+
+	close(listener);
+	unlink(path);
+	close(wakeup[0]);
+	close(wakeup[1]);
+
+	pthread_mutex_lock(&jobs.lock);
+	jobs.stop = 1;
+	pthread_cond_broadcast(&jobs.ready);
+	pthread_mutex_unlock(&jobs.lock);
+	for (long i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		sc_scratch_free(&workers[i].scratch);
+		free(workers[i].out);
+	}
+
+	for (size_t i = 0; i < nconns; i++) {
+		conn_put(conns[i]);
+	}
+	for (unsigned i = 0; i < graph_count; i++) {
+		slgraph_close(&graphs[i]);
+	}
+	free(conns);
+	free(fds);
+	free(workers);
+	free(graphs);
+	return 0;
+}
@@ -0,0 +1,307 @@
+// Load generator for slgraphd: C clients each keep P requests in flight on their own connection, and the throughput
+// and latency percentiles over all requests are reported.
+//
+// Usage:
+//   slgraphd_bench [--clients C] [--depth P] [--requests N] [--op OP] [--batch K] [--cutoff L] [--graph I] <socket>
+//
+// OP is degree (K random nodes per request, default), neighbours (up to K out-neighbours of a random node), sample
+// (K random nodes), bfs (BFS from a random node with cutoff L, default 64), tester (basic tester, eps 0.05, d 8, a new
+// seed per request) or info. Each client sends N requests (default 100000). Latency is measured from sending a
+// request to receiving its response, so with P > 1 it includes queueing behind the client's other requests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "slgraphd.h"
+
+typedef struct {
+	pthread_t thread;
+	const char *path;
+	unsigned op;
+	unsigned graph;
+	uint64_t requests;
+	uint64_t depth;
+	uint64_t batch;
+	uint64_t cutoff;
+	uint64_t seed;
+	uint64_t *latency;   // Nanoseconds, per request
+	uint64_t errors;
+	int failed;
+} client_t;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t xorshift(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static int write_all(int fd, const unsigned char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t r = write(fd, buf, len);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return -1;
+		buf += r;
+		len -= (size_t)r;
+	}
+	return 0;
+}
+
+// Build the request number seq with tag into buf. Returns its size.
+static size_t build(client_t *c, unsigned char *buf, uint32_t tag, uint64_t seq, uint64_t nodes, uint64_t *rng)
+{
+	uint64_t args[512];
+	size_t argc = 0;
+	unsigned op = c->op;
+
+	switch (op) {
+	case SLGRAPHD_DEGREE:
+		args[argc++] = SLGRAPHD_OUT;
+		for (uint64_t i = 0; i < c->batch; i++) args[argc++] = xorshift(rng) % nodes;
+		break;
+	case SLGRAPHD_NEIGHBOURS:
+		args[argc++] = SLGRAPHD_OUT;
+		args[argc++] = xorshift(rng) % nodes;
+		args[argc++] = 0;
+		args[argc++] = c->batch;
+		break;
+	case SLGRAPHD_SAMPLE:
+		args[argc++] = xorshift(rng);
+		args[argc++] = c->batch;
+		break;
+	case SLGRAPHD_BFS:
+		args[argc++] = SLGRAPHD_OUT;
+		args[argc++] = xorshift(rng) % nodes;
+		args[argc++] = c->cutoff;
+		break;
+	case SLGRAPHD_TESTER: {
+		double eps = 0.05;
+		args[argc++] = SLGRAPHD_BASIC;
+		memcpy(&args[argc++], &eps, sizeof(eps));
+		args[argc++] = 8;
+		args[argc++] = c->seed * c->requests + seq;
+		break;
+	}
+	}
+
+	size_t size = SLGRAPHD_HEADERSIZE + argc * 8;
+	slgraphd_put32(buf, (uint32_t)(size - 4));
+	slgraphd_put32(buf + 4, tag);
+	buf[8] = (unsigned char)op;
+	buf[9] = (unsigned char)c->graph;
+	buf[10] = buf[11] = 0;
+	for (size_t i = 0; i < argc; i++) slgraphd_put64(buf + SLGRAPHD_HEADERSIZE + 8 * i, args[i]);
+	return size;
+}
+
+// Read one response into *buf (grown as needed). Returns its size, or 0 on error.
+static size_t read_response(int fd, unsigned char **buf, size_t *cap, unsigned char *in, size_t *in_len, size_t in_cap)
+{
+	for (;;) {
+		if (*in_len >= 4) {
+			size_t size = slgraphd_get32(in) + 4;
+			if (size < SLGRAPHD_HEADERSIZE) return 0;
+			if (size > *cap) {
+				unsigned char *b = realloc(*buf, size);
+				if (!b) return 0;
+				*buf = b;
+				*cap = size;
+			}
+			if (*in_len >= size) {
+				memcpy(*buf, in, size);
+				memmove(in, in + size, *in_len - size);
+				*in_len -= size;
+				return size;
+			}
+			if (size > in_cap) {
+				// Larger than the read buffer: copy what we have and read the rest directly.
+				size_t have = *in_len;
+				memcpy(*buf, in, have);
+				*in_len = 0;
+				while (have < size) {
+					ssize_t r = read(fd, *buf + have, size - have);
+					if (r < 0 && errno == EINTR) continue;
+					if (r <= 0) return 0;
+					have += (size_t)r;
+				}
+				return size;
+			}
+		}
+		ssize_t r = read(fd, in + *in_len, in_cap - *in_len);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return 0;
+		*in_len += (size_t)r;
+	}
+}
+
+static void *client(void *arg)
+{
+	client_t *c = arg;
+	struct sockaddr_un addr;
+	unsigned char req[SLGRAPHD_HEADERSIZE + 512 * 8];
+	unsigned char in[64 * 1024];
+	size_t in_len = 0, cap = 0;
+	unsigned char *resp = NULL;
+	uint64_t *sent = malloc(c->depth * sizeof(uint64_t));
+	uint32_t *free_tags = malloc(c->depth * sizeof(uint32_t));
+	uint64_t rng = c->seed * 0x9e3779b97f4a7c15ull + 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, c->path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (!sent || !free_tags || fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		c->failed = 1;
+		goto done;
+	}
+
+	// Ask for the number of nodes to draw nodes from.
+	slgraphd_put32(req, SLGRAPHD_HEADERSIZE - 4);
+	slgraphd_put32(req + 4, 0);
+	req[8] = SLGRAPHD_INFO;
+	req[9] = (unsigned char)c->graph;
+	req[10] = req[11] = 0;
+	if (write_all(fd, req, SLGRAPHD_HEADERSIZE) || read_response(fd, &resp, &cap, in, &in_len, sizeof(in)) != SLGRAPHD_HEADERSIZE + 3 * 8
+	    || slgraphd_get32(resp + 8) != SLGRAPHD_OK || slgraphd_get64(resp + SLGRAPHD_HEADERSIZE) == 0) {
+		c->failed = 1;
+		goto done;
+	}
+	uint64_t nodes = slgraphd_get64(resp + SLGRAPHD_HEADERSIZE);
+
+	// Tags are slots of requests in flight, sent[tag] their send time. Responses arrive in any order.
+	uint64_t next = 0, received = 0, free_count = c->depth;
+	for (uint64_t i = 0; i < c->depth; i++) free_tags[i] = (uint32_t)i;
+	while (received < c->requests) {
+		while (next < c->requests && free_count) {
+			uint32_t tag = free_tags[--free_count];
+			size_t size = build(c, req, tag, next, nodes, &rng);
+			sent[tag] = now_ns();
+			if (write_all(fd, req, size)) {
+				c->failed = 1;
+				goto done;
+			}
+			next++;
+		}
+
+		if (!read_response(fd, &resp, &cap, in, &in_len, sizeof(in))) {
+			c->failed = 1;
+			goto done;
+		}
+		uint32_t tag = slgraphd_get32(resp + 4);
+		if (tag >= c->depth) {
+			c->failed = 1;
+			goto done;
+		}
+		c->latency[received++] = now_ns() - sent[tag];
+		free_tags[free_count++] = tag;
+		c->errors += slgraphd_get32(resp + 8) != SLGRAPHD_OK;
+	}
+
+done:
+	if (fd >= 0) close(fd);
+	free(sent);
+	free(free_tags);
+	free(resp);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t clients = 4, depth = 16, requests = 100000, batch = 16, cutoff = 64, graph = 0;
+	const char *op = "degree";
+	int argi = 1;
+
+	for (; argi < argc - 1; argi += 2) {
+		if (strcmp(argv[argi], "--clients") == 0) clients = strtoull(argv[argi + 1], NULL, 10);
+		else if (strcmp(argv[argi], "--depth") == 0) depth = strtoull(argv[argi + 1], NULL, 10);
+		else if (strcmp(argv[argi], "--requests") == 0) requests = strtoull(argv[argi + 1], NULL, 10);
+		else if (strcmp(argv[argi], "--op") == 0) op = argv[argi + 1];
+		else if (strcmp(argv[argi], "--batch") == 0) batch = strtoull(argv[argi + 1], NULL, 10);
+		else if (strcmp(argv[argi], "--cutoff") == 0) cutoff = strtoull(argv[argi + 1], NULL, 10);
+		else if (strcmp(argv[argi], "--graph") == 0) graph = strtoull(argv[argi + 1], NULL, 10);
+		else break;
+	}
+
+	unsigned opcode = strcmp(op, "degree") == 0 ? SLGRAPHD_DEGREE
+	                : strcmp(op, "neighbours") == 0 ? SLGRAPHD_NEIGHBOURS
+	                : strcmp(op, "sample") == 0 ? SLGRAPHD_SAMPLE
+	                : strcmp(op, "bfs") == 0 ? SLGRAPHD_BFS
+	                : strcmp(op, "tester") == 0 ? SLGRAPHD_TESTER
+	                : strcmp(op, "info") == 0 ? SLGRAPHD_INFO : 0;
+	if (argi != argc - 1 || !opcode || !clients || !depth || !requests || batch > 500 || graph > 255) {
+		fprintf(stderr, "Usage: %s [--clients C] [--depth P] [--requests N] [--op degree|neighbours|sample|bfs|tester|info] [--batch K] [--cutoff L] [--graph I] <socket>\n", argv[0]);
+		return 1;
+	}
+
+	client_t *c = calloc(clients, sizeof(client_t));
+	uint64_t *latency = malloc(clients * requests * sizeof(uint64_t));
+	if (!c || !latency) {
+		fprintf(stderr, "Out of memory for %lu requests\n", (unsigned long)(clients * requests));
+		return 1;
+	}
+
+	uint64_t start = now_ns();
+	for (uint64_t i = 0; i < clients; i++) {
+		c[i] = (client_t){.path = argv[argi], .op = opcode, .graph = (unsigned)graph, .requests = requests, .depth = depth,
+		                  .batch = batch, .cutoff = cutoff, .seed = i + 1, .latency = latency + i * requests};
+		if (pthread_create(&c[i].thread, NULL, client, &c[i])) {
+			fprintf(stderr, "Failed to start client threads\n");
+			return 1;
+		}
+	}
+
+	uint64_t errors = 0;
+	int failed = 0;
+	for (uint64_t i = 0; i < clients; i++) {
+		pthread_join(c[i].thread, NULL);
+		errors += c[i].errors;
+		failed |= c[i].failed;
+	}
+	double seconds = (double)(now_ns() - start) / 1e9;
+
+	if (failed) {
+		fprintf(stderr, "Lost the connection to slgraphd at %s\n", argv[argi]);
+		free(c);
+		free(latency);
+		return 1;
+	}
+
+	uint64_t total = clients * requests;
+	qsort(latency, total, sizeof(uint64_t), cmp_u64);
+
+	printf("Stats: clients=%lu depth=%lu requests=%lu op=%s errors=%lu\n", (unsigned long)clients, (unsigned long)depth,
+	       (unsigned long)total, op, (unsigned long)errors);
+	printf("seconds=%.3f qps=%.0f\n", seconds, (double)total / seconds);
+	printf("latency_us p50=%.1f p90=%.1f p99=%.1f p999=%.1f max=%.1f\n", latency[total / 2] / 1e3,
+	       latency[total * 9 / 10] / 1e3, latency[total * 99 / 100] / 1e3, latency[total * 999 / 1000] / 1e3,
+	       latency[total - 1] / 1e3);
+
+	free(c);
+	free(latency);
+	return errors ? 1 : 0;
+}
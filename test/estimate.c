@@ -0,0 +1,665 @@
+// Estimate the average out-degree, the fraction of nodes in small strongly connected, sink and source components, and
+// the number of strongly connected components of a directed SLGraph from a sample of its nodes, without reading all of
+// it.
+//
+// Usage:
+//   slgraph_estimate [--threads N] [--eps E] [--confidence C] [--samples M] [--size L] [--budget B] [--seed S] [--check] <graph.slg>
+//
+// M nodes (default 2 ln(2 / (1 - C)) / E^2, enough for +-E/2 by Hoeffding's bound, with E = 0.05 and C = 0.95) are
+// drawn with the random number generator of the testers. Small components are those of at most L nodes (default 2 /
+// E). From every sampled node v, a forward and a backward search run until they have reached B nodes (default 4L).
+// The nodes that reach v and that v reaches over the edges they followed are in the component of v. If one of the
+// searches stops before B nodes, it has found all nodes v reaches (or that reach v), and these are exactly the
+// component, which is a sink if the forward search found nothing else, and a source if the backward one did not.
+// Otherwise they give a lower bound on its size.
+//
+// The number of components is n times the mean of 1 / size. Samples without an exact size count 0 in the estimate and
+// 1 / their lower bound in the upper end of its interval; the interval also allows for the components of more than L
+// nodes, of which there are at most n / L. Fractions get Wilson score intervals, the means normal ones, at confidence
+// C. The N threads (default: one per CPU) share out the samples, and the result does not depend on N.
+//
+// Prints every estimate with its interval, the number of degree and neighbour queries it took and the time. The four
+// component estimates come from one pass over the samples, and show its queries and time. --check computes the exact
+// values by a linear pass (Kosaraju), which is only meant for graphs that fit, and fails if one is out of its interval
+// at three standard errors (or at confidence C, if that is wider).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+#include "sc_testers.h"
+
+// Samples are handed out to threads in chunks of this size.
+#define CHUNK 16
+
+// The nodes reached by a bounded search from a root, with the edges it followed between them.
+typedef struct {
+	uint64_t *node;         // Nodes in the order they were reached, the root first
+	uint64_t *table;        // Open addressing set of index + 1, by node
+	unsigned bits;
+	uint64_t *offset;       // Followed edges of the node at each index, as indices
+	uint64_t *edge;
+	uint64_t edge_size;
+	uint64_t size;
+	int complete;           // Whether the search found all nodes it could reach
+} ball_t;
+
+typedef struct {
+	ball_t ball[2];         // Forward and backward search
+	uint64_t *id;           // Node of the union of both balls for every node of the backward one
+	uint64_t *from;         // Edges of the union
+	uint64_t *to;
+	uint64_t *adjacent;
+	uint64_t edge_size;
+	uint64_t *start;        // Offsets into adjacent
+	uint64_t *queue;
+	unsigned char *mark[2]; // Nodes of the union reached from the root, and reaching it
+} scratch_t;
+
+typedef struct {
+	uint64_t out_degree;
+	uint64_t size;          // Size of the component, or 0 if not known
+	uint64_t lower;         // Lower bound on the size otherwise
+	int sink;
+	int source;
+	uint64_t queries;
+} sample_t;
+
+typedef struct {
+	const slgraph_t *g;
+	int components;         // Probe the components, else only the degrees
+	const slgraph_node_t *nodes;
+	sample_t *samples;
+	uint64_t count;
+	uint64_t budget;
+	atomic_uint_fast64_t next;
+	atomic_int failed;
+} job_t;
+
+typedef enum {
+	EST_DEGREE,             // Average out-degree
+	EST_SMALL,              // Fraction of nodes in components of at most L nodes
+	EST_SINKS,              // Fraction of nodes in such sink components
+	EST_SOURCES,            // Fraction of nodes in such source components
+	EST_SCCS,               // Number of components
+	ESTIMATES
+} estimate_t;
+
+// Sums over the samples.
+typedef struct {
+	uint64_t samples;
+	uint64_t queries;       // Of the pass over the components
+	uint64_t resolved;      // Samples with the exact size of their component
+	uint64_t in_small;
+	uint64_t unknown;       // Samples without it whose component may be small
+	uint64_t in_sinks;
+	uint64_t in_sources;
+	double degree_sum, degree_squares;
+	double x_sum, x_squares;         // x is 1 / the size where it is known, and 0 otherwise
+	double upper_sum, upper_squares; // upper is 1 / the lower bound where the size is not known, and x otherwise
+} totals_t;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint64_t slot(uint64_t node, unsigned bits)
+{
+	return ((node + 1) * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+}
+
+// Index of node in b, or UINT64_MAX if b has not reached it.
+static uint64_t find(const ball_t *b, uint64_t node)
+{
+	uint64_t mask = ((uint64_t)1 << b->bits) - 1;
+
+	for (uint64_t i = slot(node, b->bits); b->table[i]; i = (i + 1) & mask) {
+		if (b->node[b->table[i] - 1] == node) return b->table[i] - 1;
+	}
+	return UINT64_MAX;
+}
+
+static void insert(ball_t *b, uint64_t node)
+{
+	uint64_t mask = ((uint64_t)1 << b->bits) - 1, i = slot(node, b->bits);
+
+	while (b->table[i]) i = (i + 1) & mask;
+	b->node[b->size] = node;
+	b->table[i] = ++b->size;
+}
+
+static void free_scratch(scratch_t *s)
+{
+	for (int d = 0; d < 2; d++) {
+		free(s->ball[d].node);
+		free(s->ball[d].table);
+		free(s->ball[d].offset);
+		free(s->ball[d].edge);
+		free(s->mark[d]);
+	}
+	free(s->id);
+	free(s->from);
+	free(s->to);
+	free(s->adjacent);
+	free(s->start);
+	free(s->queue);
+}
+
+// Returns 0 if successful.
+static int alloc_scratch(scratch_t *s, uint64_t budget)
+{
+	unsigned bits = 4;
+
+	memset(s, 0, sizeof(*s));
+	while (((uint64_t)1 << bits) < 2 * budget) bits++;
+	for (int d = 0; d < 2; d++) {
+		ball_t *b = &s->ball[d];
+		b->bits = bits;
+		b->node = malloc(budget * sizeof(uint64_t));
+		b->table = calloc((size_t)1 << bits, sizeof(uint64_t));
+		b->offset = malloc((budget + 1) * sizeof(uint64_t));
+		s->mark[d] = malloc(2 * budget);
+		if (!b->node || !b->table || !b->offset || !s->mark[d]) return 1;
+	}
+	s->id = malloc(budget * sizeof(uint64_t));
+	s->start = malloc((2 * budget + 1) * sizeof(uint64_t));
+	s->queue = malloc(2 * budget * sizeof(uint64_t));
+	return !s->id || !s->start || !s->queue;
+}
+
+// Breadth-first search from root along out-edges (in-edges if in is set) until budget nodes are reached. Returns 0 if
+// successful, and adds the queries it made to queries.
+static int explore(const slgraph_t *g, ball_t *b, slgraph_node_t root, int in, uint64_t budget, uint64_t *queries)
+{
+	uint64_t n = slgraph_nodes(g), edges = 0;
+
+	// Only the slots that were used need clearing. In reverse order of insertion, the probe for each entry still passes
+	// over the same earlier entries as when it was inserted.
+	while (b->size) {
+		uint64_t mask = ((uint64_t)1 << b->bits) - 1, j = slot(b->node[b->size - 1], b->bits);
+		while (b->table[j] != b->size) j = (j + 1) & mask;
+		b->table[j] = 0;
+		b->size--;
+	}
+	b->complete = 1;
+	insert(b, root);
+
+	uint64_t head = 0;
+	for (; head < b->size && b->complete; head++) {
+		slgraph_node_t v = b->node[head];
+		uint_fast64_t deg = in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+		b->offset[head] = edges;
+		(*queries)++;
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t u = in ? slgraph_in_neighbour(g, v, k) : slgraph_out_neighbour(g, v, k);
+			(*queries)++;
+			if (u >= n) continue;
+			uint64_t i = find(b, u);
+			if (i == UINT64_MAX) {
+				if (b->size == budget) {
+					b->complete = 0;
+					break;
+				}
+				i = b->size;
+				insert(b, u);
+			}
+			if (edges == b->edge_size) {
+				uint64_t size = b->edge_size ? 2 * b->edge_size : 4 * budget;
+				uint64_t *edge = realloc(b->edge, size * sizeof(uint64_t));
+				if (!edge) return 1;
+				b->edge = edge;
+				b->edge_size = size;
+			}
+			b->edge[edges++] = i;
+		}
+	}
+	// Nodes not expanded have no edges.
+	for (; head <= b->size; head++) b->offset[head] = edges;
+	return 0;
+}
+
+// Mark the nodes reached from node 0 over the edges of a graph in CSR form.
+static void search(const uint64_t *start, const uint64_t *adjacent, unsigned char *seen, uint64_t *queue)
+{
+	uint64_t head = 0, tail = 0;
+
+	seen[0] = 1;
+	queue[tail++] = 0;
+	while (head < tail) {
+		uint64_t i = queue[head++];
+		for (uint64_t e = start[i]; e < start[i + 1]; e++) {
+			if (seen[adjacent[e]]) continue;
+			seen[adjacent[e]] = 1;
+			queue[tail++] = adjacent[e];
+		}
+	}
+}
+
+// The CSR form of the edges from -> to of a graph of nodes nodes, with the edges from node i at adjacent[start[i]]
+// up to adjacent[start[i + 1]].
+static void csr(uint64_t nodes, uint64_t edges, const uint64_t *from, const uint64_t *to, uint64_t *start, uint64_t *adjacent)
+{
+	memset(start, 0, (nodes + 1) * sizeof(uint64_t));
+	for (uint64_t e = 0; e < edges; e++) start[from[e] + 1]++;
+	for (uint64_t i = 0; i < nodes; i++) start[i + 1] += start[i];
+	for (uint64_t e = 0; e < edges; e++) adjacent[start[from[e]]++] = to[e];
+	// start[i] is now where the edges of i + 1 begin.
+	memmove(start + 1, start, nodes * sizeof(uint64_t));
+	start[0] = 0;
+}
+
+// The number of nodes of the union of both balls that the root reaches and that reach the root over the edges the
+// searches followed, which are in its component. Returns 0 if out of memory.
+static uint64_t component(scratch_t *s)
+{
+	const ball_t *fwd = &s->ball[0], *bwd = &s->ball[1];
+	uint64_t nodes = fwd->size, edges = fwd->offset[fwd->size] + bwd->offset[bwd->size], found = 0;
+
+	if (edges > s->edge_size) {
+		uint64_t *from = realloc(s->from, edges * sizeof(uint64_t));
+		if (from) s->from = from;
+		uint64_t *to = realloc(s->to, edges * sizeof(uint64_t));
+		if (to) s->to = to;
+		uint64_t *adjacent = realloc(s->adjacent, edges * sizeof(uint64_t));
+		if (adjacent) s->adjacent = adjacent;
+		if (!from || !to || !adjacent) return 0;
+		s->edge_size = edges;
+	}
+
+	// The roots are the same node, 0.
+	for (uint64_t j = 0; j < bwd->size; j++) {
+		uint64_t i = find(fwd, bwd->node[j]);
+		s->id[j] = i != UINT64_MAX ? i : nodes++;
+	}
+	edges = 0;
+	for (uint64_t i = 0; i < fwd->size; i++) {
+		for (uint64_t e = fwd->offset[i]; e < fwd->offset[i + 1]; e++) {
+			s->from[edges] = i;
+			s->to[edges++] = fwd->edge[e];
+		}
+	}
+	// The backward search follows edges against their direction.
+	for (uint64_t j = 0; j < bwd->size; j++) {
+		for (uint64_t e = bwd->offset[j]; e < bwd->offset[j + 1]; e++) {
+			s->from[edges] = s->id[bwd->edge[e]];
+			s->to[edges++] = s->id[j];
+		}
+	}
+
+	memset(s->mark[0], 0, nodes);
+	memset(s->mark[1], 0, nodes);
+	csr(nodes, edges, s->from, s->to, s->start, s->adjacent);
+	search(s->start, s->adjacent, s->mark[0], s->queue);
+	csr(nodes, edges, s->to, s->from, s->start, s->adjacent);
+	search(s->start, s->adjacent, s->mark[1], s->queue);
+	for (uint64_t i = 0; i < nodes; i++) found += s->mark[0][i] && s->mark[1][i];
+	return found;
+}
+
+// Returns 0 if successful.
+static int probe(scratch_t *s, const slgraph_t *g, slgraph_node_t v, uint64_t budget, sample_t *r)
+{
+	if (explore(g, &s->ball[0], v, 0, budget, &r->queries) || explore(g, &s->ball[1], v, 1, budget, &r->queries)) return 1;
+
+	uint64_t size = component(s);
+	if (!size) return 1;
+	if (s->ball[0].complete || s->ball[1].complete) {
+		r->size = size;
+		r->sink = s->ball[0].complete && size == s->ball[0].size;
+		r->source = s->ball[1].complete && size == s->ball[1].size;
+	} else {
+		r->lower = size;
+	}
+	return 0;
+}
+
+static void *worker(void *arg)
+{
+	job_t *job = arg;
+	scratch_t s;
+	uint64_t first;
+
+	if (job->components && alloc_scratch(&s, job->budget)) {
+		atomic_store(&job->failed, 1);
+		free_scratch(&s);
+		return NULL;
+	}
+
+	while (!atomic_load(&job->failed) && (first = atomic_fetch_add(&job->next, CHUNK)) < job->count) {
+		uint64_t end = first + CHUNK < job->count ? first + CHUNK : job->count;
+		for (uint64_t i = first; i < end; i++) {
+			sample_t *r = &job->samples[i];
+			r->queries = 0;
+			if (!job->components) {
+				r->out_degree = slgraph_out_degree(job->g, job->nodes[i]);
+				r->queries = 1;
+			} else if (probe(&s, job->g, job->nodes[i], job->budget, r)) {
+				atomic_store(&job->failed, 1);
+				break;
+			}
+		}
+	}
+
+	if (job->components) free_scratch(&s);
+	return NULL;
+}
+
+// Run job on threads threads.
+static void run(job_t *job, long threads)
+{
+	pthread_t tids[threads];
+	long started = 1;
+
+	atomic_store(&job->next, 0);
+	for (; started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, job)) break;
+	}
+	worker(job);
+	for (long t = 1; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+// The z such that a standard normal variable is within +-z with probability confidence.
+static double quantile(double confidence)
+{
+	double lo = 0.0, hi = 40.0;
+
+	for (int i = 0; i < 200; i++) {
+		double mid = (lo + hi) / 2;
+		if (erfc(mid / sqrt(2.0)) > 1.0 - confidence) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return (lo + hi) / 2;
+}
+
+// Wilson score interval of a proportion of k in m at z.
+static void wilson(uint64_t k, uint64_t m, double z, double *lo, double *hi)
+{
+	double p = (double)k / m, q = z * z / m;
+	double center = (p + q / 2) / (1 + q), half = z / (1 + q) * sqrt(p * (1 - p) / m + q / (4 * m));
+
+	*lo = center - half > 0.0 ? center - half : 0.0;
+	*hi = center + half < 1.0 ? center + half : 1.0;
+}
+
+// Mean and standard error of the mean of m values with sum and sum of squares.
+static void mean_error(double sum, double squares, uint64_t m, double *mean, double *error)
+{
+	double variance = m > 1 ? (squares - sum * sum / m) / (m - 1) : 0.0;
+
+	*mean = sum / m;
+	*error = variance > 0.0 ? sqrt(variance / m) : 0.0;
+}
+
+// The estimates from the totals t of a graph of n nodes, and their intervals at z.
+static void intervals(const totals_t *t, uint64_t n, uint64_t small, double z, double *value, double *lo, double *hi)
+{
+	uint64_t m = t->samples;
+	double error, unused, upper, upper_error;
+
+	mean_error(t->degree_sum, t->degree_squares, m, &value[EST_DEGREE], &error);
+	lo[EST_DEGREE] = value[EST_DEGREE] - z * error;
+	hi[EST_DEGREE] = value[EST_DEGREE] + z * error;
+
+	value[EST_SMALL] = (double)t->in_small / m;
+	wilson(t->in_small, m, z, &lo[EST_SMALL], &unused);
+	wilson(t->in_small + t->unknown, m, z, &unused, &hi[EST_SMALL]);
+	value[EST_SINKS] = (double)t->in_sinks / m;
+	wilson(t->in_sinks, m, z, &lo[EST_SINKS], &hi[EST_SINKS]);
+	value[EST_SOURCES] = (double)t->in_sources / m;
+	wilson(t->in_sources, m, z, &lo[EST_SOURCES], &hi[EST_SOURCES]);
+
+	mean_error(t->x_sum, t->x_squares, m, &value[EST_SCCS], &error);
+	mean_error(t->upper_sum, t->upper_squares, m, &upper, &upper_error);
+	lo[EST_SCCS] = n * (value[EST_SCCS] - z * error);
+	hi[EST_SCCS] = n * (upper + z * upper_error) + (double)n / small;
+	// There is at least one component.
+	value[EST_SCCS] = value[EST_SCCS] * n > 1.0 ? value[EST_SCCS] * n : 1.0;
+	if (lo[EST_SCCS] < 1.0) lo[EST_SCCS] = 1.0;
+	if (hi[EST_SCCS] > n) hi[EST_SCCS] = n;
+}
+
+typedef struct {
+	slgraph_node_t node;
+	uint64_t next;
+} frame_t;
+
+// The exact values of the estimates, by Kosaraju's algorithm. Returns 0 if successful.
+static int exact(const slgraph_t *g, uint64_t small, double *expected, uint64_t *count)
+{
+	uint64_t n = slgraph_nodes(g), order_len = 0, edges = 0, in_small = 0, in_sinks = 0, in_sources = 0;
+	uint64_t *component = malloc(n * sizeof(uint64_t)), *order = malloc(n * sizeof(uint64_t)), *size = NULL;
+	frame_t *stack = malloc(n * sizeof(frame_t));
+	unsigned char *flags = NULL;
+	int failed = 1;
+
+	*count = 0;
+	if (!component || !order || !stack) goto out;
+
+	for (uint64_t v = 0; v < n; v++) component[v] = UINT64_MAX;
+	for (uint64_t start = 0; start < n; start++) {
+		uint64_t sp = 0;
+		if (component[start] != UINT64_MAX) continue;
+		component[start] = 0; // Visited
+		stack[sp++] = (frame_t){start, 0};
+		while (sp) {
+			frame_t *top = &stack[sp - 1];
+			if (top->next < slgraph_out_degree(g, top->node)) {
+				slgraph_node_t u = slgraph_out_neighbour(g, top->node, top->next++);
+				if (u < n && component[u] == UINT64_MAX) {
+					component[u] = 0;
+					stack[sp++] = (frame_t){u, 0};
+				}
+				continue;
+			}
+			order[order_len++] = top->node;
+			sp--;
+		}
+	}
+
+	uint64_t *nodes = (uint64_t *)stack;
+	for (uint64_t v = 0; v < n; v++) component[v] = UINT64_MAX;
+	for (uint64_t i = n; i > 0; i--) {
+		uint64_t start = order[i - 1], sp = 0;
+		if (component[start] != UINT64_MAX) continue;
+		component[start] = *count;
+		nodes[sp++] = start;
+		while (sp) {
+			slgraph_node_t v = nodes[--sp];
+			uint_fast64_t deg = slgraph_in_degree(g, v);
+			for (uint_fast64_t k = 0; k < deg; k++) {
+				slgraph_node_t u = slgraph_in_neighbour(g, v, k);
+				if (u >= n || component[u] != UINT64_MAX) continue;
+				component[u] = *count;
+				nodes[sp++] = u;
+			}
+		}
+		(*count)++;
+	}
+
+	// Bit 0: an edge leaves the component, bit 1: an edge enters it.
+	size = calloc(*count, sizeof(uint64_t));
+	flags = calloc(*count, 1);
+	if (!size || !flags) goto out;
+	for (uint64_t v = 0; v < n; v++) {
+		uint_fast64_t deg = slgraph_out_degree(g, v);
+		size[component[v]]++;
+		edges += deg;
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t u = slgraph_out_neighbour(g, v, k);
+			if (u >= n || component[u] == component[v]) continue;
+			flags[component[v]] |= 1;
+			flags[component[u]] |= 2;
+		}
+	}
+	for (uint64_t c = 0; c < *count; c++) {
+		if (size[c] > small) continue;
+		in_small += size[c];
+		if (!(flags[c] & 1)) in_sinks += size[c];
+		if (!(flags[c] & 2)) in_sources += size[c];
+	}
+	expected[EST_DEGREE] = (double)edges / n;
+	expected[EST_SMALL] = (double)in_small / n;
+	expected[EST_SINKS] = (double)in_sinks / n;
+	expected[EST_SOURCES] = (double)in_sources / n;
+	expected[EST_SCCS] = (double)*count;
+	failed = 0;
+
+out:
+	free(component);
+	free(order);
+	free(stack);
+	free(size);
+	free(flags);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double eps = 0.05, confidence = 0.95;
+	uint64_t samples = 0, small = 0, budget = 0, seed = 1;
+	int check = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--eps") == 0 && argi + 1 < argc - 1) {
+			eps = atof(argv[++argi]);
+		} else if (strcmp(argv[argi], "--confidence") == 0 && argi + 1 < argc - 1) {
+			confidence = atof(argv[++argi]);
+		} else if (strcmp(argv[argi], "--samples") == 0 && argi + 1 < argc - 1) {
+			samples = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--size") == 0 && argi + 1 < argc - 1) {
+			small = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--budget") == 0 && argi + 1 < argc - 1) {
+			budget = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--seed") == 0 && argi + 1 < argc - 1) {
+			seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1 || !(eps > 0.0 && eps < 1.0) || !(confidence > 0.0 && confidence < 1.0)) {
+		fprintf(stderr, "Usage: %s [--threads N] [--eps E] [--confidence C] [--samples M] [--size L] [--budget B] [--seed S] [--check] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+	if (!samples) samples = (uint64_t)ceil(2.0 * log(2.0 / (1.0 - confidence)) / (eps * eps));
+	if (!small) small = (uint64_t)ceil(2.0 / eps);
+	if (budget < small) budget = budget ? small : 4 * small;
+
+	slgraph_t g;
+	if (slgraph_open(&g, argv[argi], true)) {
+		fprintf(stderr, "Failed to open graph: %s\n", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	slgraph_node_t *nodes = malloc(samples * sizeof(slgraph_node_t));
+	sample_t *results = calloc(samples, sizeof(sample_t));
+	if (!nodes || !results) {
+		fprintf(stderr, "Out of memory for %lu samples\n", (unsigned long)samples);
+		return 1;
+	}
+	sc_sample(&g, seed, samples, nodes);
+	double z = quantile(confidence);
+
+	printf("Stats: nodes=%lu edges=%lu mode=estimate eps=%.6f confidence=%.3f samples=%lu L=%lu budget=%lu seed=%lu threads=%ld\n",
+	       (unsigned long)n, (unsigned long)slgraph_edges(&g), eps, confidence, (unsigned long)samples,
+	       (unsigned long)small, (unsigned long)budget, (unsigned long)seed, threads);
+
+	job_t job = {.g = &g, .nodes = nodes, .samples = results, .count = samples, .budget = budget};
+	atomic_init(&job.next, 0);
+	atomic_init(&job.failed, 0);
+
+	double t0 = now();
+	run(&job, threads);
+	double degree_time = now() - t0;
+	job.components = 1;
+	t0 = now();
+	run(&job, threads);
+	double components_time = now() - t0;
+	if (atomic_load(&job.failed)) {
+		fprintf(stderr, "Out of memory for searches of %lu nodes\n", (unsigned long)budget);
+		return 1;
+	}
+
+	totals_t t = {.samples = samples};
+	for (uint64_t i = 0; i < samples; i++) {
+		const sample_t *r = &results[i];
+		double x = r->size ? 1.0 / r->size : 0.0, upper = r->size ? x : 1.0 / r->lower;
+		t.degree_sum += r->out_degree;
+		t.degree_squares += (double)r->out_degree * r->out_degree;
+		t.queries += r->queries;
+		t.resolved += r->size != 0;
+		t.in_small += r->size && r->size <= small;
+		t.unknown += !r->size && r->lower <= small;
+		t.in_sinks += r->sink && r->size <= small;
+		t.in_sources += r->source && r->size <= small;
+		t.x_sum += x;
+		t.x_squares += x * x;
+		t.upper_sum += upper;
+		t.upper_squares += upper * upper;
+	}
+
+	double value[ESTIMATES], lo[ESTIMATES], hi[ESTIMATES];
+	intervals(&t, n, small, z, value, lo, hi);
+	printf("avg_out_degree=%.4f ci=%.4f..%.4f queries=%lu time=%.3f\n", value[EST_DEGREE], lo[EST_DEGREE],
+	       hi[EST_DEGREE], (unsigned long)samples, degree_time);
+	printf("small_scc_fraction=%.4f ci=%.4f..%.4f queries=%lu time=%.3f\n", value[EST_SMALL], lo[EST_SMALL],
+	       hi[EST_SMALL], (unsigned long)t.queries, components_time);
+	printf("sink_fraction=%.4f ci=%.4f..%.4f queries=%lu time=%.3f\n", value[EST_SINKS], lo[EST_SINKS],
+	       hi[EST_SINKS], (unsigned long)t.queries, components_time);
+	printf("source_fraction=%.4f ci=%.4f..%.4f queries=%lu time=%.3f\n", value[EST_SOURCES], lo[EST_SOURCES],
+	       hi[EST_SOURCES], (unsigned long)t.queries, components_time);
+	printf("sccs=%.0f ci=%.0f..%.0f resolved=%.4f queries=%lu time=%.3f\n", value[EST_SCCS], lo[EST_SCCS],
+	       hi[EST_SCCS], (double)t.resolved / samples, (unsigned long)t.queries, components_time);
+
+	int failed = 0;
+	if (check) {
+		double expected[ESTIMATES];
+		uint64_t exact_sccs;
+		t0 = now();
+		if (exact(&g, small, expected, &exact_sccs)) {
+			fprintf(stderr, "Out of memory for the check\n");
+			return 1;
+		}
+		printf("exact_avg_out_degree=%.4f exact_small_scc_fraction=%.4f exact_sink_fraction=%.4f exact_source_fraction=%.4f exact_sccs=%lu time=%.3f\n",
+		       expected[EST_DEGREE], expected[EST_SMALL], expected[EST_SINKS], expected[EST_SOURCES],
+		       (unsigned long)exact_sccs, now() - t0);
+		intervals(&t, n, small, z > 3.0 ? z : 3.0, value, lo, hi);
+		for (int e = 0; e < ESTIMATES; e++) {
+			// Some slack for rounding.
+			double slack = 1e-9 * (fabs(expected[e]) + 1.0);
+			failed |= expected[e] < lo[e] - slack || expected[e] > hi[e] + slack;
+		}
+		printf("check=%s\n", failed ? "FAILED" : "OK");
+	}
+
+	free(nodes);
+	free(results);
+	slgraph_close(&g);
+	return failed;
+}
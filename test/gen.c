@@ -0,0 +1,448 @@
+// Generate synthetic directed graphs straight into a new SLGraph, in parallel and deterministically by seed.
+//
+// Usage:
+//   slgraph_gen er --nodes N --edges M [options] <output.slg>
+//   slgraph_gen rmat --scale S [--edge-factor F] [--probabilities A,B,C] [options] <output.slg>
+//   slgraph_gen grid --width W --height H [--drop P] [--oneway Q] [options] <output.slg>
+//   slgraph_gen regular --nodes N --degree D [options] <output.slg>
+//   slgraph_gen far --nodes N --degree D --eps E [--sink-size S] [options] <output.slg>
+// Options: [--seed X] [--threads T] [--batch B] [--sorted]
+//
+// Models:
+//   er       M edges between uniformly random distinct nodes (Erdos-Renyi G(n, M); parallel edges are possible).
+//   rmat     2^S nodes and F * 2^S edges (default F = 16), each placed by descending S levels of the adjacency matrix
+//            into one of its quadrants with probabilities A, B, C and 1 - A - B - C (default 0.57,0.19,0.19, as in
+//            Graph500), with nodes relabelled by a random permutation; self-loops and parallel edges are kept.
+//   grid     a W x H lattice, node r * W + c at row r and column c, with road segments to the right and down that
+//            are two-way, one-way with probability Q in a random direction, or missing with probability P.
+//   regular  every node has out-degree and in-degree D: the edges of node v go to p_1(v), ..., p_D(v) for D random
+//            permutations p_i (self-loops and parallel edges are possible).
+//   far      a strongly connected core with planted sink components: K = floor(E * D * n) + 1 groups of S nodes
+//            (default 2) that are a cycle each and only have edges from the core. Every sink needs an edge of its own
+//            to become strongly connected, so in the bounded-degree model with degree bound D the graph is E-far from
+//            strongly connected. The core is a cycle plus D - 2 random permutations, and gives every sink node one
+//            edge, so no node has more than D out- or in-edges. Nodes are relabelled by a random permutation.
+//
+// All random choices are hash functions of the seed (default 1) and of the edge or node they are for, so the same
+// arguments give the same graph with any number of threads or batch size. The T threads (default: one per CPU) each
+// generate a batch of about B edges (default 1048576) at a time, which are appended in order with
+// slgraph_append_edges(). --sorted sorts the incidence lists at the end. The output must not exist yet.
+//
+// Prints the model parameters and the generation rate; for far also the number of sinks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "slgraph.h"
+
+typedef enum {
+	MODEL_ER,
+	MODEL_RMAT,
+	MODEL_GRID,
+	MODEL_REGULAR,
+	MODEL_FAR
+} model_t;
+
+static const char *const model_names[] = {"er", "rmat", "grid", "regular", "far"};
+
+// A random permutation of 0 .. n - 1: a four-round Feistel network on the smallest even number of bits that holds
+// n - 1, applied again to values of n and more (cycle walking), which are less than three in four.
+typedef struct {
+	uint64_t n;
+	unsigned half;             // Bits per half
+	uint64_t keys[4];
+} permutation_t;
+
+typedef struct {
+	model_t model;
+	uint64_t seed;
+	uint64_t nodes, edges;     // Edges only for er and rmat
+	unsigned scale;
+	uint64_t edge_factor;
+	double a, b, c;
+	uint64_t width, height;
+	double drop, oneway;
+	uint64_t degree;
+	double eps;
+	uint64_t sink_size, sinks, core;
+	permutation_t label;       // Node labels, for rmat and far
+	permutation_t *perms;      // Edge permutations, for regular and far
+	uint64_t items;            // Edges (er, rmat) or nodes (the others) to generate
+	uint64_t per_item;         // Most edges per item
+} spec_t;
+
+typedef struct {
+	const spec_t *s;
+	slgraph_t *g;
+	uint64_t chunk;            // Items per batch
+	uint64_t chunks;
+	atomic_uint_fast64_t next_chunk;
+	pthread_mutex_t lock;
+	pthread_cond_t turn_done;
+	uint64_t turn;             // Next batch to append
+	int failed;
+} job_t;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint64_t mix(uint64_t z)
+{
+	z += 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static uint64_t splitmix(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Random state for item of the stream with the given salt.
+static uint64_t item_state(uint64_t seed, uint64_t salt, uint64_t item)
+{
+	return mix(mix(seed ^ salt) ^ item);
+}
+
+static double unit(uint64_t x)
+{
+	return (x >> 11) * 0x1.0p-53;
+}
+
+static void permutation_init(permutation_t *p, uint64_t n, uint64_t seed, uint64_t salt)
+{
+	unsigned bits = 0;
+
+	while (bits < 64 && ((uint64_t)1 << bits) < n) bits++;
+	p->n = n;
+	p->half = (bits + 1) / 2;
+	for (int r = 0; r < 4; r++) p->keys[r] = item_state(seed, salt, (uint64_t)r);
+}
+
+static uint64_t permute(const permutation_t *p, uint64_t x)
+{
+	uint64_t mask = ((uint64_t)1 << p->half) - 1;
+
+	do {
+		uint64_t left = x >> p->half, right = x & mask;
+		for (int r = 0; r < 4; r++) {
+			uint64_t next = left ^ (mix(right ^ p->keys[r]) & mask);
+			left = right;
+			right = next;
+		}
+		x = left << p->half | right;
+	} while (x >= p->n);
+	return x;
+}
+
+// Write the edges of item into src and dst. Returns their number.
+static uint64_t generate(const spec_t *s, uint64_t item, slgraph_node_t *src, slgraph_node_t *dst)
+{
+	uint64_t count = 0, state;
+
+	switch (s->model) {
+	case MODEL_ER:
+		state = item_state(s->seed, 1, item);
+		src[0] = splitmix(&state) % s->nodes;
+		// Uniform over the other nodes.
+		dst[0] = splitmix(&state) % (s->nodes - 1);
+		if (dst[0] >= src[0]) dst[0]++;
+		return 1;
+
+	case MODEL_RMAT: {
+		uint64_t u = 0, v = 0;
+		state = item_state(s->seed, 2, item);
+		for (unsigned level = 0; level < s->scale; level++) {
+			double r = unit(splitmix(&state));
+			u <<= 1;
+			v <<= 1;
+			if (r >= s->a + s->b) u |= 1;
+			if ((r >= s->a && r < s->a + s->b) || r >= s->a + s->b + s->c) v |= 1;
+		}
+		src[0] = permute(&s->label, u);
+		dst[0] = permute(&s->label, v);
+		return 1;
+	}
+
+	case MODEL_GRID: {
+		uint64_t row = item / s->width, col = item % s->width;
+		for (int down = 0; down < 2; down++) {
+			if (down ? row + 1 == s->height : col + 1 == s->width) continue;
+			uint64_t other = down ? item + s->width : item + 1;
+			state = item_state(s->seed, 3 + down, item);
+			if (unit(splitmix(&state)) < s->drop) continue;
+			int oneway = unit(splitmix(&state)) < s->oneway, reverse = splitmix(&state) & 1;
+			if (!oneway || !reverse) {
+				src[count] = item;
+				dst[count++] = other;
+			}
+			if (!oneway || reverse) {
+				src[count] = other;
+				dst[count++] = item;
+			}
+		}
+		return count;
+	}
+
+	case MODEL_REGULAR:
+		for (uint64_t i = 0; i < s->degree; i++) {
+			src[count] = item;
+			dst[count++] = permute(&s->perms[i], item);
+		}
+		return count;
+
+	case MODEL_FAR:
+		// Core nodes come first, then the sinks, one after the other, before relabelling.
+		if (item < s->core) {
+			src[count] = item;
+			dst[count++] = (item + 1) % s->core;
+			for (uint64_t i = 0; i + 2 < s->degree; i++) {
+				src[count] = item;
+				dst[count++] = permute(&s->perms[i], item);
+			}
+			if (item < s->sinks * s->sink_size) {
+				src[count] = item;
+				dst[count++] = s->core + item;
+			}
+		} else if (s->sink_size > 1) {
+			uint64_t first = item - (item - s->core) % s->sink_size;
+			src[count] = item;
+			dst[count++] = item + 1 == first + s->sink_size ? first : item + 1;
+		}
+		for (uint64_t i = 0; i < count; i++) {
+			src[i] = permute(&s->label, src[i]);
+			dst[i] = permute(&s->label, dst[i]);
+		}
+		return count;
+	}
+	return 0;
+}
+
+static void *worker(void *arg)
+{
+	job_t *job = arg;
+	const spec_t *s = job->s;
+	slgraph_node_t *src = malloc(job->chunk * s->per_item * sizeof(slgraph_node_t));
+	slgraph_node_t *dst = malloc(job->chunk * s->per_item * sizeof(slgraph_node_t));
+	uint64_t c;
+
+	while ((c = atomic_fetch_add(&job->next_chunk, 1)) < job->chunks) {
+		uint64_t first = c * job->chunk, end = first + job->chunk < s->items ? first + job->chunk : s->items, count = 0;
+		if (src && dst) {
+			for (uint64_t item = first; item < end; item++) count += generate(s, item, src + count, dst + count);
+		}
+
+		// Batches are appended in order, so that edge IDs and list orders don't depend on the threads.
+		pthread_mutex_lock(&job->lock);
+		while (job->turn != c) pthread_cond_wait(&job->turn_done, &job->lock);
+		pthread_mutex_unlock(&job->lock);
+		if (!src || !dst || (count && slgraph_append_edges(job->g, s->nodes, src, dst, count) == SLGRAPH_INVALID_EDGE)) job->failed = 1;
+		pthread_mutex_lock(&job->lock);
+		job->turn++;
+		pthread_cond_broadcast(&job->turn_done);
+		pthread_mutex_unlock(&job->lock);
+	}
+
+	free(src);
+	free(dst);
+	return NULL;
+}
+
+// Parse "A,B,C".
+static int parse_probabilities(const char *arg, spec_t *s)
+{
+	return sscanf(arg, "%lf,%lf,%lf", &s->a, &s->b, &s->c) == 3 && s->a >= 0.0 && s->b >= 0.0 && s->c >= 0.0 &&
+	       s->a + s->b + s->c <= 1.0;
+}
+
+// Check the parameters of the model and derive the rest. Returns an error message, or NULL.
+static const char *prepare(spec_t *s)
+{
+	switch (s->model) {
+	case MODEL_ER:
+		if (s->nodes < 2) return "er needs --nodes of at least 2";
+		s->items = s->edges;
+		s->per_item = 1;
+		break;
+	case MODEL_RMAT:
+		if (s->scale < 1 || s->scale > 40) return "rmat needs --scale between 1 and 40";
+		s->nodes = (uint64_t)1 << s->scale;
+		s->items = s->edges = s->edge_factor * s->nodes;
+		s->per_item = 1;
+		permutation_init(&s->label, s->nodes, s->seed, 6);
+		break;
+	case MODEL_GRID:
+		if (!s->width || !s->height) return "grid needs --width and --height";
+		if (!(s->drop >= 0.0 && s->drop <= 1.0 && s->oneway >= 0.0 && s->oneway <= 1.0)) return "--drop and --oneway are probabilities";
+		s->items = s->nodes = s->width * s->height;
+		s->per_item = 4;
+		break;
+	case MODEL_REGULAR:
+	case MODEL_FAR:
+		if (!s->nodes || !s->degree) return "regular and far need --nodes and --degree";
+		s->items = s->nodes;
+		s->per_item = s->degree;
+		if (s->model == MODEL_REGULAR) break;
+		if (s->degree < 2 || !(s->eps > 0.0) || !s->sink_size) return "far needs --degree of at least 2, --eps above 0 and --sink-size of at least 1";
+		s->sinks = (uint64_t)floor(s->eps * s->degree * s->nodes) + 1;
+		if (s->sinks > s->nodes / 2 / s->sink_size) return "far needs the sinks to take at most half of the nodes: lower --eps or --sink-size";
+		s->core = s->nodes - s->sinks * s->sink_size;
+		permutation_init(&s->label, s->nodes, s->seed, 7);
+		break;
+	}
+
+	uint64_t perms = s->model == MODEL_REGULAR ? s->degree : s->model == MODEL_FAR ? s->degree - 2 : 0;
+	if (perms && !(s->perms = malloc(perms * sizeof(permutation_t)))) return "out of memory";
+	for (uint64_t i = 0; i < perms; i++) permutation_init(&s->perms[i], s->model == MODEL_FAR ? s->core : s->nodes, s->seed, 8 + i);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t batch = (uint64_t)1 << 20;
+	spec_t s = {.seed = 1, .edge_factor = 16, .a = 0.57, .b = 0.19, .c = 0.19, .sink_size = 2};
+	int sorted = 0, known = 0;
+	int argi = 2;
+
+	for (int m = 0; argc > 1 && m < (int)(sizeof(model_names) / sizeof(model_names[0])); m++) {
+		if (strcmp(argv[1], model_names[m]) == 0) {
+			s.model = (model_t)m;
+			known = 1;
+		}
+	}
+	for (; known && argi < argc - 1; argi++) {
+		int value = argi + 1 < argc - 1;
+		if (strcmp(argv[argi], "--nodes") == 0 && value) {
+			s.nodes = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--edges") == 0 && value) {
+			s.edges = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--edge-factor") == 0 && value) {
+			s.edge_factor = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--scale") == 0 && value) {
+			s.scale = (unsigned)strtoul(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--probabilities") == 0 && value) {
+			if (!parse_probabilities(argv[++argi], &s)) break;
+		} else if (strcmp(argv[argi], "--width") == 0 && value) {
+			s.width = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--height") == 0 && value) {
+			s.height = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--drop") == 0 && value) {
+			s.drop = atof(argv[++argi]);
+		} else if (strcmp(argv[argi], "--oneway") == 0 && value) {
+			s.oneway = atof(argv[++argi]);
+		} else if (strcmp(argv[argi], "--degree") == 0 && value) {
+			s.degree = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--eps") == 0 && value) {
+			s.eps = atof(argv[++argi]);
+		} else if (strcmp(argv[argi], "--sink-size") == 0 && value) {
+			s.sink_size = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--seed") == 0 && value) {
+			s.seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--threads") == 0 && value) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--batch") == 0 && value) {
+			batch = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--sorted") == 0) {
+			sorted = 1;
+		} else {
+			break;
+		}
+	}
+	if (!known || argi != argc - 1 || batch < 1) {
+		fprintf(stderr, "Usage: %s er --nodes N --edges M [options] <output.slg>\n", argv[0]);
+		fprintf(stderr, "       %s rmat --scale S [--edge-factor F] [--probabilities A,B,C] [options] <output.slg>\n", argv[0]);
+		fprintf(stderr, "       %s grid --width W --height H [--drop P] [--oneway Q] [options] <output.slg>\n", argv[0]);
+		fprintf(stderr, "       %s regular --nodes N --degree D [options] <output.slg>\n", argv[0]);
+		fprintf(stderr, "       %s far --nodes N --degree D --eps E [--sink-size S] [options] <output.slg>\n", argv[0]);
+		fprintf(stderr, "Options: [--seed X] [--threads T] [--batch B] [--sorted]\n");
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	const char *error = prepare(&s);
+	if (error) {
+		fprintf(stderr, "%s\n", error);
+		return 1;
+	}
+
+	struct stat st;
+	slgraph_t g;
+	if (stat(argv[argi], &st) == 0 && st.st_size > 0) {
+		fprintf(stderr, "Output exists already: %s\n", argv[argi]);
+		return 1;
+	}
+	if (slgraph_open_batched(&g, argv[argi])) {
+		fprintf(stderr, "Failed to create graph: %s\n", argv[argi]);
+		return 1;
+	}
+
+	job_t job = {.s = &s, .g = &g};
+	job.chunk = batch / s.per_item ? batch / s.per_item : 1;
+	job.chunks = (s.items + job.chunk - 1) / job.chunk;
+	atomic_init(&job.next_chunk, 0);
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.turn_done, NULL);
+
+	double t0 = now();
+	pthread_t tids[threads];
+	long started = 1;
+	for (; started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, &job)) break;
+	}
+	worker(&job);
+	for (long t = 1; t < started; t++) pthread_join(tids[t], NULL);
+	pthread_cond_destroy(&job.turn_done);
+	pthread_mutex_destroy(&job.lock);
+
+	// Nodes without edges are only added by growing the graph to all nodes.
+	int failed = job.failed;
+	if (!failed && slgraph_nodes(&g) < s.nodes && slgraph_append_edges(&g, s.nodes, NULL, NULL, 0) == SLGRAPH_INVALID_EDGE) failed = 1;
+	if (!failed && slgraph_checkpoint(&g)) failed = 1;
+	if (!failed && sorted && slgraph_sort_adjacency(&g)) failed = 1;
+	double t = now() - t0;
+	if (failed) {
+		fprintf(stderr, "Failed to write %s\n", argv[argi]);
+		slgraph_close(&g);
+		free(s.perms);
+		return 1;
+	}
+
+	uint64_t edges = slgraph_edges(&g);
+	printf("Stats: nodes=%lu edges=%lu mode=gen model=%s seed=%lu threads=%ld\n", (unsigned long)slgraph_nodes(&g),
+	       (unsigned long)edges, model_names[s.model], (unsigned long)s.seed, threads);
+	if (s.model == MODEL_FAR) {
+		printf("sinks=%lu sink_size=%lu core=%lu degree=%lu eps=%g\n", (unsigned long)s.sinks, (unsigned long)s.sink_size,
+		       (unsigned long)s.core, (unsigned long)s.degree, s.eps);
+	}
+	printf("batches=%lu time=%.3f medges_per_second=%.2f\n", (unsigned long)job.chunks, t, t > 0.0 ? edges / t / 1e6 : 0.0);
+
+	slgraph_close(&g);
+	free(s.perms);
+
+	// The write-ahead log of the appends is empty after the checkpoint.
+	char *wal = malloc(strlen(argv[argi]) + 5);
+	if (wal) {
+		sprintf(wal, "%s.wal", argv[argi]);
+		unlink(wal);
+		free(wal);
+	}
+	return 0;
+}
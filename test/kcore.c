@@ -0,0 +1,384 @@
+// k-core decomposition of a directed SLGraph by parallel peeling.
+//
+// Usage:
+//   slgraph_kcore [--threads T] [--degree total|out|in] [--members] [--original-ids] [--store] [--check] <graph.slg>
+//
+// The k-core is what is left after repeatedly removing the nodes of degree less than k, and the core number of a node
+// the largest k whose k-core contains it. Degrees are in-degree plus out-degree (default), or only out- or in-degree;
+// parallel edges count as often as they occur. Levels k are peeled in increasing order, skipping empty ones: the
+// remaining nodes of degree at most k form the frontier, and the T threads (default: one per CPU) remove its nodes
+// together, lowering the degrees of their remaining neighbours with atomic decrements. A neighbour whose degree drops to
+// k joins the next frontier of the level, which is peeled in turn until it is empty. Besides the graph, memory is a few
+// arrays of n entries.
+//
+// Prints the largest core number, the number of nodes of each core number and the size of each k-core:
+//   core_histogram: <k>:<nodes with core number k> ...
+//   kcore_sizes: <k>:<nodes with core number at least k> ...
+// --members prints "<node> <core number>" for every node, by its input ID with --original-ids. --store keeps the core
+// numbers in the node property column "core" (not updated when the graph changes). --check compares them with those of
+// the sequential bucket algorithm of Batagelj and Zaversnik.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+
+#define CHUNK 256              // Frontier nodes a thread claims at once
+#define BUFFER 1024            // Nodes a thread collects for the next frontier before adding them
+
+#define NO_CORE UINT32_MAX
+
+typedef enum {
+	DEGREE_TOTAL,
+	DEGREE_OUT,
+	DEGREE_IN
+} degree_t;
+
+typedef struct {
+	const slgraph_t *g;
+	degree_t degree;
+	unsigned threads;
+	_Atomic uint32_t *deg;
+	uint32_t *core;            // NO_CORE until the node joins a frontier
+	slgraph_node_t *remaining; // Nodes not yet in a frontier; compacted at every level
+	uint64_t remaining_count;
+	slgraph_node_t *frontier, *next_frontier;
+	uint64_t frontier_size;
+	atomic_uint_fast64_t next_size;
+	atomic_uint_fast64_t next_chunk;
+	uint32_t k;
+	uint64_t levels, rounds;
+	int done;
+	pthread_barrier_t barrier;
+} kcore_t;
+
+typedef struct {
+	kcore_t *c;
+	unsigned id;
+	slgraph_node_t buffer[BUFFER];
+	uint64_t buffered;
+} worker_t;
+
+// Degree of v that counts.
+static uint64_t node_degree(const slgraph_t *g, degree_t degree, slgraph_node_t v)
+{
+	return (degree != DEGREE_IN ? slgraph_out_degree(g, v) : 0) + (degree != DEGREE_OUT ? slgraph_in_degree(g, v) : 0);
+}
+
+// Number of nodes whose degree drops when v is removed; they are dependent(g, degree, v, i) for i below it.
+static uint64_t dependents(const slgraph_t *g, degree_t degree, slgraph_node_t v)
+{
+	// Removing v lowers the out-degree of its in-neighbours and the in-degree of its out-neighbours.
+	return (degree != DEGREE_OUT ? slgraph_out_degree(g, v) : 0) + (degree != DEGREE_IN ? slgraph_in_degree(g, v) : 0);
+}
+
+static slgraph_node_t dependent(const slgraph_t *g, degree_t degree, slgraph_node_t v, uint64_t i)
+{
+	uint64_t out = degree != DEGREE_OUT ? slgraph_out_degree(g, v) : 0;
+	return i < out ? slgraph_out_neighbour(g, v, i) : slgraph_in_neighbour(g, v, i - out);
+}
+
+static void flush(worker_t *w)
+{
+	kcore_t *c = w->c;
+	uint64_t at = atomic_fetch_add(&c->next_size, w->buffered);
+	memcpy(c->next_frontier + at, w->buffer, w->buffered * sizeof(slgraph_node_t));
+	w->buffered = 0;
+}
+
+// Peel the frontier. Its nodes already have their core number.
+static void peel(worker_t *w)
+{
+	kcore_t *c = w->c;
+	const slgraph_t *g = c->g;
+	uint64_t n = slgraph_nodes(g), first;
+
+	while ((first = atomic_fetch_add(&c->next_chunk, CHUNK)) < c->frontier_size) {
+		uint64_t end = first + CHUNK < c->frontier_size ? first + CHUNK : c->frontier_size;
+		for (uint64_t i = first; i < end; i++) {
+			slgraph_node_t v = c->frontier[i];
+			uint64_t count = dependents(g, c->degree, v);
+			for (uint64_t j = 0; j < count; j++) {
+				slgraph_node_t u = dependent(g, c->degree, v, j);
+				if (u >= n) continue;
+				// The one thread that lowers u to k claims it for the next frontier. Nodes peeled before have degree
+				// at most k already, and every edge is only counted down once, so degrees never wrap around.
+				if (atomic_fetch_sub_explicit(&c->deg[u], 1, memory_order_relaxed) == c->k + 1) {
+					c->core[u] = c->k;
+					if (w->buffered == BUFFER) flush(w);
+					w->buffer[w->buffered++] = u;
+				}
+			}
+		}
+	}
+	if (w->buffered) flush(w);
+}
+
+// Set up the next round: the next frontier of this level, or else the first of the next non-empty level.
+static void next_round(kcore_t *c)
+{
+	slgraph_node_t *swap = c->frontier;
+	c->frontier = c->next_frontier;
+	c->next_frontier = swap;
+	c->frontier_size = atomic_load(&c->next_size);
+	atomic_store(&c->next_size, 0);
+	atomic_store(&c->next_chunk, 0);
+	if (c->frontier_size) {
+		c->rounds++;
+		return;
+	}
+
+	// Drop the nodes peeled so far from remaining, and start at the smallest degree left.
+	uint64_t kept = 0;
+	uint32_t k = UINT32_MAX;
+	for (uint64_t i = 0; i < c->remaining_count; i++) {
+		slgraph_node_t v = c->remaining[i];
+		if (c->core[v] != NO_CORE) continue;
+		c->remaining[kept++] = v;
+		uint32_t d = atomic_load_explicit(&c->deg[v], memory_order_relaxed);
+		if (d < k) k = d;
+	}
+	c->remaining_count = kept;
+	if (!kept) {
+		c->done = 1;
+		return;
+	}
+
+	c->k = k;
+	for (uint64_t i = 0; i < kept; i++) {
+		slgraph_node_t v = c->remaining[i];
+		if (atomic_load_explicit(&c->deg[v], memory_order_relaxed) > k) continue;
+		c->core[v] = k;
+		c->frontier[c->frontier_size++] = v;
+	}
+	c->levels++;
+	c->rounds++;
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	kcore_t *c = w->c;
+
+	for (;;) {
+		if (w->id == 0) next_round(c);
+		pthread_barrier_wait(&c->barrier);
+		if (c->done) break;
+		peel(w);
+		pthread_barrier_wait(&c->barrier);
+	}
+	return NULL;
+}
+
+// Sequential reference: Batagelj and Zaversnik's O(m) algorithm with nodes sorted into buckets by degree.
+static int bz_cores(const slgraph_t *g, degree_t degree, uint32_t *core)
+{
+	uint64_t n = slgraph_nodes(g), max = 0;
+	uint64_t *deg = malloc(n * sizeof(uint64_t)), *pos = malloc(n * sizeof(uint64_t));
+	slgraph_node_t *vert = malloc(n * sizeof(slgraph_node_t));
+	uint64_t *bin = NULL;
+
+	if (!deg || !pos || !vert) goto fail;
+	for (uint64_t v = 0; v < n; v++) {
+		deg[v] = node_degree(g, degree, v);
+		if (deg[v] > max) max = deg[v];
+	}
+	if (!(bin = calloc(max + 2, sizeof(uint64_t)))) goto fail;
+	for (uint64_t v = 0; v < n; v++) bin[deg[v] + 1]++;
+	for (uint64_t d = 1; d <= max + 1; d++) bin[d] += bin[d - 1];
+	for (uint64_t v = 0; v < n; v++) {
+		pos[v] = bin[deg[v]]++;
+		vert[pos[v]] = v;
+	}
+	for (uint64_t d = max + 1; d > 0; d--) bin[d] = bin[d - 1];
+	bin[0] = 0;
+
+	for (uint64_t i = 0; i < n; i++) {
+		slgraph_node_t v = vert[i];
+		core[v] = (uint32_t)deg[v];
+		uint64_t count = dependents(g, degree, v);
+		for (uint64_t j = 0; j < count; j++) {
+			slgraph_node_t u = dependent(g, degree, v, j);
+			if (u >= n || pos[u] <= i || deg[u] <= deg[v]) continue;
+			// Swap u with the first node of its bucket, and move the bucket boundary past it.
+			uint64_t du = deg[u], pu = pos[u], pw = bin[du];
+			slgraph_node_t w = vert[pw];
+			if (w != u) {
+				pos[u] = pw;
+				vert[pw] = u;
+				pos[w] = pu;
+				vert[pu] = w;
+			}
+			bin[du]++;
+			deg[u]--;
+		}
+	}
+
+	free(deg);
+	free(pos);
+	free(vert);
+	free(bin);
+	return 0;
+fail:
+	free(deg);
+	free(pos);
+	free(vert);
+	free(bin);
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	degree_t degree = DEGREE_TOTAL;
+	int members = 0, original_ids = 0, store = 0, check = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--degree") == 0 && argi + 1 < argc - 1) {
+			argi++;
+			if (strcmp(argv[argi], "out") == 0) {
+				degree = DEGREE_OUT;
+			} else if (strcmp(argv[argi], "in") == 0) {
+				degree = DEGREE_IN;
+			} else if (strcmp(argv[argi], "total") == 0) {
+				degree = DEGREE_TOTAL;
+			} else {
+				break;
+			}
+		} else if (strcmp(argv[argi], "--members") == 0) {
+			members = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else if (strcmp(argv[argi], "--store") == 0) {
+			store = 1;
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1) {
+		fprintf(stderr, "Usage: %s [--threads T] [--degree total|out|in] [--members] [--original-ids] [--store] [--check] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	slgraph_t g;
+	if (slgraph_open_existing(&g, argv[argi], !store)) {
+		fprintf(stderr, "Failed to open graph%s: %s\n", store ? " for writing" : "", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	kcore_t c = {.g = &g, .degree = degree, .threads = (unsigned)threads};
+	c.deg = malloc(n * sizeof(_Atomic uint32_t));
+	c.core = malloc(n * sizeof(uint32_t));
+	c.remaining = malloc(n * sizeof(slgraph_node_t));
+	c.frontier = malloc(n * sizeof(slgraph_node_t));
+	c.next_frontier = malloc(n * sizeof(slgraph_node_t));
+	worker_t *workers = calloc(threads, sizeof(worker_t));
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+	if (!c.deg || !c.core || !c.remaining || !c.frontier || !c.next_frontier || !workers || !tids ||
+	    pthread_barrier_init(&c.barrier, NULL, (unsigned)threads)) {
+		fprintf(stderr, "Out of memory for k-core computation\n");
+		return 1;
+	}
+
+	for (uint64_t v = 0; v < n; v++) {
+		uint64_t d = node_degree(&g, degree, v);
+		atomic_init(&c.deg[v], d < UINT32_MAX ? (uint32_t)d : UINT32_MAX - 1);
+		c.core[v] = NO_CORE;
+		c.remaining[v] = v;
+	}
+	c.remaining_count = n;
+	atomic_init(&c.next_size, 0);
+	atomic_init(&c.next_chunk, 0);
+
+	unsigned started = 0;
+	for (; started < threads; started++) {
+		workers[started].c = &c;
+		workers[started].id = started;
+		if (started && pthread_create(&tids[started], NULL, worker, &workers[started])) break;
+	}
+	if (started != threads) {
+		// The barrier counts on all threads, so the ones started wait forever: give up.
+		fprintf(stderr, "Failed to start worker threads\n");
+		return 1;
+	}
+	worker(&workers[0]);
+	for (unsigned t = 1; t < threads; t++) pthread_join(tids[t], NULL);
+	pthread_barrier_destroy(&c.barrier);
+
+	uint32_t max_core = 0;
+	for (uint64_t v = 0; v < n; v++) {
+		if (c.core[v] > max_core) max_core = c.core[v];
+	}
+	uint64_t *histogram = calloc((uint64_t)max_core + 1, sizeof(uint64_t));
+	if (!histogram) {
+		fprintf(stderr, "Out of memory for the histogram\n");
+		return 1;
+	}
+	for (uint64_t v = 0; v < n; v++) histogram[c.core[v]]++;
+
+	static const char *const degree_names[] = {"total", "out", "in"};
+	printf("Stats: nodes=%lu edges=%lu mode=kcore degree=%s threads=%ld\n", (unsigned long)n, (unsigned long)slgraph_edges(&g),
+	       degree_names[degree], threads);
+	printf("max_core=%lu levels=%lu rounds=%lu\n", (unsigned long)max_core, (unsigned long)c.levels, (unsigned long)c.rounds);
+	printf("core_histogram:");
+	for (uint64_t k = 0; k <= max_core; k++) {
+		if (histogram[k]) printf(" %lu:%lu", (unsigned long)k, (unsigned long)histogram[k]);
+	}
+	printf("\nkcore_sizes:");
+	for (uint64_t k = 0, size = n; k <= max_core; size -= histogram[k++]) {
+		if (histogram[k]) printf(" %lu:%lu", (unsigned long)k, (unsigned long)size);
+	}
+	printf("\n");
+
+	int failed = 0;
+	if (check) {
+		uint32_t *expected = (uint32_t *)c.frontier; // No longer needed
+		uint64_t mismatched = 0;
+		if (bz_cores(&g, degree, expected)) {
+			fprintf(stderr, "Out of memory for the check\n");
+			failed = 1;
+		} else {
+			for (uint64_t v = 0; v < n; v++) mismatched += expected[v] != c.core[v];
+			printf("check=%s mismatched=%lu\n", mismatched ? "FAILED" : "OK", (unsigned long)mismatched);
+			failed = mismatched != 0;
+		}
+	}
+
+	if (store && (!slgraph_property_add(&g, "core", SLGRAPH_NODE_PROPERTY, SLGRAPH_U32) || slgraph_property_set(&g, "core", 0, n, c.core))) {
+		fprintf(stderr, "Failed to store the core numbers\n");
+		failed = 1;
+	}
+
+	for (slgraph_node_t v = 0; members && v < n; v++) {
+		printf("%lu %lu\n", (unsigned long)(original_ids ? slgraph_original_id(&g, v) : v), (unsigned long)c.core[v]);
+	}
+
+	free(histogram);
+	free((void *)c.deg);
+	free(c.core);
+	free(c.remaining);
+	free(c.frontier);
+	free(c.next_frontier);
+	free(workers);
+	free(tids);
+	slgraph_close(&g);
+	return failed;
+}
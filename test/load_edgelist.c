@@ -5,70 +5,230 @@
 //   - This loader streams the file and builds the slgraph directly.
 //
 // Input format:
-//   - One edge per line: "u v"
-//   - Lines starting with '#' or blank lines are ignored.
+//   - Text (default): one edge per line: "u v", or with --weighted "u v w",
+//     where a missing weight w is 1.
+//     Lines starting with '#' or blank lines are ignored.
+//   - Binary (--binary): packed little-endian records of two u64 node IDs,
+//     or with --binary-weighted of two u64 node IDs and an f64 weight.
+//   - Weights are stored in the edge property column "weight".
+//   - An input of "-" is read from stdin.
+//
+// Single pass:
+//   - The input is parsed once. Edges are spilled to an unlinked temporary file
+//     (in $TMPDIR, default /tmp) as packed records, which the second pass reads
+//     back, so stdin works and text is never parsed twice. A binary input file
+//     is re-read directly instead.
 //
 // Node IDs:
 //   - Original IDs can be large and sparse (e.g., OSM node IDs).
 //   - We remap them to a compact 0..N-1 range for slgraph storage.
+//   - The original IDs are stored in the graph (see slgraph_original_id()), so tools can report them.
 //
 // Directed vs undirected:
 //   - Default is directed edges.
 //   - Use --undirected to add edges as undirected.
 //
+// Sorted adjacency (directed only):
+//   - Use --sorted to sort incidence lists by neighbour, for fast slgraph_has_edge().
+//   - Use --dedup to skip edges that are already in the graph (implies --sorted).
+//
+// Sharded output (directed only):
+//   - Use --shards K to split the graph by node range into K shard files <output>.0 .. <output>.K-1,
+//     built by K parallel processes, and write a manifest to <output>. Open the manifest as the graph.
+//   - Use --shard I to build only shard I, e.g. on another machine. Then write the manifest
+//     with --manifest once all shard files are there.
+//
 // Usage:
-//   slgraph_load_edgelist [--undirected] <input.txt> <output.slg>
+//   slgraph_load_edgelist [--weighted | --binary | --binary-weighted] [--undirected] [--sorted] [--dedup] <input | -> <output.slg>
+//   slgraph_load_edgelist [--binary] [--sorted] --shards K [--shard I] <input | -> <output>
+//   slgraph_load_edgelist --shards K --manifest <output>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "slgraph.h"
 
+// Edges are read back in chunks of this many bytes.
+#define READ_BUFFER (1 << 16)
+
+typedef struct {
+	uint64_t u, v;
+	double w;
+} edge_t;
+
+// Reads packed edge records from a file descriptor with pread(), so forked shard builders can share it.
+typedef struct {
+	int fd;
+	off_t offset;
+	size_t recsize;
+	size_t len, pos;
+	unsigned char buf[READ_BUFFER];
+} edge_reader_t;
+
 static int cmp_u64(const void *a, const void *b) {
 	uint64_t va = *(const uint64_t *)a;
 	uint64_t vb = *(const uint64_t *)b;
 	return (va > vb) - (va < vb);
 }
 
+// Get the size of a packed edge record.
+static size_t record_size(int weighted) {
+	return weighted ? 24 : 16;
+}
+
+static void pack_edge(unsigned char *rec, const edge_t *e, int weighted) {
+	slgraph_write64(rec, e->u);
+	slgraph_write64(rec + 8, e->v);
+	if (weighted) {
+		uint64_t bits;
+		memcpy(&bits, &e->w, sizeof(bits));
+		slgraph_write64(rec + 16, bits);
+	}
+}
+
+static void unpack_edge(const unsigned char *rec, edge_t *e, int weighted) {
+	e->u = slgraph_read64(rec);
+	e->v = slgraph_read64(rec + 8);
+	e->w = 0.0;
+	if (weighted) {
+		uint64_t bits = slgraph_read64(rec + 16);
+		memcpy(&e->w, &bits, sizeof(bits));
+	}
+}
+
+// Get the next edge. Returns 1 if there is one, 0 at the end, -1 on read errors.
+static int next_edge(edge_reader_t *r, edge_t *e, int weighted) {
+	if (r->len - r->pos < r->recsize) {
+		memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+		r->len -= r->pos;
+		r->pos = 0;
+		while (r->len < r->recsize) {
+			ssize_t n = pread(r->fd, r->buf + r->len, sizeof(r->buf) - r->len, r->offset);
+			if (n < 0 && errno == EINTR) continue;
+			if (n < 0) return -1;
+			if (n == 0) return 0; // A trailing partial record is ignored.
+			r->len += n;
+			r->offset += n;
+		}
+	}
+	unpack_edge(r->buf + r->pos, e, weighted);
+	r->pos += r->recsize;
+	return 1;
+}
+
+// Parse a text edge line, with an optional weight if weighted. Returns 1 for an edge, 0 for lines to skip.
+static int parse_edge(const char *line, edge_t *e, int weighted) {
+	char *end;
+
+	if (line[0] == '#' || line[0] == '\n') return 0;
+	errno = 0;
+	e->u = strtoull(line, &end, 10);
+	if (end == line || errno) return 0;
+	line = end;
+	e->v = strtoull(line, &end, 10);
+	if (end == line || errno) return 0;
+	e->w = 0.0;
+	if (weighted) {
+		line = end;
+		e->w = strtod(line, &end);
+		if (end == line) e->w = 1.0;
+	}
+	return 1;
+}
+
+// Add an ID to the dynamic array of node IDs.
+static int push_id(uint64_t **ids, size_t *count, size_t *cap, uint64_t id) {
+	if (*count + 1 > *cap) {
+		uint64_t *tmp = realloc(*ids, *cap * 2 * sizeof(uint64_t));
+		if (!tmp) return -1;
+		*ids = tmp;
+		*cap *= 2;
+	}
+	(*ids)[(*count)++] = id;
+	return 0;
+}
+
+// Create an unlinked temporary file for spilled edges.
+static int spill_open(void) {
+	const char *dir = getenv("TMPDIR");
+	char *name = malloc(strlen(dir ? dir : "/tmp") + 32);
+	if (!name) return -1;
+	sprintf(name, "%s/slgraph_spill_XXXXXX", dir ? dir : "/tmp");
+	int fd = mkstemp(name);
+	if (fd != -1) unlink(name);
+	free(name);
+	return fd;
+}
+
 // First pass:
 //   Read all edges and collect every node ID in a dynamic array.
 //   This is the only data structure we keep in RAM.
-static int read_edge_ids(const char *path, uint64_t **out_ids, size_t *out_count) {
-	FILE *f = fopen(path, "r");
+//   Returns a file descriptor to read the edges from again as packed records: the input itself if it is a
+//   binary file, otherwise a spill file the edges are written to.
+static int read_edge_ids(const char *path, int binary, int weighted, uint64_t **out_ids, size_t *out_count, int *out_fd) {
+	const int from_stdin = !strcmp(path, "-");
+	FILE *f = from_stdin ? stdin : fopen(path, binary ? "rb" : "r");
 	if (!f) return -1;
 
+	const int spill = from_stdin || !binary;
+	const size_t recsize = record_size(weighted);
+	int fd = spill ? spill_open() : dup(fileno(f));
+	FILE *out = spill && fd != -1 ? fdopen(dup(fd), "wb") : NULL;
+
 	size_t cap = 1024;
 	size_t count = 0;
 	uint64_t *ids = malloc(cap * sizeof(uint64_t));
-	if (!ids) {
-		fclose(f);
+	if (!ids || fd == -1 || (spill && !out)) {
+		free(ids);
+		if (fd != -1) close(fd);
+		if (out) fclose(out);
+		if (!from_stdin) fclose(f);
 		return -1;
 	}
 
+	int failed = 0;
+	edge_t e;
+	unsigned char rec[24];
 	char line[256];
-	while (fgets(line, sizeof(line), f)) {
-		if (line[0] == '#' || line[0] == '\n') continue;
-		uint64_t u, v;
-		if (sscanf(line, "%lu %lu", &u, &v) != 2) continue;
-		if (count + 2 > cap) {
-			cap *= 2;
-			uint64_t *tmp = realloc(ids, cap * sizeof(uint64_t));
-			if (!tmp) {
-				free(ids);
-				fclose(f);
-				return -1;
+	for (;;) {
+		if (binary) {
+			if (fread(rec, recsize, 1, f) != 1) break;
+			unpack_edge(rec, &e, weighted);
+		} else {
+			if (!fgets(line, sizeof(line), f)) break;
+			if (!parse_edge(line, &e, weighted)) continue;
+		}
+		if (push_id(&ids, &count, &cap, e.u) || push_id(&ids, &count, &cap, e.v)) {
+			failed = 1;
+			break;
+		}
+		if (out) {
+			pack_edge(rec, &e, weighted);
+			if (fwrite(rec, recsize, 1, out) != 1) {
+				failed = 1;
+				break;
 			}
-			ids = tmp;
 		}
-		ids[count++] = u;
-		ids[count++] = v;
+	}
+	failed |= ferror(f);
+
+	if (!from_stdin) fclose(f);
+	if (out && fclose(out)) failed = 1;
+	if (failed) {
+		free(ids);
+		close(fd);
+		return -1;
 	}
 
-	fclose(f);
 	*out_ids = ids;
 	*out_count = count;
+	*out_fd = fd;
 	return 0;
 }
 
@@ -97,26 +257,146 @@ static uint64_t map_id(const uint64_t *ids, size_t n, uint64_t key) {
 	return (uint64_t)(found - ids);
 }
 
+// Get the file name of shard k of the sharded graph with manifest path (free() it).
+static char *shard_path(const char *path, unsigned k) {
+	char *name = malloc(strlen(path) + 16);
+	if (name) sprintf(name, "%s.%u", path, k);
+	return name;
+}
+
+// Build shard k of shards: the nodes in its range, and every edge that starts or ends there.
+static int load_shard(int edges_fd, const uint64_t *ids, size_t unique_count, const char *path, unsigned k, unsigned shards, int sorted) {
+	const uint64_t first = unique_count * k / shards;
+	const uint64_t last = unique_count * (k + 1) / shards;
+	char *name = shard_path(path, k);
+	slgraph_t g;
+
+	if (!name || slgraph_shard_new(&g, name, first, last - first, unique_count)) {
+		fprintf(stderr, "Failed to create shard (it must not exist yet): %s\n", name ? name : path);
+		free(name);
+		return 1;
+	}
+	if (last > first && slgraph_set_original_ids(&g, ids + first, last - first)) {
+		fprintf(stderr, "Failed to store original node IDs in %s\n", name);
+		slgraph_close(&g);
+		free(name);
+		return 1;
+	}
+
+	edge_reader_t *r = calloc(1, sizeof(edge_reader_t));
+	if (!r) {
+		fprintf(stderr, "Out of memory\n");
+		slgraph_close(&g);
+		free(name);
+		return 1;
+	}
+	r->fd = edges_fd;
+	r->recsize = record_size(0);
+
+	int ret = 0;
+	edge_t e;
+	while ((ret = next_edge(r, &e, 0)) > 0) {
+		uint64_t su = map_id(ids, unique_count, e.u);
+		uint64_t sv = map_id(ids, unique_count, e.v);
+		if (su == UINT64_MAX || sv == UINT64_MAX) continue;
+		if ((su < first || su >= last) && (sv < first || sv >= last)) continue;
+		if (slgraph_shard_add_edge(&g, su, sv) == SLGRAPH_INVALID_EDGE) {
+			fprintf(stderr, "Failed to add edge %lu -> %lu to %s\n", (unsigned long)e.u, (unsigned long)e.v, name);
+			ret = -1;
+			break;
+		}
+	}
+	free(r);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to build %s\n", name);
+		slgraph_close(&g);
+		free(name);
+		return 1;
+	}
+
+	if (sorted && slgraph_sort_adjacency(&g)) {
+		fprintf(stderr, "Failed to sort adjacency of %s\n", name);
+		ret = 1;
+	}
+
+	slgraph_close(&g);
+	free(name);
+	return ret;
+}
+
+static int write_manifest(const char *path, unsigned shards) {
+	char **names = calloc(shards, sizeof(char *));
+	int ret = !names;
+
+	for (unsigned k = 0; k < shards && !ret; k++) {
+		if (!(names[k] = shard_path(path, k))) ret = 1;
+	}
+	if (!ret && slgraph_shards_write_manifest(path, (const char *const *)names, shards)) {
+		fprintf(stderr, "Failed to write manifest %s (are all %u shard files complete?)\n", path, shards);
+		ret = 1;
+	}
+
+	for (unsigned k = 0; names && k < shards; k++) free(names[k]);
+	free(names);
+	return ret;
+}
+
 int main(int argc, char **argv) {
 	int undirected = 0;
+	int sorted = 0;
+	int dedup = 0;
+	int binary = 0;
+	int weighted = 0;
+	long shards = 0;
+	long shard = -1;
+	int manifest = 0;
 	const char *in_path = NULL;
 	const char *out_path = NULL;
 
-	if (argc == 3) {
-		in_path = argv[1];
-		out_path = argv[2];
-	} else if (argc == 4 && strcmp(argv[1], "--undirected") == 0) {
-		undirected = 1;
-		in_path = argv[2];
-		out_path = argv[3];
-	} else {
-		fprintf(stderr, "Usage: %s [--undirected] <input.txt> <output.slg>\n", argv[0]);
+	int argi = 1;
+	for (; argi < argc && strncmp(argv[argi], "--", 2) == 0; argi++) {
+		if (strcmp(argv[argi], "--undirected") == 0) {
+			undirected = 1;
+		} else if (strcmp(argv[argi], "--sorted") == 0) {
+			sorted = 1;
+		} else if (strcmp(argv[argi], "--dedup") == 0) {
+			sorted = 1;
+			dedup = 1;
+		} else if (strcmp(argv[argi], "--binary") == 0) {
+			binary = 1;
+		} else if (strcmp(argv[argi], "--weighted") == 0) {
+			weighted = 1;
+		} else if (strcmp(argv[argi], "--binary-weighted") == 0) {
+			binary = 1;
+			weighted = 1;
+		} else if (strcmp(argv[argi], "--shards") == 0 && argi + 1 < argc) {
+			shards = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--shard") == 0 && argi + 1 < argc) {
+			shard = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--manifest") == 0) {
+			manifest = 1;
+		} else {
+			break;
+		}
+	}
+	if (argc - argi != 2 - manifest || (undirected && sorted) || shards < 0 ||
+	    ((shard >= 0 || manifest) && (shard >= shards || !shards)) || (shards && (undirected || dedup || weighted))) {
+		fprintf(stderr, "Usage: %s [--weighted | --binary | --binary-weighted] [--undirected] [--sorted] [--dedup] <input | -> <output.slg>\n", argv[0]);
+		fprintf(stderr, "       %s [--binary] [--sorted] --shards K [--shard I] <input | -> <output>\n", argv[0]);
+		fprintf(stderr, "       %s --shards K --manifest <output>\n", argv[0]);
+		fprintf(stderr, "--sorted and --dedup apply to directed graphs only, --shards to directed graphs without --dedup and weights\n");
 		return 1;
 	}
+	if (manifest) {
+		return write_manifest(argv[argi], shards);
+	}
+	in_path = argv[argi];
+	out_path = argv[argi + 1];
 
 	uint64_t *ids = NULL;
 	size_t id_count = 0;
-	if (read_edge_ids(in_path, &ids, &id_count)) {
+	int edges_fd = -1;
+	if (read_edge_ids(in_path, binary, weighted, &ids, &id_count, &edges_fd)) {
 		fprintf(stderr, "Failed to read edge list: %s\n", in_path);
 		return 1;
 	}
@@ -127,14 +407,45 @@ int main(int argc, char **argv) {
 	if (unique_count == 0) {
 		fprintf(stderr, "No edges found in: %s\n", in_path);
 		free(ids);
+		close(edges_fd);
 		return 1;
 	}
 
+	if (shards) {
+		if (shard >= 0) {
+			int ret = load_shard(edges_fd, ids, unique_count, out_path, shard, shards, sorted);
+			free(ids);
+			close(edges_fd);
+			return ret;
+		}
+
+		// One process per shard. They share the ID mapping and the edges, but nothing else.
+		int failed = 0;
+		long started = 0;
+		for (; started < shards; started++) {
+			pid_t pid = fork();
+			if (pid == 0) _exit(load_shard(edges_fd, ids, unique_count, out_path, started, shards, sorted));
+			if (pid < 0) {
+				fprintf(stderr, "Failed to start process for shard %ld\n", started);
+				failed = 1;
+				break;
+			}
+		}
+		for (long k = 0; k < started; k++) {
+			int status;
+			if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) failed = 1;
+		}
+		free(ids);
+		close(edges_fd);
+		return failed || write_manifest(out_path, shards);
+	}
+
 	// Create an empty slgraph file and allocate N nodes.
 	slgraph_t g;
 	if (slgraph_open(&g, out_path, false)) {
 		fprintf(stderr, "Failed to open output graph: %s\n", out_path);
 		free(ids);
+		close(edges_fd);
 		return 1;
 	}
 
@@ -145,47 +456,93 @@ int main(int argc, char **argv) {
 			fprintf(stderr, "Failed to add node %lu\n", (unsigned long)i);
 			slgraph_close(&g);
 			free(ids);
+			close(edges_fd);
 			return 1;
 		}
 	}
 
-	FILE *f = fopen(in_path, "r");
-	if (!f) {
-		fprintf(stderr, "Failed to reopen input: %s\n", in_path);
+	if (slgraph_set_original_ids(&g, ids, unique_count)) {
+		fprintf(stderr, "Failed to store original node IDs\n");
 		slgraph_close(&g);
 		free(ids);
+		close(edges_fd);
 		return 1;
 	}
 
-	// Second pass: re-read edges, map IDs, and add them to slgraph.
-	char line[256];
-	while (fgets(line, sizeof(line), f)) {
-		if (line[0] == '#' || line[0] == '\n') continue;
-		uint64_t u, v;
-		if (sscanf(line, "%lu %lu", &u, &v) != 2) continue;
-		uint64_t su = map_id(ids, unique_count, u);
-		uint64_t sv = map_id(ids, unique_count, v);
+	// With --dedup the lists are kept sorted while loading, so each duplicate check is a binary search.
+	if (dedup && slgraph_sort_adjacency(&g)) {
+		fprintf(stderr, "Failed to enable sorted adjacency\n");
+		slgraph_close(&g);
+		free(ids);
+		close(edges_fd);
+		return 1;
+	}
+
+	if (weighted && !slgraph_property_add(&g, "weight", SLGRAPH_EDGE_PROPERTY, SLGRAPH_F64)) {
+		fprintf(stderr, "Failed to add weight column\n");
+		slgraph_close(&g);
+		free(ids);
+		close(edges_fd);
+		return 1;
+	}
+
+	edge_reader_t *r = calloc(1, sizeof(edge_reader_t));
+	if (!r) {
+		fprintf(stderr, "Out of memory\n");
+		slgraph_close(&g);
+		free(ids);
+		close(edges_fd);
+		return 1;
+	}
+	r->fd = edges_fd;
+	r->recsize = record_size(weighted);
+
+	// Second pass: read the edges back, map IDs, and add them to slgraph.
+	int ret;
+	edge_t e;
+	while ((ret = next_edge(r, &e, weighted)) > 0) {
+		uint64_t su = map_id(ids, unique_count, e.u);
+		uint64_t sv = map_id(ids, unique_count, e.v);
 		if (su == UINT64_MAX || sv == UINT64_MAX) continue;
+		slgraph_edge_t edge;
 		if (undirected) {
-			if (slgraph_add_edge(&g, su, sv) == SLGRAPH_INVALID_EDGE) {
-				fprintf(stderr, "Failed to add edge %lu -- %lu\n", u, v);
-				fclose(f);
-				slgraph_close(&g);
-				free(ids);
-				return 1;
+			if ((edge = slgraph_add_edge(&g, su, sv)) == SLGRAPH_INVALID_EDGE) {
+				fprintf(stderr, "Failed to add edge %lu -- %lu\n", (unsigned long)e.u, (unsigned long)e.v);
+				ret = -1;
+				break;
 			}
 		} else {
-			if (slgraph_add_directed_edge(&g, su, sv) == SLGRAPH_INVALID_EDGE) {
-				fprintf(stderr, "Failed to add edge %lu -> %lu\n", u, v);
-				fclose(f);
-				slgraph_close(&g);
-				free(ids);
-				return 1;
+			if (dedup && slgraph_has_edge(&g, su, sv)) continue;
+			if ((edge = slgraph_add_directed_edge(&g, su, sv)) == SLGRAPH_INVALID_EDGE) {
+				fprintf(stderr, "Failed to add edge %lu -> %lu\n", (unsigned long)e.u, (unsigned long)e.v);
+				ret = -1;
+				break;
 			}
 		}
+		if (weighted && slgraph_property_set(&g, "weight", edge, 1, &e.w)) {
+			fprintf(stderr, "Failed to store weight of edge %lu -> %lu\n", (unsigned long)e.u, (unsigned long)e.v);
+			ret = -1;
+			break;
+		}
+	}
+
+	free(r);
+	close(edges_fd);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to load edges from: %s\n", in_path);
+		slgraph_close(&g);
+		free(ids);
+		return 1;
+	}
+
+	// Sorting once at the end is cheaper than keeping the lists sorted during the load.
+	if (sorted && slgraph_sort_adjacency(&g)) {
+		fprintf(stderr, "Failed to sort adjacency\n");
+		slgraph_close(&g);
+		free(ids);
+		return 1;
 	}
 
-	fclose(f);
 	slgraph_close(&g);
 	free(ids);
 	return 0;
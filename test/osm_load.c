@@ -0,0 +1,773 @@
+// Build a directed SLGraph straight from an OpenStreetMap .osm.pbf file, without osmium, jq or
+// an intermediate edge list. Produces the same graph as
+//   scripts/prepare_edgelist.sh --mode osm ... --output - | slgraph_load_edgelist - <graph.slg>
+// but decodes the file blocks in parallel.
+//
+// What it does:
+//   - decompresses and decodes the zlib-compressed protobuf blocks on all cores (--threads N)
+//   - keeps ways with a "highway" tag and emits consecutive node refs as edges
+//   - compacts OSM node IDs to 0..N-1 in ascending order and adds the edges in file order
+//   - stores the OSM node IDs in the graph (see slgraph_original_id())
+//   - with --coords, stores node latitude and longitude in degrees in the node property
+//     columns "lat" and "lon" (NaN for nodes missing from the file)
+//
+// --undirected adds the reverse of every edge and implies --dedup, which skips edges that are
+// already in the graph. --sorted sorts the incidence lists by neighbour.
+//
+// Usage:
+//   slgraph_osm_load [--threads N] [--undirected] [--sorted] [--dedup] [--coords] <input.osm.pbf> <output.slg>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "slgraph.h"
+
+// Upper bounds from the PBF specification.
+#define MAX_HEADER_SIZE (64 * 1024)
+#define MAX_BLOB_SIZE (32 * 1024 * 1024)
+
+// Protobuf wire types.
+#define WIRE_VARINT 0
+#define WIRE_64BIT 1
+#define WIRE_BYTES 2
+#define WIRE_32BIT 5
+
+// A protobuf message or packed field that is being decoded.
+typedef struct {
+	const unsigned char *p;
+	const unsigned char *end;
+} pb_t;
+
+// An OSMData block of the file, and the edges of its highway ways.
+typedef struct {
+	const unsigned char *data;
+	uint64_t size;
+	uint64_t *pairs;
+	uint64_t pair_count;
+	int has_nodes;
+} block_t;
+
+typedef struct {
+	block_t *blocks;
+	uint64_t block_count;
+	atomic_uint_fast64_t next;
+	atomic_int failed;
+
+	// Sorted unique OSM node IDs, and the coordinates of the nodes with --coords.
+	const uint64_t *ids;
+	uint64_t id_count;
+	double *lat;
+	double *lon;
+} job_t;
+
+typedef void (*block_fn)(job_t *job, block_t *b, unsigned char **buf, uint64_t *cap);
+
+typedef struct {
+	job_t *job;
+	block_fn fn;
+} worker_t;
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a;
+	uint64_t vb = *(const uint64_t *)b;
+	return (va > vb) - (va < vb);
+}
+
+static int pb_varint(pb_t *m, uint64_t *v)
+{
+	*v = 0;
+	for (unsigned shift = 0; shift < 64 && m->p < m->end; shift += 7) {
+		unsigned char c = *m->p++;
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) return 0;
+	}
+	return -1;
+}
+
+static int64_t pb_zigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Get the next field of m. Returns 1 if there is one, 0 at the end of m, -1 if m is malformed.
+static int pb_field(pb_t *m, uint32_t *field, uint32_t *wire)
+{
+	uint64_t key;
+
+	if (m->p >= m->end) return 0;
+	if (pb_varint(m, &key)) return -1;
+	*field = key >> 3;
+	*wire = key & 7;
+	return 1;
+}
+
+// Get the value of a length-delimited field.
+static int pb_bytes(pb_t *m, pb_t *value)
+{
+	uint64_t len;
+
+	if (pb_varint(m, &len) || len > (uint64_t)(m->end - m->p)) return -1;
+	value->p = m->p;
+	value->end = m->p + len;
+	m->p += len;
+	return 0;
+}
+
+static int pb_skip(pb_t *m, uint32_t wire)
+{
+	uint64_t v;
+	pb_t value;
+
+	switch (wire) {
+	case WIRE_VARINT:
+		return pb_varint(m, &v);
+	case WIRE_64BIT:
+	case WIRE_32BIT:
+		v = wire == WIRE_64BIT ? 8 : 4;
+		if (v > (uint64_t)(m->end - m->p)) return -1;
+		m->p += v;
+		return 0;
+	case WIRE_BYTES:
+		return pb_bytes(m, &value);
+	default:
+		return -1;
+	}
+}
+
+static int pb_equals(const pb_t *s, const char *str)
+{
+	size_t len = strlen(str);
+	return (size_t)(s->end - s->p) == len && !memcmp(s->p, str, len);
+}
+
+// Get the uncompressed content of a Blob message into *buf (grown as needed). Returns its size, or -1 on errors.
+static int64_t blob_decode(const block_t *b, unsigned char **buf, uint64_t *cap)
+{
+	pb_t m = {b->data, b->data + b->size};
+	pb_t raw = {0, 0};
+	pb_t zdata = {0, 0};
+	uint64_t raw_size = 0;
+	uint32_t field, wire;
+	int r;
+
+	while ((r = pb_field(&m, &field, &wire)) > 0) {
+		if (field == 1 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &raw)) return -1;
+		} else if (field == 2 && wire == WIRE_VARINT) {
+			if (pb_varint(&m, &raw_size)) return -1;
+		} else if (field == 3 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &zdata)) return -1;
+		} else if (field >= 4 && field <= 7) {
+			fprintf(stderr, "Unsupported block compression (only zlib is supported)\n");
+			return -1;
+		} else if (pb_skip(&m, wire)) {
+			return -1;
+		}
+	}
+	if (r < 0) return -1;
+
+	if (raw.p) {
+		raw_size = raw.end - raw.p;
+	} else if (!zdata.p) {
+		return -1;
+	}
+	if (raw_size > MAX_BLOB_SIZE) return -1;
+	if (raw_size > *cap) {
+		unsigned char *tmp = realloc(*buf, raw_size);
+		if (!tmp) return -1;
+		*buf = tmp;
+		*cap = raw_size;
+	}
+
+	if (raw.p) {
+		memcpy(*buf, raw.p, raw_size);
+		return raw_size;
+	}
+	uLongf len = raw_size;
+	if (uncompress(*buf, &len, zdata.p, zdata.end - zdata.p) != Z_OK || len != raw_size) return -1;
+	return raw_size;
+}
+
+// Append pair (u, v) to the edges of b.
+static int block_add_pair(block_t *b, uint64_t *cap, uint64_t u, uint64_t v)
+{
+	if (b->pair_count == *cap) {
+		uint64_t newcap = *cap ? *cap * 2 : 1024;
+		uint64_t *tmp = realloc(b->pairs, newcap * 2 * sizeof(uint64_t));
+		if (!tmp) return -1;
+		b->pairs = tmp;
+		*cap = newcap;
+	}
+	b->pairs[2 * b->pair_count] = u;
+	b->pairs[2 * b->pair_count + 1] = v;
+	b->pair_count++;
+	return 0;
+}
+
+// Add the edges of a Way message to b, if it has a highway key (string table index highway).
+static int way_edges(pb_t m, uint64_t highway, block_t *b, uint64_t *cap)
+{
+	pb_t keys = {0, 0};
+	pb_t refs = {0, 0};
+	uint32_t field, wire;
+	int r;
+
+	while ((r = pb_field(&m, &field, &wire)) > 0) {
+		if (field == 2 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &keys)) return -1;
+		} else if (field == 8 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &refs)) return -1;
+		} else if (pb_skip(&m, wire)) {
+			return -1;
+		}
+	}
+	if (r < 0) return -1;
+
+	int found = 0;
+	uint64_t v;
+	while (keys.p < keys.end && !found) {
+		if (pb_varint(&keys, &v)) return -1;
+		found = v == highway;
+	}
+	if (!found) return 0;
+
+	// Refs are delta-coded.
+	int64_t prev = 0;
+	int64_t id = 0;
+	for (uint64_t i = 0; refs.p < refs.end; i++) {
+		if (pb_varint(&refs, &v)) return -1;
+		id += pb_zigzag(v);
+		if (i && block_add_pair(b, cap, prev, id)) return -1;
+		prev = id;
+	}
+	return 0;
+}
+
+// Decoded fields of a PrimitiveBlock message that are needed to interpret its groups.
+typedef struct {
+	int64_t granularity;
+	int64_t lat_offset;
+	int64_t lon_offset;
+} primitive_block_t;
+
+// Call fn for each PrimitiveGroup of the PrimitiveBlock message in m, with the index of string s in the string table
+// (UINT64_MAX if there is none). Returns 0 if successful.
+static int block_groups(pb_t m, const char *s, primitive_block_t *pb, uint64_t *index,
+                        int (*fn)(pb_t group, const primitive_block_t *pb, uint64_t index, void *arg), void *arg)
+{
+	pb_t msg = m;
+	uint32_t field, wire;
+	int r;
+
+	pb->granularity = 100;
+	pb->lat_offset = 0;
+	pb->lon_offset = 0;
+	*index = UINT64_MAX;
+
+	// The groups refer to the string table and the coordinate parameters, which may come later.
+	while ((r = pb_field(&msg, &field, &wire)) > 0) {
+		uint64_t v;
+		pb_t table, str;
+		if (field == 1 && wire == WIRE_BYTES) {
+			if (pb_bytes(&msg, &table)) return -1;
+			uint32_t f, w;
+			int rt;
+			for (uint64_t i = 0; (rt = pb_field(&table, &f, &w)) > 0; i++) {
+				if (f != 1 || w != WIRE_BYTES || pb_bytes(&table, &str)) return -1;
+				if (s && *index == UINT64_MAX && pb_equals(&str, s)) *index = i;
+			}
+			if (rt < 0) return -1;
+		} else if ((field == 17 || field == 19 || field == 20) && wire == WIRE_VARINT) {
+			if (pb_varint(&msg, &v)) return -1;
+			if (field == 17) pb->granularity = (int64_t)v;
+			else if (field == 19) pb->lat_offset = (int64_t)v;
+			else pb->lon_offset = (int64_t)v;
+		} else if (pb_skip(&msg, wire)) {
+			return -1;
+		}
+	}
+	if (r < 0) return -1;
+
+	msg = m;
+	while ((r = pb_field(&msg, &field, &wire)) > 0) {
+		pb_t group;
+		if (field == 2 && wire == WIRE_BYTES) {
+			if (pb_bytes(&msg, &group) || fn(group, pb, *index, arg)) return -1;
+		} else if (pb_skip(&msg, wire)) {
+			return -1;
+		}
+	}
+	return r;
+}
+
+typedef struct {
+	block_t *b;
+	uint64_t cap;
+} ways_arg_t;
+
+static int group_ways(pb_t group, const primitive_block_t *pb, uint64_t highway, void *arg)
+{
+	ways_arg_t *a = arg;
+	uint32_t field, wire;
+	int r;
+
+	(void)pb;
+	while ((r = pb_field(&group, &field, &wire)) > 0) {
+		pb_t way;
+		if (field == 3 && wire == WIRE_BYTES) {
+			if (pb_bytes(&group, &way)) return -1;
+			if (highway != UINT64_MAX && way_edges(way, highway, a->b, &a->cap)) return -1;
+		} else {
+			if ((field == 1 || field == 2) && wire == WIRE_BYTES) a->b->has_nodes = 1;
+			if (pb_skip(&group, wire)) return -1;
+		}
+	}
+	return r;
+}
+
+// First pass: collect the edges of the highway ways in b.
+static void block_ways(job_t *job, block_t *b, unsigned char **buf, uint64_t *cap)
+{
+	int64_t len = blob_decode(b, buf, cap);
+	primitive_block_t pb;
+	uint64_t highway;
+	ways_arg_t arg = {b, 0};
+
+	if (len < 0 || block_groups((pb_t){*buf, *buf + len}, "highway", &pb, &highway, group_ways, &arg)) {
+		atomic_store(&job->failed, 1);
+	}
+}
+
+// Store the coordinates of OSM node id, if it is in the graph.
+static void node_coords(job_t *job, const primitive_block_t *pb, int64_t id, int64_t lat, int64_t lon)
+{
+	uint64_t key = id;
+	const uint64_t *found = bsearch(&key, job->ids, job->id_count, sizeof(uint64_t), cmp_u64);
+	if (!found) return;
+	job->lat[found - job->ids] = 1e-9 * (pb->lat_offset + pb->granularity * lat);
+	job->lon[found - job->ids] = 1e-9 * (pb->lon_offset + pb->granularity * lon);
+}
+
+static int dense_coords(job_t *job, const primitive_block_t *pb, pb_t m)
+{
+	pb_t ids = {0, 0};
+	pb_t lats = {0, 0};
+	pb_t lons = {0, 0};
+	uint32_t field, wire;
+	int r;
+
+	while ((r = pb_field(&m, &field, &wire)) > 0) {
+		if (field == 1 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &ids)) return -1;
+		} else if (field == 8 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &lats)) return -1;
+		} else if (field == 9 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &lons)) return -1;
+		} else if (pb_skip(&m, wire)) {
+			return -1;
+		}
+	}
+	if (r < 0) return -1;
+
+	// All three are delta-coded.
+	int64_t id = 0, lat = 0, lon = 0;
+	while (ids.p < ids.end) {
+		uint64_t v0, v1, v2;
+		if (pb_varint(&ids, &v0) || pb_varint(&lats, &v1) || pb_varint(&lons, &v2)) return -1;
+		id += pb_zigzag(v0);
+		lat += pb_zigzag(v1);
+		lon += pb_zigzag(v2);
+		node_coords(job, pb, id, lat, lon);
+	}
+	return 0;
+}
+
+static int node_message_coords(job_t *job, const primitive_block_t *pb, pb_t m)
+{
+	int64_t id = 0, lat = 0, lon = 0;
+	uint32_t field, wire;
+	int r;
+
+	while ((r = pb_field(&m, &field, &wire)) > 0) {
+		uint64_t v;
+		if ((field == 1 || field == 8 || field == 9) && wire == WIRE_VARINT) {
+			if (pb_varint(&m, &v)) return -1;
+			if (field == 1) id = pb_zigzag(v);
+			else if (field == 8) lat = pb_zigzag(v);
+			else lon = pb_zigzag(v);
+		} else if (pb_skip(&m, wire)) {
+			return -1;
+		}
+	}
+	if (r < 0) return -1;
+	node_coords(job, pb, id, lat, lon);
+	return 0;
+}
+
+static int group_coords(pb_t group, const primitive_block_t *pb, uint64_t index, void *arg)
+{
+	job_t *job = arg;
+	uint32_t field, wire;
+	int r;
+
+	(void)index;
+	while ((r = pb_field(&group, &field, &wire)) > 0) {
+		pb_t m;
+		if ((field == 1 || field == 2) && wire == WIRE_BYTES) {
+			if (pb_bytes(&group, &m)) return -1;
+			if (field == 1 ? node_message_coords(job, pb, m) : dense_coords(job, pb, m)) return -1;
+		} else if (pb_skip(&group, wire)) {
+			return -1;
+		}
+	}
+	return r;
+}
+
+// Second pass (--coords only): store the coordinates of the nodes in b.
+static void block_coords(job_t *job, block_t *b, unsigned char **buf, uint64_t *cap)
+{
+	if (!b->has_nodes) return;
+
+	int64_t len = blob_decode(b, buf, cap);
+	primitive_block_t pb;
+	uint64_t index;
+
+	if (len < 0 || block_groups((pb_t){*buf, *buf + len}, 0, &pb, &index, group_coords, job)) {
+		atomic_store(&job->failed, 1);
+	}
+}
+
+// Replace the OSM node IDs of the edges of b by compact IDs.
+static void block_map(job_t *job, block_t *b, unsigned char **buf, uint64_t *cap)
+{
+	(void)buf;
+	(void)cap;
+	for (uint64_t i = 0; i < 2 * b->pair_count; i++) {
+		const uint64_t *found = bsearch(&b->pairs[i], job->ids, job->id_count, sizeof(uint64_t), cmp_u64);
+		b->pairs[i] = found - job->ids;
+	}
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	job_t *job = w->job;
+	unsigned char *buf = NULL;
+	uint64_t cap = 0;
+
+	for (;;) {
+		uint64_t i = atomic_fetch_add(&job->next, 1);
+		if (i >= job->block_count || atomic_load(&job->failed)) break;
+		w->fn(job, &job->blocks[i], &buf, &cap);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+// Call fn for every block on threads threads. Returns 0 if successful.
+static int run_blocks(job_t *job, block_fn fn, long threads)
+{
+	worker_t w = {job, fn};
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+	long started = 0;
+
+	atomic_store(&job->next, 0);
+	for (; tids && started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, &w)) break;
+	}
+	if (!started) worker(&w);
+	for (long t = 0; t < started; t++) {
+		pthread_join(tids[t], NULL);
+	}
+	free(tids);
+	return atomic_load(&job->failed);
+}
+
+// Check that the features required by the OSMHeader block b are supported.
+static int check_header(const block_t *b)
+{
+	unsigned char *buf = NULL;
+	uint64_t cap = 0;
+	int64_t len = blob_decode(b, &buf, &cap);
+	int ret = len < 0 ? -1 : 0;
+	pb_t m = {buf, buf + (len < 0 ? 0 : len)};
+	uint32_t field, wire;
+	int r = 0;
+
+	while (!ret && (r = pb_field(&m, &field, &wire)) > 0) {
+		pb_t feature;
+		if (field == 4 && wire == WIRE_BYTES) {
+			if (pb_bytes(&m, &feature)) {
+				ret = -1;
+			} else if (!pb_equals(&feature, "OsmSchema-V0.6") && !pb_equals(&feature, "DenseNodes")) {
+				fprintf(stderr, "Unsupported required feature: %.*s\n", (int)(feature.end - feature.p), (const char *)feature.p);
+				ret = -1;
+			}
+		} else if (pb_skip(&m, wire)) {
+			ret = -1;
+		}
+	}
+	if (!ret && r < 0) ret = -1;
+
+	free(buf);
+	return ret;
+}
+
+// Split the file into its blocks and check the header. Returns the OSMData blocks, or 0 on errors.
+static block_t *read_blocks(const unsigned char *data, uint64_t size, uint64_t *count)
+{
+	block_t *blocks = NULL;
+	uint64_t cap = 0;
+	uint64_t pos = 0;
+	int header = 0;
+
+	*count = 0;
+	while (pos < size) {
+		if (size - pos < 4) goto fail;
+		uint64_t header_size = (uint64_t)data[pos] << 24 | data[pos + 1] << 16 | data[pos + 2] << 8 | data[pos + 3];
+		pos += 4;
+		if (header_size > MAX_HEADER_SIZE || header_size > size - pos) goto fail;
+
+		// BlobHeader: type and size of the following Blob.
+		pb_t m = {data + pos, data + pos + header_size};
+		pb_t type = {0, 0};
+		uint64_t blob_size = 0;
+		uint32_t field, wire;
+		int r;
+		while ((r = pb_field(&m, &field, &wire)) > 0) {
+			if (field == 1 && wire == WIRE_BYTES) {
+				if (pb_bytes(&m, &type)) goto fail;
+			} else if (field == 3 && wire == WIRE_VARINT) {
+				if (pb_varint(&m, &blob_size)) goto fail;
+			} else if (pb_skip(&m, wire)) {
+				goto fail;
+			}
+		}
+		pos += header_size;
+		if (r < 0 || !type.p || blob_size > size - pos) goto fail;
+
+		block_t b = {data + pos, blob_size, NULL, 0, 0};
+		pos += blob_size;
+		if (pb_equals(&type, "OSMHeader")) {
+			if (check_header(&b)) goto fail;
+			header = 1;
+		} else if (pb_equals(&type, "OSMData")) {
+			if (*count == cap) {
+				cap = cap ? cap * 2 : 1024;
+				block_t *tmp = realloc(blocks, cap * sizeof(block_t));
+				if (!tmp) goto fail;
+				blocks = tmp;
+			}
+			blocks[(*count)++] = b;
+		}
+		// Unknown block types are skipped, as the specification requires.
+	}
+	if (!header) goto fail;
+	return blocks;
+
+fail:
+	free(blocks);
+	return NULL;
+}
+
+// Sort IDs and remove duplicates. Returns the number of unique IDs.
+static uint64_t unique_ids(uint64_t *ids, uint64_t count)
+{
+	if (!count) return 0;
+	qsort(ids, count, sizeof(uint64_t), cmp_u64);
+	uint64_t w = 1;
+	for (uint64_t i = 1; i < count; i++) {
+		if (ids[i] != ids[w - 1]) ids[w++] = ids[i];
+	}
+	return w;
+}
+
+static int build_graph(const job_t *job, const char *path, int undirected, int sorted, int dedup, int coords)
+{
+	slgraph_t g;
+	int ret = 0;
+
+	if (slgraph_open(&g, path, false)) {
+		fprintf(stderr, "Failed to open output graph: %s\n", path);
+		return 1;
+	}
+	slgraph_nodelist_expand(&g, job->id_count);
+	for (uint64_t i = 0; i < job->id_count; i++) {
+		if (slgraph_add_node(&g) == SLGRAPH_INVALID_NODE) {
+			fprintf(stderr, "Failed to add node %lu\n", (unsigned long)i);
+			slgraph_close(&g);
+			return 1;
+		}
+	}
+
+	if (slgraph_set_original_ids(&g, job->ids, job->id_count)) {
+		fprintf(stderr, "Failed to store OSM node IDs\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	// With --dedup the lists are kept sorted while loading, so each duplicate check is a binary search.
+	if (dedup && slgraph_sort_adjacency(&g)) {
+		fprintf(stderr, "Failed to enable sorted adjacency\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	for (uint64_t i = 0; i < job->block_count && !ret; i++) {
+		const block_t *b = &job->blocks[i];
+		for (uint64_t j = 0; j < b->pair_count && !ret; j++) {
+			for (int k = 0; k <= undirected && !ret; k++) {
+				slgraph_node_t u = b->pairs[2 * j + k];
+				slgraph_node_t v = b->pairs[2 * j + 1 - k];
+				if (dedup && slgraph_has_edge(&g, u, v)) continue;
+				if (slgraph_add_directed_edge(&g, u, v) == SLGRAPH_INVALID_EDGE) {
+					fprintf(stderr, "Failed to add edge %lu -> %lu\n", (unsigned long)job->ids[u], (unsigned long)job->ids[v]);
+					ret = 1;
+				}
+			}
+		}
+	}
+
+	if (!ret && coords && (!slgraph_property_add(&g, "lat", SLGRAPH_NODE_PROPERTY, SLGRAPH_F64) ||
+	                       !slgraph_property_add(&g, "lon", SLGRAPH_NODE_PROPERTY, SLGRAPH_F64) ||
+	                       slgraph_property_set(&g, "lat", 0, job->id_count, job->lat) ||
+	                       slgraph_property_set(&g, "lon", 0, job->id_count, job->lon))) {
+		fprintf(stderr, "Failed to store coordinates\n");
+		ret = 1;
+	}
+
+	// Sorting once at the end is cheaper than keeping the lists sorted during the load.
+	if (!ret && sorted && !dedup && slgraph_sort_adjacency(&g)) {
+		fprintf(stderr, "Failed to sort adjacency\n");
+		ret = 1;
+	}
+
+	if (!ret) {
+		printf("Stats: nodes=%lu edges=%lu mode=osm_load\n", (unsigned long)slgraph_nodes(&g), (unsigned long)slgraph_edges(&g));
+	}
+
+	slgraph_close(&g);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int undirected = 0;
+	int sorted = 0;
+	int dedup = 0;
+	int coords = 0;
+	int argi = 1;
+
+	for (; argi < argc - 2; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 2) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--undirected") == 0) {
+			undirected = 1;
+			dedup = 1;
+		} else if (strcmp(argv[argi], "--sorted") == 0) {
+			sorted = 1;
+		} else if (strcmp(argv[argi], "--dedup") == 0) {
+			dedup = 1;
+		} else if (strcmp(argv[argi], "--coords") == 0) {
+			coords = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 2) {
+		fprintf(stderr, "Usage: %s [--threads N] [--undirected] [--sorted] [--dedup] [--coords] <input.osm.pbf> <output.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	int fd = open(argv[argi], O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) || !st.st_size) {
+		fprintf(stderr, "Failed to open input: %s\n", argv[argi]);
+		if (fd >= 0) close(fd);
+		return 1;
+	}
+	const unsigned char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Failed to map input: %s\n", argv[argi]);
+		return 1;
+	}
+
+	job_t job;
+	memset(&job, 0, sizeof(job));
+	atomic_init(&job.next, 0);
+	atomic_init(&job.failed, 0);
+	if (!(job.blocks = read_blocks(data, st.st_size, &job.block_count))) {
+		fprintf(stderr, "Not a supported .osm.pbf file: %s\n", argv[argi]);
+		munmap((void *)data, st.st_size);
+		return 1;
+	}
+
+	int ret = 0;
+	uint64_t *ids = NULL;
+	if (run_blocks(&job, block_ways, threads)) {
+		fprintf(stderr, "Failed to decode ways from: %s\n", argv[argi]);
+		ret = 1;
+	}
+
+	// Compact node IDs.
+	uint64_t pair_count = 0;
+	for (uint64_t i = 0; i < job.block_count; i++) pair_count += job.blocks[i].pair_count;
+	if (!ret && !(ids = malloc((2 * pair_count + 1) * sizeof(uint64_t)))) {
+		fprintf(stderr, "Out of memory for %lu edges\n", (unsigned long)pair_count);
+		ret = 1;
+	}
+	for (uint64_t i = 0, n = 0; !ret && i < job.block_count; i++) {
+		if (!job.blocks[i].pair_count) continue;
+		memcpy(ids + n, job.blocks[i].pairs, 2 * job.blocks[i].pair_count * sizeof(uint64_t));
+		n += 2 * job.blocks[i].pair_count;
+	}
+	if (!ret) {
+		job.ids = ids;
+		job.id_count = unique_ids(ids, 2 * pair_count);
+		if (!job.id_count) {
+			fprintf(stderr, "No highway ways found in: %s\n", argv[argi]);
+			ret = 1;
+		}
+	}
+
+	if (!ret && coords) {
+		job.lat = malloc(job.id_count * sizeof(double));
+		job.lon = malloc(job.id_count * sizeof(double));
+		if (!job.lat || !job.lon) {
+			fprintf(stderr, "Out of memory for coordinates\n");
+			ret = 1;
+		}
+		for (uint64_t i = 0; !ret && i < job.id_count; i++) job.lat[i] = job.lon[i] = NAN;
+		if (!ret && run_blocks(&job, block_coords, threads)) {
+			fprintf(stderr, "Failed to decode nodes from: %s\n", argv[argi]);
+			ret = 1;
+		}
+	}
+
+	if (!ret) run_blocks(&job, block_map, threads);
+	if (!ret) ret = build_graph(&job, argv[argi + 1], undirected, sorted, dedup, coords);
+
+	for (uint64_t i = 0; i < job.block_count; i++) free(job.blocks[i].pairs);
+	free(job.blocks);
+	free(ids);
+	free(job.lat);
+	free(job.lon);
+	munmap((void *)data, st.st_size);
+	return ret;
+}
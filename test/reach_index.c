@@ -0,0 +1,501 @@
+// Build a reachability index of a directed SLGraph and answer batched "can u reach v" queries with it.
+//
+// Usage:
+//   slgraph_reach_index [--build] [--labels D] [--seed S] [--queries Q] [--pairs FILE] [--print] [--original-ids]
+//                       [--check] <graph.slg>
+//
+// --build condenses the graph into the DAG of its strongly connected components, numbered in topological order, and
+// gives every component D intervals (default 3), one per DFS of the DAG with the roots and the children of every
+// component taken in a random order (GRAIL, Yildirim, Chaoji and Zaki): post is its postorder number and low the
+// smallest postorder number below it, so if u reaches v the intervals of v lie within those of u. The index is stored
+// in the graph (see slgraph_set_reach()) and dropped when the graph is modified.
+//
+// Then it runs Q queries (default 1000) between random nodes, or one for each "<u> <v>" line of FILE ("-" for stdin),
+// on the stored index. A query is answered at once if u and v are in the same component, if the component of v comes
+// before that of u, or if an interval of v is not within that of u. Otherwise a DFS of the DAG from the component of u
+// looks for that of v, skipping components that come after it or whose intervals don't contain its intervals.
+//
+// Prints how the queries were answered, the mean numbers of components searched and DAG edges looked at per search, and
+// the latency percentiles. --print prints "<u> <v> <1 if u reaches v, else 0>" per query, by input IDs with
+// --original-ids. --check compares every answer with a BFS of the graph.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "slgraph.h"
+
+typedef struct {
+	uint64_t node;
+	uint64_t next;
+} frame_t;
+
+// Query state, over components.
+typedef struct {
+	const slgraph_reach_t *r;
+	uint32_t *stamp;            // Query that visited the component
+	uint32_t query;
+	uint64_t *stack;
+	uint64_t visited;           // Components searched, over all queries
+	uint64_t scanned;           // DAG edges looked at, over all queries
+} search_t;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double now(void)
+{
+	return now_ns() / 1e9;
+}
+
+static uint64_t splitmix(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// === Building ===
+
+// Number the strongly connected components of g in topological order (Kosaraju: a DFS for the finish order, then
+// searches along in-edges in decreasing finish order, which find a source component first). Returns the number of
+// components, or 0 if out of memory.
+static uint64_t components(const slgraph_t *g, uint64_t *component)
+{
+	uint64_t n = slgraph_nodes(g), count = 0, order_len = 0;
+	uint64_t *order = malloc(n * sizeof(uint64_t));
+	frame_t *stack = malloc(n * sizeof(frame_t));
+
+	if (!order || !stack) {
+		free(order);
+		free(stack);
+		return 0;
+	}
+
+	for (uint64_t v = 0; v < n; v++) component[v] = UINT64_MAX;
+	for (uint64_t start = 0; start < n; start++) {
+		uint64_t sp = 0;
+		if (component[start] != UINT64_MAX) continue;
+		component[start] = 0; // Visited
+		stack[sp++] = (frame_t){start, 0};
+		while (sp) {
+			frame_t *top = &stack[sp - 1];
+			if (top->next < slgraph_out_degree(g, top->node)) {
+				slgraph_node_t u = slgraph_out_neighbour(g, top->node, top->next++);
+				if (u < n && component[u] == UINT64_MAX) {
+					component[u] = 0;
+					stack[sp++] = (frame_t){u, 0};
+				}
+				continue;
+			}
+			order[order_len++] = top->node;
+			sp--;
+		}
+	}
+
+	// The stack is only needed as a plain node stack now.
+	uint64_t *nodes = (uint64_t *)stack;
+	for (uint64_t v = 0; v < n; v++) component[v] = UINT64_MAX;
+	for (uint64_t i = n; i > 0; i--) {
+		uint64_t start = order[i - 1], sp = 0;
+		if (component[start] != UINT64_MAX) continue;
+		component[start] = count;
+		nodes[sp++] = start;
+		while (sp) {
+			slgraph_node_t v = nodes[--sp];
+			uint_fast64_t deg = slgraph_in_degree(g, v);
+			for (uint_fast64_t k = 0; k < deg; k++) {
+				slgraph_node_t u = slgraph_in_neighbour(g, v, k);
+				if (u >= n || component[u] != UINT64_MAX) continue;
+				component[u] = count;
+				nodes[sp++] = u;
+			}
+		}
+		count++;
+	}
+
+	free(order);
+	free(stack);
+	return count;
+}
+
+// The edges between components as CSR arrays, with the targets of each component in increasing order. Returns 0 if successful.
+static int condense(const slgraph_t *g, slgraph_reach_t *r, uint64_t **dag, uint64_t **targets)
+{
+	uint64_t n = slgraph_nodes(g), c = r->components;
+
+	*targets = NULL;
+	if (!(*dag = calloc(c + 1, sizeof(uint64_t)))) return -1;
+	for (uint64_t v = 0; v < n; v++) {
+		uint_fast64_t deg = slgraph_out_degree(g, v);
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t u = slgraph_out_neighbour(g, v, k);
+			if (u < n && r->component[u] != r->component[v]) (*dag)[r->component[v] + 1]++;
+		}
+	}
+	for (uint64_t i = 0; i < c; i++) (*dag)[i + 1] += (*dag)[i];
+
+	if (!(*targets = malloc(((*dag)[c] ? (*dag)[c] : 1) * sizeof(uint64_t)))) return -1;
+	for (uint64_t v = 0; v < n; v++) {
+		uint_fast64_t deg = slgraph_out_degree(g, v);
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t u = slgraph_out_neighbour(g, v, k);
+			if (u < n && r->component[u] != r->component[v]) (*targets)[(*dag)[r->component[v]]++] = r->component[u];
+		}
+	}
+	// Filling moved every offset to the next component's; shift them back while removing duplicates.
+	uint64_t kept = 0, first = 0;
+	for (uint64_t i = 0; i < c; i++) {
+		uint64_t end = (*dag)[i];
+		qsort(*targets + first, end - first, sizeof(uint64_t), cmp_u64);
+		(*dag)[i] = kept;
+		for (uint64_t j = first; j < end; j++) {
+			if (j == first || (*targets)[j] != (*targets)[j - 1]) (*targets)[kept++] = (*targets)[j];
+		}
+		first = end;
+	}
+	(*dag)[c] = kept;
+	return 0;
+}
+
+// Compute interval labelling i of every component by a DFS from the roots of the DAG in random order, taking the
+// children of each component from a random position on. Returns 0 if successful.
+static int label(slgraph_reach_t *r, uint64_t *intervals, const uint64_t *in_degree, uint64_t i, uint64_t seed)
+{
+	uint64_t c = r->components, post = 0, state = seed;
+	frame_t *stack = malloc(c * sizeof(frame_t));
+	unsigned char *visited = calloc(c, 1);
+
+	if (!stack || !visited) {
+		free(stack);
+		free(visited);
+		return -1;
+	}
+
+	uint64_t rotation = splitmix(&state) % c;
+	for (uint64_t j = 0; j < c; j++) {
+		uint64_t root = (j + rotation) % c, sp = 0;
+		if (in_degree[root] || visited[root]) continue;
+		visited[root] = 1;
+		stack[sp++] = (frame_t){root, 0};
+		while (sp) {
+			frame_t *top = &stack[sp - 1];
+			uint64_t x = top->node, deg = r->dag[x + 1] - r->dag[x];
+			uint64_t *low = &intervals[2 * (x * r->labels + i)];
+			if (top->next == 0) *low = UINT64_MAX;
+			if (top->next < deg) {
+				// Children from a position that depends on the labelling and the component.
+				uint64_t mix = seed ^ (x * 0x9e3779b97f4a7c15ULL);
+				uint64_t child = r->dag_targets[r->dag[x] + (splitmix(&mix) + top->next++) % deg];
+				if (!visited[child]) {
+					visited[child] = 1;
+					stack[sp++] = (frame_t){child, 0};
+				} else {
+					uint64_t child_low = intervals[2 * (child * r->labels + i)];
+					if (child_low < *low) *low = child_low;
+				}
+				continue;
+			}
+			// Done with x: its interval, and the smallest low for its parent.
+			intervals[2 * (x * r->labels + i) + 1] = post;
+			if (post < *low) *low = post;
+			post++;
+			sp--;
+			if (sp) {
+				uint64_t *parent_low = &intervals[2 * (stack[sp - 1].node * r->labels + i)];
+				if (*low < *parent_low) *parent_low = *low;
+			}
+		}
+	}
+
+	free(stack);
+	free(visited);
+	return 0;
+}
+
+// === Queries ===
+
+// Whether every interval of component d is within that of component c.
+static int contains(const slgraph_reach_t *r, uint64_t c, uint64_t d)
+{
+	const uint64_t *a = &r->intervals[2 * c * r->labels], *b = &r->intervals[2 * d * r->labels];
+
+	for (uint64_t i = 0; i < r->labels; i++) {
+		if (b[2 * i] < a[2 * i] || b[2 * i + 1] > a[2 * i + 1]) return 0;
+	}
+	return 1;
+}
+
+typedef enum {
+	BY_COMPONENT,   // Same component
+	BY_ORDER,       // Topological order rules it out
+	BY_LABELS,      // Intervals rule it out
+	BY_SEARCH,      // Needed a DFS
+	BY_COUNT
+} answer_t;
+
+// Whether u reaches v, and how that was found out.
+static int reaches(search_t *s, uint64_t u, uint64_t v, answer_t *by)
+{
+	const slgraph_reach_t *r = s->r;
+	uint64_t cu = r->component[u], cv = r->component[v], sp = 0;
+
+	if (cu == cv) return (*by = BY_COMPONENT, 1);
+	if (cu > cv) return (*by = BY_ORDER, 0);
+	if (!contains(r, cu, cv)) return (*by = BY_LABELS, 0);
+	*by = BY_SEARCH;
+
+	if (++s->query == 0) {
+		memset(s->stamp, 0, r->components * sizeof(uint32_t));
+		s->query = 1;
+	}
+	s->stamp[cu] = s->query;
+	s->stack[sp++] = cu;
+	while (sp) {
+		uint64_t c = s->stack[--sp];
+		s->visited++;
+		// The targets are in increasing order: look for an edge to cv by bisection, then search the targets before it,
+		// as the ones after it cannot reach it.
+		uint64_t first = r->dag[c], end = r->dag[c + 1];
+		while (first < end) {
+			uint64_t mid = first + (end - first) / 2;
+			if (r->dag_targets[mid] < cv) {
+				first = mid + 1;
+			} else {
+				end = mid;
+			}
+		}
+		if (first < r->dag[c + 1] && r->dag_targets[first] == cv) return 1;
+		for (uint64_t k = r->dag[c]; k < first; k++) {
+			uint64_t d = r->dag_targets[k];
+			s->scanned++;
+			if (s->stamp[d] == s->query || !contains(r, d, cv)) continue;
+			s->stamp[d] = s->query;
+			s->stack[sp++] = d;
+		}
+	}
+	return 0;
+}
+
+// Whether u reaches v, by BFS of g. seen must be zero and is left so.
+static int bfs_reaches(const slgraph_t *g, uint64_t u, uint64_t v, unsigned char *seen, uint64_t *queue)
+{
+	uint64_t n = slgraph_nodes(g), head = 0, tail = 0;
+	int found = u == v;
+
+	seen[u] = 1;
+	queue[tail++] = u;
+	while (head < tail && !found) {
+		slgraph_node_t x = queue[head++];
+		uint_fast64_t deg = slgraph_out_degree(g, x);
+		for (uint_fast64_t k = 0; k < deg && !found; k++) {
+			slgraph_node_t y = slgraph_out_neighbour(g, x, k);
+			if (y >= n || seen[y]) continue;
+			seen[y] = 1;
+			queue[tail++] = y;
+			found = y == v;
+		}
+	}
+	for (uint64_t i = 0; i < tail; i++) seen[queue[i]] = 0;
+	return found;
+}
+
+static int build(slgraph_t *g, uint64_t labels, uint64_t seed)
+{
+	uint64_t n = slgraph_nodes(g);
+	slgraph_reach_t r = {.labels = labels};
+	uint64_t *component = malloc(n * sizeof(uint64_t)), *dag = NULL, *targets = NULL, *intervals = NULL, *in_degree = NULL;
+	int failed = !component;
+
+	double t0 = now();
+	if (!failed) failed = !(r.components = components(g, component));
+	r.component = component;
+	double t1 = now();
+	if (!failed) failed = condense(g, &r, &dag, &targets);
+	r.dag = dag;
+	r.dag_targets = targets;
+	double t2 = now();
+
+	if (!failed) failed = !(intervals = malloc(r.components * labels * 2 * sizeof(uint64_t))) || !(in_degree = calloc(r.components, sizeof(uint64_t)));
+	for (uint64_t k = 0; !failed && k < dag[r.components]; k++) in_degree[targets[k]]++;
+	r.intervals = intervals;
+	uint64_t state = seed;
+	for (uint64_t i = 0; !failed && i < labels; i++) failed = label(&r, intervals, in_degree, i, splitmix(&state));
+	double t3 = now();
+
+	if (failed) {
+		fprintf(stderr, "Out of memory for the reachability index\n");
+	} else if (slgraph_set_reach(g, &r)) {
+		fprintf(stderr, "Failed to store the reachability index\n");
+		failed = 1;
+	} else {
+		printf("components=%lu dag_edges=%lu labels=%lu scc_time=%.3f dag_time=%.3f label_time=%.3f\n",
+		       (unsigned long)r.components, (unsigned long)dag[r.components], (unsigned long)labels, t1 - t0, t2 - t1, t3 - t2);
+	}
+
+	free(component);
+	free(dag);
+	free(targets);
+	free(intervals);
+	free(in_degree);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t labels = 3, seed = 1, queries = 1000;
+	const char *pairs_name = NULL;
+	int do_build = 0, print = 0, original_ids = 0, check = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--build") == 0) {
+			do_build = 1;
+		} else if (strcmp(argv[argi], "--labels") == 0 && argi + 1 < argc - 1) {
+			labels = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--seed") == 0 && argi + 1 < argc - 1) {
+			seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--queries") == 0 && argi + 1 < argc - 1) {
+			queries = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--pairs") == 0 && argi + 1 < argc - 1) {
+			pairs_name = argv[++argi];
+		} else if (strcmp(argv[argi], "--print") == 0) {
+			print = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1 || labels == 0) {
+		fprintf(stderr, "Usage: %s [--build] [--labels D] [--seed S] [--queries Q] [--pairs FILE] [--print] [--original-ids] [--check] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+
+	slgraph_t g;
+	if (slgraph_open_existing(&g, argv[argi], !do_build)) {
+		fprintf(stderr, "Failed to open graph%s: %s\n", do_build ? " for writing" : "", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	printf("Stats: nodes=%lu edges=%lu mode=reach_index\n", (unsigned long)n, (unsigned long)slgraph_edges(&g));
+	if (do_build && build(&g, labels, seed)) {
+		slgraph_close(&g);
+		return 1;
+	}
+
+	slgraph_reach_t r;
+	if (slgraph_reach(&g, &r)) {
+		fprintf(stderr, "Graph has no reachability index (run with --build)\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	FILE *pairs = NULL;
+	if (pairs_name) {
+		pairs = strcmp(pairs_name, "-") == 0 ? stdin : fopen(pairs_name, "r");
+		if (!pairs) {
+			fprintf(stderr, "Failed to open %s\n", pairs_name);
+			slgraph_close(&g);
+			return 1;
+		}
+	}
+
+	search_t s = {.r = &r};
+	s.stamp = calloc(r.components, sizeof(uint32_t));
+	s.stack = malloc(r.components * sizeof(uint64_t));
+	size_t latency_cap = queries ? queries : 1024, total = 0;
+	uint64_t *latency = malloc(latency_cap * sizeof(uint64_t));
+	unsigned char *seen = check ? calloc(n, 1) : NULL;
+	uint64_t *queue = check ? malloc(n * sizeof(uint64_t)) : NULL;
+	int failed = !s.stamp || !s.stack || !latency || (check && (!seen || !queue));
+
+	uint64_t state = seed, reachable = 0, mismatched = 0, answered[BY_COUNT] = {0};
+	char line[256];
+	while (!failed) {
+		uint64_t u, v;
+		if (pairs) {
+			unsigned long a, b;
+			if (!fgets(line, sizeof(line), pairs)) break;
+			if (line[0] == '#' || sscanf(line, "%lu %lu", &a, &b) != 2) continue;
+			u = original_ids ? slgraph_node_by_original_id(&g, a) : a;
+			v = original_ids ? slgraph_node_by_original_id(&g, b) : b;
+			if (u >= n || v >= n) {
+				fprintf(stderr, "No such node: %s", line);
+				continue;
+			}
+		} else {
+			if (total == queries) break;
+			u = splitmix(&state) % n;
+			v = splitmix(&state) % n;
+		}
+
+		answer_t by;
+		uint64_t start = now_ns();
+		int result = reaches(&s, u, v, &by);
+		uint64_t elapsed = now_ns() - start;
+
+		if (total == latency_cap) {
+			uint64_t *grown = realloc(latency, 2 * latency_cap * sizeof(uint64_t));
+			if (!grown) {
+				failed = 1;
+				break;
+			}
+			latency = grown;
+			latency_cap *= 2;
+		}
+		latency[total++] = elapsed;
+		reachable += result;
+		answered[by]++;
+		if (check) mismatched += result != bfs_reaches(&g, u, v, seen, queue);
+		if (print) {
+			printf("%lu %lu %d\n", (unsigned long)(original_ids ? slgraph_original_id(&g, u) : u),
+			       (unsigned long)(original_ids ? slgraph_original_id(&g, v) : v), result);
+		}
+	}
+
+	if (failed) {
+		fprintf(stderr, "Out of memory for queries\n");
+	} else if (total) {
+		qsort(latency, total, sizeof(uint64_t), cmp_u64);
+		printf("queries=%lu reachable=%lu same_component=%lu by_order=%lu by_labels=%lu searched=%lu visited_mean=%.1f scanned_mean=%.1f\n",
+		       (unsigned long)total, (unsigned long)reachable, (unsigned long)answered[BY_COMPONENT], (unsigned long)answered[BY_ORDER],
+		       (unsigned long)answered[BY_LABELS], (unsigned long)answered[BY_SEARCH],
+		       answered[BY_SEARCH] ? (double)s.visited / answered[BY_SEARCH] : 0.0,
+		       answered[BY_SEARCH] ? (double)s.scanned / answered[BY_SEARCH] : 0.0);
+		printf("latency_us p50=%.2f p90=%.2f p99=%.2f p999=%.2f max=%.2f\n", latency[total / 2] / 1e3,
+		       latency[total * 9 / 10] / 1e3, latency[total * 99 / 100] / 1e3, latency[total * 999 / 1000] / 1e3,
+		       latency[total - 1] / 1e3);
+		if (check) printf("check=%s mismatched=%lu\n", mismatched ? "FAILED" : "OK", (unsigned long)mismatched);
+	}
+
+	if (pairs && pairs != stdin) fclose(pairs);
+	free(s.stamp);
+	free(s.stack);
+	free(latency);
+	free(seen);
+	free(queue);
+	slgraph_close(&g);
+	return failed || mismatched;
+}
@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sc_testers.h"
+
+typedef struct {
+	uint64_t state;
+} rng_t;
+
+static void rng_seed(rng_t *r, uint64_t seed) {
+	r->state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+static uint64_t rng_next(rng_t *r) {
+	uint64_t x = r->state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	r->state = x;
+	return x * 2685821657736338717ULL;
+}
+
+static uint64_t rng_range(rng_t *r, uint64_t n) {
+	if (n == 0) return 0;
+	uint64_t x, limit = UINT64_MAX - (UINT64_MAX % n);
+	do {
+		x = rng_next(r);
+	} while (x >= limit);
+	return x % n;
+}
+
+void sc_scratch_free(sc_scratch_t *s)
+{
+	free(s->set);
+	free(s->queue);
+	s->set = NULL;
+	s->queue = NULL;
+	s->set_size = s->queue_size = 0;
+}
+
+// Insert node into the set, which is a bitmap over all nodes if bits is 0. Returns 0 if node was in it already.
+static int set_insert(uint64_t *set, unsigned bits, uint64_t node)
+{
+	if (!bits) {
+		uint64_t bit = (uint64_t)1 << (node % 64);
+		if (set[node / 64] & bit) return 0;
+		set[node / 64] |= bit;
+		return 1;
+	}
+
+	uint64_t mask = ((uint64_t)1 << bits) - 1;
+	uint64_t i = ((node + 1) * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+
+	while (set[i]) {
+		if (set[i] == node + 1) return 0;
+		i = (i + 1) & mask;
+	}
+	set[i] = node + 1;
+	return 1;
+}
+
+uint64_t sc_bfs_cutoff(sc_scratch_t *w, const slgraph_t *g, slgraph_node_t start, uint64_t cutoff, int in)
+{
+	uint64_t n = slgraph_nodes(g);
+	uint64_t cap = cutoff < n ? cutoff : n;
+	unsigned bits = 4;
+
+	if (cap < 1) cap = 1;
+	while (((uint64_t)1 << bits) < 2 * cap) bits++;
+
+	// Large searches, like the classical tester's, mark nodes in a bitmap if that is not larger than the hash set.
+	uint64_t words = (uint64_t)1 << bits;
+	if ((n + 63) / 64 <= words) {
+		bits = 0;
+		words = (n + 63) / 64;
+	}
+
+	if (w->set_size < words) {
+		uint64_t *set = realloc(w->set, words * sizeof(uint64_t));
+		if (!set) return UINT64_MAX;
+		w->set = set;
+		w->set_size = words;
+	}
+	if (w->queue_size < cap) {
+		slgraph_node_t *queue = realloc(w->queue, cap * sizeof(slgraph_node_t));
+		if (!queue) return UINT64_MAX;
+		w->queue = queue;
+		w->queue_size = cap;
+	}
+	memset(w->set, 0, words * sizeof(uint64_t));
+
+	uint64_t head = 0, tail = 0, visited = 1;
+	w->queue[tail++] = start;
+	set_insert(w->set, bits, start);
+
+	while (head < tail && visited < cutoff) {
+		slgraph_node_t v = w->queue[head++];
+		uint_fast64_t deg = in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+		for (uint_fast64_t i = 0; i < deg && visited < cutoff; i++) {
+			slgraph_node_t nb = in ? slgraph_in_neighbour(g, v, i) : slgraph_out_neighbour(g, v, i);
+			if (nb == SLGRAPH_INVALID_NODE) continue;
+			if (!set_insert(w->set, bits, nb)) continue;
+			w->queue[tail++] = nb;
+			visited++;
+		}
+	}
+	return visited;
+}
+
+// Sample count m and BFS cutoff L of the basic tester.
+static void basic_params(double eps, uint64_t d, uint64_t *m, uint64_t *L)
+{
+	*L = (uint64_t)ceil(6.0 / (eps * (double)d));
+	*m = (uint64_t)ceil((6.0 * log(3.0)) / (eps * (double)d));
+	if (*L < 1) *L = 1;
+	if (*m < 1) *m = 1;
+}
+
+// Logarithm bounding the cutoff doublings of the improved tester.
+static double improved_log_term(double eps, uint64_t d)
+{
+	double log_term = log(8.0 / (eps * (double)d));
+	return log_term < 1.0 ? 1.0 : log_term;
+}
+
+int sc_degree_bound(const slgraph_t *g, uint64_t *d)
+{
+	if (*d == 0) {
+		slgraph_summary_t summary;
+		if (slgraph_summary(g, &summary)) return SC_ESUMMARY;
+		*d = summary.max_out_degree > summary.max_in_degree ? summary.max_out_degree : summary.max_in_degree;
+		if (*d < 2) *d = 2;
+	}
+	return *d <= 1 ? SC_EARGS : SC_OK;
+}
+
+void sc_degree_error(int status, const char *path)
+{
+	if (status == SC_ESUMMARY) {
+		fprintf(stderr, "d=auto needs an up-to-date summary (run slgraph_stats %s)\n", path);
+	} else {
+		fprintf(stderr, "d must be > 1 or auto (automatic degree computation needs slgraph_stats for constant-time mode)\n");
+	}
+}
+
+// sc_run_tester(), reporting nodes by their original IDs if original_ids is set.
+static int run_tester(sc_scratch_t *w, const slgraph_t *g, int tester, double eps, uint64_t d, uint64_t seed,
+                      int original_ids, char *line, size_t size)
+{
+	uint64_t n = slgraph_nodes(g);
+
+	if (n == 0 || tester < SC_BASIC || tester > SC_CLASSICAL) return SC_EARGS;
+
+	if (tester == SC_CLASSICAL) {
+		uint64_t fwd = sc_bfs_cutoff(w, g, 0, n, 0);
+		uint64_t rev = fwd == n ? sc_bfs_cutoff(w, g, 0, n, 1) : 0;
+		if (fwd == UINT64_MAX || rev == UINT64_MAX) return SC_ENOMEM;
+		unsigned long start = original_ids ? slgraph_original_id(g, 0) : 0;
+		if (fwd != n || rev != n) {
+			snprintf(line, size, "REJECT (start=%lu, cause=%s, reached=%lu, total=%lu)",
+			         start, fwd != n ? "fwd" : "rev", (unsigned long)(fwd != n ? fwd : rev), (unsigned long)n);
+		} else {
+			snprintf(line, size, "ACCEPT (start=%lu, reached=%lu)", start, (unsigned long)n);
+		}
+	} else {
+		if (!(eps > 0.0)) return SC_EARGS;
+		int status = sc_degree_bound(g, &d);
+		if (status != SC_OK) return status;
+
+		rng_t rng;
+		rng_seed(&rng, seed);
+		line[0] = 0;
+
+		if (tester == SC_BASIC) {
+			uint64_t m, L;
+			basic_params(eps, d, &m, &L);
+
+			for (uint64_t t = 0; t < m && !line[0]; t++) {
+				slgraph_node_t v = (slgraph_node_t)rng_range(&rng, n);
+				uint64_t fwd = sc_bfs_cutoff(w, g, v, L, 0);
+				uint64_t rev = sc_bfs_cutoff(w, g, v, L, 1);
+				if (fwd == UINT64_MAX || rev == UINT64_MAX) return SC_ENOMEM;
+				if (fwd < L || rev < L) {
+					const char *cause = (fwd < L && rev < L) ? "fwd+rev" : (fwd < L ? "fwd" : "rev");
+					snprintf(line, size, "REJECT (v=%lu, cause=%s, fwd=%lu, rev=%lu, L=%lu)",
+					         (unsigned long)(original_ids ? slgraph_original_id(g, v) : v), cause, (unsigned long)fwd, (unsigned long)rev, (unsigned long)L);
+				}
+			}
+			if (!line[0]) {
+				snprintf(line, size, "ACCEPT (m=%lu, L=%lu)", (unsigned long)m, (unsigned long)L);
+			}
+		} else {
+			double log_term = improved_log_term(eps, d);
+			uint64_t iterations = (uint64_t)ceil(log_term);
+
+			for (uint64_t i = 1; i <= iterations && !line[0]; i++) {
+				uint64_t cutoff = 1ULL << i;
+				uint64_t mi = (uint64_t)ceil(32.0 * log_term / ((double)cutoff * eps * (double)d));
+				if (mi < 1) mi = 1;
+
+				for (uint64_t sidx = 0; sidx < mi && !line[0]; sidx++) {
+					slgraph_node_t s = (slgraph_node_t)rng_range(&rng, n);
+					uint64_t fwd = sc_bfs_cutoff(w, g, s, cutoff, 0);
+					uint64_t rev = sc_bfs_cutoff(w, g, s, cutoff, 1);
+					if (fwd == UINT64_MAX || rev == UINT64_MAX) return SC_ENOMEM;
+					if (fwd < cutoff || rev < cutoff) {
+						const char *cause = (fwd < cutoff && rev < cutoff) ? "fwd+rev" : (fwd < cutoff ? "fwd" : "rev");
+						snprintf(line, size, "REJECT (s=%lu, cause=%s, cutoff=%lu, fwd=%lu, rev=%lu)",
+						         (unsigned long)(original_ids ? slgraph_original_id(g, s) : s), cause, (unsigned long)cutoff, (unsigned long)fwd, (unsigned long)rev);
+					}
+				}
+			}
+			if (!line[0]) {
+				snprintf(line, size, "ACCEPT (iterations=%lu)", (unsigned long)iterations);
+			}
+		}
+	}
+
+	return SC_OK;
+}
+
+int sc_run_tester(sc_scratch_t *w, const slgraph_t *g, int tester, double eps, uint64_t d, uint64_t seed, char *line, size_t size)
+{
+	return run_tester(w, g, tester, eps, d, seed, 0, line, size);
+}
+
+int sc_tester_main(int tester, int argc, char **argv)
+{
+	int original_ids = argc > 1 && strcmp(argv[1], "--original-ids") == 0;
+	if (original_ids) {
+		argv[1] = argv[0];
+		argc--;
+		argv++;
+	}
+	if (tester == SC_CLASSICAL ? argc != 2 : argc < 4 || argc > 5) {
+		fprintf(stderr, tester == SC_CLASSICAL ? "Usage: %s [--original-ids] <graph.slg>\n"
+		                : "Usage: %s [--original-ids] <graph.slg> <epsilon> <d|auto> [seed]\n", argv[0]);
+		return 1;
+	}
+
+	const char *path = argv[1];
+	double eps = 0.0;
+	int auto_d = 0;
+	uint64_t d = 0, seed = 1;
+	if (tester != SC_CLASSICAL) {
+		eps = atof(argv[2]);
+		auto_d = strcmp(argv[3], "auto") == 0;
+		d = auto_d ? 0 : strtoull(argv[3], NULL, 10);
+		seed = (argc == 5) ? strtoull(argv[4], NULL, 10) : 1;
+		if (eps <= 0.0) {
+			fprintf(stderr, "epsilon must be > 0\n");
+			return 1;
+		}
+	}
+
+	slgraph_t g;
+	if (slgraph_open(&g, path, true)) {
+		fprintf(stderr, "Failed to open graph: %s\n", path);
+		return 1;
+	}
+
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	if (tester == SC_CLASSICAL) {
+		fprintf(stdout, "Stats: nodes=%lu edges=%lu mode=classical\n",
+		        (unsigned long)n, (unsigned long)slgraph_edges(&g));
+	} else {
+		int status = auto_d || d > 1 ? sc_degree_bound(&g, &d) : SC_EARGS;
+		if (status != SC_OK) {
+			sc_degree_error(status, path);
+			slgraph_close(&g);
+			return 1;
+		}
+
+		if (tester == SC_BASIC) {
+			uint64_t m, L;
+			basic_params(eps, d, &m, &L);
+			fprintf(stdout, "Stats: nodes=%lu edges=%lu eps=%.6f d=%lu m=%lu L=%lu\n",
+			        (unsigned long)n, (unsigned long)slgraph_edges(&g),
+			        eps, (unsigned long)d, (unsigned long)m, (unsigned long)L);
+		} else {
+			fprintf(stdout, "Stats: nodes=%lu edges=%lu eps=%.6f d=%lu iterations=%lu\n",
+			        (unsigned long)n, (unsigned long)slgraph_edges(&g),
+			        eps, (unsigned long)d, (unsigned long)ceil(improved_log_term(eps, d)));
+		}
+	}
+
+	sc_scratch_t w = {0};
+	char line[256];
+	int status = run_tester(&w, &g, tester, eps, d, seed, original_ids, line, sizeof(line));
+	sc_scratch_free(&w);
+	slgraph_close(&g);
+	if (status != SC_OK) {
+		fprintf(stderr, tester == SC_CLASSICAL ? "Out of memory for classical BFS structures\n"
+		                : "Out of memory for BFS structures\n");
+		return 1;
+	}
+	printf("%s\n", line);
+	return 0;
+}
+
+void sc_sample(const slgraph_t *g, uint64_t seed, uint64_t count, slgraph_node_t *nodes)
+{
+	uint64_t n = slgraph_nodes(g);
+	rng_t rng;
+
+	rng_seed(&rng, seed);
+	for (uint64_t i = 0; i < count; i++) {
+		nodes[i] = rng_range(&rng, n);
+	}
+}
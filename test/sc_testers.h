@@ -0,0 +1,58 @@
+// Strong connectivity testers shared by the tester programs, slgraphd and the Python module, and a bounded BFS that uses
+// a hash set instead of scanning its queue. Functions taking scratch space can run concurrently, each thread with its
+// own.
+
+#ifndef SC_TESTERS_H
+#define SC_TESTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "slgraph.h"
+
+enum sc_tester {
+	SC_BASIC = 0,
+	SC_IMPROVED = 1,
+	SC_CLASSICAL = 2
+};
+
+enum sc_status {
+	SC_OK = 0,
+	SC_EARGS,      // Unknown tester, epsilon <= 0, d == 1 or an empty graph
+	SC_ENOMEM,
+	SC_ESUMMARY    // d = 0, but the graph has no up-to-date summary
+};
+
+// Scratch space, grown as needed. Zero-initialize before first use.
+typedef struct {
+	uint64_t *set;          // Open addressing set of node + 1, or a bitmap of nodes
+	uint64_t set_size;
+	slgraph_node_t *queue;
+	uint64_t queue_size;
+} sc_scratch_t;
+
+void sc_scratch_free(sc_scratch_t *s);
+
+// BFS from start along out-edges (in-edges if in is set), stopped once cutoff nodes are reached. Returns the number of
+// nodes reached, or UINT64_MAX if out of memory.
+uint64_t sc_bfs_cutoff(sc_scratch_t *s, const slgraph_t *g, slgraph_node_t start, uint64_t cutoff, int in);
+
+// Resolve d == 0 ("auto") to the larger of the maximum out- and in-degree in the summary stored by slgraph_stats, at
+// least 2, in O(1); other values of d are kept. Returns SC_ESUMMARY if g has no up-to-date summary, SC_EARGS if d == 1.
+int sc_degree_bound(const slgraph_t *g, uint64_t *d);
+
+// Print the message of the tester programs for an sc_degree_bound() error on the graph at path to stderr.
+void sc_degree_error(int status, const char *path);
+
+// Run a tester as the tester program with arguments eps, d (0 for "auto") and seed would, and store its result line,
+// e.g. "ACCEPT (iterations=5)", in line. The classical tester ignores eps, d and seed. Returns an sc_status.
+int sc_run_tester(sc_scratch_t *s, const slgraph_t *g, int tester, double eps, uint64_t d, uint64_t seed, char *line, size_t size);
+
+// main() of the tester programs: parse [--original-ids] and the arguments of tester from argv, print the stats and
+// result lines to stdout and errors to stderr. Returns the exit status.
+int sc_tester_main(int tester, int argc, char **argv);
+
+// Draw count nodes of g uniformly at random with the random number generator of the testers.
+void sc_sample(const slgraph_t *g, uint64_t seed, uint64_t count, slgraph_node_t *nodes);
+
+#endif
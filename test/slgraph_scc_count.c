@@ -2,7 +2,10 @@
 // Uses a non-recursive Kosaraju-style algorithm.
 //
 // Usage:
-//   slgraph_scc_count <graph.slg>
+//   slgraph_scc_count [--members] [--original-ids] <graph.slg>
+//
+// --members prints one line "<node> <component>" per node, with components numbered from 0.
+// --original-ids prints nodes by their ID in the input the graph was loaded from.
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,9 +57,10 @@ static int build_finish_order(const slgraph_t *g, slgraph_node_t *order,
 	return 0;
 }
 
+// Count the SCCs, and store the component of each node in component unless it is NULL.
 static uint64_t count_sccs(const slgraph_t *g, const slgraph_node_t *order,
                            unsigned char *visited, slgraph_node_t *stack,
-                           uint64_t *largest)
+                           uint64_t *component, uint64_t *largest)
 {
 	uint64_t n = slgraph_nodes(g);
 	uint64_t count = 0;
@@ -79,6 +83,9 @@ static uint64_t count_sccs(const slgraph_t *g, const slgraph_node_t *order,
 		while (sp > 0) {
 			slgraph_node_t v = stack[--sp];
 			size++;
+			if (component) {
+				component[v] = count;
+			}
 
 			uint_fast64_t deg = slgraph_in_degree(g, v);
 			for (uint_fast64_t i = 0; i < deg; i++) {
@@ -106,14 +113,27 @@ static uint64_t count_sccs(const slgraph_t *g, const slgraph_node_t *order,
 
 int main(int argc, char **argv)
 {
-	if (argc != 2) {
-		fprintf(stderr, "Usage: %s <graph.slg>\n", argv[0]);
+	int members = 0;
+	int original_ids = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--members") == 0) {
+			members = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1) {
+		fprintf(stderr, "Usage: %s [--members] [--original-ids] <graph.slg>\n", argv[0]);
 		return 1;
 	}
 
 	slgraph_t g;
-	if (slgraph_open(&g, argv[1], true)) {
-		fprintf(stderr, "Failed to open graph: %s\n", argv[1]);
+	if (slgraph_open(&g, argv[argi], true)) {
+		fprintf(stderr, "Failed to open graph: %s\n", argv[argi]);
 		return 1;
 	}
 
@@ -128,12 +148,14 @@ int main(int argc, char **argv)
 	unsigned char *visited = malloc(n * sizeof(unsigned char));
 	dfs_frame_t *frames = malloc(n * sizeof(dfs_frame_t));
 	slgraph_node_t *stack = malloc(n * sizeof(slgraph_node_t));
-	if (!order || !visited || !frames || !stack) {
+	uint64_t *component = members ? malloc(n * sizeof(uint64_t)) : NULL;
+	if (!order || !visited || !frames || !stack || (members && !component)) {
 		fprintf(stderr, "Out of memory for SCC computation\n");
 		free(order);
 		free(visited);
 		free(frames);
 		free(stack);
+		free(component);
 		slgraph_close(&g);
 		return 1;
 	}
@@ -141,12 +163,17 @@ int main(int argc, char **argv)
 	build_finish_order(&g, order, visited, frames);
 
 	uint64_t largest = 0;
-	uint64_t sccs = count_sccs(&g, order, visited, stack, &largest);
+	uint64_t sccs = count_sccs(&g, order, visited, stack, component, &largest);
 
 	printf("Stats: nodes=%lu edges=%lu mode=scc_count\n",
 	       (unsigned long)n, (unsigned long)slgraph_edges(&g));
 	printf("SCCS=%lu largest=%lu\n", (unsigned long)sccs, (unsigned long)largest);
 
+	for (slgraph_node_t v = 0; members && v < n; v++) {
+		printf("%lu %lu\n", (unsigned long)(original_ids ? slgraph_original_id(&g, v) : v), (unsigned long)component[v]);
+	}
+
+	free(component);
 	free(order);
 	free(visited);
 	free(frames);
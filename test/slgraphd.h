@@ -0,0 +1,82 @@
+// Protocol of slgraphd, the graph query daemon (daemon.c), shared with its clients.
+//
+// Clients connect to the Unix stream socket of the daemon and may send further requests before the responses to earlier
+// ones arrive (pipelining). Requests are served concurrently by a pool of worker threads, so responses can arrive in any
+// order; each carries the tag of its request. All integers are little-endian.
+//
+// Request:  u32 size of the rest, u32 tag, u8 op, u8 graph (index on the daemon command line), u16 zero, u64 args[]
+// Response: u32 size of the rest, u32 tag, u32 status (SLGRAPHD_OK or an error), u64 results[] (text for TESTER)
+//
+// Op          Arguments                          Results
+// INFO        -                                  nodes, edges, format version
+// DEGREE      dir, node...                       the degree of each node
+// NEIGHBOURS  dir, node, first, max              up to max neighbours, starting at the first-th (see below)
+// SAMPLE      seed, count                        count nodes drawn uniformly at random
+// BFS         dir, node, cutoff                  the number of nodes reached by a BFS stopped after cutoff nodes
+// TESTER      tester, epsilon (double), d, seed  the result line of the tester program, e.g. "ACCEPT (iterations=5)"
+//
+// NEIGHBOURS returns at most SLGRAPHD_MAXRESULTS neighbours, however large max is; clients page through the neighbours
+// of high-degree nodes with first. SAMPLE rejects counts above SLGRAPHD_MAXRESULTS.
+//
+// dir is SLGRAPHD_OUT or SLGRAPHD_IN. d = 0 reads the degree bound from the graph summary, like "auto" for the tester
+// programs. The classical tester ignores epsilon, d and seed.
+
+#ifndef SLGRAPHD_H
+#define SLGRAPHD_H
+
+#include <stdint.h>
+
+#define SLGRAPHD_HEADERSIZE 12             // Request and response header, including the size field
+#define SLGRAPHD_MAXREQUEST (1024 * 1024)  // Largest request, including the header
+#define SLGRAPHD_MAXRESULTS ((SLGRAPHD_MAXREQUEST - SLGRAPHD_HEADERSIZE) / 8)  // Most u64 results of NEIGHBOURS and SAMPLE
+
+enum slgraphd_op {
+	SLGRAPHD_INFO = 1,
+	SLGRAPHD_DEGREE = 2,
+	SLGRAPHD_NEIGHBOURS = 3,
+	SLGRAPHD_SAMPLE = 4,
+	SLGRAPHD_BFS = 5,
+	SLGRAPHD_TESTER = 6
+};
+
+enum slgraphd_status {
+	SLGRAPHD_OK = 0,
+	SLGRAPHD_EREQUEST = 1,   // Unknown op, wrong number of arguments or argument out of range
+	SLGRAPHD_EGRAPH = 2,     // No graph with that index
+	SLGRAPHD_ENOMEM = 3,
+	SLGRAPHD_ESUMMARY = 4    // d = 0, but the graph has no up-to-date summary
+};
+
+enum slgraphd_dir {
+	SLGRAPHD_OUT = 0,
+	SLGRAPHD_IN = 1
+};
+
+enum slgraphd_tester {
+	SLGRAPHD_BASIC = 0,
+	SLGRAPHD_IMPROVED = 1,
+	SLGRAPHD_CLASSICAL = 2
+};
+
+static inline uint32_t slgraphd_get32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t slgraphd_get64(const unsigned char *p)
+{
+	return slgraphd_get32(p) | (uint64_t)slgraphd_get32(p + 4) << 32;
+}
+
+static inline void slgraphd_put32(unsigned char *p, uint32_t v)
+{
+	for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline void slgraphd_put64(unsigned char *p, uint64_t v)
+{
+	slgraphd_put32(p, (uint32_t)v);
+	slgraphd_put32(p + 4, (uint32_t)(v >> 32));
+}
+
+#endif
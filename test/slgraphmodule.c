@@ -0,0 +1,749 @@
+// Python bindings: the slgraph module. Arrays stored in the graph file (CSR arrays, property columns, original IDs) are
+// returned as zero-copy views of the mapping, which support the buffer protocol, so numpy.asarray() and memoryview()
+// use them in place. Batched operations (degrees, sampling, random walks, testers) run without the GIL.
+//
+// Build with "make" in this directory, then:
+//   import slgraph, numpy
+//   with slgraph.Graph("graph.slg") as g:
+//       offsets, targets = g.csr()                 # after g.store_csr() on a graph opened with writable=True
+//       degrees = numpy.diff(numpy.asarray(offsets))
+//       print(g.tester("improved", 0.05, 0, seeds=range(1, 21)))
+//
+// A graph can't be closed (or its arrays stored) while views of it exist, as that would unmap or move their memory.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slgraph.h"
+#include "sc_testers.h"
+
+typedef struct {
+	PyObject_HEAD
+	slgraph_t g;
+	int open;
+	Py_ssize_t pins;        // Views of the mapping, and calls running without the GIL
+} GraphObject;
+
+typedef struct {
+	PyObject_HEAD
+	GraphObject *graph;     // Graph whose mapping data points into, or NULL if data is owned
+	void *data;
+	Py_ssize_t length;
+	Py_ssize_t itemsize;
+	char format[2];         // struct module format of the elements
+	int readonly;
+} ArrayObject;
+
+static PyTypeObject GraphType;
+static PyTypeObject ArrayType;
+
+// === Array ===
+
+// Make an array of length elements of type format. With a graph, data points into its mapping and pins it; otherwise
+// data must come from malloc() and is owned by the array.
+static PyObject *array_new(GraphObject *graph, void *data, Py_ssize_t length, char format, int readonly)
+{
+	ArrayObject *a = PyObject_New(ArrayObject, &ArrayType);
+	if (!a) {
+		if (!graph) free(data);
+		return NULL;
+	}
+	a->graph = graph;
+	a->data = data;
+	a->length = length;
+	a->format[0] = format;
+	a->format[1] = 0;
+	a->itemsize = format == 'B' ? 1 : format == 'I' || format == 'f' ? 4 : 8;
+	a->readonly = readonly;
+	if (graph) {
+		Py_INCREF(graph);
+		graph->pins++;
+	}
+	return (PyObject *)a;
+}
+
+// Allocate an owned array of length 8-byte elements; *data receives the memory.
+static PyObject *array_alloc(Py_ssize_t length, char format, void **data)
+{
+	*data = malloc(length ? (size_t)length * 8 : 1);
+	if (!*data) return PyErr_NoMemory();
+	return array_new(NULL, *data, length, format, 0);
+}
+
+static void array_dealloc(ArrayObject *a)
+{
+	if (a->graph) {
+		a->graph->pins--;
+		Py_DECREF(a->graph);
+	} else {
+		free(a->data);
+	}
+	PyObject_Free(a);
+}
+
+static Py_ssize_t array_length(ArrayObject *a)
+{
+	return a->length;
+}
+
+static PyObject *array_item(ArrayObject *a, Py_ssize_t i)
+{
+	if (i < 0 || i >= a->length) {
+		PyErr_SetString(PyExc_IndexError, "array index out of range");
+		return NULL;
+	}
+	const char *p = (const char *)a->data + i * a->itemsize;
+	switch (a->format[0]) {
+	case 'B':
+		return PyLong_FromLong(*(const uint8_t *)p);
+	case 'I':
+		return PyLong_FromUnsignedLong(*(const uint32_t *)p);
+	case 'f':
+		return PyFloat_FromDouble(*(const float *)p);
+	case 'd':
+		return PyFloat_FromDouble(*(const double *)p);
+	default:
+		return PyLong_FromUnsignedLongLong(*(const uint64_t *)p);
+	}
+}
+
+static int array_getbuffer(ArrayObject *a, Py_buffer *view, int flags)
+{
+	if ((flags & PyBUF_WRITABLE) && a->readonly) {
+		PyErr_SetString(PyExc_BufferError, "array is read-only");
+		return -1;
+	}
+	view->obj = (PyObject *)a;
+	Py_INCREF(a);
+	view->buf = a->data;
+	view->len = a->length * a->itemsize;
+	view->itemsize = a->itemsize;
+	view->readonly = a->readonly;
+	view->ndim = 1;
+	view->format = (flags & PyBUF_FORMAT) ? a->format : NULL;
+	view->shape = (flags & PyBUF_ND) ? &a->length : NULL;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &a->itemsize : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static PyObject *array_repr(ArrayObject *a)
+{
+	return PyUnicode_FromFormat("<slgraph.Array of %zd '%s'%s>", a->length, a->format, a->graph ? " (view)" : "");
+}
+
+static PySequenceMethods array_as_sequence = {
+	.sq_length = (lenfunc)array_length,
+	.sq_item = (ssizeargfunc)array_item,
+};
+
+static PyBufferProcs array_as_buffer = {
+	.bf_getbuffer = (getbufferproc)array_getbuffer,
+};
+
+static PyTypeObject ArrayType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "slgraph.Array",
+	.tp_doc = "One-dimensional array of graph data, supporting the buffer protocol. Views of the graph file keep it open.",
+	.tp_basicsize = sizeof(ArrayObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_dealloc = (destructor)array_dealloc,
+	.tp_repr = (reprfunc)array_repr,
+	.tp_as_sequence = &array_as_sequence,
+	.tp_as_buffer = &array_as_buffer,
+};
+
+// === Graph ===
+
+static int graph_check(GraphObject *self)
+{
+	if (!self->open) {
+		PyErr_SetString(PyExc_ValueError, "graph is closed");
+		return -1;
+	}
+	return 0;
+}
+
+static int node_check(GraphObject *self, unsigned long long v)
+{
+	if (v >= slgraph_nodes(&self->g)) {
+		PyErr_Format(PyExc_IndexError, "node %llu out of range", v);
+		return -1;
+	}
+	return 0;
+}
+
+// Copy the nodes in o, a sequence of ints or a buffer of 8-byte integers (e.g. a numpy array), into a new array.
+static slgraph_node_t *nodes_arg(GraphObject *self, PyObject *o, Py_ssize_t *count)
+{
+	uint64_t n = slgraph_nodes(&self->g);
+	slgraph_node_t *nodes;
+	Py_buffer view;
+
+	if (PyObject_CheckBuffer(o) && PyObject_GetBuffer(o, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0) {
+		const char *f = view.format ? view.format : "B";
+		if (*f == '<' || *f == '=' || *f == '@') f++;
+		if (view.itemsize != 8 || !strchr("QqLlNn", *f) || f[1]) {
+			PyBuffer_Release(&view);
+			PyErr_SetString(PyExc_TypeError, "nodes must be 8-byte integers");
+			return NULL;
+		}
+		*count = view.len / 8;
+		nodes = malloc(*count ? (size_t)*count * sizeof(*nodes) : 1);
+		if (nodes) memcpy(nodes, view.buf, (size_t)*count * sizeof(*nodes));
+		PyBuffer_Release(&view);
+		if (!nodes) {
+			PyErr_NoMemory();
+			return NULL;
+		}
+	} else {
+		PyErr_Clear();
+		PyObject *seq = PySequence_Fast(o, "nodes must be a sequence or buffer of ints");
+		if (!seq) return NULL;
+		*count = PySequence_Fast_GET_SIZE(seq);
+		nodes = malloc(*count ? (size_t)*count * sizeof(*nodes) : 1);
+		if (!nodes) {
+			Py_DECREF(seq);
+			PyErr_NoMemory();
+			return NULL;
+		}
+		for (Py_ssize_t i = 0; i < *count; i++) {
+			nodes[i] = PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(seq, i));
+			if (PyErr_Occurred()) {
+				free(nodes);
+				Py_DECREF(seq);
+				return NULL;
+			}
+		}
+		Py_DECREF(seq);
+	}
+
+	for (Py_ssize_t i = 0; i < *count; i++) {
+		if (nodes[i] >= n) {
+			PyErr_Format(PyExc_IndexError, "node %llu out of range", (unsigned long long)nodes[i]);
+			free(nodes);
+			return NULL;
+		}
+	}
+	return nodes;
+}
+
+static int graph_init(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"path", "writable", NULL};
+	PyObject *path;
+	int writable = 0, ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p", kwlist, PyUnicode_FSConverter, &path, &writable)) return -1;
+	if (self->open) {
+		Py_DECREF(path);
+		PyErr_SetString(PyExc_ValueError, "graph is already open");
+		return -1;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = slgraph_open(&self->g, PyBytes_AS_STRING(path), !writable);
+	Py_END_ALLOW_THREADS
+
+	if (ret) {
+		PyErr_Format(PyExc_OSError, "cannot open graph %s", PyBytes_AS_STRING(path));
+		Py_DECREF(path);
+		return -1;
+	}
+	Py_DECREF(path);
+	self->open = 1;
+	return 0;
+}
+
+static PyObject *graph_close(GraphObject *self, PyObject *unused)
+{
+	if (self->pins) {
+		PyErr_SetString(PyExc_BufferError, "graph has views; delete them before closing it");
+		return NULL;
+	}
+	if (self->open) {
+		slgraph_close(&self->g);
+		self->open = 0;
+	}
+	Py_RETURN_NONE;
+}
+
+static void graph_dealloc(GraphObject *self)
+{
+	// Views hold a reference, so there are none left.
+	if (self->open) slgraph_close(&self->g);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *graph_enter(GraphObject *self, PyObject *unused)
+{
+	if (graph_check(self)) return NULL;
+	Py_INCREF(self);
+	return (PyObject *)self;
+}
+
+static PyObject *graph_exit(GraphObject *self, PyObject *args)
+{
+	return graph_close(self, NULL);
+}
+
+static PyObject *graph_get_nodes(GraphObject *self, void *closure)
+{
+	if (graph_check(self)) return NULL;
+	return PyLong_FromUnsignedLongLong(slgraph_nodes(&self->g));
+}
+
+static PyObject *graph_get_edges(GraphObject *self, void *closure)
+{
+	if (graph_check(self)) return NULL;
+	return PyLong_FromUnsignedLongLong(slgraph_edges(&self->g));
+}
+
+static PyObject *graph_get_version(GraphObject *self, void *closure)
+{
+	if (graph_check(self)) return NULL;
+	return PyLong_FromUnsignedLongLong(self->g.version);
+}
+
+static PyObject *graph_degree(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"node", "reverse", NULL};
+	unsigned long long v;
+	int reverse = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "K|p", kwlist, &v, &reverse)) return NULL;
+	if (graph_check(self) || node_check(self, v)) return NULL;
+	return PyLong_FromUnsignedLongLong(reverse ? slgraph_in_degree(&self->g, v) : slgraph_out_degree(&self->g, v));
+}
+
+static PyObject *graph_neighbours(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"node", "reverse", NULL};
+	unsigned long long v;
+	int reverse = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "K|p", kwlist, &v, &reverse)) return NULL;
+	if (graph_check(self) || node_check(self, v)) return NULL;
+
+	uint_fast64_t deg = reverse ? slgraph_in_degree(&self->g, v) : slgraph_out_degree(&self->g, v);
+	PyObject *list = PyList_New((Py_ssize_t)deg);
+	if (!list) return NULL;
+	for (uint_fast64_t i = 0; i < deg; i++) {
+		slgraph_node_t nb = reverse ? slgraph_in_neighbour(&self->g, v, i) : slgraph_out_neighbour(&self->g, v, i);
+		PyObject *item = PyLong_FromUnsignedLongLong(nb);
+		if (!item) {
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, (Py_ssize_t)i, item);
+	}
+	return list;
+}
+
+static PyObject *graph_degrees(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"reverse", NULL};
+	int reverse = 0;
+	uint64_t *data;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reverse)) return NULL;
+	if (graph_check(self)) return NULL;
+
+	uint64_t n = slgraph_nodes(&self->g);
+	PyObject *a = array_alloc((Py_ssize_t)n, 'Q', (void **)&data);
+	if (!a) return NULL;
+
+	self->pins++;
+	Py_BEGIN_ALLOW_THREADS
+	for (uint64_t v = 0; v < n; v++) {
+		data[v] = reverse ? slgraph_in_degree(&self->g, v) : slgraph_out_degree(&self->g, v);
+	}
+	Py_END_ALLOW_THREADS
+	self->pins--;
+	return a;
+}
+
+static PyObject *graph_store_csr(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"reverse", NULL};
+	int reverse = 0, ret;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reverse)) return NULL;
+	if (graph_check(self)) return NULL;
+	if (self->g.readonly) {
+		PyErr_SetString(PyExc_ValueError, "graph was opened read-only");
+		return NULL;
+	}
+	if (self->pins) {
+		PyErr_SetString(PyExc_BufferError, "graph has views; delete them before storing CSR arrays");
+		return NULL;
+	}
+
+	self->pins++;
+	Py_BEGIN_ALLOW_THREADS
+	ret = slgraph_csr_store(&self->g, reverse);
+	Py_END_ALLOW_THREADS
+	self->pins--;
+
+	if (ret) return PyErr_Format(PyExc_OSError, "cannot store CSR arrays");
+	Py_RETURN_NONE;
+}
+
+static PyObject *graph_csr(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"reverse", NULL};
+	int reverse = 0;
+	const uint64_t *offsets, *targets;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reverse)) return NULL;
+	if (graph_check(self)) return NULL;
+
+	offsets = slgraph_csr(&self->g, reverse, &targets);
+	if (!offsets) {
+		PyErr_SetString(PyExc_LookupError, "graph has no up-to-date CSR arrays; store them with store_csr()");
+		return NULL;
+	}
+
+	Py_ssize_t n = (Py_ssize_t)slgraph_nodes(&self->g);
+	PyObject *o = array_new(self, (void *)offsets, n + 1, 'Q', 1);
+	PyObject *t = o ? array_new(self, (void *)targets, (Py_ssize_t)offsets[n], 'Q', 1) : NULL;
+	if (!t) {
+		Py_XDECREF(o);
+		return NULL;
+	}
+	return Py_BuildValue("(NN)", o, t);
+}
+
+static PyObject *graph_property(GraphObject *self, PyObject *args)
+{
+	static const char formats[] = {[SLGRAPH_U8] = 'B', [SLGRAPH_U32] = 'I', [SLGRAPH_U64] = 'Q', [SLGRAPH_F32] = 'f', [SLGRAPH_F64] = 'd'};
+	const char *name;
+	slgraph_scope_t scope;
+	slgraph_type_t type;
+	uint_fast64_t length;
+
+	if (!PyArg_ParseTuple(args, "s", &name)) return NULL;
+	if (graph_check(self)) return NULL;
+
+	void *values = slgraph_property(&self->g, name, &scope, &type, &length);
+	if (!values) {
+		PyErr_Format(PyExc_KeyError, "%s", name);
+		return NULL;
+	}
+	return array_new(self, values, (Py_ssize_t)length, formats[type], self->g.readonly);
+}
+
+static PyObject *graph_original_ids(GraphObject *self, PyObject *unused)
+{
+	uint_fast64_t size;
+	uint64_t *data;
+
+	if (graph_check(self)) return NULL;
+	if (!slgraph_has_original_ids(&self->g)) Py_RETURN_NONE;
+
+	unsigned char *ids = slgraph_section(&self->g, "ids", &size);
+	if (ids) return array_new(self, ids, (Py_ssize_t)(size / 8), 'Q', 1);
+
+	// Sharded and cached graphs can't be viewed in place.
+	uint64_t n = slgraph_nodes(&self->g);
+	PyObject *a = array_alloc((Py_ssize_t)n, 'Q', (void **)&data);
+	if (!a) return NULL;
+	for (uint64_t v = 0; v < n; v++) {
+		data[v] = slgraph_original_id(&self->g, v);
+	}
+	return a;
+}
+
+static PyObject *graph_node_by_original_id(GraphObject *self, PyObject *args)
+{
+	unsigned long long id;
+
+	if (!PyArg_ParseTuple(args, "K", &id)) return NULL;
+	if (graph_check(self)) return NULL;
+
+	slgraph_node_t v = slgraph_node_by_original_id(&self->g, id);
+	if (v == SLGRAPH_INVALID_NODE) Py_RETURN_NONE;
+	return PyLong_FromUnsignedLongLong(v);
+}
+
+static PyObject *graph_bfs(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"node", "cutoff", "reverse", NULL};
+	unsigned long long v, cutoff;
+	int reverse = 0;
+	uint64_t visited;
+	sc_scratch_t scratch = {0};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "KK|p", kwlist, &v, &cutoff, &reverse)) return NULL;
+	if (graph_check(self) || node_check(self, v)) return NULL;
+
+	self->pins++;
+	Py_BEGIN_ALLOW_THREADS
+	visited = sc_bfs_cutoff(&scratch, &self->g, v, cutoff, reverse);
+	sc_scratch_free(&scratch);
+	Py_END_ALLOW_THREADS
+	self->pins--;
+
+	if (visited == UINT64_MAX) return PyErr_NoMemory();
+	return PyLong_FromUnsignedLongLong(visited);
+}
+
+static PyObject *graph_sample(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"count", "seed", NULL};
+	Py_ssize_t count;
+	unsigned long long seed = 1;
+	slgraph_node_t *data;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "n|K", kwlist, &count, &seed)) return NULL;
+	if (graph_check(self)) return NULL;
+	if (count < 0 || slgraph_nodes(&self->g) == 0) {
+		PyErr_SetString(PyExc_ValueError, "count must be non-negative and the graph non-empty");
+		return NULL;
+	}
+
+	PyObject *a = array_alloc(count, 'Q', (void **)&data);
+	if (!a) return NULL;
+
+	self->pins++;
+	Py_BEGIN_ALLOW_THREADS
+	sc_sample(&self->g, seed, (uint64_t)count, data);
+	Py_END_ALLOW_THREADS
+	self->pins--;
+	return a;
+}
+
+static PyObject *graph_random_walks(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"starts", "length", "restart", "reverse", "seed", "visits", NULL};
+	slgraph_walk_config_t config;
+	unsigned long long length, seed;
+	int reverse, want_visits = 0, ret;
+	PyObject *starts_arg;
+	Py_ssize_t count;
+
+	slgraph_walk_config_default(&config);
+	length = config.length;
+	seed = config.seed;
+	reverse = config.reverse;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|KdpKp", kwlist, &starts_arg, &length, &config.restart, &reverse, &seed, &want_visits)) return NULL;
+	if (graph_check(self)) return NULL;
+	config.length = length;
+	config.seed = seed;
+	config.reverse = reverse;
+
+	slgraph_node_t *starts = nodes_arg(self, starts_arg, &count);
+	if (!starts) return NULL;
+
+	uint64_t n = slgraph_nodes(&self->g);
+	slgraph_walk_t *walks = malloc(count ? (size_t)count * sizeof(*walks) : 1);
+	uint64_t *ends, *steps, *returns, *visits = NULL;
+	PyObject *e = array_alloc(count, 'Q', (void **)&ends);
+	PyObject *s = e ? array_alloc(count, 'Q', (void **)&steps) : NULL;
+	PyObject *r = s ? array_alloc(count, 'Q', (void **)&returns) : NULL;
+	PyObject *vis = r && want_visits ? array_alloc((Py_ssize_t)n, 'Q', (void **)&visits) : NULL;
+	if (!walks || !r || (want_visits && !vis)) {
+		free(starts);
+		free(walks);
+		Py_XDECREF(e);
+		Py_XDECREF(s);
+		Py_XDECREF(r);
+		return PyErr_Occurred() ? NULL : PyErr_NoMemory();
+	}
+	if (visits) memset(visits, 0, (size_t)n * 8);
+
+	self->pins++;
+	Py_BEGIN_ALLOW_THREADS
+	ret = slgraph_random_walks(&self->g, starts, (uint_fast64_t)count, &config, (uint_fast64_t *)visits, walks);
+	for (Py_ssize_t i = 0; i < count; i++) {
+		ends[i] = walks[i].end;
+		steps[i] = walks[i].steps;
+		returns[i] = walks[i].returns;
+	}
+	Py_END_ALLOW_THREADS
+	self->pins--;
+
+	free(starts);
+	free(walks);
+	if (ret) {
+		Py_DECREF(e);
+		Py_DECREF(s);
+		Py_DECREF(r);
+		Py_XDECREF(vis);
+		return PyErr_NoMemory();
+	}
+	if (!vis) {
+		Py_INCREF(Py_None);
+		vis = Py_None;
+	}
+	return Py_BuildValue("(NNNN)", e, s, r, vis);
+}
+
+static PyObject *graph_tester(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"name", "eps", "d", "seeds", NULL};
+	static const char *names[] = {[SC_BASIC] = "basic", [SC_IMPROVED] = "improved", [SC_CLASSICAL] = "classical"};
+	const char *name;
+	double eps = 0.0;
+	unsigned long long d = 0;
+	PyObject *seeds_arg = NULL;
+	int tester = -1, status = SC_OK;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|dKO", kwlist, &name, &eps, &d, &seeds_arg)) return NULL;
+	if (graph_check(self)) return NULL;
+	for (int t = SC_BASIC; t <= SC_CLASSICAL; t++) {
+		if (!strcmp(name, names[t])) tester = t;
+	}
+	if (tester < 0) return PyErr_Format(PyExc_ValueError, "unknown tester %s", name);
+
+	// One seed gives one result line, a sequence of seeds a list of them.
+	int single = !seeds_arg || PyLong_Check(seeds_arg);
+	Py_ssize_t count = 1;
+	uint64_t *seeds;
+	if (single) {
+		seeds = malloc(sizeof(*seeds));
+		if (!seeds) return PyErr_NoMemory();
+		seeds[0] = seeds_arg ? PyLong_AsUnsignedLongLong(seeds_arg) : 1;
+		if (PyErr_Occurred()) {
+			free(seeds);
+			return NULL;
+		}
+	} else {
+		PyObject *seq = PySequence_Fast(seeds_arg, "seeds must be an int or a sequence of ints");
+		if (!seq) return NULL;
+		count = PySequence_Fast_GET_SIZE(seq);
+		seeds = malloc(count ? (size_t)count * sizeof(*seeds) : 1);
+		if (!seeds) {
+			Py_DECREF(seq);
+			return PyErr_NoMemory();
+		}
+		for (Py_ssize_t i = 0; i < count; i++) {
+			seeds[i] = PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(seq, i));
+			if (PyErr_Occurred()) {
+				free(seeds);
+				Py_DECREF(seq);
+				return NULL;
+			}
+		}
+		Py_DECREF(seq);
+	}
+
+	char (*lines)[256] = malloc(count ? (size_t)count * sizeof(*lines) : 1);
+	if (!lines) {
+		free(seeds);
+		return PyErr_NoMemory();
+	}
+
+	self->pins++;
+	Py_BEGIN_ALLOW_THREADS
+	sc_scratch_t scratch = {0};
+	for (Py_ssize_t i = 0; i < count && status == SC_OK; i++) {
+		status = sc_run_tester(&scratch, &self->g, tester, eps, d, seeds[i], lines[i], sizeof(lines[i]));
+	}
+	sc_scratch_free(&scratch);
+	Py_END_ALLOW_THREADS
+	self->pins--;
+	free(seeds);
+
+	PyObject *result = NULL;
+	if (status == SC_ENOMEM) {
+		PyErr_NoMemory();
+	} else if (status == SC_ESUMMARY) {
+		PyErr_SetString(PyExc_ValueError, "graph has no up-to-date summary; pass d or run slgraph_stats");
+	} else if (status != SC_OK) {
+		PyErr_SetString(PyExc_ValueError, "invalid tester arguments (eps must be positive, d at least 2)");
+	} else if (single) {
+		result = PyUnicode_FromString(lines[0]);
+	} else if ((result = PyList_New(count))) {
+		for (Py_ssize_t i = 0; i < count; i++) {
+			PyObject *line = PyUnicode_FromString(lines[i]);
+			if (!line) {
+				Py_CLEAR(result);
+				break;
+			}
+			PyList_SET_ITEM(result, i, line);
+		}
+	}
+	free(lines);
+	return result;
+}
+
+static PyMethodDef graph_methods[] = {
+	{"close", (PyCFunction)graph_close, METH_NOARGS, "close()\n\nClose the graph. Raises BufferError while views of it exist."},
+	{"__enter__", (PyCFunction)graph_enter, METH_NOARGS, NULL},
+	{"__exit__", (PyCFunction)graph_exit, METH_VARARGS, NULL},
+	{"degree", (PyCFunction)(void (*)(void))graph_degree, METH_VARARGS | METH_KEYWORDS, "degree(node, reverse=False)\n\nOut-degree (in-degree if reverse) of node."},
+	{"neighbours", (PyCFunction)(void (*)(void))graph_neighbours, METH_VARARGS | METH_KEYWORDS, "neighbours(node, reverse=False)\n\nList of the out-neighbours (in-neighbours if reverse) of node."},
+	{"degrees", (PyCFunction)(void (*)(void))graph_degrees, METH_VARARGS | METH_KEYWORDS, "degrees(reverse=False)\n\nArray of the out-degrees (in-degrees if reverse) of all nodes."},
+	{"store_csr", (PyCFunction)(void (*)(void))graph_store_csr, METH_VARARGS | METH_KEYWORDS, "store_csr(reverse=False)\n\nStore the out-neighbours (in-neighbours if reverse) as CSR arrays in the graph, which must be writable."},
+	{"csr", (PyCFunction)(void (*)(void))graph_csr, METH_VARARGS | METH_KEYWORDS, "csr(reverse=False)\n\nViews (offsets, targets) of the stored CSR arrays. Raises LookupError if there are none or they are outdated."},
+	{"property", (PyCFunction)graph_property, METH_VARARGS, "property(name)\n\nView of property column name, writable if the graph is."},
+	{"original_ids", (PyCFunction)graph_original_ids, METH_NOARGS, "original_ids()\n\nArray of the original node IDs, a view unless the graph is sharded, or None if it has none."},
+	{"node_by_original_id", (PyCFunction)graph_node_by_original_id, METH_VARARGS, "node_by_original_id(id)\n\nNode with original ID id, or None."},
+	{"bfs", (PyCFunction)(void (*)(void))graph_bfs, METH_VARARGS | METH_KEYWORDS, "bfs(node, cutoff, reverse=False)\n\nNumber of nodes reached by a BFS from node, stopped at cutoff."},
+	{"sample", (PyCFunction)(void (*)(void))graph_sample, METH_VARARGS | METH_KEYWORDS, "sample(count, seed=1)\n\nArray of count nodes drawn uniformly at random, as the testers and slgraphd draw them."},
+	{"random_walks", (PyCFunction)(void (*)(void))graph_random_walks, METH_VARARGS | METH_KEYWORDS,
+	 "random_walks(starts, length=32, restart=0.0, reverse=False, seed=0, visits=False)\n\n"
+	 "Walk from each node of starts (ints or a buffer of 8-byte integers). Returns arrays (ends, steps, returns, visits),\n"
+	 "where visits counts the walks at each node if requested and is None otherwise."},
+	{"tester", (PyCFunction)(void (*)(void))graph_tester, METH_VARARGS | METH_KEYWORDS,
+	 "tester(name, eps=0.0, d=0, seeds=1)\n\n"
+	 "Run the basic, improved or classical strong connectivity tester with degree bound d (0 reads it from the summary).\n"
+	 "Returns the result line of the tester program, or a list of them if seeds is a sequence."},
+	{NULL}
+};
+
+static PyGetSetDef graph_getset[] = {
+	{"nodes", (getter)graph_get_nodes, NULL, "Number of nodes", NULL},
+	{"edges", (getter)graph_get_edges, NULL, "Number of edges", NULL},
+	{"version", (getter)graph_get_version, NULL, "File format version", NULL},
+	{NULL}
+};
+
+static PyTypeObject GraphType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "slgraph.Graph",
+	.tp_doc = "Graph(path, writable=False)\n\nAn SLGraph file, mapped into memory.",
+	.tp_basicsize = sizeof(GraphObject),
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_new = PyType_GenericNew,
+	.tp_init = (initproc)graph_init,
+	.tp_dealloc = (destructor)graph_dealloc,
+	.tp_methods = graph_methods,
+	.tp_getset = graph_getset,
+};
+
+static struct PyModuleDef slgraph_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "slgraph",
+	.m_doc = "SLGraph files, with zero-copy array views for NumPy.",
+	.m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_slgraph(void)
+{
+	const uint16_t one = 1;
+	if (*(const unsigned char *)&one != 1) {
+		// Arrays in graph files are little-endian.
+		PyErr_SetString(PyExc_ImportError, "slgraph needs a little-endian host");
+		return NULL;
+	}
+
+	if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&GraphType) < 0) return NULL;
+
+	PyObject *m = PyModule_Create(&slgraph_module);
+	if (!m) return NULL;
+
+	Py_INCREF(&GraphType);
+	Py_INCREF(&ArrayType);
+	if (PyModule_AddObject(m, "Graph", (PyObject *)&GraphType) < 0 || PyModule_AddObject(m, "Array", (PyObject *)&ArrayType) < 0) {
+		Py_DECREF(m);
+		return NULL;
+	}
+	return m;
+}
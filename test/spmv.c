@@ -0,0 +1,108 @@
+// Pull-style sparse matrix-vector products over the in-lists of an SLGraph (see spmv.h).
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#include "spmv.h"
+
+// Nodes per block handed out to a thread.
+#define BLOCK 1024
+
+typedef struct {
+	const spmv_t *s;
+	const void *x;
+	void *y;
+	const uint64_t *offsets;    // Stored in-CSR arrays, if any
+	const uint64_t *sources;
+	atomic_uint_fast64_t next;  // Next block, if dynamic
+} job_t;
+
+typedef struct {
+	job_t *job;
+	unsigned id;
+	uint64_t edges;
+	double acc[SPMV_ACCUMULATORS];
+} worker_t;
+
+static double x_value(const job_t *job, uint64_t u)
+{
+	double value = job->s->type == SPMV_F32 ? ((const float *)job->x)[u] : ((const double *)job->x)[u];
+	return job->s->scale ? value * job->s->scale[u] : value;
+}
+
+static void run_block(worker_t *w, uint64_t first, uint64_t end)
+{
+	const job_t *job = w->job;
+	const spmv_t *s = job->s;
+
+	for (uint64_t v = first; v < end; v++) {
+		double sum = 0.0;
+		if (job->offsets) {
+			const uint64_t *src = job->sources + job->offsets[v], *src_end = job->sources + job->offsets[v + 1];
+			w->edges += src_end - src;
+			for (; src < src_end; src++) sum += x_value(job, *src);
+		} else {
+			uint_fast64_t deg = slgraph_in_degree(s->g, v);
+			w->edges += deg;
+			for (uint_fast64_t k = 0; k < deg; k++) sum += x_value(job, slgraph_in_neighbour(s->g, v, k));
+		}
+
+		double value = s->apply(s->ctx, v, sum, w->acc);
+		if (s->type == SPMV_F32) {
+			((float *)job->y)[v] = (float)value;
+		} else {
+			((double *)job->y)[v] = value;
+		}
+	}
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	job_t *job = w->job;
+	uint64_t n = slgraph_nodes(job->s->g), first;
+
+	if (job->s->dynamic) {
+		while ((first = atomic_fetch_add(&job->next, BLOCK)) < n) run_block(w, first, first + BLOCK < n ? first + BLOCK : n);
+	} else {
+		for (first = (uint64_t)w->id * BLOCK; first < n; first += (uint64_t)job->s->threads * BLOCK) {
+			run_block(w, first, first + BLOCK < n ? first + BLOCK : n);
+		}
+	}
+	return NULL;
+}
+
+uint64_t spmv_pull(const spmv_t *s, const void *x, void *y, double acc[SPMV_ACCUMULATORS])
+{
+	unsigned threads = s->threads ? s->threads : 1, started = 1;
+	job_t job = {.s = s, .x = x, .y = y};
+	pthread_t tids[threads];
+	worker_t workers[threads];
+	uint64_t edges = 0;
+
+	job.offsets = slgraph_csr(s->g, true, &job.sources);
+	atomic_init(&job.next, 0);
+	memset(workers, 0, sizeof(workers));
+	for (unsigned t = 0; t < threads; t++) {
+		workers[t].job = &job;
+		workers[t].id = t;
+	}
+
+	for (; started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, &workers[started])) break;
+	}
+	// The main thread is worker 0, and does the share of the workers that could not be started.
+	worker(&workers[0]);
+	for (unsigned t = started; t < threads; t++) worker(&workers[t]);
+	for (unsigned t = 1; t < started; t++) pthread_join(tids[t], NULL);
+
+	for (int i = 0; i < SPMV_ACCUMULATORS; i++) acc[i] = 0.0;
+	for (unsigned t = 0; t < threads; t++) {
+		edges += workers[t].edges;
+		for (int i = 0; i < SPMV_ACCUMULATORS; i++) acc[i] += workers[t].acc[i];
+	}
+	return edges;
+}
@@ -0,0 +1,36 @@
+// Pull-style sparse matrix-vector products over the in-lists of an SLGraph, for iterative propagation algorithms
+// (slgraph_pagerank): each node sums the values of its in-neighbours, so every value is written by one thread only and
+// no atomics are needed. The in-neighbours come from the stored CSR arrays (slgraph_csr_store(g, true)) if g has up to
+// date ones, and otherwise from the incidence lists.
+
+#ifndef SPMV_H
+#define SPMV_H
+
+#include <stdint.h>
+
+#include "slgraph.h"
+
+// Accumulators per thread that apply can add to, e.g. for a residual or the mass of dangling nodes.
+#define SPMV_ACCUMULATORS 2
+
+typedef enum {
+	SPMV_F64,
+	SPMV_F32
+} spmv_type_t;
+
+typedef struct {
+	const slgraph_t *g;
+	spmv_type_t type;       // Element type of x and y
+	const double *scale;    // Factor for x[u] in every sum it is part of (e.g. 1 / out-degree of u), or 0 for 1
+	unsigned threads;
+	int dynamic;            // Hand out blocks of nodes to threads on demand instead of every threads-th block
+	// The value of y[v], given the sum over the in-edges (u, v) of v, and the accumulators of the thread.
+	double (*apply)(void *ctx, uint64_t v, double sum, double *acc);
+	void *ctx;
+} spmv_t;
+
+// Set y[v] = apply(ctx, v, sum of scale[u] * x[u] over the in-edges (u, v)) for all nodes v, and acc to the totals of
+// the accumulators (which start at 0). Returns the number of edges traversed.
+uint64_t spmv_pull(const spmv_t *s, const void *x, void *y, double acc[SPMV_ACCUMULATORS]);
+
+#endif
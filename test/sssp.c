@@ -0,0 +1,490 @@
+// Single-source shortest paths on an SLGraph: parallel delta-stepping, with Dijkstra as a baseline.
+//
+// Usage:
+//   slgraph_sssp [--source V] [--sources K] [--seed S] [--delta D] [--threads T] [--dijkstra] [--check]
+//                [--weight NAME] [--distances] [--original-ids] <graph.slg>
+//
+// Edge weights come from the edge property column NAME (default "weight", as written by slgraph_load_edgelist
+// --weighted). Without one, they are the great-circle lengths in metres between the "lat" and "lon" node columns
+// (slgraph_osm_load --coords; 0 where a node has no coordinates), and otherwise 1. Weights must be non-negative.
+//
+// Runs from V (default 0), or from K sources drawn at random with seed S, and prints for each run
+//   source=<V> reached=<nodes> max=<distance> relaxed=<edges> time=<seconds> rate=<edges per second>
+// where relaxed counts the out-edges scanned. --dijkstra runs a sequential binary heap Dijkstra instead, and --check
+// runs both and prints the number of nodes whose distances differ. --distances prints "<node> <distance>" for every
+// node the last run reached. --original-ids takes V and prints nodes by their ID in the input the graph was loaded from.
+//
+// Delta-stepping (Meyer and Sanders) settles nodes in buckets of distances of width D (default: the mean edge weight),
+// in order. The T threads (default: one per CPU) relax the out-edges of the nodes of the current bucket together,
+// lower distances with compare-and-swap, and put the nodes they improved into buckets of their own, which are merged
+// into the next frontier between rounds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+#include "weights.h"
+
+#define CHUNK 64               // Frontier nodes a thread claims at once
+#define FUSION 1024            // Largest bucket a thread relaxes on its own
+
+typedef struct {
+	slgraph_node_t *nodes;
+	size_t count, cap;
+} bucket_t;
+
+typedef struct {
+	const slgraph_t *g;
+	const double *weights;    // Weight of each edge, or 0 for unit weights
+	double delta;
+	unsigned threads;
+	_Atomic uint64_t *dist;   // Bits of the distances: non-negative doubles are ordered like their bits
+	slgraph_node_t *frontier;
+	size_t frontier_size, frontier_cap;
+	atomic_size_t next;       // Next frontier index to claim
+	uint64_t *mins;           // Smallest non-empty bucket of each thread
+	size_t *counts;           // Size of each thread's part of the next frontier
+	atomic_int failed;
+	pthread_barrier_t barrier;
+} sssp_t;
+
+typedef struct {
+	sssp_t *s;
+	unsigned id;
+	bucket_t *buckets;
+	uint64_t bucket_count;
+	uint64_t relaxed;
+	int failed;
+} worker_t;
+
+typedef struct {
+	double dist;
+	slgraph_node_t node;
+} heap_entry_t;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint64_t splitmix(uint64_t *s)
+{
+	uint64_t z = (*s += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static uint64_t dist_bits(double d)
+{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+static double bits_dist(uint64_t bits)
+{
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static int bucket_push(worker_t *w, uint64_t index, slgraph_node_t v)
+{
+	if (index >= w->bucket_count) {
+		uint64_t count = w->bucket_count ? w->bucket_count : 64;
+		while (count <= index) count *= 2;
+		bucket_t *buckets = realloc(w->buckets, count * sizeof(bucket_t));
+		if (!buckets) return -1;
+		memset(buckets + w->bucket_count, 0, (count - w->bucket_count) * sizeof(bucket_t));
+		w->buckets = buckets;
+		w->bucket_count = count;
+	}
+	bucket_t *b = &w->buckets[index];
+	if (b->count == b->cap) {
+		size_t cap = b->cap ? 2 * b->cap : 16;
+		slgraph_node_t *nodes = realloc(b->nodes, cap * sizeof(slgraph_node_t));
+		if (!nodes) return -1;
+		b->nodes = nodes;
+		b->cap = cap;
+	}
+	b->nodes[b->count++] = v;
+	return 0;
+}
+
+// Relax the out-edges of u, unless it was settled in a bucket before current.
+static void relax(worker_t *w, slgraph_node_t u, uint64_t current)
+{
+	sssp_t *s = w->s;
+	double du = bits_dist(atomic_load_explicit(&s->dist[u], memory_order_relaxed));
+
+	if ((uint64_t)(du / s->delta) < current) return;
+
+	uint_fast64_t deg = slgraph_out_degree(s->g, u);
+	w->relaxed += deg;
+	for (uint_fast64_t k = 0; k < deg; k++) {
+		slgraph_node_t v = slgraph_out_neighbour(s->g, u, k);
+		double nd = du + (s->weights ? s->weights[slgraph_out_incident(s->g, u, k)] : 1.0);
+		uint64_t old = atomic_load_explicit(&s->dist[v], memory_order_relaxed);
+		while (nd < bits_dist(old)) {
+			if (atomic_compare_exchange_weak(&s->dist[v], &old, dist_bits(nd))) {
+				if (bucket_push(w, (uint64_t)(nd / s->delta), v)) w->failed = 1;
+				break;
+			}
+		}
+	}
+}
+
+static void *delta_worker(void *arg)
+{
+	worker_t *w = arg;
+	sssp_t *s = w->s;
+	uint64_t current = 0, first = 0; // Buckets below first are empty
+
+	for (;;) {
+		// Relax the out-edges of the frontier nodes still in the current bucket.
+		size_t i;
+		while ((i = atomic_fetch_add(&s->next, CHUNK)) < s->frontier_size && !w->failed) {
+			size_t end = i + CHUNK < s->frontier_size ? i + CHUNK : s->frontier_size;
+			for (; i < end; i++) relax(w, s->frontier[i], current);
+		}
+
+		// Nodes this thread put back into the current bucket are relaxed right away while there are few of them,
+		// instead of in another round of all threads (bucket fusion).
+		while (!w->failed && current < w->bucket_count && w->buckets[current].count &&
+		       w->buckets[current].count < FUSION) {
+			bucket_t b = w->buckets[current];
+			memset(&w->buckets[current], 0, sizeof(b));
+			for (size_t k = 0; k < b.count; k++) relax(w, b.nodes[k], current);
+			free(b.nodes);
+		}
+
+		// Find the next bucket: the smallest one any thread has nodes in. Relaxing put nodes in the current one at most.
+		if (first > current) first = current;
+		while (first < w->bucket_count && !w->buckets[first].count) first++;
+		s->mins[w->id] = w->failed ? 0 : first < w->bucket_count ? first : UINT64_MAX;
+		if (w->failed) s->failed = 1;
+		pthread_barrier_wait(&s->barrier);
+
+		current = UINT64_MAX;
+		for (unsigned t = 0; t < s->threads; t++) {
+			if (s->mins[t] < current) current = s->mins[t];
+		}
+		if (current == UINT64_MAX || s->failed) break;
+		s->counts[w->id] = current < w->bucket_count ? w->buckets[current].count : 0;
+		pthread_barrier_wait(&s->barrier);
+
+		if (w->id == 0) {
+			size_t total = 0;
+			for (unsigned t = 0; t < s->threads; t++) total += s->counts[t];
+			if (total > s->frontier_cap) {
+				slgraph_node_t *frontier = realloc(s->frontier, total * sizeof(slgraph_node_t));
+				if (frontier) {
+					s->frontier = frontier;
+					s->frontier_cap = total;
+				} else {
+					s->failed = 1;
+				}
+			}
+			s->frontier_size = total;
+			atomic_store(&s->next, 0);
+		}
+		pthread_barrier_wait(&s->barrier);
+		if (s->failed) break;
+
+		// Move the bucket into this thread's part of the frontier.
+		size_t offset = 0;
+		for (unsigned t = 0; t < w->id; t++) offset += s->counts[t];
+		if (s->counts[w->id]) {
+			bucket_t *b = &w->buckets[current];
+			memcpy(s->frontier + offset, b->nodes, b->count * sizeof(slgraph_node_t));
+			free(b->nodes);
+			memset(b, 0, sizeof(*b));
+		}
+		pthread_barrier_wait(&s->barrier);
+	}
+
+	for (uint64_t b = 0; b < w->bucket_count; b++) free(w->buckets[b].nodes);
+	free(w->buckets);
+	return NULL;
+}
+
+// Compute the distances from source with delta-stepping. Returns the number of edges relaxed, or UINT64_MAX if out of
+// memory.
+static uint64_t delta_stepping(const slgraph_t *g, const double *weights, double delta, unsigned threads, slgraph_node_t source, double *dist)
+{
+	uint64_t n = slgraph_nodes(g), relaxed = 0;
+	sssp_t s = {.g = g, .weights = weights, .delta = delta, .threads = threads};
+	worker_t *workers = calloc(threads, sizeof(worker_t));
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+
+	s.dist = malloc(n * sizeof(*s.dist));
+	s.frontier = malloc(sizeof(slgraph_node_t));
+	s.frontier_cap = 1;
+	s.mins = malloc(threads * sizeof(uint64_t));
+	s.counts = malloc(threads * sizeof(size_t));
+	if (!workers || !tids || !s.dist || !s.frontier || !s.mins || !s.counts || pthread_barrier_init(&s.barrier, NULL, threads)) {
+		free(s.dist);
+		free(workers);
+		free(tids);
+		free(s.frontier);
+		free(s.mins);
+		free(s.counts);
+		return UINT64_MAX;
+	}
+
+	for (uint64_t v = 0; v < n; v++) atomic_init(&s.dist[v], dist_bits(INFINITY));
+	atomic_store(&s.dist[source], dist_bits(0.0));
+	s.frontier[0] = source;
+	s.frontier_size = 1;
+	atomic_init(&s.next, 0);
+	atomic_init(&s.failed, 0);
+
+	unsigned started = 0;
+	for (; started < threads; started++) {
+		workers[started].s = &s;
+		workers[started].id = started;
+		if (started && pthread_create(&tids[started], NULL, delta_worker, &workers[started])) break;
+	}
+	if (started == threads) {
+		delta_worker(&workers[0]);
+	} else {
+		// The barrier counts on all threads, so the ones started wait forever: give up.
+		fprintf(stderr, "Failed to start worker threads\n");
+		exit(1);
+	}
+	for (unsigned t = 1; t < threads; t++) pthread_join(tids[t], NULL);
+	for (unsigned t = 0; t < threads; t++) relaxed += workers[t].relaxed;
+
+	for (uint64_t v = 0; v < n; v++) dist[v] = bits_dist(atomic_load_explicit(&s.dist[v], memory_order_relaxed));
+
+	pthread_barrier_destroy(&s.barrier);
+	free(s.dist);
+	free(workers);
+	free(tids);
+	free(s.frontier);
+	free(s.mins);
+	free(s.counts);
+	return s.failed ? UINT64_MAX : relaxed;
+}
+
+static void heap_push(heap_entry_t *heap, size_t *size, heap_entry_t e)
+{
+	size_t i = (*size)++;
+	while (i && heap[(i - 1) / 2].dist > e.dist) {
+		heap[i] = heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	heap[i] = e;
+}
+
+static heap_entry_t heap_pop(heap_entry_t *heap, size_t *size)
+{
+	heap_entry_t top = heap[0], last = heap[--*size];
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= *size) break;
+		if (c + 1 < *size && heap[c + 1].dist < heap[c].dist) c++;
+		if (heap[c].dist >= last.dist) break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	if (*size) heap[i] = last;
+	return top;
+}
+
+// Compute the distances from source with Dijkstra's algorithm on a binary heap, with lazy deletion instead of
+// decrease-key. Returns the number of edges relaxed, or UINT64_MAX if out of memory.
+static uint64_t dijkstra(const slgraph_t *g, const double *weights, slgraph_node_t source, double *dist)
+{
+	uint64_t n = slgraph_nodes(g), relaxed = 0;
+	size_t size = 0, cap = 1024;
+	heap_entry_t *heap = malloc(cap * sizeof(heap_entry_t));
+
+	if (!heap) return UINT64_MAX;
+	for (uint64_t v = 0; v < n; v++) dist[v] = INFINITY;
+	dist[source] = 0.0;
+	heap_push(heap, &size, (heap_entry_t){0.0, source});
+
+	while (size) {
+		heap_entry_t e = heap_pop(heap, &size);
+		if (e.dist > dist[e.node]) continue; // Stale entry
+
+		uint_fast64_t deg = slgraph_out_degree(g, e.node);
+		relaxed += deg;
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t v = slgraph_out_neighbour(g, e.node, k);
+			double nd = e.dist + (weights ? weights[slgraph_out_incident(g, e.node, k)] : 1.0);
+			if (nd >= dist[v]) continue;
+			dist[v] = nd;
+			if (size == cap) {
+				heap_entry_t *grown = realloc(heap, 2 * cap * sizeof(heap_entry_t));
+				if (!grown) {
+					free(heap);
+					return UINT64_MAX;
+				}
+				heap = grown;
+				cap *= 2;
+			}
+			heap_push(heap, &size, (heap_entry_t){nd, v});
+		}
+	}
+
+	free(heap);
+	return relaxed;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t source = 0, sources = 0, seed = 1;
+	double delta = 0.0;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int use_dijkstra = 0, check = 0, distances = 0, original_ids = 0, named = 0;
+	const char *weight_name = "weight";
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--source") == 0 && argi + 1 < argc - 1) {
+			source = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--sources") == 0 && argi + 1 < argc - 1) {
+			sources = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--seed") == 0 && argi + 1 < argc - 1) {
+			seed = strtoull(argv[++argi], NULL, 10);
+		} else if (strcmp(argv[argi], "--delta") == 0 && argi + 1 < argc - 1) {
+			delta = strtod(argv[++argi], NULL);
+		} else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--dijkstra") == 0) {
+			use_dijkstra = 1;
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else if (strcmp(argv[argi], "--weight") == 0 && argi + 1 < argc - 1) {
+			weight_name = argv[++argi];
+			named = 1;
+		} else if (strcmp(argv[argi], "--distances") == 0) {
+			distances = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else {
+			break;
+		}
+	}
+	if (argc - argi != 1 || delta < 0.0) {
+		fprintf(stderr, "Usage: %s [--source V] [--sources K] [--seed S] [--delta D] [--threads T] [--dijkstra] [--check] [--weight NAME] [--distances] [--original-ids] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	slgraph_t g;
+	if (slgraph_open(&g, argv[argi], true)) {
+		fprintf(stderr, "Failed to open graph: %s\n", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g), m = slgraph_edges(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+	if (original_ids) source = slgraph_node_by_original_id(&g, source);
+	if (source >= n) {
+		fprintf(stderr, "No such source node\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	const double *weights;
+	double *owned;
+	const char *weight_source = load_weights(&g, weight_name, named, &weights, &owned);
+	if (!weight_source) {
+		slgraph_close(&g);
+		return 1;
+	}
+	if (delta == 0.0) {
+		double sum = 0.0;
+		for (uint64_t e = 0; weights && e < m; e++) sum += weights[e];
+		delta = weights && m ? sum / m : 1.0;
+		if (!(delta > 0.0)) delta = 1.0;
+	}
+
+	double *dist = malloc(n * sizeof(double)), *expected = check ? malloc(n * sizeof(double)) : NULL;
+	if (!dist || (check && !expected)) {
+		fprintf(stderr, "Out of memory for %lu distances\n", (unsigned long)n);
+		free(dist);
+		free(owned);
+		slgraph_close(&g);
+		return 1;
+	}
+
+	printf("Stats: nodes=%lu edges=%lu mode=%s weights=%s delta=%g threads=%ld\n", (unsigned long)n, (unsigned long)m,
+	       use_dijkstra ? "dijkstra" : "delta_stepping", weight_source, delta, use_dijkstra ? 1L : threads);
+
+	uint64_t runs = sources ? sources : 1, state = seed, total_relaxed = 0, mismatched = 0;
+	double total_time = 0.0;
+	int failed = 0;
+	for (uint64_t r = 0; r < runs && !failed; r++) {
+		slgraph_node_t s = sources ? splitmix(&state) % n : source;
+
+		double t0 = now();
+		uint64_t relaxed = use_dijkstra ? dijkstra(&g, weights, s, dist) : delta_stepping(&g, weights, delta, (unsigned)threads, s, dist);
+		double elapsed = now() - t0;
+		if (relaxed == UINT64_MAX) {
+			fprintf(stderr, "Out of memory\n");
+			failed = 1;
+			break;
+		}
+
+		uint64_t reached = 0;
+		double max = 0.0;
+		for (uint64_t v = 0; v < n; v++) {
+			if (isinf(dist[v])) continue;
+			reached++;
+			if (dist[v] > max) max = dist[v];
+		}
+		total_relaxed += relaxed;
+		total_time += elapsed;
+		printf("source=%lu reached=%lu max=%.17g relaxed=%lu time=%.6f rate=%.0f\n",
+		       (unsigned long)(original_ids ? slgraph_original_id(&g, s) : s), (unsigned long)reached, max,
+		       (unsigned long)relaxed, elapsed, elapsed > 0.0 ? relaxed / elapsed : 0.0);
+
+		if (check) {
+			if (use_dijkstra ? delta_stepping(&g, weights, delta, (unsigned)threads, s, expected) == UINT64_MAX
+			                 : dijkstra(&g, weights, s, expected) == UINT64_MAX) {
+				fprintf(stderr, "Out of memory\n");
+				failed = 1;
+				break;
+			}
+			// Paths of equal length can sum their weights in a different order.
+			for (uint64_t v = 0; v < n; v++) {
+				if (dist[v] != expected[v] && !(fabs(dist[v] - expected[v]) <= 1e-9 * fabs(expected[v]))) mismatched++;
+			}
+		}
+	}
+
+	if (!failed) {
+		printf("total_relaxed=%lu total_time=%.6f rate=%.0f\n", (unsigned long)total_relaxed, total_time,
+		       total_time > 0.0 ? total_relaxed / total_time : 0.0);
+		if (check) printf("check=%s mismatched=%lu\n", mismatched ? "FAIL" : "OK", (unsigned long)mismatched);
+		for (uint64_t v = 0; distances && v < n; v++) {
+			if (isinf(dist[v])) continue;
+			printf("%lu %.17g\n", (unsigned long)(original_ids ? slgraph_original_id(&g, v) : v), dist[v]);
+		}
+	}
+
+	free(dist);
+	free(expected);
+	free(owned);
+	slgraph_close(&g);
+	return failed || mismatched;
+}
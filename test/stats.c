@@ -0,0 +1,240 @@
+// Compute a summary of a directed SLGraph in one parallel pass and store it
+// in the graph file, so it can later be read in O(1): maximum in- and
+// out-degree, degree histograms, self-loops, duplicate edges and isolated nodes.
+// The testers use the stored maximum degree when called with d = auto.
+//
+// Usage:
+//   slgraph_stats [--threads N] [--show] <graph.slg>
+//
+// --show prints the stored summary without recomputing it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+
+// Nodes are handed out to threads in chunks of this size.
+#define CHUNK 4096
+
+typedef struct {
+	const slgraph_t *g;
+	atomic_uint_fast64_t *next;
+	slgraph_summary_t summary;
+	uint64_t *out_hist;
+	uint64_t *in_hist;
+	uint64_t out_hist_len;
+	uint64_t in_hist_len;
+	int failed;
+} worker_t;
+
+static int cmp_node(const void *a, const void *b)
+{
+	slgraph_node_t va = *(const slgraph_node_t *)a;
+	slgraph_node_t vb = *(const slgraph_node_t *)b;
+	return (va > vb) - (va < vb);
+}
+
+// Count one node of degree deg, growing the histogram as needed.
+static int hist_add(uint64_t **hist, uint64_t *len, uint64_t deg)
+{
+	if (deg >= *len) {
+		uint64_t newlen = deg * 2 + 16;
+		uint64_t *tmp = realloc(*hist, newlen * sizeof(uint64_t));
+		if (!tmp) return -1;
+		memset(tmp + *len, 0, (newlen - *len) * sizeof(uint64_t));
+		*hist = tmp;
+		*len = newlen;
+	}
+	(*hist)[deg]++;
+	return 0;
+}
+
+static void *worker(void *arg)
+{
+	worker_t *w = arg;
+	const slgraph_t *g = w->g;
+	uint64_t n = slgraph_nodes(g);
+	bool sorted = slgraph_sorted_adjacency(g);
+	slgraph_node_t *nbs = NULL;
+	uint64_t nbs_cap = 0;
+
+	for (;;) {
+		uint64_t begin = atomic_fetch_add(w->next, CHUNK);
+		if (begin >= n) break;
+		uint64_t end = begin + CHUNK < n ? begin + CHUNK : n;
+
+		for (slgraph_node_t v = begin; v < end; v++) {
+			if (slgraph_node_removed(g, v)) continue;
+
+			uint_fast64_t out = slgraph_out_degree(g, v);
+			uint_fast64_t in = slgraph_in_degree(g, v);
+
+			w->summary.nodes++;
+			w->summary.edges += out;
+			if (out > w->summary.max_out_degree) w->summary.max_out_degree = out;
+			if (in > w->summary.max_in_degree) w->summary.max_in_degree = in;
+			if (!out && !in) w->summary.isolated_nodes++;
+			if (hist_add(&w->out_hist, &w->out_hist_len, out) ||
+			    hist_add(&w->in_hist, &w->in_hist_len, in)) {
+				w->failed = 1;
+				free(nbs);
+				return NULL;
+			}
+
+			if (out > nbs_cap) {
+				slgraph_node_t *tmp = realloc(nbs, out * sizeof(slgraph_node_t));
+				if (!tmp) {
+					w->failed = 1;
+					free(nbs);
+					return NULL;
+				}
+				nbs = tmp;
+				nbs_cap = out;
+			}
+			for (uint_fast64_t i = 0; i < out; i++) {
+				nbs[i] = slgraph_out_neighbour(g, v, i);
+				if (nbs[i] == v) w->summary.self_loops++;
+			}
+			if (!sorted) qsort(nbs, out, sizeof(slgraph_node_t), cmp_node);
+			for (uint_fast64_t i = 1; i < out; i++) {
+				if (nbs[i] == nbs[i - 1]) w->summary.duplicate_edges++;
+			}
+		}
+	}
+
+	free(nbs);
+	return NULL;
+}
+
+static void print_summary(const slgraph_t *g, const slgraph_summary_t *s)
+{
+	printf("Stats: nodes=%lu edges=%lu mode=stats\n", (unsigned long)s->nodes, (unsigned long)s->edges);
+	printf("max_out_degree=%lu max_in_degree=%lu self_loops=%lu duplicate_edges=%lu isolated_nodes=%lu\n",
+	       (unsigned long)s->max_out_degree, (unsigned long)s->max_in_degree, (unsigned long)s->self_loops,
+	       (unsigned long)s->duplicate_edges, (unsigned long)s->isolated_nodes);
+	printf("out_degree_histogram:");
+	for (uint64_t d = 0; d <= s->max_out_degree; d++) {
+		uint64_t c = slgraph_summary_out_degree_count(g, d);
+		if (c) printf(" %lu:%lu", (unsigned long)d, (unsigned long)c);
+	}
+	printf("\nin_degree_histogram:");
+	for (uint64_t d = 0; d <= s->max_in_degree; d++) {
+		uint64_t c = slgraph_summary_in_degree_count(g, d);
+		if (c) printf(" %lu:%lu", (unsigned long)d, (unsigned long)c);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int show = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--show") == 0) {
+			show = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1) {
+		fprintf(stderr, "Usage: %s [--threads N] [--show] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	slgraph_t g;
+	if (slgraph_open_existing(&g, argv[argi], show)) {
+		fprintf(stderr, "Failed to open graph: %s\n", argv[argi]);
+		return 1;
+	}
+
+	slgraph_summary_t summary;
+	if (show) {
+		if (slgraph_summary(&g, &summary)) {
+			fprintf(stderr, "No up-to-date summary in %s (run %s without --show)\n", argv[argi], argv[0]);
+			slgraph_close(&g);
+			return 1;
+		}
+		print_summary(&g, &summary);
+		slgraph_close(&g);
+		return 0;
+	}
+
+	worker_t *workers = calloc(threads, sizeof(worker_t));
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+	if (!workers || !tids) {
+		fprintf(stderr, "Out of memory for worker threads\n");
+		free(workers);
+		free(tids);
+		slgraph_close(&g);
+		return 1;
+	}
+
+	atomic_uint_fast64_t next;
+	atomic_init(&next, 0);
+	for (long t = 0; t < threads; t++) {
+		workers[t].g = &g;
+		workers[t].next = &next;
+		if (pthread_create(&tids[t], NULL, worker, &workers[t])) {
+			threads = t;
+			break;
+		}
+	}
+	for (long t = 0; t < threads; t++) {
+		pthread_join(tids[t], NULL);
+	}
+
+	// Merge per-thread results.
+	memset(&summary, 0, sizeof(summary));
+	int failed = threads == 0;
+	for (long t = 0; t < threads; t++) {
+		const slgraph_summary_t *s = &workers[t].summary;
+		failed |= workers[t].failed;
+		summary.nodes += s->nodes;
+		summary.edges += s->edges;
+		summary.self_loops += s->self_loops;
+		summary.duplicate_edges += s->duplicate_edges;
+		summary.isolated_nodes += s->isolated_nodes;
+		if (s->max_out_degree > summary.max_out_degree) summary.max_out_degree = s->max_out_degree;
+		if (s->max_in_degree > summary.max_in_degree) summary.max_in_degree = s->max_in_degree;
+	}
+
+	uint_fast64_t *out_hist = calloc(summary.max_out_degree + 1, sizeof(uint_fast64_t));
+	uint_fast64_t *in_hist = calloc(summary.max_in_degree + 1, sizeof(uint_fast64_t));
+	failed |= !out_hist || !in_hist;
+	for (long t = 0; t < threads && !failed; t++) {
+		for (uint64_t d = 0; d < workers[t].out_hist_len && d <= summary.max_out_degree; d++) out_hist[d] += workers[t].out_hist[d];
+		for (uint64_t d = 0; d < workers[t].in_hist_len && d <= summary.max_in_degree; d++) in_hist[d] += workers[t].in_hist[d];
+	}
+	for (long t = 0; t < threads; t++) {
+		free(workers[t].out_hist);
+		free(workers[t].in_hist);
+	}
+	free(workers);
+	free(tids);
+
+	if (failed || slgraph_set_summary(&g, &summary, out_hist, in_hist)) {
+		fprintf(stderr, "Failed to compute or store summary\n");
+		free(out_hist);
+		free(in_hist);
+		slgraph_close(&g);
+		return 1;
+	}
+
+	print_summary(&g, &summary);
+
+	free(out_hist);
+	free(in_hist);
+	slgraph_close(&g);
+	return 0;
+}
@@ -0,0 +1,472 @@
+// Count the triangles of an SLGraph, and the local clustering coefficients of its nodes, in parallel.
+//
+// Usage:
+//   slgraph_triangles [--threads N] [--clustering] [--members] [--original-ids] [--store] [--check] <graph.slg>
+//
+// The graph is taken as undirected and simple: the neighbours of a node are its out- and in-neighbours, without
+// duplicates or the node itself. Every edge is oriented from the end of lower degree to the one of higher degree (ties
+// broken by node), which leaves every node at most sqrt(2m) out-neighbours. The sorted lists are written as CSR arrays
+// to an unlinked temporary file (in $TMPDIR, default /tmp) that is mapped into memory, so they need not fit in RAM,
+// and then cut down to the oriented edges in place. Each triangle is then found once, from its node of lowest degree
+// u: for every oriented edge (u, v), the N threads (default: one per CPU) intersect the out-lists of u and v. Lists of
+// similar length are merged; when the list of u is much longer, the nodes of the other are looked up in a hash table
+// of the list of u, built once for u.
+//
+// Prints the number of undirected edges and triangles and the transitivity, 3 * triangles / wedges, where a wedge is a
+// pair of neighbours of a node. --clustering also counts the triangles of every node, which costs atomic additions,
+// and prints the average local clustering coefficient, the fraction of the wedges of a node closed by an edge (0 for
+// nodes of degree below 2). --members prints "<node> <triangles> <clustering coefficient>" for every node, by its input
+// ID with --original-ids. --store keeps the coefficients in the node property column "clustering" (not updated when
+// the graph changes). --check compares the counts with those of a sequential merge over the undirected lists.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "slgraph.h"
+
+// Nodes are handed out to threads in chunks of this size.
+#define CHUNK 256
+
+// An intersection uses the hash table of the list of u if that is this many times longer than the other list.
+#define HASH_RATIO 8
+
+typedef enum {
+	PHASE_DEGREE,   // Count the undirected neighbours of every node
+	PHASE_FILL,     // Write the undirected lists
+	PHASE_ORIENT,   // Keep the oriented neighbours at the start of every list
+	PHASE_COUNT     // Count triangles
+} phase_t;
+
+typedef struct {
+	const slgraph_t *g;
+	phase_t phase;
+	atomic_uint_fast64_t next;
+	uint64_t max_degree;            // Largest in- plus out-degree
+	uint64_t *degree;               // Undirected degree of every node
+	uint64_t *offsets;              // n + 1 offsets into targets, in the temporary file
+	uint64_t *targets;
+	uint64_t *oriented;             // Oriented degree of every node, until the lists are packed
+	uint64_t max_oriented;          // Largest oriented degree
+	_Atomic uint64_t *node_triangles; // Triangles of every node, if counted
+	atomic_uint_fast64_t triangles;
+	atomic_uint_fast64_t merged;    // Intersections by merging
+	atomic_uint_fast64_t hashed;    // Intersections by hash table
+	int failed;                     // Set when a thread ran out of memory
+} job_t;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// The neighbours of v in buffer, sorted and without duplicates or v itself. Returns their number.
+static uint64_t neighbours(const slgraph_t *g, slgraph_node_t v, uint64_t *buffer)
+{
+	uint64_t n = slgraph_nodes(g), count = 0, kept = 0;
+
+	for (int in = 0; in < 2; in++) {
+		uint_fast64_t deg = in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+		for (uint_fast64_t k = 0; k < deg; k++) {
+			slgraph_node_t u = in ? slgraph_in_neighbour(g, v, k) : slgraph_out_neighbour(g, v, k);
+			if (u < n && u != v) buffer[count++] = u;
+		}
+	}
+	qsort(buffer, count, sizeof(uint64_t), cmp_u64);
+	for (uint64_t i = 0; i < count; i++) {
+		if (i == 0 || buffer[i] != buffer[i - 1]) buffer[kept++] = buffer[i];
+	}
+	return kept;
+}
+
+// Whether the edge between u and v is oriented from u to v.
+static int before(const uint64_t *degree, uint64_t u, uint64_t v)
+{
+	return degree[u] < degree[v] || (degree[u] == degree[v] && u < v);
+}
+
+static uint64_t hash_slot(uint64_t node, uint64_t mask)
+{
+	return ((node + 1) * 0x9e3779b97f4a7c15ULL >> 32) & mask;
+}
+
+static void add_triangle(job_t *job, uint64_t v, uint64_t w)
+{
+	if (!job->node_triangles) return;
+	atomic_fetch_add_explicit(&job->node_triangles[v], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&job->node_triangles[w], 1, memory_order_relaxed);
+}
+
+// Count the triangles from u. table is a hash table of mask + 1 slots, empty (0) on entry and exit, with node + 1 in
+// the slots in use.
+static uint64_t count_from(job_t *job, uint64_t u, uint64_t *table, uint64_t mask, uint64_t *merged, uint64_t *hashed)
+{
+	const uint64_t *a = job->targets + job->offsets[u], *a_end = job->targets + job->offsets[u + 1];
+	uint64_t a_len = a_end - a, triangles = 0;
+	int filled = 0;
+
+	for (const uint64_t *p = a; p < a_end; p++) {
+		uint64_t v = *p, found = 0;
+		const uint64_t *b = job->targets + job->offsets[v], *b_end = job->targets + job->offsets[v + 1];
+		uint64_t b_len = b_end - b;
+		if (!b_len) continue;
+
+		if (a_len > HASH_RATIO * b_len) {
+			if (!filled) {
+				for (const uint64_t *q = a; q < a_end; q++) {
+					uint64_t slot = hash_slot(*q, mask);
+					while (table[slot]) slot = (slot + 1) & mask;
+					table[slot] = *q + 1;
+				}
+				filled = 1;
+			}
+			for (; b < b_end; b++) {
+				uint64_t slot = hash_slot(*b, mask);
+				while (table[slot] && table[slot] != *b + 1) slot = (slot + 1) & mask;
+				if (table[slot]) {
+					found++;
+					add_triangle(job, v, *b);
+				}
+			}
+			(*hashed)++;
+		} else {
+			const uint64_t *x = a;
+			while (x < a_end && b < b_end) {
+				if (*x < *b) {
+					x++;
+				} else if (*b < *x) {
+					b++;
+				} else {
+					found++;
+					add_triangle(job, v, *b);
+					x++;
+					b++;
+				}
+			}
+			(*merged)++;
+		}
+		triangles += found;
+	}
+
+	if (filled) {
+		// Empty the run of slots from the home slot of every node on, which the node is in.
+		for (const uint64_t *q = a; q < a_end; q++) {
+			for (uint64_t slot = hash_slot(*q, mask); table[slot]; slot = (slot + 1) & mask) table[slot] = 0;
+		}
+	}
+	if (job->node_triangles && triangles) atomic_fetch_add_explicit(&job->node_triangles[u], triangles, memory_order_relaxed);
+	return triangles;
+}
+
+static void *worker(void *arg)
+{
+	job_t *job = arg;
+	const slgraph_t *g = job->g;
+	uint64_t n = slgraph_nodes(g), first, triangles = 0, merged = 0, hashed = 0, mask = 0;
+	uint64_t *buffer = NULL;
+
+	if (job->phase == PHASE_COUNT) {
+		// At least twice as many slots as the longest list.
+		for (mask = 1; mask < 2 * job->max_oriented; mask *= 2);
+		buffer = calloc(mask, sizeof(uint64_t));
+		mask--;
+	} else if (job->phase != PHASE_ORIENT) {
+		buffer = malloc((job->max_degree ? job->max_degree : 1) * sizeof(uint64_t));
+	}
+	if (!buffer && job->phase != PHASE_ORIENT) {
+		job->failed = 1;
+		return NULL;
+	}
+
+	while ((first = atomic_fetch_add(&job->next, CHUNK)) < n) {
+		uint64_t end = first + CHUNK < n ? first + CHUNK : n;
+		for (uint64_t v = first; v < end; v++) {
+			if (job->phase == PHASE_COUNT) {
+				triangles += count_from(job, v, buffer, mask, &merged, &hashed);
+			} else if (job->phase == PHASE_ORIENT) {
+				uint64_t *list = job->targets + job->offsets[v], count = job->offsets[v + 1] - job->offsets[v], kept = 0;
+				for (uint64_t i = 0; i < count; i++) {
+					if (before(job->degree, v, list[i])) list[kept++] = list[i];
+				}
+				job->oriented[v] = kept;
+			} else if (job->phase == PHASE_FILL) {
+				// Gathered in the buffer, as the duplicates could run into the next list.
+				memcpy(job->targets + job->offsets[v], buffer, neighbours(g, v, buffer) * sizeof(uint64_t));
+			} else {
+				job->degree[v] = neighbours(g, v, buffer);
+			}
+		}
+	}
+
+	atomic_fetch_add(&job->triangles, triangles);
+	atomic_fetch_add(&job->merged, merged);
+	atomic_fetch_add(&job->hashed, hashed);
+	free(buffer);
+	return NULL;
+}
+
+// Run the current phase of job on threads threads.
+static void run(job_t *job, long threads)
+{
+	pthread_t tids[threads];
+	long started = 1;
+
+	atomic_store(&job->next, 0);
+	for (; started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, job)) break;
+	}
+	worker(job);
+	for (long t = 1; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+// Map an unlinked temporary file of size bytes. Returns NULL if that fails.
+static void *temp_map(size_t size)
+{
+	const char *dir = getenv("TMPDIR");
+	char *name = malloc(strlen(dir ? dir : "/tmp") + 32);
+	void *ptr = MAP_FAILED;
+
+	if (!name) return NULL;
+	sprintf(name, "%s/slgraph_triangles_XXXXXX", dir ? dir : "/tmp");
+	int fd = mkstemp(name);
+	if (fd != -1) {
+		unlink(name);
+		if (ftruncate(fd, (off_t)size) == 0) ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+	}
+	free(name);
+	return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+// Sequential reference: count the triangles of every node by merging the sorted undirected lists of the ends of every
+// edge (u, v) with u < v, over the neighbours w > v. Returns the number of triangles, or UINT64_MAX if out of memory.
+static uint64_t merge_triangles(const slgraph_t *g, const uint64_t *degree, uint64_t max_degree, uint64_t *node_triangles)
+{
+	uint64_t n = slgraph_nodes(g), total = 0;
+	uint64_t *offsets = malloc((n + 1) * sizeof(uint64_t)), *lists = NULL;
+
+	if (!offsets) return UINT64_MAX;
+	offsets[0] = 0;
+	for (uint64_t v = 0; v < n; v++) offsets[v + 1] = offsets[v] + degree[v];
+	if (!(lists = malloc((offsets[n] + max_degree + 1) * sizeof(uint64_t)))) {
+		free(offsets);
+		return UINT64_MAX;
+	}
+	// Each list is gathered in place; the extra room at the end takes duplicates before they are removed.
+	for (uint64_t v = 0; v < n; v++) neighbours(g, v, lists + offsets[v]);
+
+	for (uint64_t v = 0; v < n; v++) node_triangles[v] = 0;
+	for (uint64_t u = 0; u < n; u++) {
+		for (uint64_t i = offsets[u]; i < offsets[u + 1]; i++) {
+			uint64_t v = lists[i];
+			if (v <= u) continue;
+			const uint64_t *a = lists + i + 1, *a_end = lists + offsets[u + 1];
+			const uint64_t *b = lists + offsets[v], *b_end = lists + offsets[v + 1];
+			while (a < a_end && b < b_end) {
+				if (*a < *b) {
+					a++;
+				} else if (*b < *a) {
+					b++;
+				} else {
+					node_triangles[u]++;
+					node_triangles[v]++;
+					node_triangles[*a]++;
+					total++;
+					a++;
+					b++;
+				}
+			}
+		}
+	}
+
+	free(offsets);
+	free(lists);
+	return total;
+}
+
+static double coefficient(uint64_t triangles, uint64_t degree)
+{
+	return degree < 2 ? 0.0 : 2.0 * triangles / ((double)degree * (degree - 1));
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int clustering = 0, members = 0, original_ids = 0, store = 0, check = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--clustering") == 0) {
+			clustering = 1;
+		} else if (strcmp(argv[argi], "--members") == 0) {
+			members = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else if (strcmp(argv[argi], "--store") == 0) {
+			store = 1;
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1) {
+		fprintf(stderr, "Usage: %s [--threads N] [--clustering] [--members] [--original-ids] [--store] [--check] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+	clustering |= members || store || check;
+
+	slgraph_t g;
+	if (slgraph_open_existing(&g, argv[argi], !store)) {
+		fprintf(stderr, "Failed to open graph%s: %s\n", store ? " for writing" : "", argv[argi]);
+		return 1;
+	}
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	job_t job = {.g = &g};
+	job.degree = malloc(n * sizeof(uint64_t));
+	job.oriented = malloc(n * sizeof(uint64_t));
+	if (clustering) job.node_triangles = calloc(n, sizeof(_Atomic uint64_t));
+	if (!job.degree || !job.oriented || (clustering && !job.node_triangles)) {
+		fprintf(stderr, "Out of memory for %lu nodes\n", (unsigned long)n);
+		return 1;
+	}
+	atomic_init(&job.triangles, 0);
+	atomic_init(&job.merged, 0);
+	atomic_init(&job.hashed, 0);
+	for (uint64_t v = 0; v < n; v++) {
+		uint64_t d = slgraph_out_degree(&g, v) + slgraph_in_degree(&g, v);
+		if (d > job.max_degree) job.max_degree = d;
+	}
+
+	double t0 = now();
+	job.phase = PHASE_DEGREE;
+	run(&job, threads);
+	if (job.failed) {
+		fprintf(stderr, "Out of memory for neighbour lists\n");
+		return 1;
+	}
+	uint64_t ends = 0, wedges = 0;
+	for (uint64_t v = 0; v < n; v++) {
+		ends += job.degree[v];
+		wedges += job.degree[v] * (job.degree[v] ? job.degree[v] - 1 : 0) / 2;
+	}
+
+	// The CSR arrays, offsets and then targets, in one temporary file: first the undirected lists, then the oriented
+	// part of each is moved to the start of its list, and finally the oriented lists are packed.
+	size_t size = (n + 1 + (ends ? ends : 1)) * sizeof(uint64_t);
+	uint64_t *csr = temp_map(size);
+	if (!csr) {
+		fprintf(stderr, "Failed to map a temporary file of %lu bytes\n", (unsigned long)size);
+		return 1;
+	}
+	job.offsets = csr;
+	job.targets = csr + n + 1;
+	job.offsets[0] = 0;
+	for (uint64_t v = 0; v < n; v++) job.offsets[v + 1] = job.offsets[v] + job.degree[v];
+	job.phase = PHASE_FILL;
+	run(&job, threads);
+	job.phase = PHASE_ORIENT;
+	if (!job.failed) run(&job, threads);
+	if (job.failed) {
+		fprintf(stderr, "Out of memory for neighbour lists\n");
+		return 1;
+	}
+	uint64_t edges = 0;
+	for (uint64_t v = 0; v < n; v++) {
+		uint64_t first = job.offsets[v];
+		memmove(job.targets + edges, job.targets + first, job.oriented[v] * sizeof(uint64_t));
+		job.offsets[v] = edges;
+		edges += job.oriented[v];
+		if (job.oriented[v] > job.max_oriented) job.max_oriented = job.oriented[v];
+	}
+	job.offsets[n] = edges;
+	free(job.oriented);
+	double t1 = now();
+
+	job.phase = PHASE_COUNT;
+	if (!job.failed) run(&job, threads);
+	if (job.failed) {
+		fprintf(stderr, "Out of memory for hash tables\n");
+		return 1;
+	}
+	double t2 = now();
+	uint64_t triangles = atomic_load(&job.triangles);
+
+	printf("Stats: nodes=%lu edges=%lu mode=triangles threads=%ld\n", (unsigned long)n, (unsigned long)slgraph_edges(&g), threads);
+	printf("undirected_edges=%lu max_oriented_degree=%lu orient_time=%.3f\n", (unsigned long)edges, (unsigned long)job.max_oriented,
+	       t1 - t0);
+	printf("triangles=%lu wedges=%lu transitivity=%.6f count_time=%.3f merged=%lu hashed=%lu\n", (unsigned long)triangles,
+	       (unsigned long)wedges, wedges ? 3.0 * triangles / wedges : 0.0, t2 - t1, (unsigned long)atomic_load(&job.merged),
+	       (unsigned long)atomic_load(&job.hashed));
+
+	int failed = 0;
+	double *local = clustering ? malloc(n * sizeof(double)) : NULL;
+	if (clustering && !local) {
+		fprintf(stderr, "Out of memory for clustering coefficients\n");
+		failed = 1;
+	} else if (clustering) {
+		double sum = 0.0;
+		for (uint64_t v = 0; v < n; v++) {
+			local[v] = coefficient(atomic_load_explicit(&job.node_triangles[v], memory_order_relaxed), job.degree[v]);
+			sum += local[v];
+		}
+		printf("average_clustering=%.6f\n", sum / n);
+	}
+
+	if (!failed && check) {
+		// The degrees are no longer needed after the expected counts.
+		uint64_t *expected = malloc(n * sizeof(uint64_t)), mismatched = 0;
+		uint64_t total = expected ? merge_triangles(&g, job.degree, job.max_degree, expected) : UINT64_MAX;
+		if (total == UINT64_MAX) {
+			fprintf(stderr, "Out of memory for the check\n");
+			failed = 1;
+		} else {
+			for (uint64_t v = 0; v < n; v++) mismatched += expected[v] != atomic_load_explicit(&job.node_triangles[v], memory_order_relaxed);
+			mismatched += total != triangles;
+			printf("check=%s mismatched=%lu\n", mismatched ? "FAILED" : "OK", (unsigned long)mismatched);
+			failed = mismatched != 0;
+		}
+		free(expected);
+	}
+
+	if (!failed && store && (!slgraph_property_add(&g, "clustering", SLGRAPH_NODE_PROPERTY, SLGRAPH_F64) || slgraph_property_set(&g, "clustering", 0, n, local))) {
+		fprintf(stderr, "Failed to store the clustering coefficients\n");
+		failed = 1;
+	}
+
+	for (slgraph_node_t v = 0; !failed && members && v < n; v++) {
+		printf("%lu %lu %.6f\n", (unsigned long)(original_ids ? slgraph_original_id(&g, v) : v),
+		       (unsigned long)atomic_load_explicit(&job.node_triangles[v], memory_order_relaxed), local[v]);
+	}
+
+	munmap(csr, size);
+	free(job.degree);
+	free((void *)job.node_triangles);
+	free(local);
+	slgraph_close(&g);
+	return failed;
+}
@@ -0,0 +1,290 @@
+// Count weakly connected components in a directed SLGraph, in parallel with Afforest (Sutton, Ben-Nun and Barak).
+//
+// Usage:
+//   slgraph_wcc [--threads N] [--members] [--original-ids] [--store] [--check] <graph.slg>
+//
+// Every node starts as a tree of its own in a union-find forest that the N threads (default: one per CPU) link without
+// locks, always hanging the larger root below the smaller one with compare-and-swap, so that each component ends up
+// labelled with its smallest node. First the first two out-neighbours of every node are linked, which already joins
+// most of a road network into one giant component. The component that 1024 sampled nodes are most often in is then
+// skipped: only the nodes outside it link their remaining out-neighbours and their in-neighbours, which takes care of
+// the edges between it and the rest.
+//
+// --members prints one line "<node> <component>" per node, with the component labelled by its smallest node.
+// --original-ids prints nodes and labels by their ID in the input the graph was loaded from. --store keeps the labels
+// in the node property column "wcc", which other tools can then map (not updated when the graph changes). --check
+// compares the components with those of a sequential breadth-first search.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "slgraph.h"
+
+// Nodes are handed out to threads in chunks of this size.
+#define CHUNK 4096
+
+// Neighbours linked per node before sampling.
+#define NEIGHBOUR_ROUNDS 2
+
+// Nodes sampled to find the largest component.
+#define SAMPLES 1024
+
+typedef enum {
+	PHASE_SAMPLE,    // Link out-neighbour round of every node
+	PHASE_COMPRESS,  // Point every node at its root
+	PHASE_FINISH     // Link the remaining neighbours of the nodes outside skip
+} phase_t;
+
+typedef struct {
+	const slgraph_t *g;
+	_Atomic uint64_t *comp;
+	atomic_uint_fast64_t next;
+	phase_t phase;
+	uint64_t round;
+	uint64_t skip;
+} job_t;
+
+// Join the trees of u and v.
+static void link_nodes(_Atomic uint64_t *comp, uint64_t u, uint64_t v)
+{
+	uint64_t p1 = atomic_load_explicit(&comp[u], memory_order_relaxed);
+	uint64_t p2 = atomic_load_explicit(&comp[v], memory_order_relaxed);
+
+	while (p1 != p2) {
+		uint64_t high = p1 > p2 ? p1 : p2, low = p1 + p2 - high;
+		uint64_t p_high = atomic_load_explicit(&comp[high], memory_order_relaxed);
+		if (p_high == low) break;
+		if (p_high == high && atomic_compare_exchange_strong(&comp[high], &p_high, low)) break;
+		p1 = atomic_load_explicit(&comp[atomic_load_explicit(&comp[high], memory_order_relaxed)], memory_order_relaxed);
+		p2 = atomic_load_explicit(&comp[low], memory_order_relaxed);
+	}
+}
+
+static void *worker(void *arg)
+{
+	job_t *job = arg;
+	const slgraph_t *g = job->g;
+	_Atomic uint64_t *comp = job->comp;
+	uint64_t n = slgraph_nodes(g), first;
+
+	while ((first = atomic_fetch_add(&job->next, CHUNK)) < n) {
+		uint64_t end = first + CHUNK < n ? first + CHUNK : n;
+		for (uint64_t v = first; v < end; v++) {
+			if (job->phase == PHASE_COMPRESS) {
+				uint64_t p;
+				while ((p = atomic_load_explicit(&comp[v], memory_order_relaxed)) != atomic_load_explicit(&comp[p], memory_order_relaxed)) {
+					atomic_store_explicit(&comp[v], atomic_load_explicit(&comp[p], memory_order_relaxed), memory_order_relaxed);
+				}
+			} else if (job->phase == PHASE_SAMPLE) {
+				if (job->round < slgraph_out_degree(g, v)) {
+					slgraph_node_t u = slgraph_out_neighbour(g, v, job->round);
+					if (u < n) link_nodes(comp, v, u);
+				}
+			} else if (atomic_load_explicit(&comp[v], memory_order_relaxed) != job->skip) {
+				uint_fast64_t deg = slgraph_out_degree(g, v);
+				for (uint_fast64_t k = NEIGHBOUR_ROUNDS; k < deg; k++) {
+					slgraph_node_t u = slgraph_out_neighbour(g, v, k);
+					if (u < n) link_nodes(comp, v, u);
+				}
+				deg = slgraph_in_degree(g, v);
+				for (uint_fast64_t k = 0; k < deg; k++) {
+					slgraph_node_t u = slgraph_in_neighbour(g, v, k);
+					if (u < n) link_nodes(comp, v, u);
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+// Run the current phase of job on threads threads.
+static void run(job_t *job, long threads)
+{
+	pthread_t tids[threads];
+	long started = 1;
+
+	atomic_store(&job->next, 0);
+	for (; started < threads; started++) {
+		if (pthread_create(&tids[started], NULL, worker, job)) break;
+	}
+	worker(job);
+	for (long t = 1; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+static uint64_t splitmix(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// The component most of SAMPLES random nodes are in.
+static uint64_t most_frequent(const _Atomic uint64_t *comp, uint64_t n)
+{
+	uint64_t sample[SAMPLES], state = 1, best = 0, best_count = 0;
+
+	for (int i = 0; i < SAMPLES; i++) sample[i] = atomic_load_explicit(&comp[splitmix(&state) % n], memory_order_relaxed);
+	qsort(sample, SAMPLES, sizeof(uint64_t), cmp_u64);
+	for (int i = 0, j; i < SAMPLES; i = j) {
+		for (j = i; j < SAMPLES && sample[j] == sample[i]; j++);
+		if ((uint64_t)(j - i) > best_count) {
+			best_count = j - i;
+			best = sample[i];
+		}
+	}
+	return best;
+}
+
+// Label every node with the smallest node of its component by breadth-first search over out- and in-lists. Returns 0
+// if successful.
+static int bfs_components(const slgraph_t *g, uint64_t *label)
+{
+	uint64_t n = slgraph_nodes(g);
+	slgraph_node_t *queue = malloc(n * sizeof(slgraph_node_t));
+
+	if (!queue) return -1;
+	for (uint64_t v = 0; v < n; v++) label[v] = UINT64_MAX;
+
+	for (uint64_t start = 0; start < n; start++) {
+		uint64_t head = 0, tail = 0;
+		if (label[start] != UINT64_MAX) continue;
+		label[start] = start;
+		queue[tail++] = start;
+		while (head < tail) {
+			slgraph_node_t v = queue[head++];
+			for (int in = 0; in < 2; in++) {
+				uint_fast64_t deg = in ? slgraph_in_degree(g, v) : slgraph_out_degree(g, v);
+				for (uint_fast64_t k = 0; k < deg; k++) {
+					slgraph_node_t u = in ? slgraph_in_neighbour(g, v, k) : slgraph_out_neighbour(g, v, k);
+					if (u >= n || label[u] != UINT64_MAX) continue;
+					label[u] = start;
+					queue[tail++] = u;
+				}
+			}
+		}
+	}
+
+	free(queue);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int members = 0, original_ids = 0, store = 0, check = 0;
+	int argi = 1;
+
+	for (; argi < argc - 1; argi++) {
+		if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc - 1) {
+			threads = atol(argv[++argi]);
+		} else if (strcmp(argv[argi], "--members") == 0) {
+			members = 1;
+		} else if (strcmp(argv[argi], "--original-ids") == 0) {
+			original_ids = 1;
+		} else if (strcmp(argv[argi], "--store") == 0) {
+			store = 1;
+		} else if (strcmp(argv[argi], "--check") == 0) {
+			check = 1;
+		} else {
+			break;
+		}
+	}
+	if (argi != argc - 1) {
+		fprintf(stderr, "Usage: %s [--threads N] [--members] [--original-ids] [--store] [--check] <graph.slg>\n", argv[0]);
+		return 1;
+	}
+	if (threads < 1) threads = 1;
+
+	slgraph_t g;
+	if (slgraph_open_existing(&g, argv[argi], !store)) {
+		fprintf(stderr, "Failed to open graph%s: %s\n", store ? " for writing" : "", argv[argi]);
+		return 1;
+	}
+
+	uint64_t n = slgraph_nodes(&g);
+	if (n == 0) {
+		fprintf(stderr, "Graph has 0 nodes\n");
+		slgraph_close(&g);
+		return 1;
+	}
+
+	_Atomic uint64_t *comp = malloc(n * sizeof(_Atomic uint64_t));
+	uint64_t *size = calloc(n, sizeof(uint64_t));
+	uint64_t *label = malloc(n * sizeof(uint64_t));
+	if (!comp || !size || !label) {
+		fprintf(stderr, "Out of memory for WCC computation\n");
+		free(comp);
+		free(size);
+		free(label);
+		slgraph_close(&g);
+		return 1;
+	}
+	for (uint64_t v = 0; v < n; v++) atomic_init(&comp[v], v);
+
+	job_t job = {.g = &g, .comp = comp};
+	for (job.round = 0; job.round < NEIGHBOUR_ROUNDS; job.round++) {
+		job.phase = PHASE_SAMPLE;
+		run(&job, threads);
+		job.phase = PHASE_COMPRESS;
+		run(&job, threads);
+	}
+	job.skip = most_frequent(comp, n);
+	job.phase = PHASE_FINISH;
+	run(&job, threads);
+	job.phase = PHASE_COMPRESS;
+	run(&job, threads);
+
+	uint64_t wccs = 0, largest = 0;
+	for (uint64_t v = 0; v < n; v++) {
+		label[v] = atomic_load_explicit(&comp[v], memory_order_relaxed);
+		wccs += label[v] == v;
+		if (++size[label[v]] > largest) largest = size[label[v]];
+	}
+
+	printf("Stats: nodes=%lu edges=%lu mode=wcc threads=%ld\n", (unsigned long)n, (unsigned long)slgraph_edges(&g), threads);
+	printf("WCCS=%lu largest=%lu\n", (unsigned long)wccs, (unsigned long)largest);
+
+	int failed = 0;
+	if (check) {
+		// Both label each component with its smallest node, so they must agree exactly.
+		uint64_t *expected = malloc(n * sizeof(uint64_t)), mismatched = 0;
+		if (!expected || bfs_components(&g, expected)) {
+			fprintf(stderr, "Out of memory for BFS\n");
+			failed = 1;
+		} else {
+			for (uint64_t v = 0; v < n; v++) mismatched += label[v] != expected[v];
+			printf("check=%s mismatched=%lu\n", mismatched ? "FAILED" : "OK", (unsigned long)mismatched);
+			failed = mismatched != 0;
+		}
+		free(expected);
+	}
+
+	if (store && (!slgraph_property_add(&g, "wcc", SLGRAPH_NODE_PROPERTY, SLGRAPH_U64) || slgraph_property_set(&g, "wcc", 0, n, label))) {
+		fprintf(stderr, "Failed to store the components\n");
+		failed = 1;
+	}
+
+	for (slgraph_node_t v = 0; members && v < n; v++) {
+		printf("%lu %lu\n", (unsigned long)(original_ids ? slgraph_original_id(&g, v) : v),
+		       (unsigned long)(original_ids ? slgraph_original_id(&g, label[v]) : label[v]));
+	}
+
+	free(comp);
+	free(size);
+	free(label);
+	slgraph_close(&g);
+	return failed;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "weights.h"
+
+#define EARTH_RADIUS 6371008.8 // Mean radius in metres
+#define RADIANS (3.14159265358979323846 / 180.0)
+
+// Great-circle distance in metres between two points given in degrees.
+static double haversine(double lat0, double lon0, double lat1, double lon1)
+{
+	const double rad = RADIANS;
+	double a = sin((lat1 - lat0) * rad / 2), b = sin((lon1 - lon0) * rad / 2);
+	double h = a * a + cos(lat0 * rad) * cos(lat1 * rad) * b * b;
+	return 2 * EARTH_RADIUS * asin(sqrt(h < 1.0 ? h : 1.0));
+}
+
+// Read the node column name as doubles into values (n of them). Returns 0 if successful.
+static int read_node_column(const slgraph_t *g, const char *name, double *values)
+{
+	slgraph_scope_t scope;
+	slgraph_type_t type;
+	uint_fast64_t length;
+	const void *column = slgraph_property(g, name, &scope, &type, &length);
+
+	if (column) {
+		if (scope != SLGRAPH_NODE_PROPERTY || type != SLGRAPH_F64 || length < slgraph_nodes(g)) return -1;
+		memcpy(values, column, slgraph_nodes(g) * sizeof(double));
+		return 0;
+	}
+	return slgraph_property_get(g, name, 0, slgraph_nodes(g), values);
+}
+
+const char *load_weights(const slgraph_t *g, const char *name, int named, const double **weights, double **owned)
+{
+	uint64_t n = slgraph_nodes(g), m = slgraph_edges(g);
+	slgraph_scope_t scope;
+	slgraph_type_t type;
+	uint_fast64_t length;
+	const void *column = slgraph_property(g, name, &scope, &type, &length);
+	double probe;
+
+	*weights = NULL;
+	*owned = NULL;
+	if (column && (scope != SLGRAPH_EDGE_PROPERTY || length < m)) {
+		fprintf(stderr, "Column %s is not an edge property of every edge\n", name);
+		return NULL;
+	}
+
+	if (column && type == SLGRAPH_F64) {
+		*weights = column;
+	} else if (column || !slgraph_property_get(g, name, 0, 0, &probe)) {
+		// Convert other column types; columns of graphs read through the block cache are f64, as the loaders write them.
+		if (!(*owned = malloc((m ? m : 1) * sizeof(double)))) return NULL;
+		if (!column && slgraph_property_get(g, name, 0, m, *owned)) {
+			fprintf(stderr, "Failed to read column %s\n", name);
+			free(*owned);
+			return NULL;
+		}
+		for (uint64_t e = 0; column && e < m; e++) {
+			switch (type) {
+			case SLGRAPH_U8: (*owned)[e] = ((const uint8_t *)column)[e]; break;
+			case SLGRAPH_U32: (*owned)[e] = ((const uint32_t *)column)[e]; break;
+			case SLGRAPH_U64: (*owned)[e] = (double)((const uint64_t *)column)[e]; break;
+			default: (*owned)[e] = ((const float *)column)[e]; break;
+			}
+		}
+		*weights = *owned;
+	} else if (named) {
+		fprintf(stderr, "No edge column %s\n", name);
+		return NULL;
+	} else {
+		double *lat = malloc((n ? n : 1) * sizeof(double)), *lon = malloc((n ? n : 1) * sizeof(double));
+		if (!lat || !lon || read_node_column(g, "lat", lat) || read_node_column(g, "lon", lon)) {
+			free(lat);
+			free(lon);
+			return "unit";
+		}
+		if (!(*owned = malloc((m ? m : 1) * sizeof(double)))) {
+			free(lat);
+			free(lon);
+			return NULL;
+		}
+		for (uint64_t e = 0; e < m; e++) {
+			slgraph_node_t a, b;
+			slgraph_edge_ends(g, e, &a, &b);
+			double d = a < n && b < n ? haversine(lat[a], lon[a], lat[b], lon[b]) : 0.0;
+			(*owned)[e] = isnan(d) ? 0.0 : d;
+		}
+		free(lat);
+		free(lon);
+		*weights = *owned;
+		name = "coords";
+	}
+
+	for (uint64_t e = 0; e < m; e++) {
+		if (!((*weights)[e] >= 0.0)) {
+			fprintf(stderr, "Edge %lu has weight %g, but weights must be non-negative\n", (unsigned long)e, (*weights)[e]);
+			free(*owned);
+			return NULL;
+		}
+	}
+	return name;
+}
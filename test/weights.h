@@ -0,0 +1,18 @@
+// Edge weights for the path tools (slgraph_sssp, slgraph_ch_build, slgraph_ch_query).
+//
+// Weights come from the edge property column name (e.g. "weight", as written by slgraph_load_edgelist --weighted).
+// Unless named is set, graphs without that column use the great-circle lengths in metres between the "lat" and "lon"
+// node columns (slgraph_osm_load --coords; 0 where a node has no coordinates), and otherwise unit weights.
+// Weights must be non-negative.
+
+#ifndef WEIGHTS_H
+#define WEIGHTS_H
+
+#include "slgraph.h"
+
+// Get the weights of the edges of g: *weights is 0 for unit weights, the column itself if it can be used in place, or
+// else an array in *owned (free() it). Returns the source of the weights ("unit", "coords" or the column name), or 0 on
+// error, which is reported on stderr.
+const char *load_weights(const slgraph_t *g, const char *name, int named, const double **weights, double **owned);
+
+#endif